@@ -1,166 +1,287 @@
 #include "AudioPlayer.h"
+#include "NullAudioSink.h"
 #include <cmath>
+#include <vector>
+#include <algorithm>
 
 namespace nv {
-	AudioPlayer::AudioPlayer(WORD nChannels_, DWORD nSamplesPerSec_)
-		: nChannels(nChannels_), nSamplesPerSec(nSamplesPerSec_), pwfx(nullptr), flags(0)
+	AudioPlayer::AudioPlayer(std::shared_ptr<AudioSink> sink_, int nChannels_, int nSamplesPerSec_, double bufferSeconds_)
+		: nChannels(nChannels_), nSamplesPerSec(nSamplesPerSec_), bufferSeconds(bufferSeconds_), sink(sink_),
+		isScrubbing(false), isRunning(false), isPlaying(false), flushPosition(0), flushCount(0), handledFlushCount(0), writeEndPts(-1), remixDelay(0), overflowCount(0), underflowCount(0), isStarved(true),
+		lowWaterFrames(0), isBelowLowWater(false), targetGain(1), currentGain(1), rampTarget(1), rampStep(0)
 	{
 		Init();
 	}
 
-	HRESULT AudioPlayer::Start() {
-		return pAudioClient->Start();
+	AudioPlayer::~AudioPlayer() {
+		isRunning = false;
+		if (renderThread.joinable()) {
+			renderThread.join();
+		}
 	}
 
-	HRESULT AudioPlayer::Stop() {
-		return pAudioClient->Stop();
+	int AudioPlayer::Start() {
+		std::lock_guard<std::mutex> lock(sinkMutex);
+		isPlaying = true;
+		// 暂停期间缓冲区会被填满，水位要重新取
+		drift->Reset();
+		return sink->Start();
 	}
 
-	BYTE* AudioPlayer::GetBuffer(UINT32 wantFrames) {
-		BYTE* buffer;
-		pRenderClient->GetBuffer(wantFrames, &buffer);
-		return buffer;
+	int AudioPlayer::Stop() {
+		std::lock_guard<std::mutex> lock(sinkMutex);
+		isPlaying = false;
+		return sink->Stop();
 	}
 
-	HRESULT AudioPlayer::ReleaseBuffer(UINT32 writtenFrames) {
-		return pRenderClient->ReleaseBuffer(writtenFrames, flags);
-	}
+	int AudioPlayer::Write(const uint8_t* const* data, AVSampleFormat format, int srcChannels, uint64_t srcLayout, uint32_t sampleCount, double pts) {
+		if (!data || srcChannels <= 0) {
+			return -1;
+		}
+
+		remixer->SetCompensation(drift->GetCorrection());
 
-	HRESULT AudioPlayer::WriteFLTP(float* left, float* right, UINT32 sampleCount) {
-		UINT32 padding;
-		pAudioClient->GetCurrentPadding(&padding);
-		if ((maxSampleCount - padding) < sampleCount) { // Ƶд̫ˣֱл֤ʱԵ
-			pAudioClient->Stop();
-			pAudioClient->Reset();
-			pAudioClient->Start();
+		const float* converted = nullptr;
+		int frames = remixer->Convert(data, format, srcLayout, srcChannels, nSamplesPerSec, sampleCount, &converted);
+		if (frames <= 0) {
+			return frames;
 		}
 
-		if (left && right) {
-			auto pData = GetBuffer(sampleCount);
-			for (int i = 0; i < sampleCount; i++) {
-				int p = i * 2;
-				((float*)pData)[p] = left[i];
-				((float*)pData)[p + 1] = right[i];
-			}
+		meter->Process(converted, frames);
+
+		uint32_t written = ring->Write(converted, frames);
+		if (written < (uint32_t)frames) {
+			overflowCount++;
 		}
-		else if (left) {
-			auto pData = GetBuffer(sampleCount);
-			for (int i = 0; i < sampleCount; i++) {
-				int p = i * 2;
-				((float*)pData)[p] = left[i];
-				((float*)pData)[p + 1] = left[i];
-			}
+
+		// 补偿时输出的帧数和输入不一样，时间按输入算；放不下被丢掉的部分按比例扣掉
+		double startPts = pts >= 0 ? pts : writeEndPts.load();
+		if (startPts >= 0) {
+			writeEndPts = startPts + (double)sampleCount * written / frames / nSamplesPerSec;
 		}
+		remixDelay = remixer->GetDelay();
 
+		if (isPlaying && !isScrubbing) {
+			drift->Update((double)GetQueuedFrames(), (double)frames / nSamplesPerSec);
+		}
 
-		return ReleaseBuffer(sampleCount);
+		return 0;
 	}
 
-	HRESULT AudioPlayer::WriteS16(short* data, UINT32 sampleCount)
-	{
-		UINT32 padding;
-		pAudioClient->GetCurrentPadding(&padding);
-		if ((maxSampleCount - padding) < sampleCount) { // Ƶд̫ˣֱл֤ʱԵ
-			pAudioClient->Stop();
-			pAudioClient->Reset();
-			pAudioClient->Start();
-		}
-
-		if (data) {
-			auto pData = GetBuffer(sampleCount);
-			for (size_t i = 0; i < sampleCount * this->nChannels; i++) {
-				float s = (float)data[i];
-				if (s > 0) {
-					s = s / SHRT_MAX;
-				}
-				else if (s < 0) {
-					s = -s / SHRT_MIN;
-				}
-				((float*)pData)[i] = s;
-			}
-			return ReleaseBuffer(sampleCount);
-		}
+	void AudioPlayer::Flush() {
+		flushPosition = ring->GetWritePosition();
+		flushCount++;
+		writeEndPts = -1;
+		drift->Reset();
+		// 重采样器里的旧样本和滤波器状态也不要了，和 Write 在同一个线程
+		remixer->Reset();
+		remixDelay = 0;
+	}
 
-		return -1;
+	void AudioPlayer::SetScrubbing(bool scrubbing) {
+		if (isScrubbing != scrubbing) {
+			isScrubbing = scrubbing;
+			drift->Reset();
+		}
 	}
 
-	HRESULT AudioPlayer::PlaySinWave(int nb_samples) {
+	int AudioPlayer::PlaySinWave(int nb_samples) {
 		auto m_time = 0.0;
 		auto m_deltaTime = 1.0 / nb_samples;
 
-		auto pData = GetBuffer(nb_samples);
+		std::vector<float> samples((size_t)nb_samples * nChannels);
 
 		for (int sample = 0; sample < nb_samples; ++sample) {
 			float value = 0.05 * std::sin(5000 * m_time);
-			int p = sample * nChannels;
-			((float*)pData)[p] = value;
-			((float*)pData)[p + 1] = value;
+			for (int c = 0; c < nChannels; c++) {
+				samples[sample * nChannels + c] = value;
+			}
 			m_time += m_deltaTime;
 		}
 
-		return ReleaseBuffer(nb_samples);
+		return ring->Write(samples.data(), nb_samples) == (uint32_t)nb_samples ? 0 : -1;
+	}
+
+	int AudioPlayer::SetVolume(float v) {
+		return sink->SetVolume(v);
+	}
+
+	void AudioPlayer::SetGain(float gain) {
+		targetGain = gain;
+	}
+
+	float AudioPlayer::GetGain() {
+		return targetGain;
+	}
+
+	LoudnessMeter* AudioPlayer::GetLoudnessMeter() {
+		return meter.get();
+	}
+
+	int AudioPlayer::GetChannels() {
+		return nChannels;
+	}
+
+	uint32_t AudioPlayer::GetBufferedFrames() {
+		return ring->GetReadableFrames();
+	}
+
+	uint64_t AudioPlayer::GetQueuedFrames() {
+		// 还没被音频线程丢掉的旧数据不算，设备缓冲区里的会在那时一起清掉，也不算
+		bool isFlushPending = flushCount != handledFlushCount;
+		uint64_t writePos = ring->GetWritePosition();
+		uint64_t readPos = isFlushPending ? std::max(ring->GetReadPosition(), flushPosition.load()) : ring->GetReadPosition();
+		uint64_t ringFrames = writePos - std::min(readPos, writePos);
+		return ringFrames + (isFlushPending ? 0 : sink->GetPadding());
+	}
+
+	double AudioPlayer::GetLatency() {
+		return (double)(GetQueuedFrames() + remixDelay) / nSamplesPerSec + sink->GetStreamLatency();
+	}
+
+	double AudioPlayer::GetClock() {
+		double endPts = writeEndPts;
+		if (endPts < 0) {
+			return -1;
+		}
+		return std::max(endPts - GetLatency(), 0.0);
+	}
+
+	void AudioPlayer::SetNeedDataCallback(std::function<void()> callback, uint32_t lowWaterFrames_) {
+		std::lock_guard<std::mutex> lock(sinkMutex);
+		needDataCallback = callback;
+		lowWaterFrames = lowWaterFrames_;
+		isBelowLowWater = false;
+	}
+
+	double AudioPlayer::GetDriftCorrection() {
+		return drift->GetCorrection();
+	}
+
+	double AudioPlayer::GetDriftError() {
+		return drift->GetError();
 	}
 
-	HRESULT AudioPlayer::SetVolume(float v) {
-		return pSimpleAudioVolume->SetMasterVolume(v, NULL);
+	uint64_t AudioPlayer::GetOverflowCount() {
+		return overflowCount;
 	}
 
-	HRESULT AudioPlayer::Init() {
-		constexpr auto REFTIMES_PER_SEC = 10000000; // 1sĻ
+	uint64_t AudioPlayer::GetUnderflowCount() {
+		return underflowCount;
+	}
+
+	AudioSink* AudioPlayer::GetSink() {
+		return sink.get();
+	}
+
+	int AudioPlayer::Init() {
+		int ret = sink->Open(nChannels, nSamplesPerSec, bufferSeconds);
+		if (ret < 0) {
+			// 没有可用的设备（没有声卡、设备被独占），换成空设备，时钟照样走，视频还能按音频时钟播放
+			sink = std::make_shared<NullAudioSink>();
+			ret = sink->Open(nChannels, nSamplesPerSec, bufferSeconds);
+		}
 
-		HRESULT hr;
+		// 以设备实际打开的声道数为准，采样率不对时空设备也打不开，至少保证环形缓冲区有声道
+		nChannels = ret >= 0 ? sink->GetChannels() : std::max(nChannels, 2);
+		remixer = std::make_unique<AudioRemixer>(sink->GetChannelLayout(), nChannels, nSamplesPerSec);
+		// 环形缓冲区放 1 秒
+		ring = std::make_unique<AudioRingBuffer>(nChannels, (uint32_t)nSamplesPerSec);
+		meter = std::make_unique<LoudnessMeter>(nChannels, nSamplesPerSec, sink->GetChannelLayout());
+		drift = std::make_unique<DriftController>(nSamplesPerSec);
 
-		hr = pEnumerator.CoCreateInstance(__uuidof(MMDeviceEnumerator));
+		if (ret >= 0) {
+			isRunning = true;
+			renderThread = std::thread(&AudioPlayer::RenderLoop, this);
+		}
 
-		hr = pEnumerator->GetDefaultAudioEndpoint(
-			eRender, eConsole, &pDevice);
+		return ret;
+	}
 
-		hr = pDevice->Activate(
-			__uuidof(IAudioClient), CLSCTX_ALL,
-			NULL, (void**)&pAudioClient);
+	void AudioPlayer::RenderLoop() {
+		while (isRunning) {
+			sink->WaitForBuffer(50);
+			FillSink();
+		}
+	}
 
-		CComPtr<IAudioSessionManager> pAudioSessionManager;
-		hr = pDevice->Activate(
-			__uuidof(IAudioSessionManager), CLSCTX_INPROC_SERVER,
-			NULL, (void**)&pAudioSessionManager
-		);
+	void AudioPlayer::FillSink() {
+		std::lock_guard<std::mutex> lock(sinkMutex);
 
-		CComPtr<IAudioSessionControl> pAudioSession;
-		hr = pAudioSessionManager->GetAudioSessionControl(
-			&GUID_NULL,
-			FALSE,
-			&pAudioSession
-		);
+		// 处理 Flush：环形缓冲区和设备缓冲区里的旧数据都不要了
+		// 先取次数再取位置，位置至少和次数一样新
+		uint64_t count = flushCount;
+		if (count != handledFlushCount) {
+			ring->SkipTo(flushPosition);
+			sink->Stop();
+			sink->Reset();
+			if (isPlaying) {
+				sink->Start();
+			}
+			isStarved = true;
+			handledFlushCount = count;
+		}
 
-		hr = pAudioSessionManager->GetSimpleAudioVolume(
-			&GUID_NULL,
-			0,
-			&pSimpleAudioVolume
-		);
+		if (!isPlaying) {
+			return;
+		}
 
-		hr = pAudioClient->GetMixFormat(&pwfx);
+		// 只在设备从有数据变成没数据时记一次
+		uint32_t padding = sink->GetPadding();
+		bool starved = padding == 0;
+		if (starved && !isStarved) {
+			underflowCount++;
+		}
+		isStarved = starved;
 
-		// ǿƵ豸ͬĲ
-		pwfx->nSamplesPerSec = nSamplesPerSec;
-		// ̶˫
-		pwfx->nAvgBytesPerSec = pwfx->nSamplesPerSec * nChannels * (pwfx->wBitsPerSample / 8);
-		// ʹָʽ
-		pwfx->wFormatTag = WAVE_FORMAT_EXTENSIBLE;
+		uint32_t frames = std::min(sink->GetBufferFrames() - padding, ring->GetReadableFrames());
+		if (frames > 0) {
+			float* pData = sink->GetBuffer(frames);
+			if (!pData) {
+				return;
+			}
+			ring->Read(pData, frames);
+			ApplyGain(pData, frames);
+			sink->ReleaseBuffer(frames);
+		}
 
-		hr = pAudioClient->Initialize(
-			AUDCLNT_SHAREMODE_SHARED,
-			AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM | AUDCLNT_STREAMFLAGS_SRC_DEFAULT_QUALITY, // flagϵͳҪز
-			REFTIMES_PER_SEC,
-			0,
-			pwfx,
-			NULL);
+		// 只在越过低水位的那一次通知
+		bool isBelow = ring->GetReadableFrames() < lowWaterFrames;
+		if (isBelow && !isBelowLowWater && needDataCallback) {
+			needDataCallback();
+		}
+		isBelowLowWater = isBelow;
+	}
 
-		hr = pAudioClient->GetService(
-			__uuidof(IAudioRenderClient),
-			(void**)&pRenderClient);
+	void AudioPlayer::ApplyGain(float* data, uint32_t frames) {
+		float target = targetGain;
+		if (target != rampTarget) {
+			constexpr float rampSeconds = 0.5;
+			rampTarget = target;
+			rampStep = std::abs(target - currentGain) / (rampSeconds * nSamplesPerSec);
+		}
 
-		maxSampleCount = pwfx->nSamplesPerSec;
+		uint32_t i = 0;
+		// 过渡中：每帧向目标靠近一步
+		for (; i < frames && currentGain != rampTarget; i++) {
+			if (currentGain < rampTarget) {
+				currentGain = std::min(currentGain + rampStep, rampTarget);
+			}
+			else {
+				currentGain = std::max(currentGain - rampStep, rampTarget);
+			}
+			for (int c = 0; c < nChannels; c++) {
+				data[i * nChannels + c] *= currentGain;
+			}
+		}
 
-		return hr;
+		// 剩下的是固定增益，增益为 1 时什么都不用做
+		if (i < frames && currentGain != 1.0f) {
+			float* p = data + (size_t)i * nChannels;
+			size_t count = (size_t)(frames - i) * nChannels;
+			for (size_t k = 0; k < count; k++) {
+				p[k] *= currentGain;
+			}
+		}
 	}
-}
\ No newline at end of file
+}
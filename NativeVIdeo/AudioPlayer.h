@@ -1,48 +1,144 @@
 #pragma once
-#include <Windows.h>
-#include <atlcomcli.h>
-#include <mmdeviceapi.h>
-#include <Audioclient.h>
-#include <audiopolicy.h>
+#include <stdint.h>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+
+#include "AudioSink.h"
+#include "AudioRemixer.h"
+#include "AudioRingBuffer.h"
+#include "LoudnessMeter.h"
+#include "DriftController.h"
 
 namespace nv {
+	// 解码线程调用 Write 把音频放进无锁环形缓冲区，独立的音频线程在设备需要数据时从里面取出来交给 AudioSink
+	// 设备时钟和媒体时钟的漂移由 DriftController 按缓冲区水位微调重采样比例来吸收
 	class AudioPlayer {
 	public:
-		AudioPlayer(WORD nChannels_, DWORD nSamplesPerSec_);
+		// nChannels_ <= 0 表示使用设备原生的声道数。sink_ 打不开时改用 NullAudioSink，GetSink 返回实际用的设备
+		// bufferSeconds_ 是设备缓冲区时长，越小音量、暂停、跳转的反应越快，但越容易欠载
+		AudioPlayer(std::shared_ptr<AudioSink> sink_, int nChannels_, int nSamplesPerSec_, double bufferSeconds_ = 0.05);
+
+		~AudioPlayer();
+
+		int Start();
+
+		int Stop();
+
+		// 写入一帧解码出来的音频，任意 AVSampleFormat 和声道布局，统一转换成设备布局的交错 float
+		// srcLayout 为 0 时按声道数取默认布局。环形缓冲区放不下的部分会被丢弃并记一次溢出
+		// pts 是这一帧第一个样本的时间（秒），小于 0 表示紧接着上一帧
+		int Write(const uint8_t* const* data, AVSampleFormat format, int srcChannels, uint64_t srcLayout, uint32_t sampleCount, double pts = -1);
+
+		// 丢弃所有还没播放的音频，跳转进度时调用
+		void Flush();
+
+		// 拖动进度条时写入的是一段段的颗粒，不是连续播放，缓冲区水位和时钟漂移无关
+		// 拖动期间不更新漂移补偿，保持拖动前的值；结束后重新预热。和 Write 在同一个线程调用
+		void SetScrubbing(bool scrubbing);
+
+		// 播放正弦波，仅仅只是用来测试你的喇叭会不会响
+		int PlaySinWave(int nb_samples);
+
+		// 设置音量
+		int SetVolume(float v);
+
+		// 响度归一化用的软件增益，和音量分开。在音频线程里用 0.5 秒线性过渡到新值，不会有爆音
+		void SetGain(float gain);
+
+		float GetGain();
+
+		// 播放过程中写入的音频的响度（按设备布局测量），只在调用 Write 的线程访问
+		LoudnessMeter* GetLoudnessMeter();
+
+		int GetChannels();
 
-		HRESULT Start();
+		// 环形缓冲区里还没交给设备的帧数
+		uint32_t GetBufferedFrames();
 
-		HRESULT Stop();
+		// 现在写入的样本要多久才能被听到（秒）：重采样器 + 环形缓冲区 + 设备缓冲区 + 设备自身的延迟
+		double GetLatency();
 
-		BYTE* GetBuffer(UINT32 wantFrames);
+		// 现在正在被听到的样本的时间（秒），音画同步以它为准。还没写入过数据时返回负数
+		double GetClock();
 
-		HRESULT ReleaseBuffer(UINT32 writtenFrames);
+		// 音频线程取完数据后，环形缓冲区从 lowWaterFrames 以上降到以下时调用一次 callback
+		// 调用方可以据此只在需要数据时才醒来解码，callback 在音频线程里执行，要尽量短
+		void SetNeedDataCallback(std::function<void()> callback, uint32_t lowWaterFrames);
 
-		// FLTP ʽֿǰǺϲһ𣬡ҡ
-		HRESULT WriteFLTP(float* left, float* right, UINT32 sampleCount);
+		// 当前的时钟漂移补偿（ppm）
+		double GetDriftCorrection();
 
-		HRESULT WriteS16(short* data, UINT32 sampleCount);
+		// 缓冲区水位和目标的差（秒）
+		double GetDriftError();
 
-		// ҲֻȻ᲻
-		HRESULT PlaySinWave(int nb_samples);
+		// Write 时环形缓冲区放不下的次数
+		uint64_t GetOverflowCount();
 
-		// 
-		HRESULT SetVolume(float v);
+		// 播放中设备缓冲区被放空的次数
+		uint64_t GetUnderflowCount();
+
+		AudioSink* GetSink();
 	private:
-		WORD nChannels;
-		DWORD nSamplesPerSec;
-		int maxSampleCount; // С
+		int nChannels;
+		int nSamplesPerSec;
+		double bufferSeconds;
+
+		std::shared_ptr<AudioSink> sink;
+
+		std::unique_ptr<AudioRemixer> remixer;
+
+		std::unique_ptr<AudioRingBuffer> ring;
+
+		std::unique_ptr<LoudnessMeter> meter;
+
+		// 只在调用 Write 的线程访问
+		std::unique_ptr<DriftController> drift;
+		bool isScrubbing;
+
+		std::thread renderThread;
+		std::atomic<bool> isRunning;
+		std::atomic<bool> isPlaying;
+		// Flush 时记下的写位置，音频线程把这之前的数据全部丢掉
+		std::atomic<uint64_t> flushPosition;
+		// Flush 的次数和音频线程处理过的次数，不相等时设备缓冲区里还是 Flush 之前的数据
+		// 不能只比较读写位置：Flush 时环形缓冲区可能已经被读空了
+		std::atomic<uint64_t> flushCount;
+		std::atomic<uint64_t> handledFlushCount;
+		// 最后写入的样本结束时的时间，负数表示还没有
+		std::atomic<double> writeEndPts;
+		// 重采样器里还没输出到环形缓冲区的帧数，Write 之后更新
+		std::atomic<int> remixDelay;
+		// 设备控制（Start/Stop/Reset）和填数据不能同时进行
+		std::mutex sinkMutex;
+
+		std::atomic<uint64_t> overflowCount;
+		std::atomic<uint64_t> underflowCount;
+		bool isStarved; // 只在音频线程里访问
+
+		// 受 sinkMutex 保护
+		std::function<void()> needDataCallback;
+		uint32_t lowWaterFrames;
+		bool isBelowLowWater;
+
+		std::atomic<float> targetGain;
+		// 下面三个只在音频线程里访问
+		float currentGain;
+		float rampTarget;
+		float rampStep;
+
+		int Init();
+
+		// 写入了但还没播放的帧数：环形缓冲区（不算等着被 Flush 掉的）+ 设备缓冲区
+		uint64_t GetQueuedFrames();
 
-		WAVEFORMATEX* pwfx;
-		CComPtr<IMMDeviceEnumerator> pEnumerator;
-		CComPtr<IMMDevice> pDevice;
-		CComPtr<IAudioClient> pAudioClient;
-		CComPtr<IAudioRenderClient> pRenderClient;
-		CComPtr<ISimpleAudioVolume> pSimpleAudioVolume;
+		void RenderLoop();
 
-		DWORD flags = 0;
+		void FillSink();
 
-		HRESULT Init();
+		void ApplyGain(float* data, uint32_t frames);
 
 	};
-}
\ No newline at end of file
+}
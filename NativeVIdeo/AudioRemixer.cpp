@@ -0,0 +1,147 @@
+#include "AudioRemixer.h"
+#include "SampleConvert.h"
+#include <stddef.h>
+#include <cmath>
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/opt.h>
+#include <libswresample/swresample.h>
+}
+
+#ifdef _MSC_VER
+#pragma comment(lib, "swresample.lib")
+#endif
+
+namespace nv {
+	AudioRemixer::AudioRemixer(uint64_t outLayout_, int outChannels_, int outRate_)
+		: outLayout(outLayout_), outChannels(outChannels_), outRate(outRate_), compensation(0), isResampling(false), lastContext(nullptr)
+	{
+		if (outLayout == 0 || av_get_channel_layout_nb_channels(outLayout) != outChannels) {
+			outLayout = av_get_default_channel_layout(outChannels);
+		}
+	}
+
+	AudioRemixer::~AudioRemixer() {
+		for (auto& item : contexts) {
+			swr_free(&item.second);
+		}
+	}
+
+	void AudioRemixer::SetCompensation(double ppm) {
+		compensation = ppm;
+	}
+
+	void AudioRemixer::Reset() {
+		for (auto& item : contexts) {
+			if (item.second) {
+				swr_init(item.second);
+			}
+		}
+		isResampling = false;
+		lastContext = nullptr;
+	}
+
+	int AudioRemixer::GetDelay() {
+		return lastContext ? (int)swr_get_delay(lastContext, outRate) : 0;
+	}
+
+	int AudioRemixer::GetOutChannels() {
+		return outChannels;
+	}
+
+	int AudioRemixer::GetContextCount() {
+		return (int)contexts.size();
+	}
+
+	SwrContext* AudioRemixer::GetContext(uint64_t inLayout, AVSampleFormat format, int inRate) {
+		InputKey key(inLayout, format, inRate);
+		auto it = contexts.find(key);
+		if (it != contexts.end()) {
+			return it->second;
+		}
+
+		SwrContext* swr = swr_alloc_set_opts(nullptr,
+			outLayout, AV_SAMPLE_FMT_FLT, outRate,
+			inLayout, format, inRate,
+			0, nullptr);
+
+		if (swr) {
+			// 采样率相同也要经过重采样器才能补偿；比例会一直微调，相位之间做线性插值
+			av_opt_set_int(swr, "flags", SWR_FLAG_RESAMPLE, 0);
+			av_opt_set_int(swr, "linear_interp", 1, 0);
+		}
+
+		if (swr && swr_init(swr) < 0) {
+			swr_free(&swr);
+		}
+
+		contexts[key] = swr;
+		return swr;
+	}
+
+	int AudioRemixer::Convert(const uint8_t* const* src, AVSampleFormat format, uint64_t inLayout, int inChannels, int inRate,
+		int nbSamples, const float** out) {
+		if (inLayout == 0 || av_get_channel_layout_nb_channels(inLayout) != inChannels) {
+			inLayout = av_get_default_channel_layout(inChannels);
+		}
+
+		// 布局和采样率都一样，补偿在死区以内时只需要转换样本格式
+		if (inLayout == outLayout && inRate == outRate) {
+			double magnitude = std::abs(compensation);
+			if (!isResampling && magnitude > deadband) {
+				isResampling = true;
+			}
+
+			if (!isResampling || magnitude < deadband / 2) {
+				auto convert = GetSampleConverter(format);
+				if (!convert) {
+					return -1;
+				}
+				// 刚从重采样器切回来：先把它里面剩下的样本接在前面，不丢也不重复
+				int tailFrames = isResampling ? Drain(lastContext) : 0;
+				isResampling = false;
+				lastContext = nullptr;
+
+				outBuffer.resize((size_t)(tailFrames + nbSamples) * outChannels);
+				convert(src, outBuffer.data() + (size_t)tailFrames * outChannels, nbSamples, outChannels);
+				*out = outBuffer.data();
+				return tailFrames + nbSamples;
+			}
+		}
+
+		auto swr = GetContext(inLayout, format, inRate);
+		if (!swr) {
+			return -1;
+		}
+		lastContext = swr;
+
+		// 在接下来 compensationDistance 个输出样本里多产生（或少产生）sampleDelta 个，精度 0.1ppm
+		// 每次转换都重新设置，这样补偿永远不会因为走完了 distance 而停下
+		constexpr int compensationDistance = 10000000;
+		int sampleDelta = (int)std::lround(compensation * compensationDistance / 1e6);
+		swr_set_compensation(swr, sampleDelta, compensationDistance);
+
+		int maxOutFrames = swr_get_out_samples(swr, nbSamples);
+		outBuffer.resize((size_t)maxOutFrames * outChannels);
+		uint8_t* dst[] = { (uint8_t*)outBuffer.data() };
+		int ret = swr_convert(swr, dst, maxOutFrames, (const uint8_t**)src, nbSamples);
+		*out = outBuffer.data();
+		return ret;
+	}
+
+	int AudioRemixer::Drain(SwrContext* swr) {
+		if (!swr) {
+			return 0;
+		}
+
+		int maxOutFrames = swr_get_out_samples(swr, 0);
+		outBuffer.resize((size_t)std::max(maxOutFrames, 0) * outChannels);
+		uint8_t* dst[] = { (uint8_t*)outBuffer.data() };
+		int ret = maxOutFrames > 0 ? swr_convert(swr, dst, maxOutFrames, nullptr, 0) : 0;
+		// 下次再进入时从干净的状态开始
+		swr_init(swr);
+		return std::max(ret, 0);
+	}
+}
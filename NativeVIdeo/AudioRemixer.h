@@ -0,0 +1,70 @@
+#pragma once
+#include <stdint.h>
+#include <map>
+#include <tuple>
+#include <vector>
+
+extern "C" {
+#include <libavutil/samplefmt.h>
+}
+
+struct SwrContext;
+
+namespace nv {
+	// 把任意声道布局的音频转换成输出设备的布局（交错 float）
+	// 布局和采样率相同时直接走 SampleConvert 的 SIMD 内核；不同时用 libswresample 做上下混音，
+	// 每一种输入（布局、格式、采样率）只创建一次 SwrContext，之后一直复用
+	// 时钟漂移补偿超出死区时，布局相同的输入也改走重采样器，回到死区一半以内再切回来，切换都在两次 Convert 之间
+	class AudioRemixer {
+	public:
+		AudioRemixer(uint64_t outLayout_, int outChannels_, int outRate_);
+
+		~AudioRemixer();
+
+		AudioRemixer(const AudioRemixer&) = delete;
+		AudioRemixer& operator=(const AudioRemixer&) = delete;
+
+		// 转换 nbSamples 个输入帧，返回输出的帧数，负数表示失败
+		// 结果放在内部缓冲区，out 指向它，下一次调用前有效
+		int Convert(const uint8_t* const* src, AVSampleFormat format, uint64_t inLayout, int inChannels, int inRate,
+			int nbSamples, const float** out);
+
+		// 设置时钟漂移补偿，正数表示多产生样本（ppm），下一次 Convert 生效
+		void SetCompensation(double ppm);
+
+		// 丢掉重采样器里缓存的样本和滤波器状态，回到直接转换，跳转时调用
+		void Reset();
+
+		// 重采样器里已经输入、还没输出的帧数（按输出采样率），直接转换时为 0
+		int GetDelay();
+
+		// 补偿在这个范围以内时，布局相同的输入不经过重采样器
+		static constexpr double deadband = 20; // ppm
+
+		int GetOutChannels();
+
+		// 创建过多少个 SwrContext
+		int GetContextCount();
+
+	private:
+		typedef std::tuple<uint64_t, int, int> InputKey; // 布局、格式、采样率
+
+		SwrContext* GetContext(uint64_t inLayout, AVSampleFormat format, int inRate);
+
+		// 把 swr 里剩下的样本全部输出到 outBuffer 开头并清空它的状态，返回输出的帧数
+		int Drain(SwrContext* swr);
+
+		uint64_t outLayout;
+		int outChannels;
+		int outRate;
+
+		double compensation;
+		// 布局相同的输入当前是否在走重采样器
+		bool isResampling;
+		// 上一次转换用的 SwrContext，直接转换时为 nullptr
+		SwrContext* lastContext;
+
+		std::map<InputKey, SwrContext*> contexts;
+		std::vector<float> outBuffer;
+	};
+}
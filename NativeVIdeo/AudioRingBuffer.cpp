@@ -0,0 +1,74 @@
+#include "AudioRingBuffer.h"
+#include <string.h>
+#include <algorithm>
+
+namespace nv {
+	AudioRingBuffer::AudioRingBuffer(int nChannels_, uint32_t capacityFrames_)
+		: nChannels(nChannels_), capacity(capacityFrames_), buffer((size_t)nChannels_ * capacityFrames_), readPos(0), writePos(0)
+	{
+	}
+
+	uint32_t AudioRingBuffer::Write(const float* data, uint32_t frames) {
+		uint64_t w = writePos.load(std::memory_order_relaxed);
+		uint64_t r = readPos.load(std::memory_order_acquire);
+		uint32_t space = capacity - (uint32_t)(w - r);
+		frames = std::min(frames, space);
+
+		uint32_t offset = (uint32_t)(w % capacity);
+		uint32_t first = std::min(frames, capacity - offset);
+		memcpy(&buffer[(size_t)offset * nChannels], data, (size_t)first * nChannels * sizeof(float));
+		if (frames > first) {
+			memcpy(&buffer[0], data + (size_t)first * nChannels, (size_t)(frames - first) * nChannels * sizeof(float));
+		}
+
+		writePos.store(w + frames, std::memory_order_release);
+		return frames;
+	}
+
+	uint64_t AudioRingBuffer::GetWritePosition() {
+		return writePos.load(std::memory_order_acquire);
+	}
+
+	uint32_t AudioRingBuffer::Read(float* data, uint32_t frames) {
+		uint64_t r = readPos.load(std::memory_order_relaxed);
+		uint64_t w = writePos.load(std::memory_order_acquire);
+		frames = std::min(frames, (uint32_t)(w - r));
+
+		uint32_t offset = (uint32_t)(r % capacity);
+		uint32_t first = std::min(frames, capacity - offset);
+		memcpy(data, &buffer[(size_t)offset * nChannels], (size_t)first * nChannels * sizeof(float));
+		if (frames > first) {
+			memcpy(data + (size_t)first * nChannels, &buffer[0], (size_t)(frames - first) * nChannels * sizeof(float));
+		}
+
+		readPos.store(r + frames, std::memory_order_release);
+		return frames;
+	}
+
+	void AudioRingBuffer::SkipTo(uint64_t position) {
+		uint64_t r = readPos.load(std::memory_order_relaxed);
+		uint64_t w = writePos.load(std::memory_order_acquire);
+		position = std::min(position, w);
+		if (position > r) {
+			readPos.store(position, std::memory_order_release);
+		}
+	}
+
+	uint64_t AudioRingBuffer::GetReadPosition() {
+		return readPos.load(std::memory_order_acquire);
+	}
+
+	uint32_t AudioRingBuffer::GetReadableFrames() {
+		uint64_t r = readPos.load(std::memory_order_acquire);
+		uint64_t w = writePos.load(std::memory_order_acquire);
+		return (uint32_t)(w - r);
+	}
+
+	uint32_t AudioRingBuffer::GetCapacity() {
+		return capacity;
+	}
+
+	int AudioRingBuffer::GetChannels() {
+		return nChannels;
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+namespace nv {
+	// 单生产者单消费者的无锁环形缓冲区，存交错 float
+	// 读写位置是单调递增的帧计数，生产者只改 writePos，消费者只改 readPos
+	class AudioRingBuffer {
+	public:
+		AudioRingBuffer(int nChannels_, uint32_t capacityFrames_);
+
+		// 生产者：写入帧，放不下的部分直接丢掉，返回实际写入的帧数
+		uint32_t Write(const float* data, uint32_t frames);
+
+		uint64_t GetWritePosition();
+
+		// 消费者：读出最多 frames 帧，返回实际读出的帧数
+		uint32_t Read(float* data, uint32_t frames);
+
+		// 消费者：丢弃 position 之前的所有数据
+		void SkipTo(uint64_t position);
+
+		uint64_t GetReadPosition();
+
+		// 两边都可以调用，结果只是某一时刻的快照
+		uint32_t GetReadableFrames();
+
+		uint32_t GetCapacity();
+
+		int GetChannels();
+
+	private:
+		int nChannels;
+		uint32_t capacity;
+		std::vector<float> buffer;
+
+		std::atomic<uint64_t> readPos;
+		std::atomic<uint64_t> writePos;
+	};
+}
@@ -0,0 +1,321 @@
+#include "AudioScrubCache.h"
+#include "SampleConvert.h"
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+namespace nv {
+	AudioScrubCache::AudioScrubCache(const std::string& filePath_, int streamIndex_, double startSecond_)
+		: filePath(filePath_), streamIndex(streamIndex_), startSecond(startSecond_), fmtCtx(nullptr), codecCtx(nullptr),
+		nChannels(0), sampleRate(0), channelLayout(0), totalChunks(INT64_MAX / 2), segmentStart(-1), decodePosition(-1),
+		centerChunk(0), isStopping(false)
+	{
+		if (avformat_open_input(&fmtCtx, filePath.c_str(), NULL, NULL) < 0) {
+			fmtCtx = nullptr;
+			return;
+		}
+		avformat_find_stream_info(fmtCtx, NULL);
+		if (streamIndex < 0 || streamIndex >= (int)fmtCtx->nb_streams) {
+			return;
+		}
+
+		// 只要这一条音频流
+		for (unsigned i = 0; i < fmtCtx->nb_streams; i++) {
+			fmtCtx->streams[i]->discard = (int)i == streamIndex ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+		}
+
+		auto codecpar = fmtCtx->streams[streamIndex]->codecpar;
+		const AVCodec* codec = avcodec_find_decoder(codecpar->codec_id);
+		if (!codec) {
+			return;
+		}
+		codecCtx = avcodec_alloc_context3(codec);
+		avcodec_parameters_to_context(codecCtx, codecpar);
+		codecCtx->thread_count = 1;
+		if (avcodec_open2(codecCtx, codec, NULL) < 0 || codecCtx->channels <= 0 || codecCtx->sample_rate <= 0) {
+			return;
+		}
+
+		nChannels = codecCtx->channels;
+		sampleRate = codecCtx->sample_rate;
+		channelLayout = codecCtx->channel_layout;
+		if (fmtCtx->duration != AV_NOPTS_VALUE && fmtCtx->duration > 0) {
+			totalChunks = (int64_t)std::ceil((double)fmtCtx->duration / AV_TIME_BASE) + 1;
+		}
+
+		decodeThread = std::thread(&AudioScrubCache::Run, this);
+	}
+
+	AudioScrubCache::~AudioScrubCache() {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			isStopping = true;
+		}
+		cond.notify_all();
+		if (decodeThread.joinable()) {
+			decodeThread.join();
+		}
+
+		avcodec_free_context(&codecCtx);
+		if (fmtCtx) {
+			avformat_close_input(&fmtCtx);
+		}
+	}
+
+	void AudioScrubCache::SetCenter(double second) {
+		int64_t index = (int64_t)std::floor(std::max(second, 0.0));
+		if (centerChunk.exchange(index) != index) {
+			std::lock_guard<std::mutex> lock(mtx);
+			cond.notify_all();
+		}
+	}
+
+	bool AudioScrubCache::Read(double second, uint32_t frames, float* out) {
+		if (sampleRate <= 0) {
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(mtx);
+		int64_t position = std::max<int64_t>(std::llround(second * sampleRate), 0);
+		uint32_t done = 0;
+		while (done < frames) {
+			int64_t index = position / sampleRate;
+			auto it = chunks.find(index);
+			if (it == chunks.end() || !it->second.isComplete) {
+				return false;
+			}
+
+			uint32_t offset = (uint32_t)(position - index * sampleRate);
+			uint32_t n = std::min(frames - done, (uint32_t)sampleRate - offset);
+			memcpy(out + (size_t)done * nChannels, &it->second.samples[(size_t)offset * nChannels], (size_t)n * nChannels * sizeof(float));
+			done += n;
+			position += n;
+		}
+		return true;
+	}
+
+	int AudioScrubCache::GetChannels() {
+		return nChannels;
+	}
+
+	int AudioScrubCache::GetSampleRate() {
+		return sampleRate;
+	}
+
+	uint64_t AudioScrubCache::GetChannelLayout() {
+		return channelLayout;
+	}
+
+	int AudioScrubCache::GetChunkCount() {
+		std::lock_guard<std::mutex> lock(mtx);
+		int count = 0;
+		for (auto& item : chunks) {
+			count += item.second.isComplete;
+		}
+		return count;
+	}
+
+	void AudioScrubCache::Run() {
+		while (true) {
+			int64_t index = 0;
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				cond.wait(lock, [&] { return isStopping || FindMissingChunk(index); });
+				if (isStopping) {
+					break;
+				}
+			}
+
+			DecodeFrom(index);
+
+			std::lock_guard<std::mutex> lock(mtx);
+			Evict();
+		}
+	}
+
+	bool AudioScrubCache::FindMissingChunk(int64_t& index) {
+		int64_t center = centerChunk;
+
+		auto isMissing = [&](int64_t i) {
+			if (i < 0 || i >= totalChunks) {
+				return false;
+			}
+			auto it = chunks.find(i);
+			return it == chunks.end() || !it->second.isComplete;
+		};
+
+		// 中心块最优先
+		if (isMissing(center)) {
+			index = center;
+			return true;
+		}
+
+		// 其次是解码器能接着往下解、不用 seek 的块
+		if (decodePosition >= 0) {
+			int64_t next = decodePosition / sampleRate;
+			if (next >= center - behindChunks && next < center + aheadChunks && isMissing(next)) {
+				index = next;
+				return true;
+			}
+		}
+
+		// 然后往后，播放和拖动大多是往后走的
+		for (int64_t i = center + 1; i < center + aheadChunks; i++) {
+			if (isMissing(i)) {
+				index = i;
+				return true;
+			}
+		}
+
+		// 最后是前面的，从最远的开始，这样之后可以一路接着解下来
+		for (int64_t i = center - behindChunks; i < center; i++) {
+			if (isMissing(i)) {
+				index = i;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void AudioScrubCache::DecodeFrom(int64_t index) {
+		int64_t chunkStart = index * sampleRate;
+
+		// 解码器在这块前面不远或者已经解到这块里面（当前段覆盖了块的开头）就接着往下解，否则 seek 过去
+		bool canContinue = decodePosition >= 0 && segmentStart <= chunkStart &&
+			decodePosition < chunkStart + sampleRate && chunkStart - decodePosition <= 2 * (int64_t)sampleRate;
+		if (!canContinue) {
+			constexpr double prerollSeconds = 0.5;
+			double second = std::max((double)index - prerollSeconds, 0.0) + startSecond;
+			auto timeBase = fmtCtx->streams[streamIndex]->time_base;
+			int64_t timestamp = (int64_t)(second * timeBase.den / timeBase.num);
+			av_seek_frame(fmtCtx, streamIndex, timestamp, AVSEEK_FLAG_BACKWARD);
+			avcodec_flush_buffers(codecCtx);
+			decodePosition = -1;
+			segmentStart = -1;
+		}
+
+		auto timeBase = fmtCtx->streams[streamIndex]->time_base;
+		double timeBaseDouble = (double)timeBase.num / timeBase.den;
+		std::vector<float> samples;
+
+		AVPacket* packet = av_packet_alloc();
+		AVFrame* frame = av_frame_alloc();
+
+		auto receiveFrames = [&]() {
+			while (avcodec_receive_frame(codecCtx, frame) == 0) {
+				auto convert = GetSampleConverter((AVSampleFormat)frame->format);
+				if (convert && frame->channels == nChannels && frame->nb_samples > 0) {
+					int64_t first = decodePosition;
+					if (frame->best_effort_timestamp != AV_NOPTS_VALUE) {
+						int64_t ptsSample = std::llround((frame->best_effort_timestamp * timeBaseDouble - startSecond) * sampleRate);
+						// 时间戳的舍入误差不算断开
+						if (decodePosition < 0 || std::abs(ptsSample - decodePosition) > 32) {
+							first = ptsSample;
+						}
+					}
+					if (first < 0 && decodePosition < 0) {
+						first = 0;
+					}
+
+					if (segmentStart < 0) {
+						// seek 只能落到目标之前或者最早的数据上，目标块前面缺的部分就当作静音
+						segmentStart = std::min(first, chunkStart);
+					}
+
+					samples.resize((size_t)frame->nb_samples * nChannels);
+					convert(frame->extended_data, samples.data(), frame->nb_samples, nChannels);
+
+					std::lock_guard<std::mutex> lock(mtx);
+					PutSamples(first, samples.data(), frame->nb_samples);
+					decodePosition = first + frame->nb_samples;
+					MarkComplete(decodePosition);
+				}
+				av_frame_unref(frame);
+			}
+		};
+
+		auto isChunkDone = [&]() {
+			std::lock_guard<std::mutex> lock(mtx);
+			auto it = chunks.find(index);
+			return it != chunks.end() && it->second.isComplete;
+		};
+
+		while (!isStopping && !isChunkDone()) {
+			int ret = av_read_frame(fmtCtx, packet);
+			if (ret < 0) {
+				// 文件读完了：剩下的都算完整，文件长度也确定了
+				avcodec_send_packet(codecCtx, NULL);
+				receiveFrames();
+
+				std::lock_guard<std::mutex> lock(mtx);
+				int64_t end = std::max(decodePosition, chunkStart);
+				if (segmentStart < 0) {
+					segmentStart = chunkStart;
+				}
+				PutSamples(end, nullptr, 0);
+				MarkComplete(INT64_MAX / 2);
+				totalChunks = std::max<int64_t>((end + sampleRate - 1) / sampleRate, index + 1);
+				decodePosition = -1;
+				break;
+			}
+
+			if (packet->stream_index == streamIndex && avcodec_send_packet(codecCtx, packet) == 0) {
+				receiveFrames();
+			}
+			av_packet_unref(packet);
+		}
+
+		av_frame_free(&frame);
+		av_packet_free(&packet);
+	}
+
+	void AudioScrubCache::PutSamples(int64_t firstSample, const float* data, uint32_t frames) {
+		// frames 为 0 时只确保 firstSample 所在的块存在
+		int64_t firstIndex = firstSample / sampleRate;
+		int64_t lastIndex = frames > 0 ? (firstSample + frames - 1) / sampleRate : firstIndex;
+
+		for (int64_t i = firstIndex; i <= lastIndex; i++) {
+			auto& chunk = chunks[i];
+			if (chunk.samples.empty()) {
+				chunk.samples.assign((size_t)sampleRate * nChannels, 0);
+				chunk.isComplete = false;
+			}
+			if (frames == 0 || chunk.isComplete) {
+				continue;
+			}
+
+			int64_t from = std::max(firstSample, i * sampleRate);
+			int64_t to = std::min(firstSample + (int64_t)frames, (i + 1) * sampleRate);
+			memcpy(&chunk.samples[(size_t)(from - i * sampleRate) * nChannels], data + (size_t)(from - firstSample) * nChannels,
+				(size_t)(to - from) * nChannels * sizeof(float));
+		}
+	}
+
+	void AudioScrubCache::MarkComplete(int64_t endSample) {
+		// segmentStart 之后连续解码过的块才算完整
+		int64_t firstIndex = (segmentStart + sampleRate - 1) / sampleRate;
+		for (auto it = chunks.lower_bound(firstIndex); it != chunks.end(); ++it) {
+			if (endSample < INT64_MAX / 2 && (it->first + 1) * sampleRate > endSample) {
+				break;
+			}
+			it->second.isComplete = true;
+		}
+	}
+
+	void AudioScrubCache::Evict() {
+		int64_t center = centerChunk;
+		for (auto it = chunks.begin(); it != chunks.end();) {
+			if (std::abs(it->first - center) > keepChunks) {
+				it = chunks.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+}
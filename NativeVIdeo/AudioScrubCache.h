@@ -0,0 +1,94 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+struct AVFormatContext;
+struct AVCodecContext;
+
+namespace nv {
+	// 播放位置附近已经解码好的 PCM，拖动进度条时从这里取音频片段，不用每次都 seek + 解码
+	// 后台线程用单独的 demuxer 按 1 秒一块解码，优先补齐离中心最近的块，离中心太远的块会被丢掉
+	// 时间从文件第一个时间戳算起，和 AudioPlayer 的时钟一致
+	class AudioScrubCache {
+	public:
+		// filePath_ 是 UTF-8 路径，streamIndex_ 是要解码的音频流
+		AudioScrubCache(const std::string& filePath_, int streamIndex_, double startSecond_);
+
+		~AudioScrubCache();
+
+		AudioScrubCache(const AudioScrubCache&) = delete;
+		AudioScrubCache& operator=(const AudioScrubCache&) = delete;
+
+		// 让后台把 second 附近的音频准备好：正常播放时传播放位置，拖动时传鼠标位置
+		void SetCenter(double second);
+
+		// 取从 second 开始的 frames 帧，交错 float，声道和采样率与源文件相同
+		// 有任何一部分还没解码好就返回 false
+		bool Read(double second, uint32_t frames, float* out);
+
+		int GetChannels();
+
+		int GetSampleRate();
+
+		uint64_t GetChannelLayout();
+
+		// 已经解码好的块数
+		int GetChunkCount();
+
+		// 中心前后预先解码的范围（秒）
+		static constexpr int aheadChunks = 20;
+		static constexpr int behindChunks = 10;
+		// 超出这个范围的块会被丢掉
+		static constexpr int keepChunks = 40;
+
+	private:
+		struct Chunk {
+			std::vector<float> samples;
+			bool isComplete;
+		};
+
+		void Run();
+
+		// 返回最需要解码的块，没有时返回 false
+		bool FindMissingChunk(int64_t& index);
+
+		// 从 index 块开始解码，直到它解码完成或者出现更需要的块
+		void DecodeFrom(int64_t index);
+
+		// 把一帧解码结果放进对应的块
+		void PutSamples(int64_t firstSample, const float* data, uint32_t frames);
+
+		void MarkComplete(int64_t endSample);
+
+		void Evict();
+
+		std::string filePath;
+		int streamIndex;
+		double startSecond;
+
+		AVFormatContext* fmtCtx;
+		AVCodecContext* codecCtx;
+		int nChannels;
+		int sampleRate;
+		uint64_t channelLayout;
+		int64_t totalChunks; // 文件长度对应的块数，未知时为很大的数
+
+		// 当前解码段开始的样本位置（seek 之后第一帧），从这里开始的数据是连续的
+		int64_t segmentStart;
+		// 解码器接下来要输出的样本位置，负数表示需要 seek
+		int64_t decodePosition;
+
+		std::map<int64_t, Chunk> chunks;
+		std::atomic<int64_t> centerChunk;
+		std::mutex mtx;
+		std::condition_variable cond;
+		std::atomic<bool> isStopping;
+		std::thread decodeThread;
+	};
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <stdint.h>
+
+namespace nv {
+	// 音频输出端。AudioPlayer 只和这个接口打交道，WASAPI、空设备、WAV 文件都是它的实现
+	// 返回 int 的函数：0 表示成功，负数表示失败（WASAPI 直接返回 HRESULT）
+	class AudioSink {
+	public:
+		virtual ~AudioSink() {}
+
+		// 以交错 float 格式打开设备。nChannels <= 0 表示使用设备原生的声道数，
+		// 设备也可以不理会请求的声道数，实际值以 GetChannels 为准
+		// bufferSeconds 是希望的缓冲区时长，不会小于设备周期，实际值以 GetBufferFrames 为准
+		virtual int Open(int nChannels, int nSamplesPerSec, double bufferSeconds) = 0;
+
+		virtual int Start() = 0;
+
+		virtual int Stop() = 0;
+
+		// 丢弃设备缓冲区里还没播放的数据，只能在 Stop 之后调用
+		virtual int Reset() = 0;
+
+		virtual int GetChannels() = 0;
+
+		virtual int GetSampleRate() = 0;
+
+		// 声道布局，位定义和 WAVEFORMATEXTENSIBLE::dwChannelMask、AV_CH_* 相同，0 表示按声道数取默认布局
+		virtual uint64_t GetChannelLayout() = 0;
+
+		// 设备缓冲区大小（帧数）
+		virtual uint32_t GetBufferFrames() = 0;
+
+		// 设备缓冲区里已写入但还没播放的帧数
+		virtual uint32_t GetPadding() = 0;
+
+		// 数据离开设备缓冲区之后还要多久才能被听到（秒），由驱动和混音器决定
+		virtual double GetStreamLatency() = 0;
+
+		virtual float* GetBuffer(uint32_t wantFrames) = 0;
+
+		virtual int ReleaseBuffer(uint32_t writtenFrames) = 0;
+
+		virtual int SetVolume(float v) = 0;
+
+		// 阻塞到设备需要更多数据或者超时，音频线程靠它决定什么时候填数据
+		virtual void WaitForBuffer(int timeoutMs) = 0;
+	};
+}
@@ -0,0 +1,111 @@
+#include "ColorSpace.h"
+#include <map>
+
+namespace nv {
+	namespace {
+		// 亮度权重 Kr、Kb，Kg = 1 - Kr - Kb
+		struct LumaWeights {
+			double kr;
+			double kb;
+		};
+
+		const std::map<AVColorSpace, LumaWeights> lumaWeightsMap = {
+			{ AVCOL_SPC_BT709, { 0.2126, 0.0722 } },
+			{ AVCOL_SPC_FCC, { 0.30, 0.11 } },
+			{ AVCOL_SPC_BT470BG, { 0.299, 0.114 } },
+			{ AVCOL_SPC_SMPTE170M, { 0.299, 0.114 } },
+			{ AVCOL_SPC_SMPTE240M, { 0.212, 0.087 } },
+			{ AVCOL_SPC_BT2020_NCL, { 0.2627, 0.0593 } },
+			{ AVCOL_SPC_BT2020_CL, { 0.2627, 0.0593 } },
+		};
+
+		// 有限范围、全范围
+		const std::map<AVColorSpace, std::pair<const char*, const char*>> colorSpaceNameMap = {
+			{ AVCOL_SPC_RGB, { "RGB", "RGB" } },
+			{ AVCOL_SPC_BT709, { "BT.709 limited", "BT.709 full" } },
+			{ AVCOL_SPC_FCC, { "FCC limited", "FCC full" } },
+			{ AVCOL_SPC_BT470BG, { "BT.601 limited", "BT.601 full" } },
+			{ AVCOL_SPC_SMPTE170M, { "BT.601 limited", "BT.601 full" } },
+			{ AVCOL_SPC_SMPTE240M, { "SMPTE 240M limited", "SMPTE 240M full" } },
+			{ AVCOL_SPC_BT2020_NCL, { "BT.2020 limited", "BT.2020 full" } },
+			{ AVCOL_SPC_BT2020_CL, { "BT.2020 limited", "BT.2020 full" } },
+		};
+
+		// 没有标注矩阵时，原色通常和矩阵一起标注
+		const std::map<AVColorPrimaries, AVColorSpace> primariesToColorSpaceMap = {
+			{ AVCOL_PRI_BT709, AVCOL_SPC_BT709 },
+			{ AVCOL_PRI_BT470BG, AVCOL_SPC_BT470BG },
+			{ AVCOL_PRI_SMPTE170M, AVCOL_SPC_SMPTE170M },
+			{ AVCOL_PRI_SMPTE240M, AVCOL_SPC_SMPTE240M },
+			{ AVCOL_PRI_BT2020, AVCOL_SPC_BT2020_NCL },
+		};
+	}
+
+	AVColorSpace ResolveColorSpace(const ColorDescription& desc) {
+		if (desc.colorspace == AVCOL_SPC_RGB || lumaWeightsMap.count(desc.colorspace)) {
+			return desc.colorspace;
+		}
+
+		auto it = primariesToColorSpaceMap.find(desc.primaries);
+		if (it != primariesToColorSpaceMap.end()) {
+			return it->second;
+		}
+
+		return desc.height >= 720 ? AVCOL_SPC_BT709 : AVCOL_SPC_SMPTE170M;
+	}
+
+	YUVMatrix GetYUVMatrix(const ColorDescription& desc) {
+		// 一个样本值在着色器里是多少：8 位为 1/255，更多位的按 R16_UNORM，P010 为 64/65535
+		int shift = desc.bitDepth - 8;
+		double unit = desc.bitDepth > 8 ? (1 << desc.sampleShift) / 65535.0 : 1.0 / 255;
+
+		YUVMatrix m = {};
+		auto colorspace = ResolveColorSpace(desc);
+		if (colorspace == AVCOL_SPC_RGB) {
+			float scale = (float)(1 / (((1 << desc.bitDepth) - 1) * unit));
+			for (int i = 0; i < 3; i++) {
+				m.matrix[i][i] = scale;
+			}
+			return m;
+		}
+
+		auto weights = lumaWeightsMap.at(colorspace);
+		double kr = weights.kr, kb = weights.kb, kg = 1 - kr - kb;
+
+		// 黑电平、色度中心和各自的范围（样本值）
+		double yBlack, yRange, cRange;
+		double cCenter = 128 << shift;
+		if (desc.range == AVCOL_RANGE_JPEG) {
+			yBlack = 0;
+			yRange = (1 << desc.bitDepth) - 1;
+			cRange = (1 << desc.bitDepth) - 1;
+		}
+		else {
+			yBlack = 16 << shift;
+			yRange = 219 << shift;
+			cRange = 224 << shift;
+		}
+
+		double ys = 1 / (yRange * unit);
+		double cs = 1 / (cRange * unit);
+
+		m.offset[0] = (float)(yBlack * unit);
+		m.offset[1] = (float)(cCenter * unit);
+		m.offset[2] = (float)(cCenter * unit);
+
+		// R = Y + 2(1 - Kr) Cr，G = Y - 2Kb(1 - Kb) / Kg Cb - 2Kr(1 - Kr) / Kg Cr，B = Y + 2(1 - Kb) Cb
+		m.matrix[0][0] = m.matrix[0][1] = m.matrix[0][2] = (float)ys;
+		m.matrix[1][0] = 0;
+		m.matrix[1][1] = (float)(-cs * 2 * kb * (1 - kb) / kg);
+		m.matrix[1][2] = (float)(cs * 2 * (1 - kb));
+		m.matrix[2][0] = (float)(cs * 2 * (1 - kr));
+		m.matrix[2][1] = (float)(-cs * 2 * kr * (1 - kr) / kg);
+		m.matrix[2][2] = 0;
+		return m;
+	}
+
+	const char* GetColorSpaceName(const ColorDescription& desc) {
+		auto& names = colorSpaceNameMap.at(ResolveColorSpace(desc));
+		return desc.range == AVCOL_RANGE_JPEG ? names.second : names.first;
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+
+namespace nv {
+	// 决定 YUV 转 RGB 矩阵的帧属性，变化时才需要重新计算系数
+	struct ColorDescription {
+		AVColorSpace colorspace;
+		AVColorRange range;
+		AVColorPrimaries primaries;
+		int height;   // 没有标注色彩空间时按分辨率猜
+		int bitDepth;    // 8 到 16
+		int sampleShift; // 超过 8 位的样本放在 16 位纹理里，有效位左移的位数：P010 为 6，yuv420p10 为 0
+
+		bool operator==(const ColorDescription&) const = default;
+	};
+
+	// rgb = (yuv - offset) * matrix，yuv 是着色器采样得到的 0..1，和 HLSL 的 mul(yuv, M) 一样按行向量计算
+	// matrix[1][0]（U 对 R）和 matrix[2][2]（V 对 B）对所有标准矩阵都是 0
+	struct YUVMatrix {
+		float matrix[3][3];
+		float offset[3];
+	};
+
+	// 按帧的 colorspace 选矩阵，没有标注时先看 color_primaries，再按高度猜（720 以上为 BT.709）
+	// color_range 没有标注时按有限范围处理。colorspace 为 AVCOL_SPC_RGB 时只把样本值换算到 0..1
+	YUVMatrix GetYUVMatrix(const ColorDescription& desc);
+
+	// 例如 "BT.709 limited"，显示用
+	const char* GetColorSpaceName(const ColorDescription& desc);
+
+	// 实际使用的矩阵标准，用于 GetColorSpaceName 和外部判断
+	AVColorSpace ResolveColorSpace(const ColorDescription& desc);
+}
@@ -0,0 +1,62 @@
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER) && defined(NV_SIMD_X86)
+#include <intrin.h>
+#endif
+
+namespace nv {
+	namespace cpu {
+		namespace {
+			struct Features {
+				bool sse41 = false;
+				bool avx2 = false;
+
+				Features() {
+#if defined(NV_SIMD_X86)
+#if defined(_MSC_VER)
+					int info[4];
+					__cpuid(info, 0);
+					int maxLeaf = info[0];
+
+					__cpuid(info, 1);
+					sse41 = (info[2] & (1 << 19)) != 0;
+					bool osxsave = (info[2] & (1 << 27)) != 0;
+					bool avx = (info[2] & (1 << 28)) != 0;
+					bool fma = (info[2] & (1 << 12)) != 0;
+
+					if (maxLeaf >= 7 && osxsave && avx && fma) {
+						// 操作系统要保存 YMM 寄存器才能用
+						bool ymmEnabled = (_xgetbv(0) & 6) == 6;
+						__cpuidex(info, 7, 0);
+						avx2 = ymmEnabled && (info[1] & (1 << 5)) != 0;
+					}
+#else
+					__builtin_cpu_init();
+					sse41 = __builtin_cpu_supports("sse4.1");
+					avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#endif
+				}
+			};
+
+			const Features& GetFeatures() {
+				static Features features;
+				return features;
+			}
+
+			bool avx2Disabled = false;
+		}
+
+		bool HasSSE41() {
+			return GetFeatures().sse41;
+		}
+
+		bool HasAVX2() {
+			return GetFeatures().avx2 && !avx2Disabled;
+		}
+
+		void DisableAVX2(bool disable) {
+			avx2Disabled = disable;
+		}
+	}
+}
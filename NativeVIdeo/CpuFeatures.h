@@ -0,0 +1,30 @@
+#pragma once
+
+// SIMD 相关的编译期开关和运行时检测，所有手写的 SIMD 内核都从这里取
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define NV_SIMD_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define NV_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+// MSVC 可以直接使用任意指令集的 intrinsic，GCC/Clang 需要给函数单独打上 target
+#if defined(__GNUC__) || defined(__clang__)
+#define NV_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define NV_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define NV_TARGET_SSE41
+#define NV_TARGET_AVX2
+#endif
+
+namespace nv {
+	namespace cpu {
+		bool HasSSE41();
+
+		bool HasAVX2();
+
+		// 调试和测试用，强制只走标量/SSE2 路径。之后再取的内核才受影响，已经取到的函数指针不变
+		void DisableAVX2(bool disable);
+	}
+}
@@ -0,0 +1,408 @@
+#include "CropDetector.h"
+#include "CpuFeatures.h"
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+// 样本先换成 8 位：min(v >> shift, 255)，再减去 black（不到的算 0），这就是每个样本高出黑电平的部分
+// 两字节的样本 shift 至少是 1，移完不超过 32767，可以当有符号数取最小值
+namespace nv {
+	namespace {
+		// 上下每隔 rowStep 行看一行
+		constexpr int rowStep = 8;
+
+		// 左右最多累加这么多行，每列的和是 16 位的，255 * 256 不会溢出
+		constexpr int maxColumnRows = 256;
+		constexpr int columnRowStep = 32;
+
+		// 编码噪声让黑边不是纯黑，高出黑电平这么多以内都算黑
+		constexpr int blackMargin = 8;
+
+		// 四条边都在这么多像素以内才算同一个结果
+		constexpr int stableTolerance = 4;
+
+		// 返回 SIMD 处理到的位置，剩下的交给标量
+		typedef int (*RowExcessFunc)(const uint8_t* row, int width, int bytesPerSample, int shift, int black, uint32_t& sum);
+		typedef int (*ColumnExcessFunc)(const uint8_t* row, int width, int bytesPerSample, int shift, int black, uint16_t* sums);
+
+		int Excess(const uint8_t* row, int x, int bytesPerSample, int shift, int black) {
+			int v = bytesPerSample == 1 ? row[x] : std::min(((const uint16_t*)row)[x] >> shift, 255);
+			return std::max(v - black, 0);
+		}
+
+		void RowExcessScalar(const uint8_t* row, int x, int width, int bytesPerSample, int shift, int black, uint32_t& sum) {
+			for (; x < width; x++) {
+				sum += Excess(row, x, bytesPerSample, shift, black);
+			}
+		}
+
+		void ColumnExcessScalar(const uint8_t* row, int x, int width, int bytesPerSample, int shift, int black, uint16_t* sums) {
+			for (; x < width; x++) {
+				sums[x] += (uint16_t)Excess(row, x, bytesPerSample, shift, black);
+			}
+		}
+
+		int RowExcessNone(const uint8_t*, int, int, int, int, uint32_t&) {
+			return 0;
+		}
+
+		int ColumnExcessNone(const uint8_t*, int, int, int, int, uint16_t*) {
+			return 0;
+		}
+
+#if defined(NV_SIMD_X86)
+		// x64 都有 SSE2。8 位的样本饱和减去 black 后用 psadbw 横着加；16 位的移位、截到 255、饱和减，再两两相加成 32 位
+		int RowExcessSSE2(const uint8_t* row, int width, int bytesPerSample, int shift, int black, uint32_t& sum) {
+			const __m128i zero = _mm_setzero_si128();
+			__m128i acc = zero;
+			int x = 0;
+			if (bytesPerSample == 1) {
+				const __m128i b = _mm_set1_epi8((char)black);
+				for (; x + 16 <= width; x += 16) {
+					__m128i v = _mm_loadu_si128((const __m128i*)(row + x));
+					acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_subs_epu8(v, b), zero));
+				}
+				sum += (uint32_t)(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(acc, acc)));
+				return x;
+			}
+
+			const __m128i b = _mm_set1_epi16((short)black);
+			const __m128i max = _mm_set1_epi16(255);
+			const __m128i ones = _mm_set1_epi16(1);
+			const __m128i count = _mm_cvtsi32_si128(shift);
+			for (; x + 8 <= width; x += 8) {
+				__m128i v = _mm_loadu_si128((const __m128i*)(row + x * 2));
+				__m128i e = _mm_subs_epu16(_mm_min_epi16(_mm_srl_epi16(v, count), max), b);
+				acc = _mm_add_epi32(acc, _mm_madd_epi16(e, ones));
+			}
+			acc = _mm_add_epi32(acc, _mm_unpackhi_epi64(acc, acc));
+			acc = _mm_add_epi32(acc, _mm_srli_si128(acc, 4));
+			sum += (uint32_t)_mm_cvtsi128_si32(acc);
+			return x;
+		}
+
+		int ColumnExcessSSE2(const uint8_t* row, int width, int bytesPerSample, int shift, int black, uint16_t* sums) {
+			const __m128i zero = _mm_setzero_si128();
+			int x = 0;
+			if (bytesPerSample == 1) {
+				const __m128i b = _mm_set1_epi8((char)black);
+				for (; x + 16 <= width; x += 16) {
+					__m128i e = _mm_subs_epu8(_mm_loadu_si128((const __m128i*)(row + x)), b);
+					__m128i lo = _mm_loadu_si128((const __m128i*)(sums + x));
+					__m128i hi = _mm_loadu_si128((const __m128i*)(sums + x + 8));
+					_mm_storeu_si128((__m128i*)(sums + x), _mm_add_epi16(lo, _mm_unpacklo_epi8(e, zero)));
+					_mm_storeu_si128((__m128i*)(sums + x + 8), _mm_add_epi16(hi, _mm_unpackhi_epi8(e, zero)));
+				}
+				return x;
+			}
+
+			const __m128i b = _mm_set1_epi16((short)black);
+			const __m128i max = _mm_set1_epi16(255);
+			const __m128i count = _mm_cvtsi32_si128(shift);
+			for (; x + 8 <= width; x += 8) {
+				__m128i v = _mm_loadu_si128((const __m128i*)(row + x * 2));
+				__m128i e = _mm_subs_epu16(_mm_min_epi16(_mm_srl_epi16(v, count), max), b);
+				__m128i s = _mm_loadu_si128((const __m128i*)(sums + x));
+				_mm_storeu_si128((__m128i*)(sums + x), _mm_add_epi16(s, e));
+			}
+			return x;
+		}
+
+		NV_TARGET_AVX2 int RowExcessAVX2(const uint8_t* row, int width, int bytesPerSample, int shift, int black, uint32_t& sum) {
+			const __m256i zero = _mm256_setzero_si256();
+			__m256i acc = zero;
+			int x = 0;
+			if (bytesPerSample == 1) {
+				const __m256i b = _mm256_set1_epi8((char)black);
+				for (; x + 32 <= width; x += 32) {
+					__m256i v = _mm256_loadu_si256((const __m256i*)(row + x));
+					acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_subs_epu8(v, b), zero));
+				}
+			}
+			else {
+				const __m256i b = _mm256_set1_epi16((short)black);
+				const __m256i max = _mm256_set1_epi16(255);
+				const __m256i ones = _mm256_set1_epi16(1);
+				const __m128i count = _mm_cvtsi32_si128(shift);
+				for (; x + 16 <= width; x += 16) {
+					__m256i v = _mm256_loadu_si256((const __m256i*)(row + x * 2));
+					__m256i e = _mm256_subs_epu16(_mm256_min_epi16(_mm256_srl_epi16(v, count), max), b);
+					acc = _mm256_add_epi32(acc, _mm256_madd_epi16(e, ones));
+				}
+				// 32 位的和换成和 8 位一样的 64 位
+				acc = _mm256_add_epi64(_mm256_and_si256(acc, _mm256_set1_epi64x(0xFFFFFFFF)), _mm256_srli_epi64(acc, 32));
+			}
+			__m128i total = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+			sum += (uint32_t)(_mm_cvtsi128_si32(total) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(total, total)));
+			return x;
+		}
+
+		// 8 位的样本 16 个一组扩成 16 位，和 16 位的走同一条路
+		NV_TARGET_AVX2 int ColumnExcessAVX2(const uint8_t* row, int width, int bytesPerSample, int shift, int black, uint16_t* sums) {
+			const __m256i b = _mm256_set1_epi16((short)black);
+			const __m256i max = _mm256_set1_epi16(255);
+			const __m128i count = _mm_cvtsi32_si128(bytesPerSample == 1 ? 0 : shift);
+			int x = 0;
+			for (; x + 16 <= width; x += 16) {
+				__m256i v = bytesPerSample == 1
+					? _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(row + x)))
+					: _mm256_loadu_si256((const __m256i*)(row + x * 2));
+				__m256i e = _mm256_subs_epu16(_mm256_min_epi16(_mm256_srl_epi16(v, count), max), b);
+				__m256i s = _mm256_loadu_si256((const __m256i*)(sums + x));
+				_mm256_storeu_si256((__m256i*)(sums + x), _mm256_add_epi16(s, e));
+			}
+			return x;
+		}
+#elif defined(NV_SIMD_NEON)
+		int RowExcessNEON(const uint8_t* row, int width, int bytesPerSample, int shift, int black, uint32_t& sum) {
+			uint32x4_t acc = vdupq_n_u32(0);
+			int x = 0;
+			if (bytesPerSample == 1) {
+				const uint8x16_t b = vdupq_n_u8((uint8_t)black);
+				for (; x + 16 <= width; x += 16) {
+					acc = vpadalq_u16(acc, vpaddlq_u8(vqsubq_u8(vld1q_u8(row + x), b)));
+				}
+			}
+			else {
+				const uint16x8_t b = vdupq_n_u16((uint16_t)black);
+				const uint16x8_t max = vdupq_n_u16(255);
+				const int16x8_t count = vdupq_n_s16((int16_t)-shift);
+				for (; x + 8 <= width; x += 8) {
+					uint16x8_t v = vld1q_u16((const uint16_t*)row + x);
+					acc = vpadalq_u16(acc, vqsubq_u16(vminq_u16(vshlq_u16(v, count), max), b));
+				}
+			}
+			sum += vaddvq_u32(acc);
+			return x;
+		}
+
+		int ColumnExcessNEON(const uint8_t* row, int width, int bytesPerSample, int shift, int black, uint16_t* sums) {
+			int x = 0;
+			if (bytesPerSample == 1) {
+				const uint8x16_t b = vdupq_n_u8((uint8_t)black);
+				for (; x + 16 <= width; x += 16) {
+					uint8x16_t e = vqsubq_u8(vld1q_u8(row + x), b);
+					vst1q_u16(sums + x, vaddw_u8(vld1q_u16(sums + x), vget_low_u8(e)));
+					vst1q_u16(sums + x + 8, vaddw_u8(vld1q_u16(sums + x + 8), vget_high_u8(e)));
+				}
+				return x;
+			}
+
+			const uint16x8_t b = vdupq_n_u16((uint16_t)black);
+			const uint16x8_t max = vdupq_n_u16(255);
+			const int16x8_t count = vdupq_n_s16((int16_t)-shift);
+			for (; x + 8 <= width; x += 8) {
+				uint16x8_t v = vld1q_u16((const uint16_t*)row + x);
+				uint16x8_t e = vqsubq_u16(vminq_u16(vshlq_u16(v, count), max), b);
+				vst1q_u16(sums + x, vaddq_u16(vld1q_u16(sums + x), e));
+			}
+			return x;
+		}
+#endif
+
+		CropRect Detect(const LumaPlane& plane, int black, RowExcessFunc rowExcess, ColumnExcessFunc columnExcess) {
+			black = std::clamp(black, 0, 255);
+			auto getRow = [&](int y) {
+				return plane.data + (size_t)y * plane.pitch;
+			};
+			auto isContent = [&](int y) {
+				uint32_t sum = 0;
+				int x = rowExcess(getRow(y), plane.width, plane.bytesPerSample, plane.shift, black, sum);
+				RowExcessScalar(getRow(y), x, plane.width, plane.bytesPerSample, plane.shift, black, sum);
+				return sum > (uint32_t)plane.width;
+			};
+
+			// 上一次看的那行是黑的，画面的第一行在这两行之间
+			int top = -1;
+			for (int y = 0; y < plane.height && top < 0; y += rowStep) {
+				if (isContent(y)) {
+					top = y;
+					for (int r = std::max(y - rowStep + 1, 0); r < y; r++) {
+						if (isContent(r)) {
+							top = r;
+							break;
+						}
+					}
+				}
+			}
+			if (top < 0) {
+				return {};
+			}
+
+			int bottom = top;
+			for (int y = plane.height - 1; y > top; y -= rowStep) {
+				if (isContent(y)) {
+					bottom = y;
+					for (int r = std::min(y + rowStep - 1, plane.height - 1); r > y; r--) {
+						if (isContent(r)) {
+							bottom = r;
+							break;
+						}
+					}
+					break;
+				}
+			}
+
+			int contentHeight = bottom - top + 1;
+			int step = std::max(columnRowStep, (contentHeight + maxColumnRows - 1) / maxColumnRows);
+			std::vector<uint16_t> sums(plane.width, 0);
+			int rows = 0;
+			for (int y = top; y <= bottom; y += step, rows++) {
+				int x = columnExcess(getRow(y), plane.width, plane.bytesPerSample, plane.shift, black, sums.data());
+				ColumnExcessScalar(getRow(y), x, plane.width, plane.bytesPerSample, plane.shift, black, sums.data());
+			}
+
+			// 看的行里整列都是黑的才是黑边，行是画面但列都不够时不裁左右
+			int left = 0;
+			while (left < plane.width && sums[left] <= rows) {
+				left++;
+			}
+			int right = plane.width - 1;
+			while (right > left && sums[right] <= rows) {
+				right--;
+			}
+			if (left == plane.width) {
+				left = 0;
+				right = plane.width - 1;
+			}
+			return { left, top, right - left + 1, contentHeight };
+		}
+
+		// 放大到两个的并集
+		CropRect Union(const CropRect& a, const CropRect& b) {
+			int x = std::min(a.x, b.x);
+			int y = std::min(a.y, b.y);
+			int right = std::max(a.x + a.width, b.x + b.width);
+			int bottom = std::max(a.y + a.height, b.y + b.height);
+			return { x, y, right - x, bottom - y };
+		}
+
+		bool Contains(const CropRect& outer, const CropRect& inner) {
+			return inner.x >= outer.x && inner.y >= outer.y && inner.x + inner.width <= outer.x + outer.width && inner.y + inner.height <= outer.y + outer.height;
+		}
+
+		bool IsNear(const CropRect& a, const CropRect& b) {
+			return abs(a.x - b.x) <= stableTolerance && abs(a.y - b.y) <= stableTolerance
+				&& abs(a.x + a.width - b.x - b.width) <= stableTolerance && abs(a.y + a.height - b.y - b.height) <= stableTolerance;
+		}
+	}
+
+	bool GetLumaPlane(const PixelFormatDesc& format, const uint8_t* data, int pitch, int width, int height, LumaPlane& plane) {
+		auto& luma = format.components[0];
+		auto& planeDesc = format.planes[luma.plane];
+		if (format.isRGB || luma.plane != 0 || luma.channel != 0 || planeDesc.channels != 1 || !data || pitch <= 0) {
+			return false;
+		}
+
+		int bytesPerSample = planeDesc.bytesPerChannel;
+		int shift = bytesPerSample == 1 ? 0 : format.bitDepth + format.sampleShift - 8;
+		if (bytesPerSample == 2 && shift < 1) {
+			return false;
+		}
+		plane = { data, pitch, width, height, bytesPerSample, shift };
+		return true;
+	}
+
+	bool GetLumaPlane(const AVFrame* frame, LumaPlane& plane) {
+		PixelFormatDesc format;
+		return GetPixelFormatDesc((AVPixelFormat)frame->format, format)
+			&& GetLumaPlane(format, frame->data[0], frame->linesize[0], frame->width, frame->height, plane);
+	}
+
+	CropRect DetectCrop(const LumaPlane& plane, int black) {
+#if defined(NV_SIMD_X86)
+		if (cpu::HasAVX2()) {
+			return Detect(plane, black, RowExcessAVX2, ColumnExcessAVX2);
+		}
+		return Detect(plane, black, RowExcessSSE2, ColumnExcessSSE2);
+#elif defined(NV_SIMD_NEON)
+		return Detect(plane, black, RowExcessNEON, ColumnExcessNEON);
+#else
+		return DetectCropRef(plane, black);
+#endif
+	}
+
+	CropRect DetectCropRef(const LumaPlane& plane, int black) {
+		return Detect(plane, black, RowExcessNone, ColumnExcessNone);
+	}
+
+	CropDetector::CropDetector(int interval_, int stableScans_)
+		: interval(interval_), stableScans(stableScans_), frameIndex(0), width(0), height(0), crop{}, candidate{}, candidateScans(0), milliseconds(0)
+	{
+	}
+
+	bool CropDetector::IsDue() {
+		return frameIndex++ % interval == 0;
+	}
+
+	bool CropDetector::Update(const LumaPlane& plane, AVColorRange range) {
+		if (plane.width != width || plane.height != height) {
+			width = plane.width;
+			height = plane.height;
+			crop = { 0, 0, width, height };
+			candidateScans = 0;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		int black = (range == AVCOL_RANGE_JPEG ? 0 : 16) + blackMargin;
+		auto detected = DetectCrop(plane, black);
+		milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		if (detected.width * 4 < width || detected.height * 4 < height) {
+			return false;
+		}
+
+		// 往外取偶数
+		int right = std::min((detected.x + detected.width + 1) & ~1, width);
+		int bottom = std::min((detected.y + detected.height + 1) & ~1, height);
+		detected.x &= ~1;
+		detected.y &= ~1;
+		detected.width = right - detected.x;
+		detected.height = bottom - detected.y;
+
+		if (!Contains(crop, detected)) {
+			crop = Union(crop, detected);
+			candidateScans = 0;
+			return true;
+		}
+		if (detected == crop) {
+			candidateScans = 0;
+			return false;
+		}
+
+		if (candidateScans > 0 && IsNear(candidate, detected)) {
+			candidate = Union(candidate, detected);
+			candidateScans++;
+		}
+		else {
+			candidate = detected;
+			candidateScans = 1;
+		}
+		if (candidateScans < stableScans) {
+			return false;
+		}
+		candidateScans = 0;
+		bool isChanged = !(candidate == crop);
+		crop = candidate;
+		return isChanged;
+	}
+
+	void CropDetector::Reset() {
+		frameIndex = 0;
+		width = 0;
+		height = 0;
+		candidateScans = 0;
+	}
+
+	CropRect CropDetector::GetCrop(int width_, int height_) {
+		if (width_ != width || height_ != height) {
+			return { 0, 0, width_, height_ };
+		}
+		return crop;
+	}
+
+	double CropDetector::GetMilliseconds() {
+		return milliseconds;
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <stdint.h>
+#include "PixelFormat.h"
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace nv {
+	// 一帧的亮度平面，样本右移 shift 位是 8 位的亮度
+	struct LumaPlane {
+		const uint8_t* data;
+		int pitch;
+		int width;
+		int height;
+		int bytesPerSample; // 1 或 2
+		int shift;
+	};
+
+	// format 是 data 里样本的格式，RGB 的格式返回 false
+	bool GetLumaPlane(const PixelFormatDesc& format, const uint8_t* data, int pitch, int width, int height, LumaPlane& plane);
+
+	// 系统内存里的帧，硬件帧和不支持的格式返回 false
+	bool GetLumaPlane(const AVFrame* frame, LumaPlane& plane);
+
+	struct CropRect {
+		int x;
+		int y;
+		int width;
+		int height;
+
+		bool operator==(const CropRect&) const = default;
+	};
+
+	// 找出 plane 里黑边围起来的画面。亮度高出 black（8 位）的部分一行加起来超过行宽（平均高出 1）就算画面
+	// 上下从边缘每隔几行看一行，碰到画面再往回找第一行；左右只在画面的行里隔行累加每一列
+	// 整帧都是黑的时宽高为 0
+	CropRect DetectCrop(const LumaPlane& plane, int black);
+
+	// 标量参考实现，SIMD 版本的结果必须和它相同
+	CropRect DetectCropRef(const LumaPlane& plane, int black);
+
+	// 每 interval 帧检测一帧，结果对齐到偶数（4:2:0 的色度也能跟着裁）
+	// 画面超出当前裁剪时马上放大；比当前裁剪小时，要连续 stableScans 次都差不多（边缘差不超过几个像素）才缩小到这几次的并集，
+	// 暗场景不会一下子被裁掉。大半是黑的帧（淡入淡出、片头）不算
+	class CropDetector {
+	public:
+		CropDetector(int interval_ = 12, int stableScans_ = 8);
+
+		// 每帧调用一次，轮到检测这一帧时返回 true
+		bool IsDue();
+
+		// 检测一帧，裁剪变了返回 true。帧的大小变了从整帧重新开始
+		bool Update(const LumaPlane& plane, AVColorRange range);
+
+		void Reset();
+
+		// width x height 的帧要显示的部分，还没检测过这个大小的帧时是整帧
+		CropRect GetCrop(int width, int height);
+
+		// 最近一次检测的耗时
+		double GetMilliseconds();
+	private:
+		int interval;
+		int stableScans;
+		int frameIndex;
+		int width;
+		int height;
+		CropRect crop;
+		CropRect candidate;
+		int candidateScans;
+		double milliseconds;
+	};
+}
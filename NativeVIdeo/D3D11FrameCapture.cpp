@@ -0,0 +1,157 @@
+#include "D3D11FrameCapture.h"
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+namespace nv {
+	namespace {
+		bool IsSupportedFormat(DXGI_FORMAT format) {
+			return format == DXGI_FORMAT_R10G10B10A2_UNORM || format == DXGI_FORMAT_R8G8B8A8_UNORM || format == DXGI_FORMAT_B8G8R8A8_UNORM;
+		}
+
+		// 一行转成 RGBA8，alpha 为 255
+		void ConvertRow(DXGI_FORMAT format, const uint8_t* src, int width, uint8_t* dst) {
+			if (format == DXGI_FORMAT_R10G10B10A2_UNORM) {
+				auto pixels = (const uint32_t*)src;
+				for (int x = 0; x < width; x++) {
+					uint32_t v = pixels[x];
+					for (int c = 0; c < 3; c++) {
+						dst[x * 4 + c] = (uint8_t)((((v >> (c * 10)) & 1023) * 255 + 511) / 1023);
+					}
+					dst[x * 4 + 3] = 255;
+				}
+				return;
+			}
+
+			memcpy(dst, src, (size_t)width * 4);
+			for (int x = 0; x < width; x++) {
+				if (format == DXGI_FORMAT_B8G8R8A8_UNORM) {
+					std::swap(dst[x * 4], dst[x * 4 + 2]);
+				}
+				dst[x * 4 + 3] = 255;
+			}
+		}
+	}
+
+	D3D11FrameCapture::D3D11FrameCapture(ID3D11Device* device_, ID3D11DeviceContext* ctx_, ImageFormat format)
+		: device(device_), ctx(ctx_), slots{}, frame(0), writer(format), requested(0), dropped(0), failed(0)
+	{
+	}
+
+	void D3D11FrameCapture::SetSource(ID3D11Texture2D* texture) {
+		source = texture;
+	}
+
+	bool D3D11FrameCapture::Capture(const std::string& path) {
+		requested++;
+
+		D3D11_TEXTURE2D_DESC desc = {};
+		if (source) {
+			source->GetDesc(&desc);
+		}
+
+		Slot* slot = nullptr;
+		for (auto& s : slots) {
+			if (!s.isPending) {
+				slot = &s;
+				break;
+			}
+		}
+		if (!source || !IsSupportedFormat(desc.Format) || desc.SampleDesc.Count != 1 || !slot) {
+			dropped++;
+			return false;
+		}
+
+		// 大小或格式变了才重建
+		D3D11_TEXTURE2D_DESC stagingDesc = {};
+		if (slot->staging) {
+			slot->staging->GetDesc(&stagingDesc);
+		}
+		if (stagingDesc.Width != desc.Width || stagingDesc.Height != desc.Height || stagingDesc.Format != desc.Format) {
+			stagingDesc = {};
+			stagingDesc.Format = desc.Format;
+			stagingDesc.ArraySize = 1;
+			stagingDesc.MipLevels = 1;
+			stagingDesc.SampleDesc = { 1, 0 };
+			stagingDesc.Width = desc.Width;
+			stagingDesc.Height = desc.Height;
+			stagingDesc.Usage = D3D11_USAGE_STAGING;
+			stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+			if (FAILED(device->CreateTexture2D(&stagingDesc, nullptr, slot->staging.ReleaseAndGetAddressOf()))) {
+				dropped++;
+				return false;
+			}
+		}
+
+		ctx->CopyResource(slot->staging.Get(), source.Get());
+		slot->path = path;
+		slot->isPending = true;
+		slot->frame = frame;
+		return true;
+	}
+
+	void D3D11FrameCapture::Poll() {
+		frame++;
+		for (auto& slot : slots) {
+			if (slot.isPending && frame - slot.frame >= readbackDelay) {
+				Read(slot, D3D11_MAP_FLAG_DO_NOT_WAIT);
+			}
+		}
+	}
+
+	bool D3D11FrameCapture::IsPending() {
+		for (auto& slot : slots) {
+			if (slot.isPending) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void D3D11FrameCapture::Flush() {
+		for (auto& slot : slots) {
+			if (slot.isPending) {
+				Read(slot, 0);
+			}
+		}
+		writer.Flush();
+	}
+
+	FrameCaptureStats D3D11FrameCapture::GetStats() {
+		return { requested, dropped, failed, writer.GetStats() };
+	}
+
+	ImageFormat D3D11FrameCapture::GetFormat() {
+		return writer.GetFormat();
+	}
+
+	bool D3D11FrameCapture::Read(Slot& slot, UINT flags) {
+		// 只有 GPU 还没拷完（DXGI_ERROR_WAS_STILL_DRAWING）时下一帧再试；别的错误（设备丢失等）再试也没用，
+		// 这一张算失败，把槽位空出来，不然 IsPending 一直为真，主循环会一直醒来
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		HRESULT hr = ctx->Map(slot.staging.Get(), 0, D3D11_MAP_READ, flags, &mapped);
+		if (hr == DXGI_ERROR_WAS_STILL_DRAWING) {
+			return false;
+		}
+		if (FAILED(hr)) {
+			slot.isPending = false;
+			slot.path.clear();
+			failed++;
+			return false;
+		}
+
+		D3D11_TEXTURE2D_DESC desc;
+		slot.staging->GetDesc(&desc);
+		int width = desc.Width;
+		int height = desc.Height;
+		std::vector<uint8_t> rgba((size_t)width * height * 4);
+		for (int y = 0; y < height; y++) {
+			ConvertRow(desc.Format, (const uint8_t*)mapped.pData + (size_t)y * mapped.RowPitch, width, &rgba[(size_t)y * width * 4]);
+		}
+		ctx->Unmap(slot.staging.Get(), 0);
+
+		slot.isPending = false;
+		writer.Write(std::move(rgba), width, height, slot.path);
+		return true;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl.h>
+#include <string>
+
+#include "FrameCapture.h"
+
+namespace nv {
+	// 抓图先 CopyResource 到回读环里的一块 staging 纹理，readbackDelay 帧之后 GPU 早就拷完了再 Map，不会让管线停下来等
+	// 环里的 staging 纹理都在等回读时，这一次就丢掉，不会阻塞
+	// 支持 R10G10B10A2、RGBA8、BGRA8 的纹理，读回来都转成 RGBA8
+	class D3D11FrameCapture : public FrameCapture {
+	public:
+		static constexpr int ringSize = 3;
+		static constexpr int readbackDelay = 2;
+
+		D3D11FrameCapture(ID3D11Device* device_, ID3D11DeviceContext* ctx_, ImageFormat format);
+
+		// Capture 拷贝的纹理，后台缓冲重建之后要重新设置
+		void SetSource(ID3D11Texture2D* texture);
+
+		bool Capture(const std::string& path) override;
+
+		void Poll() override;
+
+		bool IsPending() override;
+
+		// 不管 GPU 拷完没有，全部 Map 出来，会等 GPU
+		void Flush() override;
+
+		FrameCaptureStats GetStats() override;
+
+		ImageFormat GetFormat() override;
+	private:
+		struct Slot {
+			Microsoft::WRL::ComPtr<ID3D11Texture2D> staging;
+			std::string path;
+			bool isPending;
+			uint64_t frame; // 在第几帧拷贝的
+		};
+
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> ctx;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> source;
+		Slot slots[ringSize];
+		uint64_t frame;
+		FrameWriter writer;
+		uint64_t requested;
+		uint64_t dropped;
+		uint64_t failed;
+
+		// 读回来交给写线程，flags 为 D3D11_MAP_FLAG_DO_NOT_WAIT 时 GPU 没拷完返回 false，槽位留着下次再读
+		// Map 出了别的错时也返回 false，但槽位已经空出来，计入 failed
+		bool Read(Slot& slot, UINT flags);
+	};
+}
@@ -0,0 +1,65 @@
+#include "D3D11GpuTimer.h"
+
+namespace nv {
+	D3D11GpuTimer::D3D11GpuTimer(ID3D11Device* device, ID3D11DeviceContext* ctx_) : ctx(ctx_), current(0), milliseconds(0) {
+		D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+		D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+		for (auto& q : queries) {
+			device->CreateQuery(&disjointDesc, &q.disjoint);
+			device->CreateQuery(&timestampDesc, &q.begin);
+			device->CreateQuery(&timestampDesc, &q.end);
+			q.isPending = false;
+		}
+	}
+
+	void D3D11GpuTimer::Begin() {
+		// 从最早的一组开始取，后完成的覆盖先完成的
+		for (int i = 0; i < latency; i++) {
+			auto& q = queries[(current + i) % latency];
+			if (q.isPending) {
+				Collect(q);
+			}
+		}
+
+		// 还没完成的这组直接重用，丢掉它的结果
+		auto& q = queries[current];
+		q.isPending = false;
+		if (!q.disjoint || !q.begin || !q.end) {
+			return;
+		}
+		ctx->Begin(q.disjoint.Get());
+		ctx->End(q.begin.Get());
+	}
+
+	void D3D11GpuTimer::End() {
+		auto& q = queries[current];
+		if (!q.disjoint || !q.begin || !q.end) {
+			return;
+		}
+		ctx->End(q.end.Get());
+		ctx->End(q.disjoint.Get());
+		q.isPending = true;
+		current = (current + 1) % latency;
+	}
+
+	double D3D11GpuTimer::GetMilliseconds() {
+		return milliseconds;
+	}
+
+	void D3D11GpuTimer::Collect(Queries& q) {
+		// DONOTFLUSH：没完成就下次再来，不让 CPU 等 GPU
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+		UINT64 begin, end;
+		if (ctx->GetData(q.disjoint.Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK
+			|| ctx->GetData(q.begin.Get(), &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK
+			|| ctx->GetData(q.end.Get(), &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) {
+			return;
+		}
+
+		q.isPending = false;
+		// 期间 GPU 频率变过的结果不可信
+		if (!disjoint.Disjoint && disjoint.Frequency > 0) {
+			milliseconds = (double)(end - begin) * 1000 / disjoint.Frequency;
+		}
+	}
+}
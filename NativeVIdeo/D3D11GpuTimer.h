@@ -0,0 +1,36 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl.h>
+
+namespace nv {
+	// 用时间戳查询测一段 GPU 命令的耗时
+	// 结果要等 GPU 执行完才有，所以轮流用 latency 组查询，Begin 时不等待地取回已经完成的，拿到的是几帧之前的耗时
+	class D3D11GpuTimer {
+	public:
+		static constexpr int latency = 3;
+
+		D3D11GpuTimer(ID3D11Device* device, ID3D11DeviceContext* ctx_);
+
+		void Begin();
+
+		void End();
+
+		// 最近一次取回的耗时（毫秒），还没有结果时为 0
+		double GetMilliseconds();
+
+	private:
+		struct Queries {
+			Microsoft::WRL::ComPtr<ID3D11Query> disjoint;
+			Microsoft::WRL::ComPtr<ID3D11Query> begin;
+			Microsoft::WRL::ComPtr<ID3D11Query> end;
+			bool isPending;
+		};
+
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> ctx;
+		Queries queries[latency];
+		int current;
+		double milliseconds;
+
+		void Collect(Queries& q);
+	};
+}
@@ -0,0 +1,68 @@
+#include "D3D11LumaReadback.h"
+
+namespace nv {
+	D3D11LumaReadback::D3D11LumaReadback(ID3D11Device* device_, ID3D11DeviceContext* ctx_)
+		: device(device_), ctx(ctx_), isPending(false), frame(0), requestFrame(0), format{}, width(0), height(0)
+	{
+	}
+
+	bool D3D11LumaReadback::Request(ID3D11Texture2D* texture, int index, const PixelFormatDesc& format_, int width_, int height_) {
+		if (isPending) {
+			return false;
+		}
+
+		D3D11_TEXTURE2D_DESC desc;
+		texture->GetDesc(&desc);
+
+		// 格式和大小都跟着解码器的纹理，变了才重建。NV12、P010 这类格式的 staging 纹理 Map 出来亮度平面在前
+		D3D11_TEXTURE2D_DESC stagingDesc = {};
+		if (staging) {
+			staging->GetDesc(&stagingDesc);
+		}
+		if (stagingDesc.Width != desc.Width || stagingDesc.Height != desc.Height || stagingDesc.Format != desc.Format) {
+			stagingDesc = {};
+			stagingDesc.Format = desc.Format;
+			stagingDesc.ArraySize = 1;
+			stagingDesc.MipLevels = 1;
+			stagingDesc.SampleDesc = { 1, 0 };
+			stagingDesc.Width = desc.Width;
+			stagingDesc.Height = desc.Height;
+			stagingDesc.Usage = D3D11_USAGE_STAGING;
+			stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+			if (FAILED(device->CreateTexture2D(&stagingDesc, nullptr, staging.ReleaseAndGetAddressOf()))) {
+				staging = nullptr;
+				return false;
+			}
+		}
+
+		ctx->CopySubresourceRegion(staging.Get(), 0, 0, 0, 0, texture, D3D11CalcSubresource(0, index, desc.MipLevels), nullptr);
+		isPending = true;
+		requestFrame = frame;
+		format = format_;
+		width = width_;
+		height = height_;
+		return true;
+	}
+
+	bool D3D11LumaReadback::Poll(const std::function<void(const LumaPlane&)>& consume) {
+		frame++;
+		if (!isPending || frame - requestFrame < readbackDelay) {
+			return false;
+		}
+
+		// DXGI_ERROR_WAS_STILL_DRAWING 时下一帧再试
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		if (FAILED(ctx->Map(staging.Get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped))) {
+			return false;
+		}
+		isPending = false;
+
+		LumaPlane plane;
+		bool isRead = GetLumaPlane(format, (const uint8_t*)mapped.pData, mapped.RowPitch, width, height, plane);
+		if (isRead) {
+			consume(plane);
+		}
+		ctx->Unmap(staging.Get(), 0);
+		return isRead;
+	}
+}
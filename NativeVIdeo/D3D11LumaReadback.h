@@ -0,0 +1,33 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl.h>
+#include <functional>
+
+#include "CropDetector.h"
+
+namespace nv {
+	// 硬件解码的帧在 GPU 上，要看亮度先把纹理数组的那一层拷到 staging 纹理，readbackDelay 帧之后再 Map，不会让管线停下来等
+	// 同时只回读一帧，上一帧还没读出来时 Request 返回 false
+	class D3D11LumaReadback {
+	public:
+		static constexpr int readbackDelay = 2;
+
+		D3D11LumaReadback(ID3D11Device* device_, ID3D11DeviceContext* ctx_);
+
+		// format 是纹理里样本的格式（硬件帧的 sw_format），width、height 是帧的大小，纹理可能按编码尺寸对齐得更大
+		bool Request(ID3D11Texture2D* texture, int index, const PixelFormatDesc& format, int width, int height);
+
+		// 每帧调用一次，读出来了就把亮度平面交给 consume，平面只在 consume 里有效
+		bool Poll(const std::function<void(const LumaPlane&)>& consume);
+	private:
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> ctx;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> staging;
+		bool isPending;
+		uint64_t frame;
+		uint64_t requestFrame;
+		PixelFormatDesc format;
+		int width;
+		int height;
+	};
+}
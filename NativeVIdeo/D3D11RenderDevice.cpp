@@ -0,0 +1,110 @@
+#include "D3D11RenderDevice.h"
+#include <string.h>
+
+namespace nv {
+	D3D11RenderDevice::D3D11RenderDevice(ID3D11Device* device_, ID3D11DeviceContext* ctx_) : device(device_), ctx(ctx_) {
+	}
+
+	void D3D11RenderDevice::SetVertexBuffer(void* buffer, uint32_t stride) {
+		ID3D11Buffer* buffers[] = { (ID3D11Buffer*)buffer };
+		UINT offset = 0;
+		ctx->IASetVertexBuffers(0, 1, buffers, &stride, &offset);
+	}
+
+	void D3D11RenderDevice::SetIndexBuffer(void* buffer) {
+		ctx->IASetIndexBuffer((ID3D11Buffer*)buffer, DXGI_FORMAT_R16_UINT, 0);
+	}
+
+	void D3D11RenderDevice::SetInputLayout(void* layout) {
+		ctx->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		ctx->IASetInputLayout((ID3D11InputLayout*)layout);
+	}
+
+	void D3D11RenderDevice::SetShader(ShaderStage stage, void* shader) {
+		if (stage == ShaderStage::Vertex) {
+			ctx->VSSetShader((ID3D11VertexShader*)shader, nullptr, 0);
+		}
+		else {
+			ctx->PSSetShader((ID3D11PixelShader*)shader, nullptr, 0);
+		}
+	}
+
+	void D3D11RenderDevice::SetConstantBuffer(ShaderStage stage, int slot, void* buffer) {
+		ID3D11Buffer* buffers[] = { (ID3D11Buffer*)buffer };
+		if (stage == ShaderStage::Vertex) {
+			ctx->VSSetConstantBuffers(slot, 1, buffers);
+		}
+		else {
+			ctx->PSSetConstantBuffers(slot, 1, buffers);
+		}
+	}
+
+	void D3D11RenderDevice::SetShaderResource(int slot, void* view) {
+		ID3D11ShaderResourceView* views[] = { (ID3D11ShaderResourceView*)view };
+		ctx->PSSetShaderResources(slot, 1, views);
+	}
+
+	void D3D11RenderDevice::SetSampler(int slot, void* sampler) {
+		ID3D11SamplerState* samplers[] = { (ID3D11SamplerState*)sampler };
+		ctx->PSSetSamplers(slot, 1, samplers);
+	}
+
+	void D3D11RenderDevice::SetBlendState(void* state) {
+		ctx->OMSetBlendState((ID3D11BlendState*)state, nullptr, 0xFFFFFFFF);
+	}
+
+	void D3D11RenderDevice::SetViewport(int width, int height) {
+		D3D11_VIEWPORT viewPort = {};
+		viewPort.Width = (FLOAT)width;
+		viewPort.Height = (FLOAT)height;
+		viewPort.MaxDepth = 1;
+		ctx->RSSetViewports(1, &viewPort);
+	}
+
+	void D3D11RenderDevice::SetRenderTarget(void* view) {
+		ID3D11RenderTargetView* views[] = { (ID3D11RenderTargetView*)view };
+		ctx->OMSetRenderTargets(1, views, nullptr);
+	}
+
+	void D3D11RenderDevice::ClearRenderTarget(void* view, const float color[4]) {
+		ctx->ClearRenderTargetView((ID3D11RenderTargetView*)view, color);
+	}
+
+	void D3D11RenderDevice::DrawIndexed(int indexCount) {
+		ctx->DrawIndexed(indexCount, 0, 0);
+	}
+
+	void D3D11RenderDevice::UpdateBuffer(void* buffer, const void* data, int size) {
+		auto d3dBuffer = (ID3D11Buffer*)buffer;
+		D3D11_BUFFER_DESC desc;
+		d3dBuffer->GetDesc(&desc);
+
+		if (desc.Usage == D3D11_USAGE_DYNAMIC) {
+			D3D11_MAPPED_SUBRESOURCE mapped;
+			if (SUCCEEDED(ctx->Map(d3dBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+				memcpy(mapped.pData, data, size);
+				ctx->Unmap(d3dBuffer, 0);
+			}
+		}
+		else {
+			ctx->UpdateSubresource(d3dBuffer, 0, nullptr, data, 0, 0);
+		}
+	}
+
+	void* D3D11RenderDevice::CreateRenderTarget(void* texture) {
+		auto d3dTexture = (ID3D11Texture2D*)texture;
+		D3D11_TEXTURE2D_DESC desc;
+		d3dTexture->GetDesc(&desc);
+
+		CD3D11_RENDER_TARGET_VIEW_DESC viewDesc(D3D11_RTV_DIMENSION_TEXTURE2D, desc.Format);
+		ID3D11RenderTargetView* view = nullptr;
+		if (FAILED(device->CreateRenderTargetView(d3dTexture, &viewDesc, &view))) {
+			return nullptr;
+		}
+		return view;
+	}
+
+	void D3D11RenderDevice::ReleaseRenderTarget(void* view) {
+		((ID3D11RenderTargetView*)view)->Release();
+	}
+}
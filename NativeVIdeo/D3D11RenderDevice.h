@@ -0,0 +1,48 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl.h>
+
+#include "RenderDevice.h"
+
+namespace nv {
+	// 在 D3D11 的立即上下文上执行，资源指针就是对应的 ID3D11* 接口
+	class D3D11RenderDevice : public RenderDevice {
+	public:
+		D3D11RenderDevice(ID3D11Device* device_, ID3D11DeviceContext* ctx_);
+
+		void SetVertexBuffer(void* buffer, uint32_t stride) override;
+
+		void SetIndexBuffer(void* buffer) override;
+
+		void SetInputLayout(void* layout) override;
+
+		void SetShader(ShaderStage stage, void* shader) override;
+
+		void SetConstantBuffer(ShaderStage stage, int slot, void* buffer) override;
+
+		void SetShaderResource(int slot, void* view) override;
+
+		void SetSampler(int slot, void* sampler) override;
+
+		void SetBlendState(void* state) override;
+
+		void SetViewport(int width, int height) override;
+
+		void SetRenderTarget(void* view) override;
+
+		void ClearRenderTarget(void* view, const float color[4]) override;
+
+		void DrawIndexed(int indexCount) override;
+
+		// DYNAMIC 的缓冲用 Map 整个丢弃，其他的用 UpdateSubresource
+		void UpdateBuffer(void* buffer, const void* data, int size) override;
+
+		void* CreateRenderTarget(void* texture) override;
+
+		void ReleaseRenderTarget(void* view) override;
+
+	private:
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> ctx;
+	};
+}
@@ -0,0 +1,270 @@
+#include "Dither.h"
+#include "CpuFeatures.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <array>
+
+// 10 位到 8 位：out = (c * scale10To8 + (m << 14)) >> 22，scale10To8 是 255 / 1023 的 22 位定点
+// 误差远小于 c * 255 / 1023 的小数部分离 0.5 最近的距离，m 全为 128 时和四舍五入完全一样；最大值 1023 * scale10To8 + (255 << 14) 不到 2^31
+namespace nv {
+	namespace {
+		constexpr int ditherArea = ditherSize * ditherSize;
+		constexpr int scale10To8 = 1045505;
+		constexpr int fractionBits = 22;
+
+		typedef std::array<uint8_t, ditherArea> DitherMatrix;
+
+		// 位交错再反转得到 8x8 Bayer 的次序 0..63
+		DitherMatrix MakeOrderedMatrix() {
+			DitherMatrix matrix;
+			for (int y = 0; y < ditherSize; y++) {
+				for (int x = 0; x < ditherSize; x++) {
+					int v = 0;
+					for (int bit = 0; bit < 3; bit++) {
+						v = (v << 2) | ((((x ^ y) >> bit) & 1) << 1) | ((y >> bit) & 1);
+					}
+					matrix[y * ditherSize + x] = (uint8_t)(v * 4 + 2);
+				}
+			}
+			return matrix;
+		}
+
+		// Ulichney 的 void-and-cluster：能量是到各个点的环绕距离的高斯和
+		// 能量最大的点是最密的簇，能量最小的空位是最大的空洞，按放点的先后给每个位置排名
+		DitherMatrix MakeBlueNoiseMatrix() {
+			const double sigma = 1.5;
+			std::vector<double> kernel(ditherArea);
+			for (int dy = 0; dy < ditherSize; dy++) {
+				for (int dx = 0; dx < ditherSize; dx++) {
+					int wx = std::min(dx, ditherSize - dx), wy = std::min(dy, ditherSize - dy);
+					kernel[dy * ditherSize + dx] = std::exp(-(wx * wx + wy * wy) / (2 * sigma * sigma));
+				}
+			}
+
+			std::vector<char> points(ditherArea, 0);
+			std::vector<double> energy(ditherArea, 0);
+			auto update = [&](int p, bool isSet) {
+				points[p] = isSet;
+				double sign = isSet ? 1 : -1;
+				int px = p % ditherSize, py = p / ditherSize;
+				for (int y = 0; y < ditherSize; y++) {
+					const double* row = kernel.data() + ((y - py) & (ditherSize - 1)) * ditherSize;
+					for (int x = 0; x < ditherSize; x++) {
+						energy[y * ditherSize + x] += sign * row[(x - px) & (ditherSize - 1)];
+					}
+				}
+			};
+			auto find = [&](bool isSet, bool isTightest) {
+				int best = -1;
+				for (int p = 0; p < ditherArea; p++) {
+					if (points[p] == isSet && (best < 0 || (isTightest ? energy[p] > energy[best] : energy[p] < energy[best]))) {
+						best = p;
+					}
+				}
+				return best;
+			};
+
+			// 固定种子的随机初始点，再把最密的点挪到最大的空洞，直到挪不动
+			uint32_t seed = 12345;
+			int initialCount = ditherArea / 10;
+			for (int placed = 0; placed < initialCount;) {
+				seed = seed * 1664525 + 1013904223;
+				int p = (seed >> 8) % ditherArea;
+				if (!points[p]) {
+					update(p, true);
+					placed++;
+				}
+			}
+			for (int i = 0; i < ditherArea; i++) {
+				int cluster = find(true, true);
+				update(cluster, false);
+				int hole = find(false, false);
+				update(hole, true);
+				if (hole == cluster) {
+					break;
+				}
+			}
+
+			// 初始点按从密到疏倒着排，然后依次填最大的空洞直到填满
+			std::vector<int> rank(ditherArea);
+			auto initialPoints = points;
+			auto initialEnergy = energy;
+			for (int r = initialCount - 1; r >= 0; r--) {
+				int cluster = find(true, true);
+				update(cluster, false);
+				rank[cluster] = r;
+			}
+			points = initialPoints;
+			energy = initialEnergy;
+			for (int r = initialCount; r < ditherArea; r++) {
+				int hole = find(false, false);
+				update(hole, true);
+				rank[hole] = r;
+			}
+
+			DitherMatrix matrix;
+			for (int p = 0; p < ditherArea; p++) {
+				matrix[p] = (uint8_t)(rank[p] * 256 / ditherArea);
+			}
+			return matrix;
+		}
+
+		typedef int (*DitherRowFunc)(const uint32_t* src, int width, const uint8_t* thresholds, uint32_t* dst);
+
+		int DitherRowNone(const uint32_t*, int, const uint8_t*, uint32_t*) {
+			return 0;
+		}
+
+		void DitherRowScalar(const uint32_t* src, int x, int width, const uint8_t* thresholds, uint32_t* dst) {
+			for (; x < width; x++) {
+				uint32_t v = src[x];
+				int m = thresholds[x & (ditherSize - 1)];
+				uint32_t out = 0xFF000000;
+				for (int c = 0; c < 3; c++) {
+					uint32_t f = ((v >> (c * 10)) & 1023) * scale10To8 + (m << (fractionBits - 8));
+					out |= (f >> fractionBits) << (c * 8);
+				}
+				dst[x] = out;
+			}
+		}
+
+#if defined(NV_SIMD_X86)
+		// 4 个像素一次，每个通道在 32 位通道里算
+		NV_TARGET_SSE41 int DitherRowSSE41(const uint32_t* src, int width, const uint8_t* thresholds, uint32_t* dst) {
+			const __m128i mask = _mm_set1_epi32(1023);
+			const __m128i scale = _mm_set1_epi32(scale10To8);
+			const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+			int x = 0;
+			for (; x + 4 <= width; x += 4) {
+				__m128i v = _mm_loadu_si128((const __m128i*)(src + x));
+				int32_t packed;
+				memcpy(&packed, thresholds + (x & (ditherSize - 1)), 4);
+				__m128i m = _mm_slli_epi32(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed)), fractionBits - 8);
+
+				__m128i r = _mm_and_si128(v, mask);
+				__m128i g = _mm_and_si128(_mm_srli_epi32(v, 10), mask);
+				__m128i b = _mm_and_si128(_mm_srli_epi32(v, 20), mask);
+				r = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(r, scale), m), fractionBits);
+				g = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(g, scale), m), fractionBits);
+				b = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(b, scale), m), fractionBits);
+
+				__m128i out = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(b, 16), alpha));
+				_mm_storeu_si128((__m128i*)(dst + x), out);
+			}
+			return x;
+		}
+
+		// 8 个像素一次，矩阵的一行是 64 个，x 按 8 对齐时不会跨行
+		NV_TARGET_AVX2 int DitherRowAVX2(const uint32_t* src, int width, const uint8_t* thresholds, uint32_t* dst) {
+			const __m256i mask = _mm256_set1_epi32(1023);
+			const __m256i scale = _mm256_set1_epi32(scale10To8);
+			const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+			int x = 0;
+			for (; x + 8 <= width; x += 8) {
+				__m256i v = _mm256_loadu_si256((const __m256i*)(src + x));
+				__m128i packed = _mm_loadl_epi64((const __m128i*)(thresholds + (x & (ditherSize - 1))));
+				__m256i m = _mm256_slli_epi32(_mm256_cvtepu8_epi32(packed), fractionBits - 8);
+
+				__m256i r = _mm256_and_si256(v, mask);
+				__m256i g = _mm256_and_si256(_mm256_srli_epi32(v, 10), mask);
+				__m256i b = _mm256_and_si256(_mm256_srli_epi32(v, 20), mask);
+				r = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(r, scale), m), fractionBits);
+				g = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(g, scale), m), fractionBits);
+				b = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(b, scale), m), fractionBits);
+
+				__m256i out = _mm256_or_si256(_mm256_or_si256(r, _mm256_slli_epi32(g, 8)), _mm256_or_si256(_mm256_slli_epi32(b, 16), alpha));
+				_mm256_storeu_si256((__m256i*)(dst + x), out);
+			}
+			return x;
+		}
+#elif defined(NV_SIMD_NEON)
+		int DitherRowNEON(const uint32_t* src, int width, const uint8_t* thresholds, uint32_t* dst) {
+			const uint32x4_t mask = vdupq_n_u32(1023);
+			const uint32x4_t alpha = vdupq_n_u32(0xFF000000);
+			int x = 0;
+			for (; x + 4 <= width; x += 4) {
+				uint32x4_t v = vld1q_u32(src + x);
+				uint32_t packed;
+				memcpy(&packed, thresholds + (x & (ditherSize - 1)), 4);
+				uint32x4_t m = vshlq_n_u32(vmovl_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(packed))))), fractionBits - 8);
+
+				uint32x4_t r = vandq_u32(v, mask);
+				uint32x4_t g = vandq_u32(vshrq_n_u32(v, 10), mask);
+				uint32x4_t b = vandq_u32(vshrq_n_u32(v, 20), mask);
+				r = vshrq_n_u32(vmlaq_n_u32(m, r, scale10To8), fractionBits);
+				g = vshrq_n_u32(vmlaq_n_u32(m, g, scale10To8), fractionBits);
+				b = vshrq_n_u32(vmlaq_n_u32(m, b, scale10To8), fractionBits);
+
+				uint32x4_t out = vorrq_u32(vorrq_u32(r, vshlq_n_u32(g, 8)), vorrq_u32(vshlq_n_u32(b, 16), alpha));
+				vst1q_u32(dst + x, out);
+			}
+			return x;
+		}
+#endif
+
+		void Dither(const uint8_t* src, int srcPitch, int width, int height, uint8_t* dst, int dstPitch, DitherMode mode, DitherRowFunc row) {
+			const uint8_t* matrix = GetDitherMatrix(mode);
+			for (int y = 0; y < height; y++) {
+				auto srcRow = (const uint32_t*)(src + (size_t)y * srcPitch);
+				auto dstRow = (uint32_t*)(dst + (size_t)y * dstPitch);
+				const uint8_t* thresholds = matrix + (y & (ditherSize - 1)) * ditherSize;
+				int x = row(srcRow, width, thresholds, dstRow);
+				DitherRowScalar(srcRow, x, width, thresholds, dstRow);
+			}
+		}
+	}
+
+	const char* GetDitherModeName(DitherMode mode) {
+		switch (mode) {
+		case DitherMode::None:
+			return "none";
+		case DitherMode::Ordered:
+			return "ordered";
+		case DitherMode::BlueNoise:
+			return "blue noise";
+		}
+		return "";
+	}
+
+	const uint8_t* GetDitherMatrix(DitherMode mode) {
+		static const DitherMatrix none = [] {
+			DitherMatrix matrix;
+			matrix.fill(128);
+			return matrix;
+		}();
+		static const DitherMatrix ordered = MakeOrderedMatrix();
+
+		switch (mode) {
+		case DitherMode::Ordered:
+			return ordered.data();
+		case DitherMode::BlueNoise: {
+			static const DitherMatrix blueNoise = MakeBlueNoiseMatrix();
+			return blueNoise.data();
+		}
+		default:
+			return none.data();
+		}
+	}
+
+	void DitherRGB10A2(const uint8_t* src, int srcPitch, int width, int height, uint8_t* dst, int dstPitch, DitherMode mode) {
+#if defined(NV_SIMD_X86)
+		if (cpu::HasAVX2()) {
+			Dither(src, srcPitch, width, height, dst, dstPitch, mode, DitherRowAVX2);
+			return;
+		}
+		if (cpu::HasSSE41()) {
+			Dither(src, srcPitch, width, height, dst, dstPitch, mode, DitherRowSSE41);
+			return;
+		}
+#elif defined(NV_SIMD_NEON)
+		Dither(src, srcPitch, width, height, dst, dstPitch, mode, DitherRowNEON);
+		return;
+#endif
+		DitherRGB10A2Ref(src, srcPitch, width, height, dst, dstPitch, mode);
+	}
+
+	void DitherRGB10A2Ref(const uint8_t* src, int srcPitch, int width, int height, uint8_t* dst, int dstPitch, DitherMode mode) {
+		Dither(src, srcPitch, width, height, dst, dstPitch, mode, DitherRowNone);
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <stdint.h>
+
+namespace nv {
+	enum class DitherMode {
+		None,      // 直接四舍五入
+		Ordered,   // 8x8 Bayer 矩阵，有规则的十字纹理
+		BlueNoise, // 64x64 的蓝噪声，没有规则纹理，噪声集中在高频，默认用它
+	};
+
+	const char* GetDitherModeName(DitherMode mode);
+
+	constexpr int ditherSize = 64;
+
+	// ditherSize x ditherSize 的阈值表，像素 (x, y) 取第 (y % ditherSize) * ditherSize + x % ditherSize 个，值在 0..255 均匀分布
+	// 量化到 n 级时输出 floor(v * n + m / 256)，平均下来和原值一样；None 全是 128，就是四舍五入
+	// 蓝噪声用 void-and-cluster 生成，第一次用到时算一次，结果是固定的
+	const uint8_t* GetDitherMatrix(DitherMode mode);
+
+	// RGB10A2（R 在低位）抖动量化成 RGBA8，alpha 为 255，dst 可以和 src 是同一块内存
+	// 阈值按像素在画面上的位置取，和 GPU 按 SV_POSITION 取的一样
+	void DitherRGB10A2(const uint8_t* src, int srcPitch, int width, int height, uint8_t* dst, int dstPitch, DitherMode mode);
+
+	// 标量参考实现，SIMD 版本的结果必须和它逐位相同
+	void DitherRGB10A2Ref(const uint8_t* src, int srcPitch, int width, int height, uint8_t* dst, int dstPitch, DitherMode mode);
+}
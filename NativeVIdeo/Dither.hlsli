@@ -0,0 +1,23 @@
+// Dither.hlsli
+// Quantizes the final colour to the display's code values with a tiled threshold matrix (nv::GetDitherMatrix),
+// so 10-bit and tone-mapped gradients do not band when the output is 8 bits. Intermediate passes leave b1
+// unbound; unbound constant buffers read as zero, which turns the dither off.
+cbuffer DitherConstants : register(b1)
+{
+    float4 dither; // x: largest code value of the display, 0 disables
+};
+
+Texture2D<float> ditherMatrix : register(t4);
+
+float3 Dither(float3 rgb, float2 pos)
+{
+    float levels = dither.x;
+    if (levels <= 0)
+    {
+        return rgb;
+    }
+
+    uint2 cell = uint2(pos) % 64;
+    float threshold = ditherMatrix.Load(int3(cell, 0)) * (255.0 / 256.0);
+    return floor(saturate(rgb) * levels + threshold) / levels;
+}
@@ -0,0 +1,65 @@
+#include "DriftController.h"
+#include <cmath>
+#include <algorithm>
+
+namespace nv {
+	namespace {
+		// 缓冲区水位是锯齿形的（解码按包写入，设备按周期取走），先低通滤掉
+		constexpr double filterSeconds = 2.0;
+		constexpr double warmupSeconds = 3.0;
+		// PI 参数：闭环自然频率约 1/60 Hz，阻尼约 0.7
+		// 1ms 的水位误差对应约 150ppm，误差每持续 1 秒积分约 11ppm
+		constexpr double kp = 1.5e5;
+		constexpr double ki = 1.1e4;
+	}
+
+	DriftController::DriftController(int sampleRate_)
+		: sampleRate(sampleRate_), integral(0), correction(0)
+	{
+		Reset();
+	}
+
+	void DriftController::Reset() {
+		warmupLeft = warmupSeconds;
+		filtered = 0;
+		hasFiltered = false;
+		target = 0;
+		// 积分项和补偿值保留：时钟误差不会因为跳转而改变
+	}
+
+	double DriftController::Update(double bufferedFrames, double elapsed) {
+		if (sampleRate <= 0 || elapsed <= 0) {
+			return correction;
+		}
+
+		double level = bufferedFrames / sampleRate;
+		if (!hasFiltered) {
+			filtered = level;
+			hasFiltered = true;
+		}
+		else {
+			filtered += (level - filtered) * std::min(elapsed / filterSeconds, 1.0);
+		}
+
+		if (warmupLeft > 0) {
+			warmupLeft -= elapsed;
+			target = filtered;
+			return correction;
+		}
+
+		// 水位高于目标说明设备取得比写得慢，要少产生样本
+		double error = filtered - target;
+		double limit = maxCorrection / ki;
+		integral = std::clamp(integral + error * elapsed, -limit, limit);
+		correction = std::clamp(-(kp * error + ki * integral), -maxCorrection, maxCorrection);
+		return correction;
+	}
+
+	double DriftController::GetCorrection() {
+		return correction;
+	}
+
+	double DriftController::GetError() {
+		return warmupLeft > 0 ? 0 : filtered - target;
+	}
+}
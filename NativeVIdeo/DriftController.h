@@ -0,0 +1,35 @@
+#pragma once
+
+namespace nv {
+	// 设备时钟和媒体时钟之间的漂移控制器
+	// 输入缓冲区里的帧数，输出重采样要补偿的比例（ppm），让缓冲区稳定在目标水位
+	// 目标水位在 Reset 之后的预热阶段自动取，不和文件本身的音视频交织方式较劲
+	class DriftController {
+	public:
+		DriftController(int sampleRate_);
+
+		// bufferedFrames 是还没播放的帧数，elapsed 是距离上次调用经过的媒体时间（秒）
+		// 返回新的补偿值：正数表示多产生样本（设备时钟偏快）
+		double Update(double bufferedFrames, double elapsed);
+
+		// 跳转、暂停后缓冲区水位会突变，重新预热
+		void Reset();
+
+		double GetCorrection();
+
+		// 平滑后的水位和目标的差（秒），预热阶段为 0
+		double GetError();
+
+		// 补偿的上限，足够覆盖 0.1% 的时钟误差
+		static constexpr double maxCorrection = 2000; // ppm
+
+	private:
+		int sampleRate;
+		double warmupLeft;
+		double filtered;
+		bool hasFiltered;
+		double target;
+		double integral;
+		double correction;
+	};
+}
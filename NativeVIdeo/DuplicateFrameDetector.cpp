@@ -0,0 +1,231 @@
+#include "DuplicateFrameDetector.h"
+#include "CpuFeatures.h"
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+
+// 一个块行（最多 blockSize 行）的样本每 blockSize 个一列，整列加成一个数，就是这一块的和。16 位的样本先换成 8 位：min(v >> shift, 255)
+// 两字节的样本 shift 至少是 1，移完不超过 32767，可以当有符号数取最小值。一块的和最多 255 * 256，16 位的样本 16 行加起来也不会溢出
+// SIMD 版本一列一列地往下加，和留在寄存器里，每块只写一次
+namespace nv {
+	namespace {
+		constexpr int blockSize = FrameSignature::blockSize;
+
+		// 返回 SIMD 处理到的样本位置，是 blockSize 的倍数，剩下的交给标量
+		typedef int (*BlockSumFunc)(const uint8_t* data, int pitch, int rows, int count, int bytesPerSample, int shift, uint32_t* sums);
+
+		void BlockSumScalar(const uint8_t* data, int pitch, int rows, int x, int count, int bytesPerSample, int shift, uint32_t* sums) {
+			for (int y = 0; y < rows; y++) {
+				const uint8_t* row = data + (size_t)y * pitch;
+				for (int i = x; i < count; i++) {
+					int v = bytesPerSample == 1 ? row[i] : std::min(((const uint16_t*)row)[i] >> shift, 255);
+					sums[i / blockSize] += v;
+				}
+			}
+		}
+
+		int BlockSumNone(const uint8_t*, int, int, int, int, int, uint32_t*) {
+			return 0;
+		}
+
+#if defined(NV_SIMD_X86)
+		// 8 位的一块正好 16 字节，psadbw 和 0 相减得到两半的和；16 位的截到 255 之后两半相加，最后 pmaddwd 加成 32 位
+		int BlockSumSSE2(const uint8_t* data, int pitch, int rows, int count, int bytesPerSample, int shift, uint32_t* sums) {
+			const __m128i zero = _mm_setzero_si128();
+			int x = 0;
+			if (bytesPerSample == 1) {
+				for (; x + blockSize <= count; x += blockSize) {
+					__m128i acc = zero;
+					for (int y = 0; y < rows; y++) {
+						acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(data + (size_t)y * pitch + x)), zero));
+					}
+					sums[x / blockSize] = (uint32_t)(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(acc, acc)));
+				}
+				return x;
+			}
+
+			const __m128i max = _mm_set1_epi16(255);
+			const __m128i ones = _mm_set1_epi16(1);
+			const __m128i shiftCount = _mm_cvtsi32_si128(shift);
+			for (; x + blockSize <= count; x += blockSize) {
+				__m128i acc = zero;
+				for (int y = 0; y < rows; y++) {
+					const uint8_t* p = data + (size_t)y * pitch + x * 2;
+					__m128i a = _mm_min_epi16(_mm_srl_epi16(_mm_loadu_si128((const __m128i*)p), shiftCount), max);
+					__m128i b = _mm_min_epi16(_mm_srl_epi16(_mm_loadu_si128((const __m128i*)(p + 16)), shiftCount), max);
+					acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_add_epi16(a, b), ones));
+				}
+				acc = _mm_add_epi32(acc, _mm_unpackhi_epi64(acc, acc));
+				acc = _mm_add_epi32(acc, _mm_srli_si128(acc, 4));
+				sums[x / blockSize] = (uint32_t)_mm_cvtsi128_si32(acc);
+			}
+			return x;
+		}
+
+		// 8 位的一次两块，_mm256_sad_epu8 的四个结果前两个是第一块的
+		NV_TARGET_AVX2 int BlockSumAVX2(const uint8_t* data, int pitch, int rows, int count, int bytesPerSample, int shift, uint32_t* sums) {
+			if (bytesPerSample != 1) {
+				return BlockSumSSE2(data, pitch, rows, count, bytesPerSample, shift, sums);
+			}
+
+			const __m256i zero = _mm256_setzero_si256();
+			int x = 0;
+			for (; x + blockSize * 2 <= count; x += blockSize * 2) {
+				__m256i acc = zero;
+				for (int y = 0; y < rows; y++) {
+					acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i*)(data + (size_t)y * pitch + x)), zero));
+				}
+				__m128i lo = _mm256_castsi256_si128(acc);
+				__m128i hi = _mm256_extracti128_si256(acc, 1);
+				sums[x / blockSize] = (uint32_t)(_mm_cvtsi128_si32(lo) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(lo, lo)));
+				sums[x / blockSize + 1] = (uint32_t)(_mm_cvtsi128_si32(hi) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(hi, hi)));
+			}
+			return x;
+		}
+#elif defined(NV_SIMD_NEON)
+		int BlockSumNEON(const uint8_t* data, int pitch, int rows, int count, int bytesPerSample, int shift, uint32_t* sums) {
+			int x = 0;
+			if (bytesPerSample == 1) {
+				for (; x + blockSize <= count; x += blockSize) {
+					uint16x8_t acc = vdupq_n_u16(0);
+					for (int y = 0; y < rows; y++) {
+						acc = vpadalq_u8(acc, vld1q_u8(data + (size_t)y * pitch + x));
+					}
+					sums[x / blockSize] = vaddlvq_u16(acc);
+				}
+				return x;
+			}
+
+			const uint16x8_t max = vdupq_n_u16(255);
+			const int16x8_t shiftCount = vdupq_n_s16((int16_t)-shift);
+			for (; x + blockSize <= count; x += blockSize) {
+				uint32x4_t acc = vdupq_n_u32(0);
+				for (int y = 0; y < rows; y++) {
+					const uint16_t* p = (const uint16_t*)(data + (size_t)y * pitch) + x;
+					uint16x8_t a = vminq_u16(vshlq_u16(vld1q_u16(p), shiftCount), max);
+					uint16x8_t b = vminq_u16(vshlq_u16(vld1q_u16(p + 8), shiftCount), max);
+					acc = vpadalq_u16(acc, vaddq_u16(a, b));
+				}
+				sums[x / blockSize] = vaddvq_u32(acc);
+			}
+			return x;
+		}
+#endif
+
+		bool Compute(const AVFrame* frame, FrameSignature& signature, BlockSumFunc blockSum) {
+			PixelFormatDesc format;
+			if (!GetPixelFormatDesc((AVPixelFormat)frame->format, format) || frame->width <= 0 || frame->height <= 0) {
+				return false;
+			}
+
+			size_t total = 0;
+			int counts[PixelFormatDesc::maxPlanes];
+			int heights[PixelFormatDesc::maxPlanes];
+			for (int i = 0; i < format.planeCount; i++) {
+				if (!frame->data[i] || frame->linesize[i] <= 0) {
+					return false;
+				}
+				counts[i] = GetPlaneWidth(format, i, frame->width) * format.planes[i].channels;
+				heights[i] = GetPlaneHeight(format, i, frame->height);
+				total += (size_t)(counts[i] + blockSize - 1) / blockSize * ((heights[i] + blockSize - 1) / blockSize);
+			}
+
+			signature.format = format.format;
+			signature.width = frame->width;
+			signature.height = frame->height;
+			signature.sums.assign(total, 0);
+
+			uint32_t* sums = signature.sums.data();
+			for (int i = 0; i < format.planeCount; i++) {
+				int bytesPerSample = format.planes[i].bytesPerChannel;
+				int shift = bytesPerSample == 1 ? 0 : std::max(format.bitDepth + format.sampleShift - 8, 1);
+				int blocksPerRow = (counts[i] + blockSize - 1) / blockSize;
+				for (int y = 0; y < heights[i]; y += blockSize) {
+					const uint8_t* band = frame->data[i] + (size_t)y * frame->linesize[i];
+					int rows = std::min(blockSize, heights[i] - y);
+					uint32_t* bandSums = sums + (size_t)(y / blockSize) * blocksPerRow;
+					int x = blockSum(band, frame->linesize[i], rows, counts[i], bytesPerSample, shift, bandSums);
+					BlockSumScalar(band, frame->linesize[i], rows, x, counts[i], bytesPerSample, shift, bandSums);
+				}
+				sums += (size_t)blocksPerRow * ((heights[i] + blockSize - 1) / blockSize);
+			}
+			return true;
+		}
+	}
+
+	bool ComputeFrameSignature(const AVFrame* frame, FrameSignature& signature) {
+#if defined(NV_SIMD_X86)
+		return Compute(frame, signature, cpu::HasAVX2() ? BlockSumAVX2 : BlockSumSSE2);
+#elif defined(NV_SIMD_NEON)
+		return Compute(frame, signature, BlockSumNEON);
+#else
+		return ComputeFrameSignatureRef(frame, signature);
+#endif
+	}
+
+	bool ComputeFrameSignatureRef(const AVFrame* frame, FrameSignature& signature) {
+		return Compute(frame, signature, BlockSumNone);
+	}
+
+	bool IsSimilarFrame(const FrameSignature& a, const FrameSignature& b, int tolerance) {
+		if (a.format != b.format || a.width != b.width || a.height != b.height || a.sums.size() != b.sums.size()) {
+			return false;
+		}
+		for (size_t i = 0; i < a.sums.size(); i++) {
+			if (abs((int)a.sums[i] - (int)b.sums[i]) > tolerance) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	DuplicateFrameDetector::DuplicateFrameDetector(int tolerance_)
+		: tolerance(tolerance_), isEnabled(true), hasReference(false), reference{}, current{}, frameCount(0), duplicateCount(0), milliseconds(0)
+	{
+	}
+
+	bool DuplicateFrameDetector::IsDuplicate(const AVFrame* frame) {
+		if (!isEnabled || !frame) {
+			return false;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		bool isComputed = ComputeFrameSignature(frame, current);
+		milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (!isComputed) {
+			hasReference = false;
+			return false;
+		}
+		frameCount++;
+
+		if (hasReference && IsSimilarFrame(reference, current, tolerance)) {
+			duplicateCount++;
+			return true;
+		}
+		// 换下来的那份留着下次算指纹用，不用重新分配
+		std::swap(reference, current);
+		hasReference = true;
+		return false;
+	}
+
+	void DuplicateFrameDetector::SetEnabled(bool enabled) {
+		isEnabled = enabled;
+		hasReference = false;
+	}
+
+	bool DuplicateFrameDetector::IsEnabled() {
+		return isEnabled;
+	}
+
+	uint64_t DuplicateFrameDetector::GetFrameCount() {
+		return frameCount;
+	}
+
+	uint64_t DuplicateFrameDetector::GetDuplicateCount() {
+		return duplicateCount;
+	}
+
+	double DuplicateFrameDetector::GetMilliseconds() {
+		return milliseconds;
+	}
+}
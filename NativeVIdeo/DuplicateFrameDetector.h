@@ -0,0 +1,63 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "PixelFormat.h"
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace nv {
+	// 帧的指纹：每个平面按 blockSize x blockSize 个样本分块，记下块里样本（换成 8 位）的和
+	// 改动哪怕只有几个像素，所在块的和也会变；解码噪声这种每个像素差 1 的变化大多落在容差里
+	struct FrameSignature {
+		static constexpr int blockSize = 16;
+
+		AVPixelFormat format;
+		int width;
+		int height;
+		std::vector<uint32_t> sums;
+	};
+
+	// 系统内存里的帧，硬件帧和不支持的格式返回 false
+	bool ComputeFrameSignature(const AVFrame* frame, FrameSignature& signature);
+
+	// 标量参考实现，SIMD 版本的结果必须和它相同
+	bool ComputeFrameSignatureRef(const AVFrame* frame, FrameSignature& signature);
+
+	// 格式、大小一样，每块的和相差都不超过 tolerance
+	bool IsSimilarFrame(const FrameSignature& a, const FrameSignature& b, int tolerance);
+
+	// 动画、幻灯片、录屏里常有连续几帧一模一样，换上这样的帧不用再转换、上传和合成
+	// 总是和最近一次不重复的帧比，缓慢的渐变攒够了差别还是会显示出来
+	class DuplicateFrameDetector {
+	public:
+		// 默认容差是一块的样本数的 1/4，块里平均每个样本差不到 1/4，每个像素差 1 的解码噪声一般在这之内
+		DuplicateFrameDetector(int tolerance_ = FrameSignature::blockSize * FrameSignature::blockSize / 4);
+
+		// 和上一个不重复的帧差不多时返回 true。算不了指纹的帧（硬件帧）返回 false，也不再和之前的帧比
+		bool IsDuplicate(const AVFrame* frame);
+
+		// 关掉时 IsDuplicate 总是返回 false，用来对比开销
+		void SetEnabled(bool enabled);
+
+		bool IsEnabled();
+
+		// 算过指纹的帧数，硬件帧不算
+		uint64_t GetFrameCount();
+
+		uint64_t GetDuplicateCount();
+
+		// 最近一帧算指纹的耗时
+		double GetMilliseconds();
+	private:
+		int tolerance;
+		bool isEnabled;
+		bool hasReference;
+		FrameSignature reference;
+		FrameSignature current;
+		uint64_t frameCount;
+		uint64_t duplicateCount;
+		double milliseconds;
+	};
+}
@@ -0,0 +1,56 @@
+#include "DxgiPresentTarget.h"
+#include <math.h>
+#include <chrono>
+
+namespace nv {
+	DxgiPresentTarget::DxgiPresentTarget(IDXGISwapChain2* swapchain_, int maxFrameLatency) : swapchain(swapchain_), waitable(NULL), isReady(false) {
+		swapchain->SetMaximumFrameLatency(maxFrameLatency);
+		waitable = swapchain->GetFrameLatencyWaitableObject();
+
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		qpcFrequency = (double)frequency.QuadPart;
+	}
+
+	DxgiPresentTarget::~DxgiPresentTarget() {
+		if (waitable) {
+			CloseHandle(waitable);
+		}
+	}
+
+	bool DxgiPresentTarget::WaitForReady(double timeoutSeconds) {
+		// 可等待对象是个信号量，等到一次就占一个名额，不 Present 就不能再等
+		if (isReady || !waitable) {
+			return true;
+		}
+		isReady = WaitForSingleObjectEx(waitable, (DWORD)ceil(timeoutSeconds * 1000), TRUE) == WAIT_OBJECT_0;
+		return isReady;
+	}
+
+	uint32_t DxgiPresentTarget::Present() {
+		swapchain->Present(1, 0);
+		isReady = false;
+
+		UINT presentCount = 0;
+		swapchain->GetLastPresentCount(&presentCount);
+		return presentCount;
+	}
+
+	bool DxgiPresentTarget::GetStatistics(PresentStatistics& stats) {
+		// 还没有帧显示出来时返回 DXGI_ERROR_FRAME_STATISTICS_DISJOINT
+		DXGI_FRAME_STATISTICS frameStats = {};
+		if (FAILED(swapchain->GetFrameStatistics(&frameStats)) || frameStats.PresentCount == 0) {
+			return false;
+		}
+
+		// 用同一时刻的 QPC 和 steady_clock 对齐，不依赖 steady_clock 的实现
+		LARGE_INTEGER qpcNow;
+		QueryPerformanceCounter(&qpcNow);
+		double now = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+		stats.presentCount = frameStats.PresentCount;
+		stats.syncRefreshCount = frameStats.SyncRefreshCount;
+		stats.syncTime = now - (qpcNow.QuadPart - frameStats.SyncQPCTime.QuadPart) / qpcFrequency;
+		return true;
+	}
+}
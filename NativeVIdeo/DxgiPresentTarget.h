@@ -0,0 +1,32 @@
+#pragma once
+#include <Windows.h>
+#include <dxgi1_3.h>
+#include <wrl.h>
+
+#include "PresentClock.h"
+
+namespace nv {
+	// 翻转模型的交换链，用帧延迟的可等待对象控制排队的帧数，Present 之前等它，Present 本身就不会阻塞
+	// 交换链要带 DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT 创建，ResizeBuffers 时也要保留这个标志
+	class DxgiPresentTarget : public PresentTarget {
+	public:
+		DxgiPresentTarget(IDXGISwapChain2* swapchain_, int maxFrameLatency);
+
+		~DxgiPresentTarget();
+
+		DxgiPresentTarget(const DxgiPresentTarget&) = delete;
+		DxgiPresentTarget& operator=(const DxgiPresentTarget&) = delete;
+
+		bool WaitForReady(double timeoutSeconds) override;
+
+		uint32_t Present() override;
+
+		// 帧统计的 QPC 时间换算成 steady_clock 的秒，和 Win32LoopWaiter::Now 一致
+		bool GetStatistics(PresentStatistics& stats) override;
+	private:
+		Microsoft::WRL::ComPtr<IDXGISwapChain2> swapchain;
+		HANDLE waitable;
+		bool isReady; // 已经等到了名额，还没有 Present
+		double qpcFrequency;
+	};
+}
@@ -0,0 +1,42 @@
+#include "FrameCapture.h"
+
+namespace nv {
+	SoftwareFrameCapture::SoftwareFrameCapture(std::shared_ptr<SoftwareRenderer> renderer_, ImageFormat format)
+		: renderer(renderer_), writer(format), requested(0), dropped(0)
+	{
+	}
+
+	bool SoftwareFrameCapture::Capture(const std::string& path) {
+		requested++;
+		int width = renderer->GetWidth();
+		int height = renderer->GetHeight();
+		// 还没有画过
+		if (width <= 0 || height <= 0) {
+			dropped++;
+			return false;
+		}
+
+		auto framebuffer = renderer->GetFramebuffer();
+		writer.Write(std::vector<uint8_t>(framebuffer, framebuffer + (size_t)width * height * 4), width, height, path);
+		return true;
+	}
+
+	void SoftwareFrameCapture::Poll() {
+	}
+
+	bool SoftwareFrameCapture::IsPending() {
+		return false;
+	}
+
+	void SoftwareFrameCapture::Flush() {
+		writer.Flush();
+	}
+
+	FrameCaptureStats SoftwareFrameCapture::GetStats() {
+		return { requested, dropped, 0, writer.GetStats() };
+	}
+
+	ImageFormat SoftwareFrameCapture::GetFormat() {
+		return writer.GetFormat();
+	}
+}
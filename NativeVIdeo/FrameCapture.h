@@ -0,0 +1,63 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <memory>
+
+#include "FrameWriter.h"
+#include "SoftwareRenderer.h"
+
+namespace nv {
+	struct FrameCaptureStats {
+		uint64_t requested;
+		uint64_t dropped; // 回读环满了没抓的
+		uint64_t failed;  // 拷贝出去了但读不回来的（比如设备丢失）
+		FrameWriterStats writer;
+	};
+
+	// 把画好的画面异步存成图片。GPU 的实现经过回读环，几帧之后才读回来；CPU 的实现直接拷帧缓冲
+	// 编码和写文件都在 FrameWriter 的后台线程里，不会卡住画面
+	class FrameCapture {
+	public:
+		virtual ~FrameCapture() {}
+
+		// 抓最近画好的一帧，存到 path（不带扩展名的 UTF-8 路径）。这一帧没法抓时丢掉并返回 false
+		virtual bool Capture(const std::string& path) = 0;
+
+		// 每画一帧调用一次，把已经读回来的交给写线程
+		virtual void Poll() = 0;
+
+		// 还有没读回来的抓图，主循环要继续醒来调用 Poll
+		virtual bool IsPending() = 0;
+
+		// 等所有抓到的图片写完
+		virtual void Flush() = 0;
+
+		virtual FrameCaptureStats GetStats() = 0;
+
+		virtual ImageFormat GetFormat() = 0;
+	};
+
+	// 抓 SoftwareRenderer 的帧缓冲，不需要 GPU，Linux 上不开窗口也能用
+	// 写线程跟不上时 Capture 会等而不是丢帧，逐帧 Render + Capture 就能按解码速度导出一段帧
+	class SoftwareFrameCapture : public FrameCapture {
+	public:
+		SoftwareFrameCapture(std::shared_ptr<SoftwareRenderer> renderer_, ImageFormat format);
+
+		bool Capture(const std::string& path) override;
+
+		void Poll() override;
+
+		bool IsPending() override;
+
+		void Flush() override;
+
+		FrameCaptureStats GetStats() override;
+
+		ImageFormat GetFormat() override;
+	private:
+		std::shared_ptr<SoftwareRenderer> renderer;
+		FrameWriter writer;
+		uint64_t requested;
+		uint64_t dropped;
+	};
+}
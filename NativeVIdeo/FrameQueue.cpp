@@ -0,0 +1,60 @@
+#include "FrameQueue.h"
+
+namespace nv {
+	FrameQueue::FrameQueue(int capacity_) : capacity(capacity_), current(nullptr) {
+	}
+
+	FrameQueue::~FrameQueue() {
+		Flush();
+		av_frame_free(&current);
+	}
+
+	int FrameQueue::Push(const AVFrame* frame) {
+		if (IsFull()) {
+			return -1;
+		}
+
+		AVFrame* ref = av_frame_alloc();
+		if (av_frame_ref(ref, frame) < 0) {
+			av_frame_free(&ref);
+			return -1;
+		}
+
+		frames.push_back(ref);
+		return 0;
+	}
+
+	const AVFrame* FrameQueue::Pop() {
+		if (frames.empty()) {
+			return nullptr;
+		}
+
+		av_frame_free(&current);
+		current = frames.front();
+		frames.pop_front();
+		return current;
+	}
+
+	const AVFrame* FrameQueue::GetCurrent() {
+		return current;
+	}
+
+	void FrameQueue::Flush() {
+		for (auto frame : frames) {
+			av_frame_free(&frame);
+		}
+		frames.clear();
+	}
+
+	int FrameQueue::GetSize() {
+		return (int)frames.size();
+	}
+
+	int FrameQueue::GetCapacity() {
+		return capacity;
+	}
+
+	bool FrameQueue::IsFull() {
+		return (int)frames.size() >= capacity;
+	}
+}
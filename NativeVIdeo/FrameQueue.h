@@ -0,0 +1,44 @@
+#pragma once
+#include <deque>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace nv {
+	// 解码和呈现之间的视频帧队列，解码可以比呈现提前 capacity 帧
+	// 队列里的帧和正在显示的帧都是引用（av_frame_ref），硬件解码时引用着的纹理不会被解码器复用，
+	// 呈现端可以直接采样解码器输出的纹理，不用先拷贝出来。解码器要按 capacity + 1 留出 extra_hw_frames
+	// 只依赖 libavutil，和渲染后端无关，只在一个线程里用
+	class FrameQueue {
+	public:
+		FrameQueue(int capacity_);
+
+		~FrameQueue();
+
+		FrameQueue(const FrameQueue&) = delete;
+		FrameQueue& operator=(const FrameQueue&) = delete;
+
+		// 引用 frame 放到队尾，队列满时返回 -1
+		int Push(const AVFrame* frame);
+
+		// 取出最早的一帧作为当前帧，释放之前的当前帧。队列为空时返回 nullptr，当前帧不变
+		const AVFrame* Pop();
+
+		// 正在显示的帧，到下一次成功的 Pop 之前一直有效，还没有时为 nullptr
+		const AVFrame* GetCurrent();
+
+		// 跳转时丢掉排队的帧，当前帧留到新的帧出来
+		void Flush();
+
+		int GetSize();
+
+		int GetCapacity();
+
+		bool IsFull();
+	private:
+		int capacity;
+		std::deque<AVFrame*> frames;
+		AVFrame* current;
+	};
+}
@@ -0,0 +1,449 @@
+#include "FrameWriter.h"
+#include "MediaCache.h"
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+extern "C" {
+#include <libavutil/crc.h>
+#include <libavutil/adler32.h>
+}
+
+namespace nv {
+	namespace {
+		void PutBE32(std::vector<uint8_t>& out, uint32_t v) {
+			uint8_t bytes[4] = { (uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v };
+			out.insert(out.end(), bytes, bytes + 4);
+		}
+
+		// 长度、类型、数据、CRC（类型和数据的）
+		void PutPNGChunk(std::vector<uint8_t>& out, const char type[4], const uint8_t* data, size_t size) {
+			PutBE32(out, (uint32_t)size);
+			size_t start = out.size();
+			out.insert(out.end(), type, type + 4);
+			out.insert(out.end(), data, data + size);
+			uint32_t crc = av_crc(av_crc_get_table(AV_CRC_32_IEEE_LE), UINT32_MAX, &out[start], size + 4) ^ UINT32_MAX;
+			PutBE32(out, crc);
+		}
+
+		// deflate 的比特流从每个字节的低位开始写，哈夫曼码要先反转
+		class BitWriter {
+		public:
+			BitWriter(std::vector<uint8_t>& out_) : out(out_), bits(0), count(0) {}
+
+			void Put(uint32_t value, int length) {
+				bits |= (uint64_t)value << count;
+				count += length;
+				while (count >= 8) {
+					out.push_back((uint8_t)bits);
+					bits >>= 8;
+					count -= 8;
+				}
+			}
+
+			void PutCode(uint32_t code, int length) {
+				uint32_t reversed = 0;
+				for (int i = 0; i < length; i++) {
+					reversed = reversed << 1 | (code >> i & 1);
+				}
+				Put(reversed, length);
+			}
+
+			void Finish() {
+				if (count > 0) {
+					out.push_back((uint8_t)bits);
+				}
+				bits = 0;
+				count = 0;
+			}
+		private:
+			std::vector<uint8_t>& out;
+			uint64_t bits;
+			int count;
+		};
+
+		// 固定哈夫曼表（RFC 1951 3.2.6）的字面量和长度符号
+		void PutLiteral(BitWriter& writer, int symbol) {
+			if (symbol < 144) {
+				writer.PutCode(0x30 + symbol, 8);
+			}
+			else if (symbol < 256) {
+				writer.PutCode(0x190 + symbol - 144, 9);
+			}
+			else if (symbol < 280) {
+				writer.PutCode(symbol - 256, 7);
+			}
+			else {
+				writer.PutCode(0xC0 + symbol - 280, 8);
+			}
+		}
+
+		int FloorLog2(uint32_t v) {
+			int n = 0;
+			while (v >>= 1) {
+				n++;
+			}
+			return n;
+		}
+
+		// 长度 3..258、距离 1..32768 的符号和额外位，按 RFC 1951 3.2.5 的表，每两（四）个符号额外位加一
+		void PutMatch(BitWriter& writer, int length, int distance) {
+			if (length == 258) {
+				PutLiteral(writer, 285);
+			}
+			else {
+				int n = length - 3;
+				if (n < 8) {
+					PutLiteral(writer, 257 + n);
+				}
+				else {
+					int extraBits = FloorLog2(n) - 2;
+					PutLiteral(writer, 257 + 4 * (extraBits + 1) + (n >> extraBits & 3));
+					writer.Put(n & ((1 << extraBits) - 1), extraBits);
+				}
+			}
+
+			int n = distance - 1;
+			if (n < 4) {
+				writer.PutCode(n, 5);
+			}
+			else {
+				int extraBits = FloorLog2(n) - 1;
+				writer.PutCode(2 * (extraBits + 1) + (n >> extraBits & 1), 5);
+				writer.Put(n & ((1 << extraBits) - 1), extraBits);
+			}
+		}
+
+		// zlib 格式的 deflate：LZ77 用 3 字节的哈希链找 32K 窗口里的匹配，只用一个固定哈夫曼块
+		// 链只走 maxChain 步，够长的匹配就不再找，截图在后台线程里编码，压缩率够用、耗时可控
+		void Deflate(const std::vector<uint8_t>& data, std::vector<uint8_t>& out) {
+			constexpr int windowSize = 32768;
+			constexpr int minMatch = 3;
+			constexpr int maxMatch = 258;
+			constexpr int hashBits = 15;
+			constexpr int maxChain = 32;
+			constexpr int niceMatch = 128;
+
+			out.push_back(0x78);
+			out.push_back(0x01);
+			BitWriter writer(out);
+			writer.Put(1, 1); // 最后一块
+			writer.Put(1, 2); // 固定哈夫曼
+
+			// head 是每个哈希最近出现的位置 + 1，prev 按窗口回绕记同一哈希的上一个位置 + 1，0 表示没有
+			std::vector<uint32_t> head(1 << hashBits, 0);
+			std::vector<uint32_t> prev(windowSize, 0);
+			const uint8_t* p = data.data();
+			size_t size = data.size();
+			auto hash = [&](size_t i) {
+				return (p[i] << 10 ^ p[i + 1] << 5 ^ p[i + 2]) & ((1 << hashBits) - 1);
+			};
+			auto insert = [&](size_t i) {
+				if (i + minMatch <= size) {
+					uint32_t h = hash(i);
+					prev[i % windowSize] = head[h];
+					head[h] = (uint32_t)i + 1;
+				}
+			};
+
+			size_t i = 0;
+			while (i < size) {
+				int bestLength = 0;
+				size_t bestDistance = 0;
+				if (i + minMatch <= size) {
+					int limit = (int)std::min<size_t>(maxMatch, size - i);
+					uint32_t candidate = head[hash(i)];
+					for (int chain = 0; candidate > 0 && chain < maxChain; chain++) {
+						size_t j = candidate - 1;
+						if (i - j > windowSize) {
+							break;
+						}
+						// 先比最长匹配之后的那个字节，大多数候选在这里就被排除
+						if (p[j + bestLength] == p[i + bestLength] || bestLength == 0) {
+							int length = 0;
+							while (length < limit && p[j + length] == p[i + length]) {
+								length++;
+							}
+							if (length > bestLength) {
+								bestLength = length;
+								bestDistance = i - j;
+								if (length >= niceMatch || length == limit) {
+									break;
+								}
+							}
+						}
+						candidate = prev[j % windowSize];
+					}
+				}
+
+				if (bestLength >= minMatch) {
+					PutMatch(writer, bestLength, (int)bestDistance);
+					for (int k = 0; k < bestLength; k++) {
+						insert(i + k);
+					}
+					i += bestLength;
+				}
+				else {
+					PutLiteral(writer, p[i]);
+					insert(i);
+					i++;
+				}
+			}
+			PutLiteral(writer, 256);
+			writer.Finish();
+
+			constexpr size_t adlerChunk = 1 << 20;
+			uint32_t adler = 1;
+			for (size_t offset = 0; offset < size; offset += adlerChunk) {
+				adler = (uint32_t)av_adler32_update(adler, p + offset, (unsigned int)std::min(size - offset, adlerChunk));
+			}
+			PutBE32(out, adler);
+		}
+
+		int Paeth(int a, int b, int c) {
+			int pa = abs(b - c);
+			int pb = abs(a - c);
+			int pc = abs(a + b - 2 * c);
+			return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+		}
+
+		// 按 PNG 规范建议的办法给每行选过滤方式：五种都试一遍，取差值（按有符号看）绝对值之和最小的
+		void FilterRow(const uint8_t* row, const uint8_t* above, size_t size, uint8_t* out, std::vector<uint8_t>& candidate) {
+			constexpr int bpp = 3;
+			long bestSum = -1;
+			for (int type = 0; type <= 4; type++) {
+				candidate[0] = (uint8_t)type;
+				long sum = 0;
+				for (size_t x = 0; x < size; x++) {
+					int a = x >= bpp ? row[x - bpp] : 0;
+					int b = above ? above[x] : 0;
+					int c = above && x >= bpp ? above[x - bpp] : 0;
+					int predicted = type == 0 ? 0 : type == 1 ? a : type == 2 ? b : type == 3 ? (a + b) / 2 : Paeth(a, b, c);
+					uint8_t v = (uint8_t)(row[x] - predicted);
+					candidate[x + 1] = v;
+					sum += abs((int8_t)v);
+				}
+				if (bestSum < 0 || sum < bestSum) {
+					bestSum = sum;
+					memcpy(out, candidate.data(), size + 1);
+				}
+			}
+		}
+
+		// 每行自适应选过滤方式，再用 Deflate 压缩，外面是 zlib 的头和 Adler-32
+		void EncodePNG(const uint8_t* rgba, int pitch, int width, int height, std::vector<uint8_t>& out) {
+			static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+			out.insert(out.end(), signature, signature + 8);
+
+			std::vector<uint8_t> header;
+			PutBE32(header, width);
+			PutBE32(header, height);
+			const uint8_t format[5] = { 8, 2, 0, 0, 0 }; // 8 位，RGB，deflate，自适应过滤，不隔行
+			header.insert(header.end(), format, format + 5);
+			PutPNGChunk(out, "IHDR", header.data(), header.size());
+
+			size_t rowSize = (size_t)width * 3;
+			std::vector<uint8_t> rows[2] = { std::vector<uint8_t>(rowSize), std::vector<uint8_t>(rowSize) };
+			std::vector<uint8_t> candidate(rowSize + 1);
+			std::vector<uint8_t> filtered((rowSize + 1) * height);
+			for (int y = 0; y < height; y++) {
+				const uint8_t* src = rgba + (size_t)y * pitch;
+				auto& row = rows[y & 1];
+				for (int x = 0; x < width; x++) {
+					row[x * 3] = src[x * 4];
+					row[x * 3 + 1] = src[x * 4 + 1];
+					row[x * 3 + 2] = src[x * 4 + 2];
+				}
+				FilterRow(row.data(), y > 0 ? rows[(y - 1) & 1].data() : nullptr, rowSize, &filtered[(rowSize + 1) * y], candidate);
+			}
+
+			std::vector<uint8_t> zlib;
+			Deflate(filtered, zlib);
+			PutPNGChunk(out, "IDAT", zlib.data(), zlib.size());
+			PutPNGChunk(out, "IEND", nullptr, 0);
+		}
+
+		// https://qoiformat.org/qoi-specification.pdf
+		void EncodeQOI(const uint8_t* rgba, int pitch, int width, int height, std::vector<uint8_t>& out) {
+			const uint8_t magic[4] = { 'q', 'o', 'i', 'f' };
+			out.insert(out.end(), magic, magic + 4);
+			PutBE32(out, width);
+			PutBE32(out, height);
+			out.push_back(4); // RGBA
+			out.push_back(0); // sRGB
+
+			uint8_t index[64][4] = {};
+			uint8_t prev[4] = { 0, 0, 0, 255 };
+			int run = 0;
+			for (int y = 0; y < height; y++) {
+				const uint8_t* row = rgba + (size_t)y * pitch;
+				for (int x = 0; x < width; x++) {
+					const uint8_t px[4] = { row[x * 4], row[x * 4 + 1], row[x * 4 + 2], 255 };
+					if (memcmp(px, prev, 4) == 0) {
+						if (++run == 62) {
+							out.push_back(0xC0 | (run - 1));
+							run = 0;
+						}
+						continue;
+					}
+					if (run > 0) {
+						out.push_back(0xC0 | (run - 1));
+						run = 0;
+					}
+
+					int hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+					if (memcmp(index[hash], px, 4) == 0) {
+						out.push_back((uint8_t)hash);
+					}
+					else {
+						memcpy(index[hash], px, 4);
+						// 差值按 8 位回绕
+						int8_t dr = (int8_t)(px[0] - prev[0]);
+						int8_t dg = (int8_t)(px[1] - prev[1]);
+						int8_t db = (int8_t)(px[2] - prev[2]);
+						int8_t drg = (int8_t)(dr - dg);
+						int8_t dbg = (int8_t)(db - dg);
+						if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+							out.push_back(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+						}
+						else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+							out.push_back(0x80 | (dg + 32));
+							out.push_back((uint8_t)((drg + 8) << 4 | (dbg + 8)));
+						}
+						else {
+							const uint8_t op[4] = { 0xFE, px[0], px[1], px[2] };
+							out.insert(out.end(), op, op + 4);
+						}
+					}
+					memcpy(prev, px, 4);
+				}
+			}
+			if (run > 0) {
+				out.push_back(0xC0 | (run - 1));
+			}
+
+			const uint8_t end[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+			out.insert(out.end(), end, end + 8);
+		}
+
+		void EncodeRaw(const uint8_t* rgba, int pitch, int width, int height, std::vector<uint8_t>& out) {
+			out.resize((size_t)width * height * 4);
+			for (int y = 0; y < height; y++) {
+				memcpy(&out[(size_t)y * width * 4], rgba + (size_t)y * pitch, (size_t)width * 4);
+			}
+		}
+	}
+
+	const char* GetImageFormatName(ImageFormat format) {
+		switch (format) {
+		case ImageFormat::PNG:
+			return "PNG";
+		case ImageFormat::QOI:
+			return "QOI";
+		default:
+			return "raw RGBA";
+		}
+	}
+
+	std::string GetImageFileSuffix(ImageFormat format, int width, int height) {
+		switch (format) {
+		case ImageFormat::PNG:
+			return ".png";
+		case ImageFormat::QOI:
+			return ".qoi";
+		default:
+			return "_" + std::to_string(width) + "x" + std::to_string(height) + ".rgba";
+		}
+	}
+
+	void EncodeImage(ImageFormat format, const uint8_t* rgba, int pitch, int width, int height, std::vector<uint8_t>& out) {
+		out.clear();
+		switch (format) {
+		case ImageFormat::PNG:
+			EncodePNG(rgba, pitch, width, height, out);
+			break;
+		case ImageFormat::QOI:
+			EncodeQOI(rgba, pitch, width, height, out);
+			break;
+		default:
+			EncodeRaw(rgba, pitch, width, height, out);
+			break;
+		}
+	}
+
+	FrameWriter::FrameWriter(ImageFormat format_, int maxPending_) : format(format_), maxPending(maxPending_), isBusy(false), stats{}, isStopping(false) {
+		writeThread = std::thread(&FrameWriter::Run, this);
+	}
+
+	FrameWriter::~FrameWriter() {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			isStopping = true;
+		}
+		cond.notify_all();
+		writeThread.join();
+	}
+
+	ImageFormat FrameWriter::GetFormat() {
+		return format;
+	}
+
+	void FrameWriter::Write(std::vector<uint8_t>&& rgba, int width, int height, const std::string& path) {
+		std::unique_lock<std::mutex> lock(mtx);
+		cond.wait(lock, [&] { return (int)queue.size() < maxPending; });
+		queue.push_back({ std::move(rgba), width, height, path });
+		cond.notify_all();
+	}
+
+	void FrameWriter::Flush() {
+		std::unique_lock<std::mutex> lock(mtx);
+		cond.wait(lock, [&] { return queue.empty() && !isBusy; });
+	}
+
+	FrameWriterStats FrameWriter::GetStats() {
+		std::lock_guard<std::mutex> lock(mtx);
+		return stats;
+	}
+
+	void FrameWriter::Run() {
+		while (1) {
+			Image image;
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				cond.wait(lock, [&] { return isStopping || !queue.empty(); });
+				// 退出之前把排队的写完
+				if (queue.empty()) {
+					return;
+				}
+				image = std::move(queue.front());
+				queue.pop_front();
+				isBusy = true;
+			}
+			// 空出了位置，等着的 Write 可以继续
+			cond.notify_all();
+
+			auto start = std::chrono::steady_clock::now();
+			bool isSaved = Save(image);
+			double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				isBusy = false;
+				isSaved ? stats.written++ : stats.failed++;
+				stats.encodeMilliseconds = milliseconds;
+			}
+			cond.notify_all();
+		}
+	}
+
+	bool FrameWriter::Save(const Image& image) {
+		std::vector<uint8_t> encoded;
+		EncodeImage(format, image.rgba.data(), image.width * 4, image.width, image.height, encoded);
+
+		std::ofstream file(U8Path(image.path + GetImageFileSuffix(format, image.width, image.height)), std::ios::binary | std::ios::trunc);
+		file.write((const char*)encoded.data(), encoded.size());
+		return file.good();
+	}
+}
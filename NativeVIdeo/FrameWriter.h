@@ -0,0 +1,76 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+namespace nv {
+	enum class ImageFormat {
+		PNG, // 8 位 RGB，每行自适应过滤，deflate 只用固定哈夫曼表，1080p 编码几十到一百毫秒，比 QOI 慢、文件小
+		QOI, // 无损，编码很快，视频画面通常比 raw 小得多
+		Raw, // RGBA8 原样写出，文件名里带宽高
+	};
+
+	const char* GetImageFormatName(ImageFormat format);
+
+	// 带点的扩展名，Raw 的是 "_<宽>x<高>.rgba"
+	std::string GetImageFileSuffix(ImageFormat format, int width, int height);
+
+	// rgba 是 RGBA8，alpha 都按不透明处理。PNG 写成 8 位 RGB
+	void EncodeImage(ImageFormat format, const uint8_t* rgba, int pitch, int width, int height, std::vector<uint8_t>& out);
+
+	struct FrameWriterStats {
+		uint64_t written;
+		uint64_t failed;           // 打不开或写不进文件
+		double encodeMilliseconds; // 最近一张的编码加写文件耗时
+	};
+
+	// 在后台线程里编码、写文件，调用 Write 的线程只做一次拷贝
+	// 排队的图片最多 maxPending 张，满了 Write 会等，一段帧可以按解码速度导出而不会把内存占满
+	class FrameWriter {
+	public:
+		FrameWriter(ImageFormat format_, int maxPending_ = 4);
+
+		// 写完排队的图片再退出
+		~FrameWriter();
+
+		FrameWriter(const FrameWriter&) = delete;
+		FrameWriter& operator=(const FrameWriter&) = delete;
+
+		ImageFormat GetFormat();
+
+		// rgba 每行 width * 4 字节。path 是不带扩展名的 UTF-8 路径，扩展名按格式加
+		void Write(std::vector<uint8_t>&& rgba, int width, int height, const std::string& path);
+
+		// 等排队的图片都写完
+		void Flush();
+
+		FrameWriterStats GetStats();
+	private:
+		struct Image {
+			std::vector<uint8_t> rgba;
+			int width;
+			int height;
+			std::string path;
+		};
+
+		void Run();
+
+		bool Save(const Image& image);
+
+		ImageFormat format;
+		int maxPending;
+
+		std::deque<Image> queue;
+		bool isBusy; // 后台线程正在写一张
+		FrameWriterStats stats;
+		std::mutex mtx;
+		std::condition_variable cond;
+		std::atomic<bool> isStopping;
+		std::thread writeThread;
+	};
+}
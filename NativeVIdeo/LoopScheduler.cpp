@@ -0,0 +1,87 @@
+#include "LoopScheduler.h"
+#include <math.h>
+#include <algorithm>
+#include <limits>
+
+namespace nv {
+	namespace {
+		constexpr double never = std::numeric_limits<double>::infinity();
+	}
+
+	LoopScheduler::LoopScheduler(LoopWaiter* waiter_) : waiter(waiter_), nextTime(never), pendingFrames(1), wakeups(0), eventWakeups(0) {
+	}
+
+	void LoopScheduler::RequestAt(double time) {
+		nextTime = std::min(nextTime, time);
+	}
+
+	void LoopScheduler::RequestFrames(int count) {
+		pendingFrames = std::max(pendingFrames, count);
+	}
+
+	void LoopScheduler::Wait() {
+		double timeout = -1;
+		if (pendingFrames > 0) {
+			pendingFrames--;
+			timeout = 0;
+		}
+		else if (nextTime != never) {
+			timeout = std::max(nextTime - waiter->Now(), 0.0);
+		}
+
+		bool isEvent = waiter->Wait(timeout);
+		wakeups++;
+		if (isEvent) {
+			eventWakeups++;
+		}
+
+		if (nextTime <= waiter->Now()) {
+			nextTime = never;
+		}
+	}
+
+	uint64_t LoopScheduler::GetWakeups() {
+		return wakeups;
+	}
+
+	uint64_t LoopScheduler::GetEventWakeups() {
+		return eventWakeups;
+	}
+
+	DisplayClock::DisplayClock(double displayFreq_) : displayFreq(displayFreq_), baseTime(0), baseCount(0), isPaused(false) {
+	}
+
+	void DisplayClock::Reset(double now, int count) {
+		baseTime = now;
+		baseCount = count;
+	}
+
+	void DisplayClock::Pause(double now) {
+		if (!isPaused) {
+			baseCount = GetCount(now);
+			isPaused = true;
+		}
+	}
+
+	void DisplayClock::Resume(double now) {
+		if (isPaused) {
+			baseTime = now;
+			isPaused = false;
+		}
+	}
+
+	int DisplayClock::GetCount(double now) {
+		if (isPaused) {
+			return baseCount;
+		}
+		// 刚好在 GetTime 算出的时刻醒来时不能因为舍入少算一次
+		return baseCount + (int)floor((now - baseTime) * displayFreq + 1e-6);
+	}
+
+	double DisplayClock::GetTime(int count) {
+		if (isPaused) {
+			return never;
+		}
+		return baseTime + (count - baseCount) / displayFreq;
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <stdint.h>
+
+namespace nv {
+	// 主循环在什么上面睡眠。Win32LoopWaiter 等窗口消息和内核事件，测试可以换成模拟时钟的实现
+	class LoopWaiter {
+	public:
+		virtual ~LoopWaiter() {}
+
+		// 单调时钟（秒）
+		virtual double Now() = 0;
+
+		// 阻塞到有输入消息、等待的事件被触发或者过了 timeoutSeconds，timeoutSeconds < 0 时一直等
+		// 被消息或事件唤醒返回 true，超时返回 false
+		virtual bool Wait(double timeoutSeconds) = 0;
+	};
+
+	// 主循环的调度：每一轮登记下一次要做事的时间，没有要做的事就一直睡到有消息或事件
+	class LoopScheduler {
+	public:
+		LoopScheduler(LoopWaiter* waiter_);
+
+		// 在 time（LoopWaiter::Now 的时钟）醒来。登记的时间到了才清掉，多次登记取最早的
+		void RequestAt(double time);
+
+		// 接下来 count 轮不睡，输入之后多画几帧，让 ImGui 的悬停、拖动状态跟上
+		void RequestFrames(int count);
+
+		// 睡到登记的最早时间，或者被消息、事件提前唤醒
+		void Wait();
+
+		// 累计醒来的次数，和其中被消息、事件唤醒的次数
+		uint64_t GetWakeups();
+
+		uint64_t GetEventWakeups();
+	private:
+		LoopWaiter* waiter;
+		double nextTime; // 没有登记时为无穷大
+		int pendingFrames;
+		uint64_t wakeups;
+		uint64_t eventWakeups;
+	};
+
+	// 屏幕刷新次数的时钟。次数由经过的时间推算，不用每次刷新都醒来数，暂停时停走
+	class DisplayClock {
+	public:
+		DisplayClock(double displayFreq_);
+
+		// 从 now 开始按 count 计，跳转和按音频时钟校正时调用
+		void Reset(double now, int count);
+
+		void Pause(double now);
+
+		void Resume(double now);
+
+		int GetCount(double now);
+
+		// 计数到达 count 的时间，暂停时为无穷大
+		double GetTime(int count);
+	private:
+		double displayFreq;
+		double baseTime;
+		int baseCount;
+		bool isPaused;
+	};
+}
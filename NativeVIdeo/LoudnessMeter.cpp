@@ -0,0 +1,234 @@
+#include "LoudnessMeter.h"
+#include "CpuFeatures.h"
+#include <cmath>
+#include <string.h>
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+}
+
+namespace nv {
+	namespace {
+		constexpr double absoluteGate = -70.0;
+		constexpr double relativeGate = -10.0;
+		// 直方图覆盖 -70 ~ +10 LUFS，每桶 0.05 LU
+		constexpr double histogramStep = 0.05;
+		constexpr int histogramSize = 1600;
+
+		double EnergyToLoudness(double energy) {
+			return -0.691 + 10 * std::log10(energy);
+		}
+
+		double LoudnessToEnergy(double loudness) {
+			return std::pow(10, (loudness + 0.691) / 10);
+		}
+
+#if defined(NV_SIMD_X86)
+		typedef __m128 Vec4;
+		inline Vec4 Load4(const float* p) { return _mm_loadu_ps(p); }
+		inline void Store4(float* p, Vec4 v) { _mm_storeu_ps(p, v); }
+		inline Vec4 Set4(float v) { return _mm_set1_ps(v); }
+		inline Vec4 Add4(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+		inline Vec4 Sub4(Vec4 a, Vec4 b) { return _mm_sub_ps(a, b); }
+		inline Vec4 Mul4(Vec4 a, Vec4 b) { return _mm_mul_ps(a, b); }
+#elif defined(NV_SIMD_NEON)
+		typedef float32x4_t Vec4;
+		inline Vec4 Load4(const float* p) { return vld1q_f32(p); }
+		inline void Store4(float* p, Vec4 v) { vst1q_f32(p, v); }
+		inline Vec4 Set4(float v) { return vdupq_n_f32(v); }
+		inline Vec4 Add4(Vec4 a, Vec4 b) { return vaddq_f32(a, b); }
+		inline Vec4 Sub4(Vec4 a, Vec4 b) { return vsubq_f32(a, b); }
+		inline Vec4 Mul4(Vec4 a, Vec4 b) { return vmulq_f32(a, b); }
+#else
+		struct Vec4 { float v[4]; };
+		inline Vec4 Load4(const float* p) { Vec4 r; memcpy(r.v, p, sizeof(r.v)); return r; }
+		inline void Store4(float* p, Vec4 v) { memcpy(p, v.v, sizeof(v.v)); }
+		inline Vec4 Set4(float x) { return { { x, x, x, x } }; }
+		inline Vec4 Add4(Vec4 a, Vec4 b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+		inline Vec4 Sub4(Vec4 a, Vec4 b) { for (int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+		inline Vec4 Mul4(Vec4 a, Vec4 b) { for (int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+#endif
+	}
+
+	LoudnessMeter::LoudnessMeter(int nChannels_, int sampleRate_, uint64_t channelLayout)
+		: nChannels(nChannels_), sampleRate(sampleRate_)
+	{
+		groupCount = (nChannels + 3) / 4;
+
+		// BS.1770 的两级 K 加权滤波器，按采样率重新计算系数（与 libebur128 相同）
+		const double pi = 3.14159265358979323846;
+		double f0 = 1681.974450955533;
+		double G = 3.999843853973347;
+		double Q = 0.7071752369554196;
+		double K = std::tan(pi * f0 / sampleRate);
+		double Vh = std::pow(10.0, G / 20.0);
+		double Vb = std::pow(Vh, 0.4996667741545416);
+		double a0 = 1.0 + K / Q + K * K;
+		shelf.b0 = (float)((Vh + Vb * K / Q + K * K) / a0);
+		shelf.b1 = (float)(2.0 * (K * K - Vh) / a0);
+		shelf.b2 = (float)((Vh - Vb * K / Q + K * K) / a0);
+		shelf.a1 = (float)(2.0 * (K * K - 1.0) / a0);
+		shelf.a2 = (float)((1.0 - K / Q + K * K) / a0);
+
+		f0 = 38.13547087602444;
+		Q = 0.5003270373238773;
+		K = std::tan(pi * f0 / sampleRate);
+		a0 = 1.0 + K / Q + K * K;
+		highPass.b0 = 1;
+		highPass.b1 = -2;
+		highPass.b2 = 1;
+		highPass.a1 = (float)(2.0 * (K * K - 1.0) / a0);
+		highPass.a2 = (float)((1.0 - K / Q + K * K) / a0);
+
+		// 声道权重
+		weights.assign(groupCount * 4, 0);
+		for (int c = 0; c < nChannels; c++) {
+			float w = 1;
+			if (channelLayout != 0 && av_get_channel_layout_nb_channels(channelLayout) == nChannels) {
+				uint64_t channel = av_channel_layout_extract_channel(channelLayout, c);
+				if (channel == AV_CH_LOW_FREQUENCY || channel == AV_CH_LOW_FREQUENCY_2) {
+					w = 0;
+				}
+				else if (channel == AV_CH_SIDE_LEFT || channel == AV_CH_SIDE_RIGHT || channel == AV_CH_BACK_LEFT || channel == AV_CH_BACK_RIGHT) {
+					w = 1.41f;
+				}
+			}
+			weights[c] = w;
+		}
+
+		subBlockFrames = std::max(sampleRate / 10, 1);
+		Reset();
+	}
+
+	void LoudnessMeter::Reset() {
+		state.assign(groupCount * 16, 0);
+		accum.assign(groupCount * 4, 0);
+		subBlockPos = 0;
+		subBlockCount = 0;
+		totalFrames = 0;
+		histogramCount.assign(histogramSize, 0);
+		histogramEnergy.assign(histogramSize, 0);
+		gatedEnergySum = 0;
+		gatedBlockCount = 0;
+	}
+
+	void LoudnessMeter::Process(const float* data, uint32_t frames) {
+		const Vec4 sb0 = Set4(shelf.b0), sb1 = Set4(shelf.b1), sb2 = Set4(shelf.b2), sa1 = Set4(shelf.a1), sa2 = Set4(shelf.a2);
+		const Vec4 ha1 = Set4(highPass.a1), ha2 = Set4(highPass.a2), two = Set4(2);
+
+		uint32_t done = 0;
+		while (done < frames) {
+			uint32_t n = std::min(frames - done, subBlockFrames - subBlockPos);
+
+			for (int g = 0; g < groupCount; g++) {
+				float* s = &state[g * 16];
+				Vec4 z1 = Load4(s), z2 = Load4(s + 4), h1 = Load4(s + 8), h2 = Load4(s + 12);
+				Vec4 acc = Load4(&accum[g * 4]);
+				int lanes = std::min(4, nChannels - g * 4);
+				const float* in = data + (size_t)done * nChannels + g * 4;
+
+				alignas(16) float tmp[4] = { 0, 0, 0, 0 };
+				for (uint32_t i = 0; i < n; i++) {
+					Vec4 x;
+					if (lanes == 4) {
+						x = Load4(in);
+					}
+					else {
+						memcpy(tmp, in, lanes * sizeof(float));
+						x = Load4(tmp);
+					}
+					in += nChannels;
+
+					// 转置直接 II 型，第一级：高架
+					Vec4 y = Add4(Mul4(sb0, x), z1);
+					z1 = Sub4(Add4(Mul4(sb1, x), z2), Mul4(sa1, y));
+					z2 = Sub4(Mul4(sb2, x), Mul4(sa2, y));
+
+					// 第二级：高通，b = { 1, -2, 1 }
+					Vec4 k = Add4(y, h1);
+					h1 = Sub4(Sub4(h2, Mul4(two, y)), Mul4(ha1, k));
+					h2 = Sub4(y, Mul4(ha2, k));
+
+					acc = Add4(acc, Mul4(k, k));
+				}
+
+				Store4(s, z1);
+				Store4(s + 4, z2);
+				Store4(s + 8, h1);
+				Store4(s + 12, h2);
+				Store4(&accum[g * 4], acc);
+			}
+
+			done += n;
+			subBlockPos += n;
+			totalFrames += n;
+			if (subBlockPos == subBlockFrames) {
+				EndSubBlock();
+			}
+		}
+	}
+
+	void LoudnessMeter::EndSubBlock() {
+		double energy = 0;
+		for (int c = 0; c < groupCount * 4; c++) {
+			energy += (double)accum[c] * weights[c];
+		}
+		energy /= subBlockFrames;
+		std::fill(accum.begin(), accum.end(), 0.0f);
+		subBlockPos = 0;
+
+		subBlocks[subBlockCount % 4] = energy;
+		subBlockCount++;
+		if (subBlockCount >= 4) {
+			AddBlock((subBlocks[0] + subBlocks[1] + subBlocks[2] + subBlocks[3]) / 4);
+		}
+	}
+
+	void LoudnessMeter::AddBlock(double energy) {
+		if (energy <= 0) {
+			return;
+		}
+
+		double loudness = EnergyToLoudness(energy);
+		if (loudness < absoluteGate) {
+			return;
+		}
+
+		int bin = std::min((int)((loudness - absoluteGate) / histogramStep), histogramSize - 1);
+		histogramCount[bin]++;
+		histogramEnergy[bin] += energy;
+		gatedEnergySum += energy;
+		gatedBlockCount++;
+	}
+
+	bool LoudnessMeter::HasResult() {
+		return gatedBlockCount > 0;
+	}
+
+	double LoudnessMeter::GetIntegratedLoudness() {
+		if (gatedBlockCount == 0) {
+			return absoluteGate;
+		}
+
+		// 相对门限：超过绝对门限的块的平均响度 - 10 LU
+		double threshold = EnergyToLoudness(gatedEnergySum / gatedBlockCount) + relativeGate;
+		int startBin = std::max((int)std::ceil((threshold - absoluteGate) / histogramStep), 0);
+
+		double energySum = 0;
+		uint64_t count = 0;
+		for (int i = startBin; i < histogramSize; i++) {
+			energySum += histogramEnergy[i];
+			count += histogramCount[i];
+		}
+
+		if (count == 0) {
+			return absoluteGate;
+		}
+		return EnergyToLoudness(energySum / count);
+	}
+
+	double LoudnessMeter::GetMeasuredSeconds() {
+		return (double)totalFrames / sampleRate;
+	}
+}
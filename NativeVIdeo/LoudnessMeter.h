@@ -0,0 +1,59 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+namespace nv {
+	// EBU R128 / ITU-R BS.1770 的积分响度，可以一边播放一边喂数据
+	// K 加权滤波按声道并行做 SIMD，门限用直方图统计，内存占用和时长无关
+	class LoudnessMeter {
+	public:
+		// channelLayout 用来确定声道权重（LFE 不计，环绕声道 1.41），为 0 时全部按 1 计
+		LoudnessMeter(int nChannels_, int sampleRate_, uint64_t channelLayout);
+
+		// 输入交错 float
+		void Process(const float* data, uint32_t frames);
+
+		// 至少凑满一个 400ms 的块才有结果
+		bool HasResult();
+
+		// 积分响度（LUFS）
+		double GetIntegratedLoudness();
+
+		// 已经测量过的时长（秒）
+		double GetMeasuredSeconds();
+
+		void Reset();
+
+	private:
+		struct Biquad {
+			float b0, b1, b2, a1, a2;
+		};
+
+		void EndSubBlock();
+
+		void AddBlock(double energy);
+
+		int nChannels;
+		int sampleRate;
+		int groupCount; // 每 4 个声道一组做 SIMD
+		Biquad shelf;
+		Biquad highPass;
+		std::vector<float> weights; // 按组补齐到 4 的倍数
+
+		// 滤波器状态，每组 4 个 float：两级滤波器各两个
+		std::vector<float> state;
+		// 当前 100ms 子块的加权平方和，每组 4 个 float
+		std::vector<float> accum;
+		uint32_t subBlockFrames;
+		uint32_t subBlockPos;
+		double subBlocks[4]; // 最近 4 个子块的能量，凑成一个 400ms 的块（75% 重叠）
+		int subBlockCount;
+		uint64_t totalFrames;
+
+		// 超过绝对门限的块按响度分桶，每桶记块数和能量和
+		std::vector<uint32_t> histogramCount;
+		std::vector<double> histogramEnergy;
+		double gatedEnergySum;
+		uint64_t gatedBlockCount;
+	};
+}
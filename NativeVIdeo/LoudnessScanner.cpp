@@ -0,0 +1,170 @@
+#include "LoudnessScanner.h"
+#include "LoudnessMeter.h"
+#include "SampleConvert.h"
+#include "MediaCache.h"
+#include <fstream>
+#include <vector>
+#include <memory>
+#include <chrono>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+namespace nv {
+	namespace {
+		bool LoadCache(const std::string& cachePath, double& lufs) {
+			std::ifstream file(cachePath);
+			return file && (file >> lufs);
+		}
+
+		void SaveCache(const std::string& cachePath, double lufs) {
+			std::ofstream file(cachePath, std::ios::trunc);
+			file.precision(10);
+			file << lufs << '\n';
+		}
+	}
+
+	LoudnessScanner::LoudnessScanner(const std::string& filePath_)
+		: filePath(filePath_), isCancelled(false), isDone(false), isValid(false), isCached(false), loudness(0), speed(0)
+	{
+		cachePath = GetMediaCachePath(filePath, "loudness", ".txt");
+		if (!cachePath.empty() && LoadCache(cachePath, loudness)) {
+			isValid = true;
+			isCached = true;
+			isDone = true;
+			return;
+		}
+
+		scanThread = std::thread(&LoudnessScanner::Run, this);
+	}
+
+	LoudnessScanner::~LoudnessScanner() {
+		isCancelled = true;
+		if (scanThread.joinable()) {
+			scanThread.join();
+		}
+	}
+
+	bool LoudnessScanner::IsDone() {
+		return isDone;
+	}
+
+	bool LoudnessScanner::GetLoudness(double& lufs) {
+		if (!isDone || !isValid) {
+			return false;
+		}
+		lufs = loudness;
+		return true;
+	}
+
+	bool LoudnessScanner::IsCached() {
+		return isCached;
+	}
+
+	double LoudnessScanner::GetSpeed() {
+		return isDone ? speed : 0;
+	}
+
+	void LoudnessScanner::Run() {
+		auto startTime = std::chrono::steady_clock::now();
+
+		double lufs = 0, mediaSeconds = 0;
+		bool ok = ScanFile(lufs, mediaSeconds);
+
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+		speed = elapsed > 0 ? mediaSeconds / elapsed : 0;
+
+		if (ok) {
+			loudness = lufs;
+			isValid = true;
+			if (!cachePath.empty()) {
+				SaveCache(cachePath, lufs);
+			}
+		}
+		isDone = true;
+	}
+
+	bool LoudnessScanner::ScanFile(double& lufs, double& mediaSeconds) {
+		AVFormatContext* fmtCtx = nullptr;
+		if (avformat_open_input(&fmtCtx, filePath.c_str(), NULL, NULL) < 0) {
+			return false;
+		}
+		std::shared_ptr<AVFormatContext*> fmtGuard(&fmtCtx, [](AVFormatContext** p) { avformat_close_input(p); });
+
+		if (avformat_find_stream_info(fmtCtx, NULL) < 0) {
+			return false;
+		}
+
+		const AVCodec* codec = nullptr;
+		int streamIndex = av_find_best_stream(fmtCtx, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+		if (streamIndex < 0 || !codec) {
+			return false;
+		}
+
+		// 其它流直接在 demuxer 里丢掉
+		for (unsigned i = 0; i < fmtCtx->nb_streams; i++) {
+			fmtCtx->streams[i]->discard = (int)i == streamIndex ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+		}
+
+		AVCodecContext* codecCtx = avcodec_alloc_context3(codec);
+		std::shared_ptr<AVCodecContext*> codecGuard(&codecCtx, [](AVCodecContext** p) { avcodec_free_context(p); });
+		avcodec_parameters_to_context(codecCtx, fmtCtx->streams[streamIndex]->codecpar);
+		// 只占一个核，不和正在播放的解码抢
+		codecCtx->thread_count = 1;
+		if (avcodec_open2(codecCtx, codec, NULL) < 0) {
+			return false;
+		}
+
+		AVPacket* packet = av_packet_alloc();
+		AVFrame* frame = av_frame_alloc();
+		std::unique_ptr<LoudnessMeter> meter;
+		std::vector<float> samples;
+		int meterChannels = 0;
+		int meterRate = 0;
+
+		auto receiveFrames = [&]() {
+			while (avcodec_receive_frame(codecCtx, frame) == 0) {
+				auto convert = GetSampleConverter((AVSampleFormat)frame->format);
+				if (convert && frame->channels > 0 && frame->sample_rate > 0) {
+					// 中途换了格式的话之前测的就不算了，按新格式重新开始
+					if (!meter || meterChannels != frame->channels || meterRate != frame->sample_rate) {
+						meterChannels = frame->channels;
+						meterRate = frame->sample_rate;
+						meter = std::make_unique<LoudnessMeter>(meterChannels, meterRate, frame->channel_layout);
+					}
+
+					samples.resize((size_t)frame->nb_samples * frame->channels);
+					convert(frame->extended_data, samples.data(), frame->nb_samples, frame->channels);
+					meter->Process(samples.data(), frame->nb_samples);
+				}
+				av_frame_unref(frame);
+			}
+		};
+
+		while (!isCancelled && av_read_frame(fmtCtx, packet) == 0) {
+			if (packet->stream_index == streamIndex && avcodec_send_packet(codecCtx, packet) == 0) {
+				receiveFrames();
+			}
+			av_packet_unref(packet);
+		}
+
+		// 把解码器里剩下的帧取完
+		if (!isCancelled) {
+			avcodec_send_packet(codecCtx, NULL);
+			receiveFrames();
+		}
+
+		av_frame_free(&frame);
+		av_packet_free(&packet);
+
+		if (isCancelled || !meter || !meter->HasResult()) {
+			return false;
+		}
+
+		lufs = meter->GetIntegratedLoudness();
+		mediaSeconds = meter->GetMeasuredSeconds();
+		return true;
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <thread>
+#include <atomic>
+
+namespace nv {
+	// 在后台用单独的 demuxer 只解码音频，测出整个文件的积分响度
+	// 结果按文件缓存，同一个文件（路径、大小、修改时间都不变）第二次打开时直接读缓存
+	class LoudnessScanner {
+	public:
+		// filePath_ 是 UTF-8 路径
+		LoudnessScanner(const std::string& filePath_);
+
+		// 扫描没结束时会取消并等待后台线程退出
+		~LoudnessScanner();
+
+		bool IsDone();
+
+		// 扫描结束并且测出了响度时返回 true
+		bool GetLoudness(double& lufs);
+
+		// 结果是否来自缓存
+		bool IsCached();
+
+		// 扫描速度，实时的多少倍，读缓存时为 0
+		double GetSpeed();
+
+	private:
+		void Run();
+
+		bool ScanFile(double& lufs, double& mediaSeconds);
+
+		std::string filePath;
+		std::string cachePath;
+
+		std::thread scanThread;
+		std::atomic<bool> isCancelled;
+		std::atomic<bool> isDone;
+		bool isValid;
+		bool isCached;
+		double loudness;
+		double speed;
+	};
+}
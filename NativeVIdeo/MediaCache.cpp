@@ -0,0 +1,41 @@
+#include "MediaCache.h"
+#include <sstream>
+
+namespace nv {
+	namespace fs = std::filesystem;
+
+	fs::path U8Path(const std::string& str) {
+		return fs::path(std::u8string(str.begin(), str.end()));
+	}
+
+	std::string GetMediaCachePath(const std::string& filePath, const std::string& kind, const std::string& extension) {
+		std::error_code ec;
+		auto path = U8Path(filePath);
+		auto size = fs::file_size(path, ec);
+		if (ec) {
+			return "";
+		}
+		auto mtime = fs::last_write_time(path, ec);
+		if (ec) {
+			return "";
+		}
+
+		auto dir = fs::temp_directory_path(ec);
+		if (ec) {
+			return "";
+		}
+		dir /= "NativeVideo";
+		dir /= kind;
+		fs::create_directories(dir, ec);
+		if (ec) {
+			return "";
+		}
+
+		std::ostringstream key;
+		key << filePath << '|' << size << '|' << mtime.time_since_epoch().count();
+
+		std::ostringstream name;
+		name << std::hex << std::hash<std::string>()(key.str()) << extension;
+		return (dir / name.str()).string();
+	}
+}
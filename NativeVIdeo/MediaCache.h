@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+#include <filesystem>
+
+namespace nv {
+	// UTF-8 路径转成 std::filesystem::path
+	std::filesystem::path U8Path(const std::string& str);
+
+	// 按文件生成缓存文件的路径：临时目录下的 NativeVideo/<kind>/<hash><extension>
+	// hash 由路径、大小和修改时间决定，文件被改过就会变。目录不存在会创建，失败时返回空字符串
+	std::string GetMediaCachePath(const std::string& filePath, const std::string& kind, const std::string& extension);
+}
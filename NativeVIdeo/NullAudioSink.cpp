@@ -0,0 +1,196 @@
+#include "NullAudioSink.h"
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+namespace nv {
+	NullAudioSink::NullAudioSink(bool realtime_)
+		: realtime(realtime_), streamLatency(0), clockRate(1), nChannels(0), nSamplesPerSec(0), isStarted(false), volume(1),
+		bufferFrames(0), readPos(0), padding(0), fraction(0), playedFrames(0), underrunFrames(0), clockTicks(0)
+	{
+	}
+
+	int NullAudioSink::Open(int nChannels_, int nSamplesPerSec_, double bufferSeconds) {
+		if (nSamplesPerSec_ <= 0) {
+			return -1;
+		}
+
+		std::lock_guard<std::recursive_mutex> lock(mtx);
+		nChannels = nChannels_ > 0 ? nChannels_ : 2; // 没有真实设备，原生就当作立体声
+		nSamplesPerSec = nSamplesPerSec_;
+		bufferFrames = (uint32_t)(nSamplesPerSec * std::max(bufferSeconds, periodSeconds));
+		ring.assign((size_t)bufferFrames * nChannels, 0);
+		readPos = 0;
+		padding = 0;
+		return 0;
+	}
+
+	int NullAudioSink::Start() {
+		std::lock_guard<std::recursive_mutex> lock(mtx);
+		isStarted = true;
+		lastTime = std::chrono::steady_clock::now();
+		return 0;
+	}
+
+	int NullAudioSink::Stop() {
+		std::lock_guard<std::recursive_mutex> lock(mtx);
+		Update();
+		isStarted = false;
+		return 0;
+	}
+
+	int NullAudioSink::Reset() {
+		std::lock_guard<std::recursive_mutex> lock(mtx);
+		readPos = 0;
+		padding = 0;
+		fraction = 0;
+		return 0;
+	}
+
+	int NullAudioSink::GetChannels() {
+		return nChannels;
+	}
+
+	int NullAudioSink::GetSampleRate() {
+		return nSamplesPerSec;
+	}
+
+	uint64_t NullAudioSink::GetChannelLayout() {
+		return 0;
+	}
+
+	uint32_t NullAudioSink::GetBufferFrames() {
+		return bufferFrames;
+	}
+
+	uint32_t NullAudioSink::GetPadding() {
+		std::lock_guard<std::recursive_mutex> lock(mtx);
+		Update();
+		return padding;
+	}
+
+	double NullAudioSink::GetStreamLatency() {
+		return streamLatency;
+	}
+
+	void NullAudioSink::SetStreamLatency(double seconds) {
+		streamLatency = seconds;
+	}
+
+	void NullAudioSink::SetClockRate(double rate) {
+		std::lock_guard<std::recursive_mutex> lock(mtx);
+		Update();
+		clockRate = rate;
+	}
+
+	float* NullAudioSink::GetBuffer(uint32_t wantFrames) {
+		std::lock_guard<std::recursive_mutex> lock(mtx);
+		Update();
+		if (wantFrames > bufferFrames - padding) {
+			return nullptr;
+		}
+		writeBuffer.resize((size_t)wantFrames * nChannels);
+		return writeBuffer.data();
+	}
+
+	int NullAudioSink::ReleaseBuffer(uint32_t writtenFrames) {
+		std::lock_guard<std::recursive_mutex> lock(mtx);
+		if (writtenFrames > bufferFrames - padding || (size_t)writtenFrames * nChannels > writeBuffer.size()) {
+			return -1;
+		}
+
+		// 拷贝进环形缓冲区，可能要分两段
+		uint32_t writePos = (readPos + padding) % bufferFrames;
+		uint32_t first = std::min(writtenFrames, bufferFrames - writePos);
+		memcpy(&ring[(size_t)writePos * nChannels], writeBuffer.data(), (size_t)first * nChannels * sizeof(float));
+		if (writtenFrames > first) {
+			memcpy(&ring[0], writeBuffer.data() + (size_t)first * nChannels, (size_t)(writtenFrames - first) * nChannels * sizeof(float));
+		}
+		padding += writtenFrames;
+		return 0;
+	}
+
+	int NullAudioSink::SetVolume(float v) {
+		volume = v;
+		return 0;
+	}
+
+	float NullAudioSink::GetVolume() {
+		return volume;
+	}
+
+	void NullAudioSink::WaitForBuffer(int timeoutMs) {
+		if (realtime) {
+			std::this_thread::sleep_for(std::chrono::duration<double>(std::min(timeoutMs / 1000.0, periodSeconds)));
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(clockMutex);
+		uint64_t ticks = clockTicks;
+		clockCond.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&] { return clockTicks != ticks; });
+	}
+
+	void NullAudioSink::AdvanceClock(double seconds) {
+		{
+			std::lock_guard<std::recursive_mutex> lock(mtx);
+			if (isStarted) {
+				Consume(seconds);
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(clockMutex);
+		clockTicks++;
+		clockCond.notify_all();
+	}
+
+	uint64_t NullAudioSink::GetPlayedFrames() {
+		std::lock_guard<std::recursive_mutex> lock(mtx);
+		Update();
+		return playedFrames;
+	}
+
+	uint64_t NullAudioSink::GetUnderrunFrames() {
+		std::lock_guard<std::recursive_mutex> lock(mtx);
+		Update();
+		return underrunFrames;
+	}
+
+	void NullAudioSink::Update() {
+		if (!realtime || !isStarted) {
+			return;
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		std::chrono::duration<double> elapsed = now - lastTime;
+		lastTime = now;
+		Consume(elapsed.count());
+	}
+
+	void NullAudioSink::Consume(double seconds) {
+		if (bufferFrames == 0) {
+			return;
+		}
+
+		fraction += seconds * nSamplesPerSec * clockRate;
+		uint64_t frames = (uint64_t)fraction;
+		fraction -= frames;
+
+		while (frames > 0 && padding > 0) {
+			uint32_t n = (uint32_t)std::min<uint64_t>({ frames, padding, bufferFrames - readPos });
+			OnConsume(&ring[(size_t)readPos * nChannels], n);
+			readPos = (readPos + n) % bufferFrames;
+			padding -= n;
+			frames -= n;
+			playedFrames += n;
+		}
+
+		// 缓冲区空了，硬件照样在走，播放的是静音
+		while (frames > 0) {
+			uint32_t n = (uint32_t)std::min<uint64_t>(frames, bufferFrames);
+			OnConsume(nullptr, n);
+			frames -= n;
+			playedFrames += n;
+			underrunFrames += n;
+		}
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+#include "AudioSink.h"
+
+namespace nv {
+	// 不发声的音频设备，用一个模拟的硬件时钟按采样率消耗缓冲区里的数据
+	// realtime 为 true 时时钟跟着 steady_clock 走；为 false 时只能由 AdvanceClock 推进，适合无头测试
+	class NullAudioSink : public AudioSink {
+	public:
+		// 模拟的设备周期
+		static constexpr double periodSeconds = 0.01;
+
+		NullAudioSink(bool realtime_ = true);
+
+		int Open(int nChannels_, int nSamplesPerSec_, double bufferSeconds) override;
+
+		int Start() override;
+
+		int Stop() override;
+
+		int Reset() override;
+
+		int GetChannels() override;
+
+		int GetSampleRate() override;
+
+		uint64_t GetChannelLayout() override;
+
+		uint32_t GetBufferFrames() override;
+
+		uint32_t GetPadding() override;
+
+		double GetStreamLatency() override;
+
+		// 模拟驱动和混音器的延迟
+		void SetStreamLatency(double seconds);
+
+		float* GetBuffer(uint32_t wantFrames) override;
+
+		int ReleaseBuffer(uint32_t writtenFrames) override;
+
+		int SetVolume(float v) override;
+
+		// 实时模式下按周期睡眠，手动模式下等下一次 AdvanceClock
+		void WaitForBuffer(int timeoutMs) override;
+
+		// 模拟硬件时钟的快慢，1.001 表示实际按标称采样率的 1.001 倍消耗数据
+		void SetClockRate(double rate);
+
+		// 手动推进模拟时钟
+		void AdvanceClock(double seconds);
+
+		// 硬件已经播放的帧数，包含欠载时播放的静音
+		uint64_t GetPlayedFrames();
+
+		// 缓冲区空了还在播放的帧数
+		uint64_t GetUnderrunFrames();
+
+		float GetVolume();
+
+	protected:
+		// 帧被"播放"时调用，data 为 nullptr 表示欠载时播放的静音
+		virtual void OnConsume(const float*, uint32_t) {}
+
+	private:
+		void Consume(double seconds);
+
+		void Update();
+
+		bool realtime;
+		// 测试线程设置，音频线程和主线程读
+		std::atomic<double> streamLatency;
+		double clockRate;
+		int nChannels;
+		int nSamplesPerSec;
+		bool isStarted;
+		float volume;
+
+		// 设备缓冲区，环形
+		std::vector<float> ring;
+		uint32_t bufferFrames;
+		uint32_t readPos;
+		uint32_t padding;
+		// GetBuffer 返回给调用者的临时区域
+		std::vector<float> writeBuffer;
+
+		double fraction; // 不足一帧的时间累积
+		uint64_t playedFrames;
+		uint64_t underrunFrames;
+		std::chrono::steady_clock::time_point lastTime;
+
+		std::recursive_mutex mtx;
+
+		std::mutex clockMutex;
+		std::condition_variable clockCond;
+		uint64_t clockTicks;
+	};
+}
@@ -0,0 +1,89 @@
+#include "PixelFormat.h"
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+#include <libavutil/hwcontext.h>
+}
+
+namespace nv {
+	bool GetPixelFormatDesc(AVPixelFormat format, PixelFormatDesc& desc) {
+		auto pixDesc = av_pix_fmt_desc_get(format);
+		const uint64_t unsupportedFlags = AV_PIX_FMT_FLAG_BE | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BAYER | AV_PIX_FMT_FLAG_FLOAT;
+		if (!pixDesc || (pixDesc->flags & unsupportedFlags) || pixDesc->nb_components < 3) {
+			return false;
+		}
+
+		// 三个分量的位深和对齐必须一样，容器是 8 位或 16 位
+		auto& first = pixDesc->comp[0];
+		int bytesPerChannel = first.depth > 8 ? 2 : 1;
+		if (first.depth < 8 || first.depth + first.shift > bytesPerChannel * 8) {
+			return false;
+		}
+
+		PixelFormatDesc result = {};
+		result.format = format;
+		result.isRGB = (pixDesc->flags & AV_PIX_FMT_FLAG_RGB) != 0;
+		result.bitDepth = first.depth;
+		result.sampleShift = first.shift;
+		result.chromaShiftX = pixDesc->log2_chroma_w;
+		result.chromaShiftY = pixDesc->log2_chroma_h;
+
+		for (int i = 0; i < 3; i++) {
+			auto& comp = pixDesc->comp[i];
+			if (comp.depth != first.depth || comp.shift != first.shift || comp.plane >= PixelFormatDesc::maxPlanes
+				|| comp.step % bytesPerChannel != 0 || comp.offset % bytesPerChannel != 0) {
+				return false;
+			}
+
+			int channels = comp.step / bytesPerChannel;
+			int channel = comp.offset / bytesPerChannel;
+			if ((channels != 1 && channels != 2 && channels != 4) || channel >= channels) {
+				return false;
+			}
+
+			// 亮度所在的平面不缩小，RGB 没有色度缩小
+			bool isChroma = !result.isRGB && i > 0;
+			PlaneDesc plane = { channels, bytesPerChannel, isChroma ? result.chromaShiftX : 0, isChroma ? result.chromaShiftY : 0 };
+
+			// 同一个平面上的分量步长和缩小比例必须一样，YUYV 这类亮度和色度交错的格式不支持
+			auto& existing = result.planes[comp.plane];
+			if (existing.channels == 0) {
+				existing = plane;
+			}
+			else if (existing.channels != plane.channels || existing.widthShift != plane.widthShift || existing.heightShift != plane.heightShift) {
+				return false;
+			}
+
+			result.components[i] = { comp.plane, channel };
+			result.planeCount = std::max(result.planeCount, comp.plane + 1);
+		}
+
+		// 平面不能有空缺
+		for (int i = 0; i < result.planeCount; i++) {
+			if (result.planes[i].channels == 0) {
+				return false;
+			}
+		}
+
+		desc = result;
+		return true;
+	}
+
+	AVPixelFormat GetFramePixelFormat(const AVFrame* frame) {
+		if (frame->hw_frames_ctx) {
+			return ((AVHWFramesContext*)frame->hw_frames_ctx->data)->sw_format;
+		}
+		return (AVPixelFormat)frame->format;
+	}
+
+	int GetPlaneWidth(const PixelFormatDesc& desc, int plane, int width) {
+		int shift = desc.planes[plane].widthShift;
+		return (width + (1 << shift) - 1) >> shift;
+	}
+
+	int GetPlaneHeight(const PixelFormatDesc& desc, int plane, int height) {
+		int shift = desc.planes[plane].heightShift;
+		return (height + (1 << shift) - 1) >> shift;
+	}
+}
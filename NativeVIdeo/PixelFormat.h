@@ -0,0 +1,49 @@
+#pragma once
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+}
+
+namespace nv {
+	// 一个平面在纹理里的样子：每个像素几个通道、每个通道几个字节，宽高相对亮度右移几位（向上取整）
+	struct PlaneDesc {
+		int channels;        // 1、2 或 4
+		int bytesPerChannel; // 1 或 2
+		int widthShift;
+		int heightShift;
+	};
+
+	// 一个分量（YUV 的 Y/U/V，RGB 的 R/G/B）在第几个平面的第几个通道
+	struct ComponentDesc {
+		int plane;
+		int channel;
+	};
+
+	// 像素格式的平面布局，上传、建着色器资源、选转换函数都按它来，不再按格式一个个列表
+	struct PixelFormatDesc {
+		static constexpr int maxPlanes = 3;
+
+		AVPixelFormat format;
+		bool isRGB;
+		int bitDepth;    // 有效位数，8 到 16
+		int sampleShift; // 有效位在容器里左移的位数，P010 为 6，yuv420p10 为 0
+		int chromaShiftX;
+		int chromaShiftY;
+		int planeCount;
+		PlaneDesc planes[maxPlanes];
+		ComponentDesc components[3];
+	};
+
+	// 由 av_pix_fmt_desc_get 推出平面布局
+	// 支持小端、整数样本的平面和半平面 YUV（4:2:0、4:2:2、4:4:4，8 到 16 位，包括 NV12、P010、P016）、
+	// 平面 RGB 和每像素 4 个通道的打包 RGB。透明通道不用。其他格式（调色板、硬件帧、RGB24、YUYV 等）返回 false
+	bool GetPixelFormatDesc(AVPixelFormat format, PixelFormatDesc& desc);
+
+	// 帧里样本的实际格式，硬件帧取 hw_frames_ctx 的 sw_format
+	AVPixelFormat GetFramePixelFormat(const AVFrame* frame);
+
+	int GetPlaneWidth(const PixelFormatDesc& desc, int plane, int width);
+
+	int GetPlaneHeight(const PixelFormatDesc& desc, int plane, int height);
+}
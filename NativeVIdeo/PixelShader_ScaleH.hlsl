@@ -0,0 +1,9 @@
+// PixelShader_ScaleH.hlsl
+#include "Scale.hlsli"
+
+// First pass: video-sized RGB to view width, kept in a float target so the kernel's negative lobes survive
+float4 main_PS_ScaleH(float2 tc : TEXCOORD, float4 pos : SV_POSITION) : SV_TARGET
+{
+    int2 p = int2(pos.xy);
+    return Resample(p.x, int2(0, p.y), int2(1, 0));
+}
@@ -0,0 +1,10 @@
+// PixelShader_ScaleV.hlsl
+#include "Scale.hlsli"
+#include "Dither.hlsli"
+
+// Second pass: drawn with the fitted quad straight into the back buffer, rows are indexed in view pixels
+float4 main_PS_ScaleV(float2 tc : TEXCOORD, float4 pos : SV_POSITION) : SV_TARGET
+{
+    int2 p = int2(pos.xy);
+    return float4(Dither(saturate(Resample(p.y, int2(p.x, 0), int2(0, 1)).rgb), pos.xy), 1);
+}
@@ -0,0 +1,21 @@
+// PixelShader_ToneMap.hlsl
+#include "YUVToRGB.hlsli"
+#include "Dither.hlsli"
+
+// BT.2020 PQ/HLG RGB to SDR BT.709 RGB, baked by nv::ToneMapper
+Texture3D<float4> toneMapLut : t2;
+
+SamplerState splr : register(s0);
+SamplerState lutSampler : register(s1);
+
+float4 main_PS_ToneMap(float2 tc : TEXCOORD, float4 pos : SV_POSITION) : SV_TARGET
+{
+    float3 rgb = ConvertYUVtoRGB(SampleYUV(splr, tc));
+
+    // 0 and 1 land on the centres of the first and last texels
+    uint width, height, depth;
+    toneMapLut.GetDimensions(width, height, depth);
+    float3 coord = rgb * ((width - 1.0) / width) + 0.5 / width;
+
+    return float4(Dither(toneMapLut.SampleLevel(lutSampler, coord, 0).rgb, pos.xy), 1);
+}
\ No newline at end of file
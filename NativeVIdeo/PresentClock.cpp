@@ -0,0 +1,123 @@
+#include "PresentClock.h"
+#include <stddef.h>
+#include <limits>
+
+namespace nv {
+	namespace {
+		// 延迟和刷新周期的指数平滑系数
+		constexpr double smoothing = 1.0 / 8;
+
+		// 统计一直不来时（窗口被遮住、最小化）最多记这么多次提交
+		constexpr size_t maxSubmissions = 16;
+
+		double Smooth(double value, double sample) {
+			return value == 0 ? sample : value + (sample - value) * smoothing;
+		}
+	}
+
+	SimulatedPresentTarget::SimulatedPresentTarget(double refreshPeriod_, int maxFrameLatency_)
+		: refreshPeriod(refreshPeriod_), maxFrameLatency(maxFrameLatency_), now(0), refreshCount(0), presentCount(0), hasStatistics(false), statistics{}
+	{
+	}
+
+	double SimulatedPresentTarget::Now() {
+		return now;
+	}
+
+	void SimulatedPresentTarget::Advance(double seconds) {
+		now += seconds;
+		RunRefreshes(now);
+	}
+
+	bool SimulatedPresentTarget::WaitForReady(double timeoutSeconds) {
+		double deadline = now + timeoutSeconds;
+		while ((int)queue.size() >= maxFrameLatency) {
+			double next = (refreshCount + 1) * refreshPeriod;
+			if (next > deadline) {
+				now = deadline;
+				RunRefreshes(now);
+				return false;
+			}
+			now = next;
+			RunRefreshes(now);
+		}
+		return true;
+	}
+
+	uint32_t SimulatedPresentTarget::Present() {
+		// 和真的交换链一样，排满了 Present 会阻塞
+		WaitForReady(std::numeric_limits<double>::infinity());
+		presentCount++;
+		queue.push_back(presentCount);
+		return presentCount;
+	}
+
+	bool SimulatedPresentTarget::GetStatistics(PresentStatistics& stats) {
+		stats = statistics;
+		return hasStatistics;
+	}
+
+	void SimulatedPresentTarget::RunRefreshes(double time) {
+		while ((refreshCount + 1) * refreshPeriod <= time) {
+			refreshCount++;
+			if (!queue.empty()) {
+				statistics = { queue.front(), refreshCount, refreshCount * refreshPeriod };
+				hasStatistics = true;
+				queue.pop_front();
+			}
+		}
+	}
+
+	PresentClock::PresentClock(PresentTarget* target_)
+		: target(target_), latency(0), lastLatency(0), lastStatistics{}, hasStatistics(false), refreshPeriod(0)
+	{
+	}
+
+	void PresentClock::Present(double now) {
+		uint32_t presentCount = target->Present();
+		submissions.push_back({ presentCount, now });
+		if (submissions.size() > maxSubmissions) {
+			submissions.pop_front();
+		}
+	}
+
+	void PresentClock::Update() {
+		PresentStatistics stats;
+		if (!target->GetStatistics(stats)) {
+			return;
+		}
+		if (hasStatistics && stats.presentCount == lastStatistics.presentCount) {
+			return;
+		}
+
+		// 两次统计之间经过的刷新次数是准的，时间差除以它就是刷新周期
+		if (hasStatistics && stats.syncRefreshCount > lastStatistics.syncRefreshCount) {
+			double period = (stats.syncTime - lastStatistics.syncTime) / (stats.syncRefreshCount - lastStatistics.syncRefreshCount);
+			refreshPeriod = Smooth(refreshPeriod, period);
+		}
+		lastStatistics = stats;
+		hasStatistics = true;
+
+		// 统计只给出最近显示的那一次，之前的已经错过了
+		while (!submissions.empty() && submissions.front().presentCount < stats.presentCount) {
+			submissions.pop_front();
+		}
+		if (!submissions.empty() && submissions.front().presentCount == stats.presentCount) {
+			lastLatency = stats.syncTime - submissions.front().time;
+			latency = Smooth(latency, lastLatency);
+			submissions.pop_front();
+		}
+	}
+
+	double PresentClock::GetLatency() {
+		return latency;
+	}
+
+	double PresentClock::GetLastLatency() {
+		return lastLatency;
+	}
+
+	double PresentClock::GetRefreshRate() {
+		return refreshPeriod > 0 ? 1 / refreshPeriod : 0;
+	}
+}
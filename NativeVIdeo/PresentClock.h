@@ -0,0 +1,93 @@
+#pragma once
+#include <stdint.h>
+#include <deque>
+
+namespace nv {
+	// 交换链的帧统计：最近一次显示出来的是第 presentCount 次 Present，在第 syncRefreshCount 次刷新、syncTime 开始扫描
+	// 时间都是 LoopWaiter::Now 的时钟
+	struct PresentStatistics {
+		uint32_t presentCount;
+		uint32_t syncRefreshCount;
+		double syncTime;
+	};
+
+	// 主循环往哪里 Present。DxgiPresentTarget 是可等待的翻转交换链，测试可以换成 SimulatedPresentTarget
+	class PresentTarget {
+	public:
+		virtual ~PresentTarget() {}
+
+		// 等到还能再排一帧（排着没显示的帧少于最大帧延迟），超时返回 false
+		// 等到的名额一直留到下一次 Present，中间多次调用不会再等
+		virtual bool WaitForReady(double timeoutSeconds) = 0;
+
+		// 提交一帧，返回这次 Present 的序号
+		virtual uint32_t Present() = 0;
+
+		// 还没有帧显示出来、或者拿不到统计时返回 false
+		virtual bool GetStatistics(PresentStatistics& stats) = 0;
+	};
+
+	// 模拟的显示器：从时间 0 开始每 refreshPeriod 秒刷新一次，每次刷新显示排队的下一帧
+	// 时钟由调用者用 Advance 推进，WaitForReady 要等的时候自己推进到能排帧的那次刷新
+	class SimulatedPresentTarget : public PresentTarget {
+	public:
+		SimulatedPresentTarget(double refreshPeriod_, int maxFrameLatency_);
+
+		double Now();
+
+		void Advance(double seconds);
+
+		bool WaitForReady(double timeoutSeconds) override;
+
+		uint32_t Present() override;
+
+		bool GetStatistics(PresentStatistics& stats) override;
+	private:
+		double refreshPeriod;
+		int maxFrameLatency;
+		double now;
+		uint32_t refreshCount; // 已经过去的刷新次数，下一次刷新在 refreshCount * refreshPeriod
+		uint32_t presentCount;
+		std::deque<uint32_t> queue;
+		bool hasStatistics;
+		PresentStatistics statistics;
+
+		// 处理 time 之前（含）的所有刷新
+		void RunRefreshes(double time);
+	};
+
+	// 把每次 Present 的提交时间和帧统计对上，算出从决定画哪一帧到它开始显示的延迟
+	// 主循环按 now + GetLatency() 选帧，画面出现在屏幕上的时候才和音频对得上
+	class PresentClock {
+	public:
+		PresentClock(PresentTarget* target_);
+
+		// 在 now 决定了画面之后调用，代替直接 Present
+		void Present(double now);
+
+		// 取一次帧统计，已经显示出来的 Present 记下延迟。每次醒来调用
+		void Update();
+
+		// 平滑后的延迟（秒），还没有测到时为 0
+		double GetLatency();
+
+		// 最近一次测到的延迟，还没有测到时为 0
+		double GetLastLatency();
+
+		// 按统计里相邻两次刷新的时间算出的刷新率，还没有测到时为 0
+		double GetRefreshRate();
+	private:
+		struct Submission {
+			uint32_t presentCount;
+			double time;
+		};
+
+		PresentTarget* target;
+		std::deque<Submission> submissions;
+		double latency;
+		double lastLatency;
+		PresentStatistics lastStatistics;
+		bool hasStatistics;
+		double refreshPeriod;
+	};
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+
+namespace nv {
+	enum class ShaderStage {
+		Vertex,
+		Pixel,
+	};
+
+	// 渲染后端。RenderStateCache 只和这个接口打交道，D3D11RenderDevice 是它的实现
+	// 资源都是后端自己的对象指针（例如 ID3D11Buffer*），这一层不管引用计数，nullptr 表示解绑
+	class RenderDevice {
+	public:
+		virtual ~RenderDevice() {}
+
+		// 顶点是单个缓冲，图元固定为三角形列表
+		virtual void SetVertexBuffer(void* buffer, uint32_t stride) = 0;
+
+		// 16 位索引
+		virtual void SetIndexBuffer(void* buffer) = 0;
+
+		virtual void SetInputLayout(void* layout) = 0;
+
+		virtual void SetShader(ShaderStage stage, void* shader) = 0;
+
+		virtual void SetConstantBuffer(ShaderStage stage, int slot, void* buffer) = 0;
+
+		// 像素着色器的纹理和采样器
+		virtual void SetShaderResource(int slot, void* view) = 0;
+
+		virtual void SetSampler(int slot, void* sampler) = 0;
+
+		// nullptr 为不混合
+		virtual void SetBlendState(void* state) = 0;
+
+		// 视口从左上角开始
+		virtual void SetViewport(int width, int height) = 0;
+
+		virtual void SetRenderTarget(void* view) = 0;
+
+		virtual void ClearRenderTarget(void* view, const float color[4]) = 0;
+
+		virtual void DrawIndexed(int indexCount) = 0;
+
+		// 整个缓冲的内容换成 data
+		virtual void UpdateBuffer(void* buffer, const void* data, int size) = 0;
+
+		// 为后台缓冲或中间纹理创建渲染目标，返回的对象由 ReleaseRenderTarget 释放
+		virtual void* CreateRenderTarget(void* texture) = 0;
+
+		virtual void ReleaseRenderTarget(void* view) = 0;
+	};
+}
@@ -0,0 +1,164 @@
+#include "RenderStateCache.h"
+#include <string.h>
+
+namespace nv {
+	RenderStateCache::RenderStateCache(RenderDevice* device_) : device(device_), counters{}, frameCounters{} {
+		Invalidate();
+	}
+
+	RenderStateCache::~RenderStateCache() {
+		ReleaseRenderTargets();
+	}
+
+	void RenderStateCache::BeginFrame() {
+		frameCounters = counters;
+		counters = {};
+		state.renderTarget = (void*)-1;
+	}
+
+	const RenderCounters& RenderStateCache::GetFrameCounters() {
+		return frameCounters;
+	}
+
+	void RenderStateCache::Invalidate() {
+		memset(&state, 0xff, sizeof(state));
+	}
+
+	void* RenderStateCache::GetRenderTarget(void* texture) {
+		auto it = renderTargets.find(texture);
+		if (it != renderTargets.end()) {
+			return it->second;
+		}
+
+		counters.creations++;
+		void* view = device->CreateRenderTarget(texture);
+		if (view) {
+			renderTargets[texture] = view;
+		}
+		return view;
+	}
+
+	void RenderStateCache::ReleaseRenderTargets() {
+		if (renderTargets.empty()) {
+			return;
+		}
+
+		// 还绑在管线上的话后端不会真正释放
+		SetRenderTarget(nullptr);
+		for (auto& [texture, view] : renderTargets) {
+			device->ReleaseRenderTarget(view);
+		}
+		renderTargets.clear();
+	}
+
+	void RenderStateCache::AddCreations(int count) {
+		counters.creations += count;
+	}
+
+	template<typename T>
+	bool RenderStateCache::Change(T& cached, T value) {
+		if (cached == value) {
+			counters.redundantChanges++;
+			return false;
+		}
+
+		cached = value;
+		counters.stateChanges++;
+		return true;
+	}
+
+	void RenderStateCache::SetVertexBuffer(void* buffer, uint32_t stride) {
+		// 缓冲和步长一起下发，算一次
+		if (state.vertexBuffer == buffer && state.stride == stride) {
+			counters.redundantChanges++;
+			return;
+		}
+
+		state.vertexBuffer = buffer;
+		state.stride = stride;
+		counters.stateChanges++;
+		device->SetVertexBuffer(buffer, stride);
+	}
+
+	void RenderStateCache::SetIndexBuffer(void* buffer) {
+		if (Change(state.indexBuffer, buffer)) {
+			device->SetIndexBuffer(buffer);
+		}
+	}
+
+	void RenderStateCache::SetInputLayout(void* layout) {
+		if (Change(state.inputLayout, layout)) {
+			device->SetInputLayout(layout);
+		}
+	}
+
+	void RenderStateCache::SetShader(ShaderStage stage, void* shader) {
+		if (Change(state.shaders[(int)stage], shader)) {
+			device->SetShader(stage, shader);
+		}
+	}
+
+	void RenderStateCache::SetConstantBuffer(ShaderStage stage, int slot, void* buffer) {
+		if (Change(state.constantBuffers[(int)stage][slot], buffer)) {
+			device->SetConstantBuffer(stage, slot, buffer);
+		}
+	}
+
+	void RenderStateCache::SetShaderResource(int slot, void* view) {
+		if (Change(state.shaderResources[slot], view)) {
+			device->SetShaderResource(slot, view);
+		}
+	}
+
+	void RenderStateCache::SetSampler(int slot, void* sampler) {
+		if (Change(state.samplers[slot], sampler)) {
+			device->SetSampler(slot, sampler);
+		}
+	}
+
+	void RenderStateCache::SetBlendState(void* blendState) {
+		if (Change(state.blendState, blendState)) {
+			device->SetBlendState(blendState);
+		}
+	}
+
+	void RenderStateCache::SetViewport(int width, int height) {
+		if (state.viewportWidth == width && state.viewportHeight == height) {
+			counters.redundantChanges++;
+			return;
+		}
+
+		state.viewportWidth = width;
+		state.viewportHeight = height;
+		counters.stateChanges++;
+		device->SetViewport(width, height);
+	}
+
+	void RenderStateCache::SetRenderTarget(void* view) {
+		if (Change(state.renderTarget, view)) {
+			device->SetRenderTarget(view);
+		}
+	}
+
+	void RenderStateCache::ClearRenderTarget(void* view, const float color[4]) {
+		device->ClearRenderTarget(view, color);
+	}
+
+	void RenderStateCache::DrawIndexed(int indexCount) {
+		counters.draws++;
+		device->DrawIndexed(indexCount);
+	}
+
+	void RenderStateCache::UpdateConstantBuffer(void* buffer, const void* data, int size) {
+		auto& content = bufferContents[buffer];
+		if ((int)content.size() == size && memcmp(content.data(), data, size) == 0) {
+			counters.redundantUpdates++;
+			return;
+		}
+
+		auto bytes = (const uint8_t*)data;
+		content.assign(bytes, bytes + size);
+		counters.bufferUpdates++;
+		device->UpdateBuffer(buffer, data, size);
+	}
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <vector>
+#include <map>
+
+#include "RenderDevice.h"
+
+namespace nv {
+	// 一帧里对后端的调用次数
+	struct RenderCounters {
+		int stateChanges;      // 真正下发的状态设置
+		int redundantChanges;  // 和已绑定的相同、被省掉的状态设置
+		int bufferUpdates;     // 真正下发的缓冲更新
+		int redundantUpdates;  // 内容没变、被省掉的缓冲更新
+		int creations;         // 创建资源的调用
+		int draws;
+	};
+
+	// 记住已经绑定到后端的状态，只下发有变化的部分；常量缓冲记住上次写入的内容，没变就不更新
+	// 渲染目标按纹理建一次，之后每帧复用
+	// 绕过这里直接改了管线状态的代码（D2D 画字幕、重建交换链等）之后要调用 Invalidate
+	class RenderStateCache {
+	public:
+		static constexpr int maxSlots = 5;
+
+		RenderStateCache(RenderDevice* device_);
+
+		~RenderStateCache();
+
+		RenderStateCache(const RenderStateCache&) = delete;
+		RenderStateCache& operator=(const RenderStateCache&) = delete;
+
+		// 每帧开始时调用：这一帧的计数从零开始，上一帧的留给 GetFrameCounters
+		// 翻转模型的 Present 会把后台缓冲从管线上解绑，所以渲染目标每帧都重新绑定
+		void BeginFrame();
+
+		// 上一帧的计数
+		const RenderCounters& GetFrameCounters();
+
+		// 忘掉所有已绑定的状态，下次设置时全部重新下发
+		void Invalidate();
+
+		// 后台缓冲或中间纹理的渲染目标，第一次用到时创建
+		void* GetRenderTarget(void* texture);
+
+		// 交换链 ResizeBuffers 或重建中间纹理之前要释放所有渲染目标
+		void ReleaseRenderTargets();
+
+		// 缓存之外直接创建资源的地方调用，计入这一帧
+		void AddCreations(int count);
+
+		void SetVertexBuffer(void* buffer, uint32_t stride);
+
+		void SetIndexBuffer(void* buffer);
+
+		void SetInputLayout(void* layout);
+
+		void SetShader(ShaderStage stage, void* shader);
+
+		void SetConstantBuffer(ShaderStage stage, int slot, void* buffer);
+
+		void SetShaderResource(int slot, void* view);
+
+		void SetSampler(int slot, void* sampler);
+
+		void SetBlendState(void* state);
+
+		void SetViewport(int width, int height);
+
+		void SetRenderTarget(void* view);
+
+		void ClearRenderTarget(void* view, const float color[4]);
+
+		void DrawIndexed(int indexCount);
+
+		// 内容和上次写入的相同时不更新
+		void UpdateConstantBuffer(void* buffer, const void* data, int size);
+
+	private:
+		// 已绑定的状态，Invalidate 之后全部是不会出现的值（全 1），下一次设置一定下发
+		struct State {
+			void* vertexBuffer;
+			uint32_t stride;
+			void* indexBuffer;
+			void* inputLayout;
+			void* shaders[2];
+			void* constantBuffers[2][maxSlots];
+			void* shaderResources[maxSlots];
+			void* samplers[maxSlots];
+			void* blendState;
+			int viewportWidth;
+			int viewportHeight;
+			void* renderTarget;
+		};
+
+		// value 和缓存的不同才返回 true，并记下新值
+		template<typename T>
+		bool Change(T& cached, T value);
+
+		RenderDevice* device;
+		State state;
+		std::map<void*, void*> renderTargets; // 纹理 -> 渲染目标
+		std::map<void*, std::vector<uint8_t>> bufferContents;
+		RenderCounters counters;
+		RenderCounters frameCounters;
+	};
+}
@@ -0,0 +1,418 @@
+#include "SampleConvert.h"
+#include "CpuFeatures.h"
+#include <string.h>
+#include <map>
+
+// 所有格式都转换成 [-1, 1) 的 float，整数格式按 2 的幂缩放（与 libswresample 一致），
+// 所以标量和 SIMD 的每一步都是精确运算或同样的就近舍入，结果逐位相同
+namespace nv {
+	namespace {
+		struct FmtU8 {
+			typedef uint8_t Type;
+			static constexpr bool hasSIMD = true;
+
+			static float ToFloat(Type x) {
+				return (float)((int)x - 128) * (1.0f / 128);
+			}
+
+#if defined(NV_SIMD_X86)
+			static __m128 LoadSSE2(const Type* p) {
+				int32_t v;
+				memcpy(&v, p, 4);
+				__m128i zero = _mm_setzero_si128();
+				__m128i x = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero), zero);
+				x = _mm_sub_epi32(x, _mm_set1_epi32(128));
+				return _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.0f / 128));
+			}
+
+			static NV_TARGET_AVX2 __m256 LoadAVX2(const Type* p) {
+				__m256i x = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p));
+				x = _mm256_sub_epi32(x, _mm256_set1_epi32(128));
+				return _mm256_mul_ps(_mm256_cvtepi32_ps(x), _mm256_set1_ps(1.0f / 128));
+			}
+#elif defined(NV_SIMD_NEON)
+			static float32x4_t LoadNEON(const Type* p) {
+				uint32_t v;
+				memcpy(&v, p, 4);
+				uint16x8_t x16 = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(v)));
+				int32x4_t x = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(x16)));
+				x = vsubq_s32(x, vdupq_n_s32(128));
+				return vmulq_f32(vcvtq_f32_s32(x), vdupq_n_f32(1.0f / 128));
+			}
+#endif
+		};
+
+		struct FmtS16 {
+			typedef int16_t Type;
+			static constexpr bool hasSIMD = true;
+
+			static float ToFloat(Type x) {
+				return (float)x * (1.0f / 32768);
+			}
+
+#if defined(NV_SIMD_X86)
+			static __m128 LoadSSE2(const Type* p) {
+				__m128i x = _mm_loadl_epi64((const __m128i*)p);
+				x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+				return _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.0f / 32768));
+			}
+
+			static NV_TARGET_AVX2 __m256 LoadAVX2(const Type* p) {
+				__m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)p));
+				return _mm256_mul_ps(_mm256_cvtepi32_ps(x), _mm256_set1_ps(1.0f / 32768));
+			}
+#elif defined(NV_SIMD_NEON)
+			static float32x4_t LoadNEON(const Type* p) {
+				int32x4_t x = vmovl_s16(vld1_s16(p));
+				return vmulq_f32(vcvtq_f32_s32(x), vdupq_n_f32(1.0f / 32768));
+			}
+#endif
+		};
+
+		struct FmtS32 {
+			typedef int32_t Type;
+			static constexpr bool hasSIMD = true;
+
+			static float ToFloat(Type x) {
+				return (float)x * (1.0f / 2147483648.0f);
+			}
+
+#if defined(NV_SIMD_X86)
+			static __m128 LoadSSE2(const Type* p) {
+				__m128i x = _mm_loadu_si128((const __m128i*)p);
+				return _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.0f / 2147483648.0f));
+			}
+
+			static NV_TARGET_AVX2 __m256 LoadAVX2(const Type* p) {
+				__m256i x = _mm256_loadu_si256((const __m256i*)p);
+				return _mm256_mul_ps(_mm256_cvtepi32_ps(x), _mm256_set1_ps(1.0f / 2147483648.0f));
+			}
+#elif defined(NV_SIMD_NEON)
+			static float32x4_t LoadNEON(const Type* p) {
+				return vmulq_f32(vcvtq_f32_s32(vld1q_s32(p)), vdupq_n_f32(1.0f / 2147483648.0f));
+			}
+#endif
+		};
+
+		struct FmtFLT {
+			typedef float Type;
+			static constexpr bool hasSIMD = true;
+
+			static float ToFloat(Type x) {
+				return x;
+			}
+
+#if defined(NV_SIMD_X86)
+			static __m128 LoadSSE2(const Type* p) {
+				return _mm_loadu_ps(p);
+			}
+
+			static NV_TARGET_AVX2 __m256 LoadAVX2(const Type* p) {
+				return _mm256_loadu_ps(p);
+			}
+#elif defined(NV_SIMD_NEON)
+			static float32x4_t LoadNEON(const Type* p) {
+				return vld1q_f32(p);
+			}
+#endif
+		};
+
+		struct FmtDBL {
+			typedef double Type;
+#if defined(NV_SIMD_NEON) && !(defined(__aarch64__) || defined(_M_ARM64))
+			static constexpr bool hasSIMD = false; // 32 位 NEON 没有双精度
+#else
+			static constexpr bool hasSIMD = true;
+#endif
+
+			static float ToFloat(Type x) {
+				return (float)x;
+			}
+
+#if defined(NV_SIMD_X86)
+			static __m128 LoadSSE2(const Type* p) {
+				return _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(p)), _mm_cvtpd_ps(_mm_loadu_pd(p + 2)));
+			}
+
+			static NV_TARGET_AVX2 __m256 LoadAVX2(const Type* p) {
+				__m128 lo = _mm256_cvtpd_ps(_mm256_loadu_pd(p));
+				__m128 hi = _mm256_cvtpd_ps(_mm256_loadu_pd(p + 4));
+				return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+			}
+#elif defined(NV_SIMD_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+			static float32x4_t LoadNEON(const Type* p) {
+				return vcombine_f32(vcvt_f32_f64(vld1q_f64(p)), vcvt_f32_f64(vld1q_f64(p + 2)));
+			}
+#endif
+		};
+
+		struct FmtS64 {
+			typedef int64_t Type;
+			static constexpr bool hasSIMD = false; // 很少见，SSE2/AVX2 也没有 int64 -> float 的指令
+
+			static float ToFloat(Type x) {
+				return (float)((double)x * (1.0 / 9223372036854775808.0));
+			}
+		};
+
+		// 标量参考实现
+
+		template <class F>
+		void PackedRef(const uint8_t* const* src, float* dst, int nbSamples, int nbChannels) {
+			auto in = (const typename F::Type*)src[0];
+			int total = nbSamples * nbChannels;
+			for (int i = 0; i < total; i++) {
+				dst[i] = F::ToFloat(in[i]);
+			}
+		}
+
+		template <class F>
+		void PlanarRef(const uint8_t* const* src, float* dst, int nbSamples, int nbChannels) {
+			for (int c = 0; c < nbChannels; c++) {
+				auto in = (const typename F::Type*)src[c];
+				for (int i = 0; i < nbSamples; i++) {
+					dst[i * nbChannels + c] = F::ToFloat(in[i]);
+				}
+			}
+		}
+
+#if defined(NV_SIMD_X86)
+		template <class F>
+		void PackedSSE2(const uint8_t* const* src, float* dst, int nbSamples, int nbChannels) {
+			auto in = (const typename F::Type*)src[0];
+			int total = nbSamples * nbChannels;
+			int i = 0;
+			for (; i + 4 <= total; i += 4) {
+				_mm_storeu_ps(dst + i, F::LoadSSE2(in + i));
+			}
+			for (; i < total; i++) {
+				dst[i] = F::ToFloat(in[i]);
+			}
+		}
+
+		template <class F>
+		void PlanarSSE2(const uint8_t* const* src, float* dst, int nbSamples, int nbChannels) {
+			if (nbChannels == 1) {
+				PackedSSE2<F>(src, dst, nbSamples, 1);
+				return;
+			}
+
+			int i = 0;
+			if (nbChannels == 2) {
+				auto left = (const typename F::Type*)src[0];
+				auto right = (const typename F::Type*)src[1];
+				for (; i + 4 <= nbSamples; i += 4) {
+					__m128 l = F::LoadSSE2(left + i);
+					__m128 r = F::LoadSSE2(right + i);
+					_mm_storeu_ps(dst + i * 2, _mm_unpacklo_ps(l, r));
+					_mm_storeu_ps(dst + i * 2 + 4, _mm_unpackhi_ps(l, r));
+				}
+			}
+			else {
+				// 多声道：一次转换 4 个样本，再按声道间隔写出去
+				alignas(16) float tmp[4];
+				for (; i + 4 <= nbSamples; i += 4) {
+					for (int c = 0; c < nbChannels; c++) {
+						_mm_store_ps(tmp, F::LoadSSE2((const typename F::Type*)src[c] + i));
+						float* out = dst + i * nbChannels + c;
+						out[0] = tmp[0];
+						out[nbChannels] = tmp[1];
+						out[nbChannels * 2] = tmp[2];
+						out[nbChannels * 3] = tmp[3];
+					}
+				}
+			}
+
+			for (; i < nbSamples; i++) {
+				for (int c = 0; c < nbChannels; c++) {
+					dst[i * nbChannels + c] = F::ToFloat(((const typename F::Type*)src[c])[i]);
+				}
+			}
+		}
+
+		template <class F>
+		NV_TARGET_AVX2 void PackedAVX2(const uint8_t* const* src, float* dst, int nbSamples, int nbChannels) {
+			auto in = (const typename F::Type*)src[0];
+			int total = nbSamples * nbChannels;
+			int i = 0;
+			for (; i + 8 <= total; i += 8) {
+				_mm256_storeu_ps(dst + i, F::LoadAVX2(in + i));
+			}
+			for (; i < total; i++) {
+				dst[i] = F::ToFloat(in[i]);
+			}
+		}
+
+		template <class F>
+		NV_TARGET_AVX2 void PlanarAVX2(const uint8_t* const* src, float* dst, int nbSamples, int nbChannels) {
+			if (nbChannels == 1) {
+				PackedAVX2<F>(src, dst, nbSamples, 1);
+				return;
+			}
+
+			int i = 0;
+			if (nbChannels == 2) {
+				auto left = (const typename F::Type*)src[0];
+				auto right = (const typename F::Type*)src[1];
+				for (; i + 8 <= nbSamples; i += 8) {
+					__m256 l = F::LoadAVX2(left + i);
+					__m256 r = F::LoadAVX2(right + i);
+					// unpack 只在 128 位内交错，再把两半拼回正确的顺序
+					__m256 lo = _mm256_unpacklo_ps(l, r);
+					__m256 hi = _mm256_unpackhi_ps(l, r);
+					_mm256_storeu_ps(dst + i * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+					_mm256_storeu_ps(dst + i * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+				}
+			}
+			else {
+				alignas(32) float tmp[8];
+				for (; i + 8 <= nbSamples; i += 8) {
+					for (int c = 0; c < nbChannels; c++) {
+						_mm256_store_ps(tmp, F::LoadAVX2((const typename F::Type*)src[c] + i));
+						float* out = dst + i * nbChannels + c;
+						for (int k = 0; k < 8; k++) {
+							out[k * nbChannels] = tmp[k];
+						}
+					}
+				}
+			}
+
+			for (; i < nbSamples; i++) {
+				for (int c = 0; c < nbChannels; c++) {
+					dst[i * nbChannels + c] = F::ToFloat(((const typename F::Type*)src[c])[i]);
+				}
+			}
+		}
+#elif defined(NV_SIMD_NEON)
+		template <class F>
+		void PackedNEON(const uint8_t* const* src, float* dst, int nbSamples, int nbChannels) {
+			auto in = (const typename F::Type*)src[0];
+			int total = nbSamples * nbChannels;
+			int i = 0;
+			for (; i + 4 <= total; i += 4) {
+				vst1q_f32(dst + i, F::LoadNEON(in + i));
+			}
+			for (; i < total; i++) {
+				dst[i] = F::ToFloat(in[i]);
+			}
+		}
+
+		template <class F>
+		void PlanarNEON(const uint8_t* const* src, float* dst, int nbSamples, int nbChannels) {
+			if (nbChannels == 1) {
+				PackedNEON<F>(src, dst, nbSamples, 1);
+				return;
+			}
+
+			int i = 0;
+			if (nbChannels == 2) {
+				auto left = (const typename F::Type*)src[0];
+				auto right = (const typename F::Type*)src[1];
+				for (; i + 4 <= nbSamples; i += 4) {
+					float32x4x2_t lr = { { F::LoadNEON(left + i), F::LoadNEON(right + i) } };
+					vst2q_f32(dst + i * 2, lr);
+				}
+			}
+			else {
+				float tmp[4];
+				for (; i + 4 <= nbSamples; i += 4) {
+					for (int c = 0; c < nbChannels; c++) {
+						vst1q_f32(tmp, F::LoadNEON((const typename F::Type*)src[c] + i));
+						float* out = dst + i * nbChannels + c;
+						out[0] = tmp[0];
+						out[nbChannels] = tmp[1];
+						out[nbChannels * 2] = tmp[2];
+						out[nbChannels * 3] = tmp[3];
+					}
+				}
+			}
+
+			for (; i < nbSamples; i++) {
+				for (int c = 0; c < nbChannels; c++) {
+					dst[i * nbChannels + c] = F::ToFloat(((const typename F::Type*)src[c])[i]);
+				}
+			}
+		}
+#endif
+
+		template <class F, bool planar>
+		SampleConvertFunc SelectRef() {
+			return planar ? PlanarRef<F> : PackedRef<F>;
+		}
+
+		template <class F, bool planar>
+		SampleConvertFunc SelectFast(bool avx2) {
+			if constexpr (F::hasSIMD) {
+#if defined(NV_SIMD_X86)
+				if (avx2) {
+					return planar ? PlanarAVX2<F> : PackedAVX2<F>;
+				}
+				return planar ? PlanarSSE2<F> : PackedSSE2<F>;
+#elif defined(NV_SIMD_NEON)
+				return planar ? PlanarNEON<F> : PackedNEON<F>;
+#endif
+			}
+			return SelectRef<F, planar>();
+		}
+
+		std::map<AVSampleFormat, SampleConvertFunc> BuildRefTable() {
+			return {
+				{ AV_SAMPLE_FMT_U8, SelectRef<FmtU8, false>() },
+				{ AV_SAMPLE_FMT_S16, SelectRef<FmtS16, false>() },
+				{ AV_SAMPLE_FMT_S32, SelectRef<FmtS32, false>() },
+				{ AV_SAMPLE_FMT_FLT, SelectRef<FmtFLT, false>() },
+				{ AV_SAMPLE_FMT_DBL, SelectRef<FmtDBL, false>() },
+				{ AV_SAMPLE_FMT_S64, SelectRef<FmtS64, false>() },
+				{ AV_SAMPLE_FMT_U8P, SelectRef<FmtU8, true>() },
+				{ AV_SAMPLE_FMT_S16P, SelectRef<FmtS16, true>() },
+				{ AV_SAMPLE_FMT_S32P, SelectRef<FmtS32, true>() },
+				{ AV_SAMPLE_FMT_FLTP, SelectRef<FmtFLT, true>() },
+				{ AV_SAMPLE_FMT_DBLP, SelectRef<FmtDBL, true>() },
+				{ AV_SAMPLE_FMT_S64P, SelectRef<FmtS64, true>() },
+			};
+		}
+
+		std::map<AVSampleFormat, SampleConvertFunc> BuildFastTable(bool avx2) {
+			return {
+				{ AV_SAMPLE_FMT_U8, SelectFast<FmtU8, false>(avx2) },
+				{ AV_SAMPLE_FMT_S16, SelectFast<FmtS16, false>(avx2) },
+				{ AV_SAMPLE_FMT_S32, SelectFast<FmtS32, false>(avx2) },
+				{ AV_SAMPLE_FMT_FLT, SelectFast<FmtFLT, false>(avx2) },
+				{ AV_SAMPLE_FMT_DBL, SelectFast<FmtDBL, false>(avx2) },
+				{ AV_SAMPLE_FMT_S64, SelectFast<FmtS64, false>(avx2) },
+				{ AV_SAMPLE_FMT_U8P, SelectFast<FmtU8, true>(avx2) },
+				{ AV_SAMPLE_FMT_S16P, SelectFast<FmtS16, true>(avx2) },
+				{ AV_SAMPLE_FMT_S32P, SelectFast<FmtS32, true>(avx2) },
+				{ AV_SAMPLE_FMT_FLTP, SelectFast<FmtFLT, true>(avx2) },
+				{ AV_SAMPLE_FMT_DBLP, SelectFast<FmtDBL, true>(avx2) },
+				{ AV_SAMPLE_FMT_S64P, SelectFast<FmtS64, true>(avx2) },
+			};
+		}
+
+		SampleConvertFunc Find(const std::map<AVSampleFormat, SampleConvertFunc>& table, AVSampleFormat format) {
+			auto it = table.find(format);
+			return it == table.end() ? nullptr : it->second;
+		}
+	}
+
+	SampleConvertFunc GetSampleConverter(AVSampleFormat format) {
+		// 两张表都只建一次，每次按当前的 HasAVX2 取，DisableAVX2 之后马上生效
+		static const std::map<AVSampleFormat, SampleConvertFunc> tables[] = { BuildFastTable(false), BuildFastTable(true) };
+		return Find(tables[cpu::HasAVX2() ? 1 : 0], format);
+	}
+
+	SampleConvertFunc GetSampleConverterRef(AVSampleFormat format) {
+		static const auto table = BuildRefTable();
+		return Find(table, format);
+	}
+
+	const char* GetSampleConverterName() {
+#if defined(NV_SIMD_X86)
+		return cpu::HasAVX2() ? "avx2" : "sse2";
+#elif defined(NV_SIMD_NEON)
+		return "neon";
+#else
+		return "scalar";
+#endif
+	}
+}
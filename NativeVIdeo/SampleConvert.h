@@ -0,0 +1,21 @@
+#pragma once
+#include <stdint.h>
+
+extern "C" {
+#include <libavutil/samplefmt.h>
+}
+
+namespace nv {
+	// 把解码出来的一帧音频转成交错 float
+	// src 对应 AVFrame::extended_data（交错格式只用 src[0]），dst 长度为 nbSamples * nbChannels
+	typedef void (*SampleConvertFunc)(const uint8_t* const* src, float* dst, int nbSamples, int nbChannels);
+
+	// 按当前 CPU 选出的最快实现，不支持的格式返回 nullptr
+	SampleConvertFunc GetSampleConverter(AVSampleFormat format);
+
+	// 标量参考实现，SIMD 版本的结果必须和它逐位相同
+	SampleConvertFunc GetSampleConverterRef(AVSampleFormat format);
+
+	// 当前选用的实现名字，例如 "avx2"
+	const char* GetSampleConverterName();
+}
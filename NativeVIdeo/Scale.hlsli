@@ -0,0 +1,20 @@
+// Scale.hlsli
+// Separable resampling with the weight tables built by nv::MakeScaleWeights.
+// Row i of the weight texture is output pixel i along the pass's axis: texel 0 holds the first source texel,
+// texels 1..taps the weights, which already sum to one and fold in the clamped edge taps.
+Texture2D<float4> source : register(t0);
+Texture2D<float> weights : register(t1);
+
+float4 Resample(int i, int2 pos, int2 axis)
+{
+    uint width, height;
+    weights.GetDimensions(width, height);
+    int first = (int)weights.Load(int3(0, i, 0));
+
+    float4 sum = 0;
+    for (int k = 1; k < (int)width; k++)
+    {
+        sum += source.Load(int3(pos + axis * (first + k - 1), 0)) * weights.Load(int3(k, i, 0));
+    }
+    return sum;
+}
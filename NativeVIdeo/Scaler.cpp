@@ -0,0 +1,389 @@
+#include "Scaler.h"
+#include "CpuFeatures.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <tuple>
+
+// 横向：源 RGBA8 乘 14 位权重，右移 8 位成带 6 位小数的 16 位中间结果；纵向：中间结果乘 14 位权重，右移 20 位得到 8 位
+// 每一步都是精确的整数运算，累加不会溢出 int32，所以标量和 SIMD 的结果逐位相同
+namespace nv {
+	namespace {
+		constexpr int tempBits = 6;
+		constexpr int horizontalShift = ScaleWeights::weightBits - tempBits;
+		constexpr int verticalShift = ScaleWeights::weightBits + tempBits;
+
+		double KernelRadius(ScaleFilter filter) {
+			switch (filter) {
+			case ScaleFilter::Bilinear:
+				return 1;
+			case ScaleFilter::Lanczos3:
+				return 3;
+			default:
+				return 2;
+			}
+		}
+
+		// Mitchell-Netravali 一族的三次核
+		double Cubic(double x, double b, double c) {
+			x = std::abs(x);
+			if (x < 1) {
+				return ((12 - 9 * b - 6 * c) * x * x * x + (-18 + 12 * b + 6 * c) * x * x + (6 - 2 * b)) / 6;
+			}
+			if (x < 2) {
+				return ((-b - 6 * c) * x * x * x + (6 * b + 30 * c) * x * x + (-12 * b - 48 * c) * x + (8 * b + 24 * c)) / 6;
+			}
+			return 0;
+		}
+
+		double Sinc(double x) {
+			const double pi = 3.14159265358979323846;
+			return x == 0 ? 1 : std::sin(pi * x) / (pi * x);
+		}
+
+		double Kernel(ScaleFilter filter, double x) {
+			switch (filter) {
+			case ScaleFilter::Bilinear:
+				return std::max(1 - std::abs(x), 0.0);
+			case ScaleFilter::CatmullRom:
+				return Cubic(x, 0, 0.5);
+			case ScaleFilter::Bicubic:
+				return Cubic(x, 1.0 / 3, 1.0 / 3);
+			case ScaleFilter::Lanczos3:
+				return std::abs(x) < 3 ? Sinc(x) * Sinc(x / 3) : 0;
+			}
+			return 0;
+		}
+
+		// 从 x = begin 开始，返回做到了哪里，剩下的交给标量实现
+		typedef int (*HorizontalFunc)(const uint8_t* src, const ScaleWeights& columns, int16_t* out);
+
+		// 一行里第 [from, to) 个 16 位元素（每像素 4 个），同样返回做到了哪里
+		typedef int (*VerticalFunc)(const int16_t* temp, size_t stride, const int16_t* w, int taps, int from, int to, uint8_t* out);
+
+		int HorizontalNone(const uint8_t*, const ScaleWeights& columns, int16_t*) {
+			return columns.begin;
+		}
+
+		int VerticalNone(const int16_t*, size_t, const int16_t*, int, int from, int, uint8_t*) {
+			return from;
+		}
+
+		void HorizontalScalar(const uint8_t* src, const ScaleWeights& columns, int x, int16_t* out) {
+			for (; x < columns.end; x++) {
+				const uint8_t* in = src + (size_t)columns.offsets[x] * 4;
+				const int16_t* w = columns.weights.data() + (size_t)x * columns.taps;
+				for (int c = 0; c < 4; c++) {
+					int acc = 1 << (horizontalShift - 1);
+					for (int k = 0; k < columns.taps; k++) {
+						acc += in[k * 4 + c] * w[k];
+					}
+					out[x * 4 + c] = (int16_t)(acc >> horizontalShift);
+				}
+			}
+		}
+
+		void VerticalScalar(const int16_t* temp, size_t stride, const int16_t* w, int taps, int i, int to, uint8_t* out) {
+			for (; i < to; i++) {
+				int acc = 1 << (verticalShift - 1);
+				for (int k = 0; k < taps; k++) {
+					acc += temp[k * stride + i] * w[k];
+				}
+				out[i] = (uint8_t)std::clamp(acc >> verticalShift, 0, 255);
+			}
+		}
+
+		// madd 用的权重对，低 16 位对应 unpack 的第一个参数
+		int32_t WeightPair(int16_t a, int16_t b) {
+			return (int32_t)((uint32_t)(uint16_t)a | ((uint32_t)(uint16_t)b << 16));
+		}
+
+#if defined(NV_SIMD_X86)
+		// 相邻两个像素的同一通道排到一起：r0 r1 g0 g1 b0 b1 a0 a1，每个扩展成 16 位
+		NV_TARGET_SSE41 inline __m128i InterleavePixelsSSE41(__m128i pixels) {
+			const __m128i order = _mm_setr_epi8(0, -1, 4, -1, 1, -1, 5, -1, 2, -1, 6, -1, 3, -1, 7, -1);
+			return _mm_shuffle_epi8(pixels, order);
+		}
+
+		// 每个输出像素一次：两个源像素一组，madd 得到 4 个通道的部分和
+		NV_TARGET_SSE41 int HorizontalSSE41(const uint8_t* src, const ScaleWeights& columns, int16_t* out) {
+			const __m128i rounding = _mm_set1_epi32(1 << (horizontalShift - 1));
+			int taps = columns.taps;
+			for (int x = columns.begin; x < columns.end; x++) {
+				const uint8_t* in = src + (size_t)columns.offsets[x] * 4;
+				const int16_t* w = columns.weights.data() + (size_t)x * taps;
+				__m128i acc = rounding;
+				int k = 0;
+				for (; k + 2 <= taps; k += 2) {
+					__m128i p = InterleavePixelsSSE41(_mm_loadl_epi64((const __m128i*)(in + k * 4)));
+					acc = _mm_add_epi32(acc, _mm_madd_epi16(p, _mm_set1_epi32(WeightPair(w[k], w[k + 1]))));
+				}
+				if (k < taps) {
+					int32_t last;
+					memcpy(&last, in + k * 4, 4);
+					__m128i p = InterleavePixelsSSE41(_mm_cvtsi32_si128(last));
+					acc = _mm_add_epi32(acc, _mm_madd_epi16(p, _mm_set1_epi32(WeightPair(w[k], 0))));
+				}
+
+				__m128i v = _mm_srai_epi32(acc, horizontalShift);
+				_mm_storel_epi64((__m128i*)(out + x * 4), _mm_packs_epi32(v, v));
+			}
+			return columns.end;
+		}
+
+		// 8 个元素（2 个像素）一次，相邻两行一组做 madd
+		NV_TARGET_SSE41 int VerticalSSE41(const int16_t* temp, size_t stride, const int16_t* w, int taps, int i, int to, uint8_t* out) {
+			const __m128i rounding = _mm_set1_epi32(1 << (verticalShift - 1));
+			for (; i + 8 <= to; i += 8) {
+				__m128i lo = rounding, hi = rounding;
+				for (int k = 0; k < taps; k += 2) {
+					__m128i a = _mm_loadu_si128((const __m128i*)(temp + k * stride + i));
+					__m128i b = _mm_setzero_si128();
+					__m128i pair = _mm_set1_epi32(WeightPair(w[k], 0));
+					if (k + 1 < taps) {
+						b = _mm_loadu_si128((const __m128i*)(temp + (k + 1) * stride + i));
+						pair = _mm_set1_epi32(WeightPair(w[k], w[k + 1]));
+					}
+					lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), pair));
+					hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), pair));
+				}
+
+				__m128i v = _mm_packs_epi32(_mm_srai_epi32(lo, verticalShift), _mm_srai_epi32(hi, verticalShift));
+				_mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(v, v));
+			}
+			return i;
+		}
+
+		// 16 个元素（4 个像素）一次。unpack 和 pack 都在 128 位的半边里进行，顺序正好还原，最后把两半的低 8 字节拼起来
+		NV_TARGET_AVX2 int VerticalAVX2(const int16_t* temp, size_t stride, const int16_t* w, int taps, int i, int to, uint8_t* out) {
+			const __m256i rounding = _mm256_set1_epi32(1 << (verticalShift - 1));
+			for (; i + 16 <= to; i += 16) {
+				__m256i lo = rounding, hi = rounding;
+				for (int k = 0; k < taps; k += 2) {
+					__m256i a = _mm256_loadu_si256((const __m256i*)(temp + k * stride + i));
+					__m256i b = _mm256_setzero_si256();
+					__m256i pair = _mm256_set1_epi32(WeightPair(w[k], 0));
+					if (k + 1 < taps) {
+						b = _mm256_loadu_si256((const __m256i*)(temp + (k + 1) * stride + i));
+						pair = _mm256_set1_epi32(WeightPair(w[k], w[k + 1]));
+					}
+					lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), pair));
+					hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), pair));
+				}
+
+				__m256i v = _mm256_packs_epi32(_mm256_srai_epi32(lo, verticalShift), _mm256_srai_epi32(hi, verticalShift));
+				__m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0x08);
+				_mm_storeu_si128((__m128i*)(out + i), _mm256_castsi256_si128(bytes));
+			}
+			return VerticalSSE41(temp, stride, w, taps, i, to, out);
+		}
+#elif defined(NV_SIMD_NEON)
+		int HorizontalNEON(const uint8_t* src, const ScaleWeights& columns, int16_t* out) {
+			const int32x4_t rounding = vdupq_n_s32(1 << (horizontalShift - 1));
+			int taps = columns.taps;
+			for (int x = columns.begin; x < columns.end; x++) {
+				const uint8_t* in = src + (size_t)columns.offsets[x] * 4;
+				const int16_t* w = columns.weights.data() + (size_t)x * taps;
+				int32x4_t acc = rounding;
+				for (int k = 0; k < taps; k++) {
+					uint32_t pixel;
+					memcpy(&pixel, in + k * 4, 4);
+					int16x4_t p = vreinterpret_s16_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(pixel)))));
+					acc = vmlal_n_s16(acc, p, w[k]);
+				}
+				vst1_s16(out + x * 4, vmovn_s32(vshrq_n_s32(acc, horizontalShift)));
+			}
+			return columns.end;
+		}
+
+		int VerticalNEON(const int16_t* temp, size_t stride, const int16_t* w, int taps, int i, int to, uint8_t* out) {
+			const int32x4_t rounding = vdupq_n_s32(1 << (verticalShift - 1));
+			for (; i + 8 <= to; i += 8) {
+				int32x4_t lo = rounding, hi = rounding;
+				for (int k = 0; k < taps; k++) {
+					int16x8_t t = vld1q_s16(temp + k * stride + i);
+					lo = vmlal_n_s16(lo, vget_low_s16(t), w[k]);
+					hi = vmlal_n_s16(hi, vget_high_s16(t), w[k]);
+				}
+				int16x8_t v = vcombine_s16(vqmovn_s32(vshrq_n_s32(lo, verticalShift)), vqmovn_s32(vshrq_n_s32(hi, verticalShift)));
+				vst1_u8(out + i, vqmovun_s16(v));
+			}
+			return i;
+		}
+#endif
+
+		void FillBlack(uint8_t* out, int from, int to) {
+			for (int x = from; x < to; x++) {
+				out[x * 4 + 0] = out[x * 4 + 1] = out[x * 4 + 2] = 0;
+				out[x * 4 + 3] = 255;
+			}
+		}
+
+		void Scale(const ScaleWeights& columns, const ScaleWeights& rows, const uint8_t* src, int srcPitch, uint8_t* dst, int dstPitch, std::vector<int16_t>& temp,
+			HorizontalFunc horizontal, VerticalFunc vertical) {
+			int width = columns.dstSize;
+			size_t stride = (size_t)width * 4;
+			bool hasVideo = rows.begin < rows.end && columns.begin < columns.end;
+
+			// 只横向缩放纵向会用到的源行
+			int firstRow = hasVideo ? rows.offsets[rows.begin] : 0;
+			int lastRow = hasVideo ? rows.offsets[rows.end - 1] + rows.taps : 0;
+			temp.resize((size_t)(lastRow - firstRow) * stride);
+			for (int y = firstRow; y < lastRow; y++) {
+				const uint8_t* in = src + (size_t)y * srcPitch;
+				int16_t* out = temp.data() + (size_t)(y - firstRow) * stride;
+				int x = horizontal(in, columns, out);
+				HorizontalScalar(in, columns, x, out);
+			}
+
+			for (int y = 0; y < rows.dstSize; y++) {
+				uint8_t* out = dst + (size_t)y * dstPitch;
+				if (!hasVideo || y < rows.begin || y >= rows.end) {
+					FillBlack(out, 0, width);
+					continue;
+				}
+
+				FillBlack(out, 0, columns.begin);
+				FillBlack(out, columns.end, width);
+				const int16_t* in = temp.data() + (size_t)(rows.offsets[y] - firstRow) * stride;
+				const int16_t* w = rows.weights.data() + (size_t)y * rows.taps;
+				int i = vertical(in, stride, w, rows.taps, columns.begin * 4, columns.end * 4, out);
+				VerticalScalar(in, stride, w, rows.taps, i, columns.end * 4, out);
+			}
+		}
+	}
+
+	const char* GetScaleFilterName(ScaleFilter filter) {
+		switch (filter) {
+		case ScaleFilter::Bilinear:
+			return "bilinear";
+		case ScaleFilter::CatmullRom:
+			return "Catmull-Rom";
+		case ScaleFilter::Bicubic:
+			return "bicubic";
+		case ScaleFilter::Lanczos3:
+			return "Lanczos3";
+		}
+		return "";
+	}
+
+	std::shared_ptr<const ScaleWeights> MakeScaleWeights(ScaleFilter filter, int srcSize, int dstSize, double scale) {
+		auto result = std::make_shared<ScaleWeights>();
+		auto& sw = *result;
+		sw.srcSize = srcSize;
+		sw.dstSize = dstSize;
+		sw.begin = dstSize;
+		sw.end = 0;
+
+		// 缩小时把核展宽到输出像素的间距；双线性保持纹理过滤的行为，不展宽
+		double ratio = dstSize * scale / srcSize;
+		double stretch = filter != ScaleFilter::Bilinear && ratio < 1 ? 1 / ratio : 1;
+		double radius = KernelRadius(filter) * stretch;
+
+		// |j - pos| < radius 的源像素最多 ceil(2 * radius) 个，凑成偶数方便 SIMD 两两处理
+		int taps = std::min((int)std::ceil(2 * radius), srcSize);
+		taps = std::min(taps + (taps & 1), srcSize);
+		sw.taps = taps;
+		sw.offsets.assign(dstSize, 0);
+		sw.weights.assign((size_t)dstSize * taps, 0);
+
+		const int one = 1 << ScaleWeights::weightBits;
+		std::vector<double> w(taps);
+		for (int i = 0; i < dstSize; i++) {
+			double ndc = (i + 0.5) * 2 / dstSize - 1;
+			if (ndc < -scale || ndc >= scale) {
+				continue;
+			}
+			sw.begin = std::min(sw.begin, i);
+			sw.end = i + 1;
+
+			// 源像素 j 的中心在 j，落在边缘外的样本按 clamp 并到边上的样本
+			double pos = (ndc / scale + 1) / 2 * srcSize - 0.5;
+			int first = (int)std::floor(pos - radius) + 1;
+			int offset = std::clamp(first, 0, srcSize - taps);
+			std::fill(w.begin(), w.end(), 0.0);
+			double sum = 0;
+			for (int j = first; j - pos < radius; j++) {
+				double k = Kernel(filter, (j - pos) / stretch);
+				w[std::clamp(j, 0, srcSize - 1) - offset] += k;
+				sum += k;
+			}
+
+			// 定点化的舍入误差加到最大的权重上，和正好是 1
+			int16_t* out = sw.weights.data() + (size_t)i * taps;
+			int total = 0;
+			int largest = 0;
+			for (int k = 0; k < taps; k++) {
+				out[k] = (int16_t)std::lround(w[k] / sum * one);
+				total += out[k];
+				if (std::abs(out[k]) > std::abs(out[largest])) {
+					largest = k;
+				}
+			}
+			out[largest] += (int16_t)(one - total);
+			sw.offsets[i] = offset;
+		}
+
+		if (sw.begin >= sw.end) {
+			sw.begin = sw.end = 0;
+		}
+		return result;
+	}
+
+	bool ScaleWeightCache::Key::operator<(const Key& other) const {
+		return std::tie(filter, srcSize, dstSize, scale) < std::tie(other.filter, other.srcSize, other.dstSize, other.scale);
+	}
+
+	ScaleWeightCache::ScaleWeightCache() : useCount(0) {
+	}
+
+	std::shared_ptr<const ScaleWeights> ScaleWeightCache::Get(ScaleFilter filter, int srcSize, int dstSize, double scale) {
+		Key key = { filter, srcSize, dstSize, scale };
+		auto it = entries.find(key);
+		if (it == entries.end()) {
+			// 满了丢掉最久没用过的
+			if ((int)entries.size() >= capacity) {
+				auto oldest = std::min_element(entries.begin(), entries.end(), [](auto& a, auto& b) { return a.second.lastUse < b.second.lastUse; });
+				entries.erase(oldest);
+			}
+			it = entries.emplace(key, Entry{ MakeScaleWeights(filter, srcSize, dstSize, scale), 0 }).first;
+		}
+
+		it->second.lastUse = ++useCount;
+		return it->second.weights;
+	}
+
+	void ScaleRGBA(const ScaleWeights& columns, const ScaleWeights& rows, const uint8_t* src, int srcPitch, uint8_t* dst, int dstPitch, std::vector<int16_t>& temp) {
+#if defined(NV_SIMD_X86)
+		if (cpu::HasAVX2()) {
+			Scale(columns, rows, src, srcPitch, dst, dstPitch, temp, HorizontalSSE41, VerticalAVX2);
+			return;
+		}
+		if (cpu::HasSSE41()) {
+			Scale(columns, rows, src, srcPitch, dst, dstPitch, temp, HorizontalSSE41, VerticalSSE41);
+			return;
+		}
+#elif defined(NV_SIMD_NEON)
+		Scale(columns, rows, src, srcPitch, dst, dstPitch, temp, HorizontalNEON, VerticalNEON);
+		return;
+#endif
+		ScaleRGBARef(columns, rows, src, srcPitch, dst, dstPitch, temp);
+	}
+
+	void ScaleRGBARef(const ScaleWeights& columns, const ScaleWeights& rows, const uint8_t* src, int srcPitch, uint8_t* dst, int dstPitch, std::vector<int16_t>& temp) {
+		Scale(columns, rows, src, srcPitch, dst, dstPitch, temp, HorizontalNone, VerticalNone);
+	}
+
+	const char* GetScalerName() {
+#if defined(NV_SIMD_X86)
+		if (cpu::HasAVX2()) {
+			return "avx2";
+		}
+		return cpu::HasSSE41() ? "sse4.1" : "scalar";
+#elif defined(NV_SIMD_NEON)
+		return "neon";
+#else
+		return "scalar";
+#endif
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <map>
+#include <memory>
+
+namespace nv {
+	enum class ScaleFilter {
+		Bilinear,   // 和纹理的线性过滤一样，缩小时不展宽，单遍的 GPU 路径就是它
+		CatmullRom, // 三次样条 B = 0、C = 0.5，锐利、振铃很轻
+		Bicubic,    // Mitchell-Netravali B = C = 1/3，更柔和
+		Lanczos3,   // 3 瓣的 Lanczos，最锐利，边缘有轻微振铃
+	};
+
+	const char* GetScaleFilterName(ScaleFilter filter);
+
+	// 一个方向上的缩放权重：输出像素 i 取源的 [offsets[i], offsets[i] + taps) 加权求和
+	// 权重是 weightBits 位定点，每个输出像素的权重和正好是 1 << weightBits，超出源边缘的样本已经并到边上的样本里
+	// 缩小时核按比例展宽，每个源像素都参与，不会漏采样
+	struct ScaleWeights {
+		static constexpr int weightBits = 14;
+
+		int srcSize;
+		int dstSize;
+		int taps;
+		int begin; // 视频在输出上占 [begin, end)，之外是黑边，权重全为 0
+		int end;
+		std::vector<int> offsets;
+		std::vector<int16_t> weights; // dstSize 行，每行 taps 个
+	};
+
+	// 映射和 GetFitScale 画出来的四边形一样：输出像素中心在 -scale..scale 的 NDC 范围内才有视频，对应源的 0..srcSize
+	std::shared_ptr<const ScaleWeights> MakeScaleWeights(ScaleFilter filter, int srcSize, int dstSize, double scale);
+
+	// 按 (核, 源大小, 输出大小, 比例) 记住最近用过的权重表，逐帧和窗口来回拖动时不用重新算
+	class ScaleWeightCache {
+	public:
+		static constexpr int capacity = 8;
+
+		ScaleWeightCache();
+
+		std::shared_ptr<const ScaleWeights> Get(ScaleFilter filter, int srcSize, int dstSize, double scale);
+
+	private:
+		struct Key {
+			ScaleFilter filter;
+			int srcSize;
+			int dstSize;
+			double scale;
+
+			bool operator<(const Key& other) const;
+		};
+
+		struct Entry {
+			std::shared_ptr<const ScaleWeights> weights;
+			uint64_t lastUse;
+		};
+
+		std::map<Key, Entry> entries;
+		uint64_t useCount;
+	};
+
+	// RGBA8 两遍缩放：先横向缩放到 16 位的中间结果（temp），再纵向缩放到 dst
+	// dst 是 columns.dstSize x rows.dstSize，视频之外的黑边填成不透明的黑，和 ClearRenderTargetView 的颜色一样
+	void ScaleRGBA(const ScaleWeights& columns, const ScaleWeights& rows, const uint8_t* src, int srcPitch, uint8_t* dst, int dstPitch, std::vector<int16_t>& temp);
+
+	// 标量参考实现，SIMD 版本的结果必须和它逐位相同
+	void ScaleRGBARef(const ScaleWeights& columns, const ScaleWeights& rows, const uint8_t* src, int srcPitch, uint8_t* dst, int dstPitch, std::vector<int16_t>& temp);
+
+	// 当前选用的实现名字，例如 "avx2"
+	const char* GetScalerName();
+}
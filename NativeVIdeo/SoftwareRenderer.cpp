@@ -0,0 +1,199 @@
+#include "SoftwareRenderer.h"
+#include "YUVConvert.h"
+#include <chrono>
+#include <algorithm>
+
+namespace nv {
+	namespace {
+		double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+	}
+
+	void GetFitScale(int videoWidth, int videoHeight, int viewWidth, int viewHeight, double& scaleX, double& scaleY) {
+		double videoRatio = (double)videoWidth / videoHeight;
+		double viewRatio = (double)viewWidth / viewHeight;
+
+		scaleX = 1;
+		scaleY = 1;
+		if (videoRatio > viewRatio) {
+			scaleY = viewRatio / videoRatio;
+		}
+		else if (videoRatio < viewRatio) {
+			scaleX = videoRatio / viewRatio;
+		}
+	}
+
+	SoftwareRenderer::SoftwareRenderer()
+		: width(0), height(0), sourceWidth(0), sourceHeight(0), coeffsFormat(AV_PIX_FMT_NONE), coeffsRGBFormat(RGBFormat::RGBA8), colorDesc{}, coeffs{},
+		toneMapCurve(ToneMapCurve::BT2390), hdrMetadata{}, ditherMode(DitherMode::BlueNoise), crop{}, scaleFilter(ScaleFilter::CatmullRom), timings{}
+	{
+	}
+
+	bool SoftwareRenderer::IsSupported(int format) {
+		return GetYUVConverter((AVPixelFormat)format, RGBFormat::RGBA8) != nullptr;
+	}
+
+	int SoftwareRenderer::Render(const AVFrame* frame, int viewWidth, int viewHeight, const uint8_t* overlay, int overlayPitch) {
+		if (!frame || !IsSupported(frame->format) || frame->width <= 0 || frame->height <= 0 || viewWidth <= 0 || viewHeight <= 0) {
+			return -1;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+
+		Convert(frame);
+		timings.convert = MillisecondsSince(start);
+
+		auto toneMapStart = std::chrono::steady_clock::now();
+		ToneMap(frame);
+		timings.toneMap = MillisecondsSince(toneMapStart);
+
+		auto ditherStart = std::chrono::steady_clock::now();
+		Dither();
+		timings.dither = MillisecondsSince(ditherStart);
+
+		auto scaleStart = std::chrono::steady_clock::now();
+		width = viewWidth;
+		height = viewHeight;
+		Scale();
+		timings.scale = MillisecondsSince(scaleStart);
+
+		auto blendStart = std::chrono::steady_clock::now();
+		if (overlay) {
+			Blend(overlay, overlayPitch);
+		}
+		timings.blend = MillisecondsSince(blendStart);
+
+		timings.total = MillisecondsSince(start);
+		return 0;
+	}
+
+	const uint8_t* SoftwareRenderer::GetFramebuffer() {
+		return framebuffer.data();
+	}
+
+	int SoftwareRenderer::GetWidth() {
+		return width;
+	}
+
+	int SoftwareRenderer::GetHeight() {
+		return height;
+	}
+
+	const SoftwareRenderTimings& SoftwareRenderer::GetTimings() {
+		return timings;
+	}
+
+	void SoftwareRenderer::SetToneMapCurve(ToneMapCurve curve) {
+		toneMapCurve = curve;
+	}
+
+	std::shared_ptr<const ToneMapper> SoftwareRenderer::GetToneMapper() {
+		return toneMapper;
+	}
+
+	void SoftwareRenderer::SetScaleFilter(ScaleFilter filter) {
+		scaleFilter = filter;
+	}
+
+	ScaleFilter SoftwareRenderer::GetScaleFilter() {
+		return scaleFilter;
+	}
+
+	void SoftwareRenderer::SetDitherMode(DitherMode mode) {
+		ditherMode = mode;
+	}
+
+	DitherMode SoftwareRenderer::GetDitherMode() {
+		return ditherMode;
+	}
+
+	void SoftwareRenderer::SetCrop(const CropRect& rect) {
+		crop = rect;
+	}
+
+	void SoftwareRenderer::Convert(const AVFrame* frame) {
+		auto format = (AVPixelFormat)frame->format;
+		int bitDepth = GetYUVBitDepth(format);
+		bool isDithered = bitDepth > 8 && ditherMode != DitherMode::None;
+		auto rgbFormat = IsHDRTransfer(frame->color_trc) || isDithered ? RGBFormat::RGB10A2 : RGBFormat::RGBA8;
+		ColorDescription desc = { frame->colorspace, frame->color_range, frame->color_primaries, frame->height, bitDepth, bitDepth > 8 ? 16 - bitDepth : 0 };
+		if (format != coeffsFormat || rgbFormat != coeffsRGBFormat || !(desc == colorDesc)) {
+			GetYUVCoeffs(format, rgbFormat, GetYUVMatrix(desc), coeffs);
+			coeffsFormat = format;
+			coeffsRGBFormat = rgbFormat;
+			colorDesc = desc;
+		}
+
+		// 裁剪时各平面的起点按色度的缩小倍数挪到裁剪的左上角
+		const uint8_t* data[PixelFormatDesc::maxPlanes] = { frame->data[0], frame->data[1], frame->data[2] };
+		sourceWidth = frame->width;
+		sourceHeight = frame->height;
+		bool isCropped = crop.width > 0 && crop.height > 0 && crop.x >= 0 && crop.y >= 0
+			&& crop.x + crop.width <= frame->width && crop.y + crop.height <= frame->height;
+		PixelFormatDesc formatDesc;
+		if (isCropped && GetPixelFormatDesc(format, formatDesc)) {
+			for (int i = 0; i < formatDesc.planeCount; i++) {
+				auto& plane = formatDesc.planes[i];
+				data[i] += (size_t)(crop.y >> plane.heightShift) * frame->linesize[i] + (size_t)(crop.x >> plane.widthShift) * plane.channels * plane.bytesPerChannel;
+			}
+			sourceWidth = crop.width;
+			sourceHeight = crop.height;
+		}
+
+		sourceRGBA.resize((size_t)sourceWidth * sourceHeight * 4);
+		GetYUVConverter(format, rgbFormat)(data, frame->linesize, sourceWidth, sourceHeight, sourceRGBA.data(), sourceWidth * 4, coeffs);
+	}
+
+	void SoftwareRenderer::ToneMap(const AVFrame* frame) {
+		bool isChanged = UpdateHDRMetadata(frame, hdrMetadata);
+		if (!IsHDRTransfer(hdrMetadata.transfer)) {
+			toneMapper = nullptr;
+			return;
+		}
+
+		if (isChanged || !toneMapper || toneMapper->GetCurve() != toneMapCurve) {
+			toneMapper = std::make_shared<ToneMapper>(hdrMetadata, toneMapCurve);
+		}
+
+		// RGB10A2 原地换成 RGBA8
+		int pitch = sourceWidth * 4;
+		toneMapper->Apply(sourceRGBA.data(), pitch, sourceWidth, sourceHeight, sourceRGBA.data(), pitch, ditherMode);
+	}
+
+	void SoftwareRenderer::Dither() {
+		// HDR 的帧已经在 ToneMap 里量化好了
+		if (coeffsRGBFormat != RGBFormat::RGB10A2 || toneMapper) {
+			return;
+		}
+
+		int pitch = sourceWidth * 4;
+		DitherRGB10A2(sourceRGBA.data(), pitch, sourceWidth, sourceHeight, sourceRGBA.data(), pitch, ditherMode);
+	}
+
+	void SoftwareRenderer::Scale() {
+		framebuffer.resize((size_t)width * height * 4);
+
+		double scaleX, scaleY;
+		GetFitScale(sourceWidth, sourceHeight, width, height, scaleX, scaleY);
+
+		auto columns = scaleWeights.Get(scaleFilter, sourceWidth, width, scaleX);
+		auto rows = scaleWeights.Get(scaleFilter, sourceHeight, height, scaleY);
+		ScaleRGBA(*columns, *rows, sourceRGBA.data(), sourceWidth * 4, framebuffer.data(), width * 4, scaleTemp);
+	}
+
+	void SoftwareRenderer::Blend(const uint8_t* overlay, int overlayPitch) {
+		// 和 Draw 里的混合状态一样：颜色 SRC_ALPHA / INV_SRC_ALPHA，alpha 直接取字幕层的
+		for (int y = 0; y < height; y++) {
+			const uint8_t* src = overlay + (size_t)y * overlayPitch;
+			uint8_t* dst = framebuffer.data() + (size_t)y * width * 4;
+			for (int x = 0; x < width; x++) {
+				int a = src[x * 4 + 3];
+				for (int c = 0; c < 3; c++) {
+					dst[x * 4 + c] = (uint8_t)((src[x * 4 + c] * a + dst[x * 4 + c] * (255 - a) + 127) / 255);
+				}
+				dst[x * 4 + 3] = (uint8_t)a;
+			}
+		}
+	}
+}
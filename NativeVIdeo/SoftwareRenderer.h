@@ -0,0 +1,113 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "YUVConvert.h"
+#include "ToneMapping.h"
+#include "Scaler.h"
+#include "CropDetector.h"
+#include <memory>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace nv {
+	// 保持视频比例放进视图时，全屏四边形（-1..1）在 x、y 方向的缩放，多出来的部分是黑边
+	void GetFitScale(int videoWidth, int videoHeight, int viewWidth, int viewHeight, double& scaleX, double& scaleY);
+
+	// 最近一次 Render 各阶段的耗时（毫秒）
+	struct SoftwareRenderTimings {
+		double convert; // YUV 转 RGB
+		double toneMap; // HDR 转 SDR，SDR 的帧为 0
+		double dither;  // 超过 8 位的 SDR 帧抖动量化到 8 位，HDR 的帧在色调映射里一起做
+		double scale;   // 两遍缩放到视图并留黑边
+		double blend;   // 叠加字幕
+		double total;
+	};
+
+	// 不依赖 GPU 的参考渲染器，流程和 Draw 一样：YUV 转 RGB、HDR 查表转 SDR、抖动到 8 位、按 GetFitScale 缩放并留黑边、叠加字幕
+	// GPU 在缩放之后按视图的像素抖动，这里在缩放之前按源的像素抖动，缩放用的是 8 位的 RGB
+	// 颜色矩阵（按帧的色彩属性选）、采样位置和混合方式都和 GPU 一致，用来核对 GPU 的输出、测量转换开销
+	// 只依赖 libavutil，可以在 Linux 上编译运行
+	class SoftwareRenderer {
+	public:
+		SoftwareRenderer();
+
+		// 支持的格式和 GetYUVConverter 一样
+		static bool IsSupported(int format);
+
+		// 把 frame 画到 viewWidth x viewHeight 的帧缓冲里
+		// overlay 是同样大小的 RGBA8 字幕层（和 D2D 画出来的一样是预乘的），没有字幕时传 nullptr
+		// 不支持的像素格式返回 -1，帧缓冲保持不变
+		int Render(const AVFrame* frame, int viewWidth, int viewHeight, const uint8_t* overlay = nullptr, int overlayPitch = 0);
+
+		// RGBA8，每行 GetWidth() * 4 字节
+		const uint8_t* GetFramebuffer();
+
+		int GetWidth();
+
+		int GetHeight();
+
+		const SoftwareRenderTimings& GetTimings();
+
+		// PQ/HLG 的帧用的色调映射曲线，默认 BT.2390
+		void SetToneMapCurve(ToneMapCurve curve);
+
+		// 最近一帧用的色调映射，SDR 的帧为 nullptr
+		std::shared_ptr<const ToneMapper> GetToneMapper();
+
+		// 缩放用的核，默认 Catmull-Rom，和 GPU 的默认一样
+		void SetScaleFilter(ScaleFilter filter);
+
+		ScaleFilter GetScaleFilter();
+
+		// 超过 8 位和 HDR 的帧量化到 8 位时的抖动，默认蓝噪声；None 时超过 8 位的帧直接转成 RGBA8
+		void SetDitherMode(DitherMode mode);
+
+		DitherMode GetDitherMode();
+
+		// 只转换、缩放帧里 rect 的部分（自动裁掉的黑边），x、y 要是偶数。宽高为 0 或超出帧时用整帧
+		void SetCrop(const CropRect& rect);
+	private:
+		int width;
+		int height;
+		std::vector<uint8_t> framebuffer;
+
+		// 源分辨率（裁过的）的 RGBA8，Scale 的输入。HDR 和要抖动的帧 Convert 出来是 RGB10A2，ToneMap 或 Dither 之后才是 RGBA8
+		int sourceWidth;
+		int sourceHeight;
+		std::vector<uint8_t> sourceRGBA;
+
+		// 帧的格式或色彩属性变了才重新算系数，HDR 的帧先转成 RGB10A2 再查表
+		AVPixelFormat coeffsFormat;
+		RGBFormat coeffsRGBFormat;
+		ColorDescription colorDesc;
+		YUVCoeffs coeffs;
+
+		// HDR 元数据或曲线变了才重建 LUT
+		ToneMapCurve toneMapCurve;
+		HDRMetadata hdrMetadata;
+		std::shared_ptr<ToneMapper> toneMapper;
+
+		DitherMode ditherMode;
+
+		CropRect crop;
+
+		// 权重表按源和视图大小缓存，temp 是横向缩放的中间结果
+		ScaleFilter scaleFilter;
+		ScaleWeightCache scaleWeights;
+		std::vector<int16_t> scaleTemp;
+
+		SoftwareRenderTimings timings;
+
+		void Convert(const AVFrame* frame);
+
+		void ToneMap(const AVFrame* frame);
+
+		void Dither();
+
+		void Scale();
+
+		void Blend(const uint8_t* overlay, int overlayPitch);
+	};
+}
@@ -0,0 +1,311 @@
+#include "ToneMapping.h"
+#include "CpuFeatures.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/mastering_display_metadata.h>
+}
+
+namespace nv {
+	namespace {
+		// SMPTE ST 2084
+		const double pqM1 = 2610.0 / 16384;
+		const double pqM2 = 2523.0 / 4096 * 128;
+		const double pqC1 = 3424.0 / 4096;
+		const double pqC2 = 2413.0 / 4096 * 32;
+		const double pqC3 = 2392.0 / 4096 * 32;
+
+		// 非线性值 -> nits
+		double PQToLinear(double e) {
+			double p = std::pow(std::max(e, 0.0), 1 / pqM2);
+			return 10000 * std::pow(std::max(p - pqC1, 0.0) / (pqC2 - pqC3 * p), 1 / pqM1);
+		}
+
+		// nits -> 非线性值
+		double LinearToPQ(double luminance) {
+			double y = std::pow(std::max(luminance, 0.0) / 10000, pqM1);
+			return std::pow((pqC1 + pqC2 * y) / (1 + pqC3 * y), pqM2);
+		}
+
+		// ARIB STD-B67，非线性值 -> 场景线性 0..1
+		const double hlgA = 0.17883277;
+		const double hlgB = 1 - 4 * hlgA;
+		const double hlgC = 0.5 - hlgA * std::log(4 * hlgA);
+
+		double HLGToScene(double e) {
+			e = std::max(e, 0.0);
+			return e <= 0.5 ? e * e / 3 : (std::exp((e - hlgC) / hlgA) + hlgB) / 12;
+		}
+
+		// BT.2100 参考显示器的 HLG OOTF：1000 nits，系统 gamma 1.2
+		const double hlgPeak = 1000;
+		const double hlgGamma = 1.2;
+
+		const double defaultPeak = 1000;
+
+		double Luma2020(const double rgb[3]) {
+			return 0.2627 * rgb[0] + 0.6780 * rgb[1] + 0.0593 * rgb[2];
+		}
+
+		// 线性光下 BT.2020 原色到 BT.709 原色
+		const double bt2020To709[3][3] = {
+			{ 1.660491, -0.587641, -0.072850 },
+			{ -0.124550, 1.132900, -0.008349 },
+			{ -0.018151, -0.100579, 1.118730 },
+		};
+
+		double Hable(double x) {
+			const double a = 0.15, b = 0.50, c = 0.10, d = 0.20, e = 0.02, f = 0.30;
+			return (x * (a * x + c * b) + d * e) / (x * (a * x + b) + d * f) - e / f;
+		}
+
+		// 三线性插值一个 LUT 单元，p 指向单元的原点，返回 RGBA8
+		// 权重在 r、g、b 三个方向上依次插值，和纹理的三线性过滤顺序一样。threshold 是量化时加的量，0.5 为四舍五入
+#if defined(NV_SIMD_X86)
+		inline __m128 LoadEntrySSE2(const uint16_t* p) {
+			return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128()));
+		}
+
+		inline __m128 LerpSSE2(__m128 a, __m128 b, __m128 w) {
+			return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), w));
+		}
+
+		inline uint32_t LookupCell(const uint16_t* p, int strideG, int strideB, float wr, float wg, float wb, float threshold) {
+			__m128 r = _mm_set1_ps(wr);
+			__m128 c00 = LerpSSE2(LoadEntrySSE2(p), LoadEntrySSE2(p + 4), r);
+			__m128 c10 = LerpSSE2(LoadEntrySSE2(p + strideG), LoadEntrySSE2(p + strideG + 4), r);
+			__m128 c01 = LerpSSE2(LoadEntrySSE2(p + strideB), LoadEntrySSE2(p + strideB + 4), r);
+			__m128 c11 = LerpSSE2(LoadEntrySSE2(p + strideB + strideG), LoadEntrySSE2(p + strideB + strideG + 4), r);
+			__m128 g = _mm_set1_ps(wg);
+			__m128 c = LerpSSE2(LerpSSE2(c00, c10, g), LerpSSE2(c01, c11, g), _mm_set1_ps(wb));
+
+			__m128i i = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(c, _mm_set1_ps(255.0f / 65535)), _mm_set1_ps(threshold)));
+			i = _mm_packs_epi32(i, i);
+			return (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(i, i));
+		}
+#elif defined(NV_SIMD_NEON)
+		inline float32x4_t LoadEntryNEON(const uint16_t* p) {
+			return vcvtq_f32_u32(vmovl_u16(vld1_u16(p)));
+		}
+
+		inline float32x4_t LerpNEON(float32x4_t a, float32x4_t b, float w) {
+			return vmlaq_n_f32(a, vsubq_f32(b, a), w);
+		}
+
+		inline uint32_t LookupCell(const uint16_t* p, int strideG, int strideB, float wr, float wg, float wb, float threshold) {
+			float32x4_t c00 = LerpNEON(LoadEntryNEON(p), LoadEntryNEON(p + 4), wr);
+			float32x4_t c10 = LerpNEON(LoadEntryNEON(p + strideG), LoadEntryNEON(p + strideG + 4), wr);
+			float32x4_t c01 = LerpNEON(LoadEntryNEON(p + strideB), LoadEntryNEON(p + strideB + 4), wr);
+			float32x4_t c11 = LerpNEON(LoadEntryNEON(p + strideB + strideG), LoadEntryNEON(p + strideB + strideG + 4), wr);
+			float32x4_t c = LerpNEON(LerpNEON(c00, c10, wg), LerpNEON(c01, c11, wg), wb);
+
+			uint32x4_t i = vcvtq_u32_f32(vmlaq_n_f32(vdupq_n_f32(threshold), c, 255.0f / 65535));
+			uint8x8_t b = vmovn_u16(vcombine_u16(vmovn_u32(i), vmovn_u32(i)));
+			return vget_lane_u32(vreinterpret_u32_u8(b), 0);
+		}
+#else
+		inline uint32_t LookupCell(const uint16_t* p, int strideG, int strideB, float wr, float wg, float wb, float threshold) {
+			uint8_t rgba[4];
+			for (int i = 0; i < 4; i++) {
+				float c00 = p[i] + (p[i + 4] - p[i]) * wr;
+				float c10 = p[i + strideG] + (p[i + strideG + 4] - p[i + strideG]) * wr;
+				float c01 = p[i + strideB] + (p[i + strideB + 4] - p[i + strideB]) * wr;
+				float c11 = p[i + strideB + strideG] + (p[i + strideB + strideG + 4] - p[i + strideB + strideG]) * wr;
+				float c0 = c00 + (c10 - c00) * wg;
+				float c1 = c01 + (c11 - c01) * wg;
+				rgba[i] = (uint8_t)((c0 + (c1 - c0) * wb) * (255.0f / 65535) + threshold);
+			}
+			uint32_t value;
+			memcpy(&value, rgba, 4);
+			return value;
+		}
+#endif
+	}
+
+	bool IsHDRTransfer(AVColorTransferCharacteristic transfer) {
+		return transfer == AVCOL_TRC_SMPTE2084 || transfer == AVCOL_TRC_ARIB_STD_B67;
+	}
+
+	bool UpdateHDRMetadata(const AVFrame* frame, HDRMetadata& metadata) {
+		HDRMetadata updated = { frame->color_trc, 0 };
+		if (frame->color_trc == AVCOL_TRC_ARIB_STD_B67) {
+			updated.peakLuminance = hlgPeak;
+		}
+		else if (frame->color_trc == AVCOL_TRC_SMPTE2084) {
+			updated.peakLuminance = metadata.transfer == AVCOL_TRC_SMPTE2084 ? metadata.peakLuminance : defaultPeak;
+
+			auto mastering = av_frame_get_side_data(frame, AV_FRAME_DATA_MASTERING_DISPLAY_METADATA);
+			if (mastering) {
+				auto data = (const AVMasteringDisplayMetadata*)mastering->data;
+				if (data->has_luminance && data->max_luminance.num > 0) {
+					updated.peakLuminance = av_q2d(data->max_luminance);
+				}
+			}
+
+			auto lightLevel = av_frame_get_side_data(frame, AV_FRAME_DATA_CONTENT_LIGHT_LEVEL);
+			if (lightLevel) {
+				auto data = (const AVContentLightMetadata*)lightLevel->data;
+				if (data->MaxCLL > 0) {
+					updated.peakLuminance = data->MaxCLL;
+				}
+			}
+
+			updated.peakLuminance = std::min(updated.peakLuminance, 10000.0);
+		}
+
+		if (updated == metadata) {
+			return false;
+		}
+		metadata = updated;
+		return true;
+	}
+
+	const char* GetToneMapCurveName(ToneMapCurve curve) {
+		return curve == ToneMapCurve::Hable ? "Hable" : "BT.2390";
+	}
+
+	ToneMapper::ToneMapper(const HDRMetadata& metadata_, ToneMapCurve curve_, double targetLuminance_)
+		: metadata(metadata_), curve(curve_), targetLuminance(targetLuminance_)
+	{
+		// 曲线里和像素无关的部分。Hable 以 SDR 白为 1，把源的峰值映射到 1
+		sourcePQ = LinearToPQ(metadata.peakLuminance);
+		targetPQ = LinearToPQ(targetLuminance) / sourcePQ;
+		hableWhite = Hable(std::max(metadata.peakLuminance / targetLuminance, 1.0));
+
+		// 10 位值 v 落在格点 v * (lutSize - 1) / 1023 上，和纹理采样时 tc 换算到格点中心一致
+		for (int v = 0; v < 1024; v++) {
+			double pos = v * (lutSize - 1) / 1023.0;
+			int index = std::min((int)pos, lutSize - 2);
+			lutIndex[v] = index;
+			lutWeight[v] = (float)(pos - index);
+		}
+
+		// 解码是逐分量的，每个轴只算一次
+		double axis[lutSize];
+		for (int i = 0; i < lutSize; i++) {
+			axis[i] = DecodeChannel((double)i / (lutSize - 1));
+		}
+
+		lut.resize((size_t)lutSize * lutSize * lutSize * 4);
+		auto p = lut.data();
+		for (int b = 0; b < lutSize; b++) {
+			for (int g = 0; g < lutSize; g++) {
+				for (int r = 0; r < lutSize; r++) {
+					double decoded[3] = { axis[r], axis[g], axis[b] };
+					float out[3];
+					MapDecoded(decoded, out);
+					for (int c = 0; c < 3; c++) {
+						*p++ = (uint16_t)std::lround(out[c] * 65535);
+					}
+					*p++ = 65535;
+				}
+			}
+		}
+	}
+
+	double ToneMapper::ToneMap(double luminance) const {
+		if (curve == ToneMapCurve::Hable) {
+			return targetLuminance * Hable(luminance / targetLuminance) / hableWhite;
+		}
+
+		if (metadata.peakLuminance <= targetLuminance) {
+			return luminance;
+		}
+
+		// BT.2390 EETF，源的黑电平按 0 处理
+		double e = std::min(LinearToPQ(luminance) / sourcePQ, 1.0);
+		double maxLum = targetPQ;
+		double ks = 1.5 * maxLum - 0.5;
+		if (e > ks) {
+			double t = (e - ks) / (1 - ks);
+			double t2 = t * t, t3 = t2 * t;
+			e = (2 * t3 - 3 * t2 + 1) * ks + (t3 - 2 * t2 + t) * (1 - ks) + (-2 * t3 + 3 * t2) * maxLum;
+		}
+		return PQToLinear(e * sourcePQ);
+	}
+
+	double ToneMapper::DecodeChannel(double e) const {
+		return metadata.transfer == AVCOL_TRC_ARIB_STD_B67 ? HLGToScene(e) : PQToLinear(e);
+	}
+
+	void ToneMapper::MapPixel(const float in[3], float out[3]) const {
+		double decoded[3];
+		for (int c = 0; c < 3; c++) {
+			decoded[c] = DecodeChannel(in[c]);
+		}
+		MapDecoded(decoded, out);
+	}
+
+	void ToneMapper::MapDecoded(const double decoded[3], float out[3]) const {
+		// 显示亮度（nits），BT.2020 原色
+		double rgb[3] = { decoded[0], decoded[1], decoded[2] };
+		if (metadata.transfer == AVCOL_TRC_ARIB_STD_B67) {
+			double ys = Luma2020(decoded);
+			double gain = ys > 0 ? hlgPeak * std::pow(ys, hlgGamma - 1) : 0;
+			for (int c = 0; c < 3; c++) {
+				rgb[c] *= gain;
+			}
+		}
+
+		double bt709[3];
+		for (int c = 0; c < 3; c++) {
+			bt709[c] = bt2020To709[c][0] * rgb[0] + bt2020To709[c][1] * rgb[1] + bt2020To709[c][2] * rgb[2];
+		}
+
+		// BT.709 装不下的颜色保持亮度向灰色收，直到没有负分量
+		double y = 0.2126 * bt709[0] + 0.7152 * bt709[1] + 0.0722 * bt709[2];
+		double minValue = std::min({ bt709[0], bt709[1], bt709[2] });
+		if (minValue < 0 && y > 0) {
+			double t = y / (y - minValue);
+			for (int c = 0; c < 3; c++) {
+				bt709[c] = y + (bt709[c] - y) * t;
+			}
+		}
+
+		// 按最大分量映射，三个分量同比缩放，色相不变，也不会超出 1
+		double maxValue = std::max({ bt709[0], bt709[1], bt709[2] });
+		double scale = maxValue > 0 ? ToneMap(maxValue) / maxValue / targetLuminance : 0;
+
+		for (int c = 0; c < 3; c++) {
+			out[c] = (float)std::pow(std::clamp(bt709[c] * scale, 0.0, 1.0), 1 / 2.2);
+		}
+	}
+
+	const std::vector<uint16_t>& ToneMapper::GetLUT() const {
+		return lut;
+	}
+
+	void ToneMapper::Apply(const uint8_t* src, int srcPitch, int width, int height, uint8_t* dst, int dstPitch, DitherMode dither) const {
+		const int strideG = lutSize * 4;
+		const int strideB = lutSize * lutSize * 4;
+
+		// 阈值表换成浮点，量化时加上它而不是 0.5
+		float thresholds[ditherSize * ditherSize];
+		const uint8_t* matrix = GetDitherMatrix(dither);
+		for (int i = 0; i < ditherSize * ditherSize; i++) {
+			thresholds[i] = matrix[i] / 256.0f;
+		}
+
+		for (int y = 0; y < height; y++) {
+			auto srcRow = (const uint32_t*)(src + (size_t)y * srcPitch);
+			auto dstRow = (uint32_t*)(dst + (size_t)y * dstPitch);
+			const float* rowThresholds = thresholds + (y & (ditherSize - 1)) * ditherSize;
+			for (int x = 0; x < width; x++) {
+				uint32_t v = srcRow[x];
+				int r = v & 1023, g = (v >> 10) & 1023, b = (v >> 20) & 1023;
+				const uint16_t* p = lut.data() + lutIndex[r] * 4 + lutIndex[g] * strideG + lutIndex[b] * strideB;
+				dstRow[x] = LookupCell(p, strideG, strideB, lutWeight[r], lutWeight[g], lutWeight[b], rowThresholds[x & (ditherSize - 1)]);
+			}
+		}
+	}
+
+	const HDRMetadata& ToneMapper::GetMetadata() const {
+		return metadata;
+	}
+
+	ToneMapCurve ToneMapper::GetCurve() const {
+		return curve;
+	}
+}
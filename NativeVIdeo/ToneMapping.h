@@ -0,0 +1,78 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "Dither.h"
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace nv {
+	enum class ToneMapCurve {
+		BT2390, // ITU-R BT.2390 的 EETF，在 PQ 域用 Hermite 样条压缩高光，峰值以下的暗部和中间调不变
+		Hable,  // Uncharted 2 的 filmic 曲线，整体更暗、对比更强
+	};
+
+	// 决定色调映射的源信息，变了才需要重建 LUT
+	struct HDRMetadata {
+		AVColorTransferCharacteristic transfer;
+		double peakLuminance; // 源的峰值亮度（nits）
+
+		bool operator==(const HDRMetadata&) const = default;
+	};
+
+	// PQ（SMPTE ST 2084）和 HLG（ARIB STD-B67）
+	bool IsHDRTransfer(AVColorTransferCharacteristic transfer);
+
+	// 按帧的 color_trc 和 side data 更新 metadata，变了返回 true，metadata 初始为 {}
+	// PQ 的峰值优先用 content light level 的 MaxCLL，其次是 mastering display 的最大亮度，都没有时按 1000 nits
+	// 这两种 side data 通常只跟着关键帧，没带的帧沿用之前的值；HLG 按 BT.2100 的参考显示器固定为 1000 nits
+	bool UpdateHDRMetadata(const AVFrame* frame, HDRMetadata& metadata);
+
+	const char* GetToneMapCurveName(ToneMapCurve curve);
+
+	// 把 BT.2020 的 PQ/HLG 非线性 RGB 映射成 BT.709、gamma 2.2 的 SDR RGB：
+	// 解码到显示亮度、按 max(R, G, B) 做色调映射、转到 BT.709 色域（超出的部分保持亮度向灰色收），再编码成 gamma 2.2
+	// 逐像素的计算都烘焙进 lutSize^3 的 3D LUT，GPU 用纹理的三线性过滤查表，CPU 的 Apply 做同样的三线性插值
+	class ToneMapper {
+	public:
+		static constexpr int lutSize = 65;
+
+		// targetLuminance 是 SDR 白（输出 1.0）对应的亮度，默认用 BT.2408 的 HDR 参考白 203 nits
+		ToneMapper(const HDRMetadata& metadata, ToneMapCurve curve, double targetLuminance = 203);
+
+		// 参考实现，输入输出都是 0..1 的非线性 RGB，LUT 由它生成
+		void MapPixel(const float in[3], float out[3]) const;
+
+		// RGBA16 UNORM，r 变化最快，然后是 g、b，和 Texture3D 的 x、y、z 对应
+		const std::vector<uint16_t>& GetLUT() const;
+
+		// src 是 RGB10A2（YUVConvert 的 RGBFormat::RGB10A2），dst 是 RGBA8，dst 可以和 src 是同一块内存
+		// 量化到 8 位时按 dither 抖动（见 GetDitherMatrix），和查表在同一遍里做，不多读写一遍内存
+		void Apply(const uint8_t* src, int srcPitch, int width, int height, uint8_t* dst, int dstPitch, DitherMode dither = DitherMode::None) const;
+
+		const HDRMetadata& GetMetadata() const;
+
+		ToneMapCurve GetCurve() const;
+	private:
+		HDRMetadata metadata;
+		ToneMapCurve curve;
+		double targetLuminance;
+		double sourcePQ;   // 源峰值的 PQ 值
+		double targetPQ;   // 目标峰值的 PQ 值，相对 sourcePQ
+		double hableWhite;
+		std::vector<uint16_t> lut;
+
+		// 10 位输入值在 LUT 里的下标和权重
+		int lutIndex[1024];
+		float lutWeight[1024];
+
+		// PQ 解码到显示亮度（nits），HLG 解码到场景线性（0..1）
+		double DecodeChannel(double e) const;
+
+		// 解码后剩下的部分：HLG 的 OOTF、色域转换、色调映射、编码
+		void MapDecoded(const double decoded[3], float out[3]) const;
+
+		double ToneMap(double luminance) const;
+	};
+}
@@ -0,0 +1,155 @@
+#include "WasapiAudioSink.h"
+
+namespace nv {
+	WasapiAudioSink::WasapiAudioSink()
+		: nChannels(0), nSamplesPerSec(0), bufferFrames(0), pwfx(nullptr), flags(0), bufferEvent(NULL)
+	{
+	}
+
+	WasapiAudioSink::~WasapiAudioSink() {
+		if (pAudioClient) {
+			pAudioClient->Stop();
+		}
+		CoTaskMemFree(pwfx);
+		if (bufferEvent) {
+			CloseHandle(bufferEvent);
+		}
+	}
+
+	int WasapiAudioSink::Open(int nChannels_, int nSamplesPerSec_, double bufferSeconds) {
+		constexpr auto REFTIMES_PER_SEC = 10000000;
+
+		nSamplesPerSec = nSamplesPerSec_;
+
+		HRESULT hr;
+
+		hr = pEnumerator.CoCreateInstance(__uuidof(MMDeviceEnumerator));
+		if (FAILED(hr)) return hr;
+
+		hr = pEnumerator->GetDefaultAudioEndpoint(
+			eRender, eConsole, &pDevice);
+		if (FAILED(hr)) return hr;
+
+		hr = pDevice->Activate(
+			__uuidof(IAudioClient), CLSCTX_ALL,
+			NULL, (void**)&pAudioClient);
+		if (FAILED(hr)) return hr;
+
+		CComPtr<IAudioSessionManager> pAudioSessionManager;
+		hr = pDevice->Activate(
+			__uuidof(IAudioSessionManager), CLSCTX_INPROC_SERVER,
+			NULL, (void**)&pAudioSessionManager
+		);
+
+		if (SUCCEEDED(hr)) {
+			pAudioSessionManager->GetSimpleAudioVolume(
+				&GUID_NULL,
+				0,
+				&pSimpleAudioVolume
+			);
+		}
+
+		// 缓冲区最小只能到设备周期
+		REFERENCE_TIME defaultPeriod = 0, minPeriod = 0;
+		pAudioClient->GetDevicePeriod(&defaultPeriod, &minPeriod);
+		REFERENCE_TIME bufferDuration = (REFERENCE_TIME)(bufferSeconds * REFTIMES_PER_SEC);
+		if (bufferDuration < defaultPeriod) {
+			bufferDuration = defaultPeriod;
+		}
+
+		hr = pAudioClient->GetMixFormat(&pwfx);
+		if (FAILED(hr)) return hr;
+
+		// 我们可以设置与音频设备不同的采样率
+		pwfx->nSamplesPerSec = nSamplesPerSec;
+		// 声道数总是用设备原生的，上下混音由 AudioPlayer 完成，不交给系统
+		nChannels = pwfx->nChannels;
+		pwfx->nAvgBytesPerSec = pwfx->nSamplesPerSec * pwfx->nBlockAlign;
+		// 必须使用这种格式
+		pwfx->wFormatTag = WAVE_FORMAT_EXTENSIBLE;
+
+		hr = pAudioClient->Initialize(
+			AUDCLNT_SHAREMODE_SHARED,
+			AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM | AUDCLNT_STREAMFLAGS_SRC_DEFAULT_QUALITY | AUDCLNT_STREAMFLAGS_EVENTCALLBACK, // 这里的flag代表系统需要重采样
+			bufferDuration,
+			0,
+			pwfx,
+			NULL);
+		if (FAILED(hr)) return hr;
+
+		bufferEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+		hr = pAudioClient->SetEventHandle(bufferEvent);
+		if (FAILED(hr)) return hr;
+
+		hr = pAudioClient->GetService(
+			__uuidof(IAudioRenderClient),
+			(void**)&pRenderClient);
+		if (FAILED(hr)) return hr;
+
+		return pAudioClient->GetBufferSize(&bufferFrames);
+	}
+
+	int WasapiAudioSink::Start() {
+		return pAudioClient->Start();
+	}
+
+	int WasapiAudioSink::Stop() {
+		return pAudioClient->Stop();
+	}
+
+	int WasapiAudioSink::Reset() {
+		return pAudioClient->Reset();
+	}
+
+	int WasapiAudioSink::GetChannels() {
+		return nChannels;
+	}
+
+	int WasapiAudioSink::GetSampleRate() {
+		return nSamplesPerSec;
+	}
+
+	uint64_t WasapiAudioSink::GetChannelLayout() {
+		if (pwfx && pwfx->wFormatTag == WAVE_FORMAT_EXTENSIBLE && pwfx->cbSize >= sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX)) {
+			return ((WAVEFORMATEXTENSIBLE*)pwfx)->dwChannelMask;
+		}
+		return 0;
+	}
+
+	uint32_t WasapiAudioSink::GetBufferFrames() {
+		return bufferFrames;
+	}
+
+	uint32_t WasapiAudioSink::GetPadding() {
+		UINT32 padding = 0;
+		pAudioClient->GetCurrentPadding(&padding);
+		return padding;
+	}
+
+	double WasapiAudioSink::GetStreamLatency() {
+		REFERENCE_TIME latency = 0;
+		pAudioClient->GetStreamLatency(&latency);
+		return latency / 10000000.0;
+	}
+
+	float* WasapiAudioSink::GetBuffer(uint32_t wantFrames) {
+		BYTE* buffer = nullptr;
+		pRenderClient->GetBuffer(wantFrames, &buffer);
+		return (float*)buffer;
+	}
+
+	int WasapiAudioSink::ReleaseBuffer(uint32_t writtenFrames) {
+		return pRenderClient->ReleaseBuffer(writtenFrames, flags);
+	}
+
+	int WasapiAudioSink::SetVolume(float v) {
+		if (!pSimpleAudioVolume) {
+			return E_POINTER;
+		}
+		return pSimpleAudioVolume->SetMasterVolume(v, NULL);
+	}
+
+	void WasapiAudioSink::WaitForBuffer(int timeoutMs) {
+		WaitForSingleObject(bufferEvent, timeoutMs);
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <Windows.h>
+#include <atlcomcli.h>
+#include <mmdeviceapi.h>
+#include <Audioclient.h>
+#include <audiopolicy.h>
+
+#include "AudioSink.h"
+
+namespace nv {
+	// 默认音频设备，共享模式
+	class WasapiAudioSink : public AudioSink {
+	public:
+		WasapiAudioSink();
+
+		~WasapiAudioSink();
+
+		int Open(int nChannels_, int nSamplesPerSec_, double bufferSeconds) override;
+
+		int Start() override;
+
+		int Stop() override;
+
+		int Reset() override;
+
+		int GetChannels() override;
+
+		int GetSampleRate() override;
+
+		uint64_t GetChannelLayout() override;
+
+		uint32_t GetBufferFrames() override;
+
+		uint32_t GetPadding() override;
+
+		double GetStreamLatency() override;
+
+		float* GetBuffer(uint32_t wantFrames) override;
+
+		int ReleaseBuffer(uint32_t writtenFrames) override;
+
+		int SetVolume(float v) override;
+
+		void WaitForBuffer(int timeoutMs) override;
+	private:
+		int nChannels;
+		int nSamplesPerSec;
+		UINT32 bufferFrames;
+
+		WAVEFORMATEX* pwfx;
+		CComPtr<IMMDeviceEnumerator> pEnumerator;
+		CComPtr<IMMDevice> pDevice;
+		CComPtr<IAudioClient> pAudioClient;
+		CComPtr<IAudioRenderClient> pRenderClient;
+		CComPtr<ISimpleAudioVolume> pSimpleAudioVolume;
+
+		DWORD flags = 0;
+
+		// 事件回调模式，设备每消耗完一个周期就触发一次
+		HANDLE bufferEvent;
+	};
+}
@@ -0,0 +1,96 @@
+#include "WavFileAudioSink.h"
+#include <stdint.h>
+
+namespace nv {
+	namespace {
+		void WriteU32(std::ofstream& file, uint32_t v) {
+			char b[4] = { (char)v, (char)(v >> 8), (char)(v >> 16), (char)(v >> 24) };
+			file.write(b, 4);
+		}
+
+		void WriteU16(std::ofstream& file, uint16_t v) {
+			char b[2] = { (char)v, (char)(v >> 8) };
+			file.write(b, 2);
+		}
+	}
+
+	WavFileAudioSink::WavFileAudioSink(const std::string& filePath_, bool realtime_)
+		: NullAudioSink(realtime_), filePath(filePath_), dataBytes(0)
+	{
+	}
+
+	WavFileAudioSink::~WavFileAudioSink() {
+		Close();
+	}
+
+	int WavFileAudioSink::Open(int nChannels_, int nSamplesPerSec_, double bufferSeconds) {
+		int ret = NullAudioSink::Open(nChannels_, nSamplesPerSec_, bufferSeconds);
+		if (ret < 0) {
+			return ret;
+		}
+
+		Close();
+		file.open(filePath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return -1;
+		}
+		dataBytes = 0;
+		WriteHeader();
+		return 0;
+	}
+
+	void WavFileAudioSink::Close() {
+		if (file.is_open()) {
+			// 回到开头，把长度写进去
+			file.seekp(0);
+			WriteHeader();
+			file.close();
+		}
+	}
+
+	// 非 PCM 格式的 fmt 块要带 cbSize，还要有记录帧数的 fact 块：RIFF 头 12 + fmt 26 + fact 12 + data 头 8
+	void WavFileAudioSink::WriteHeader() {
+		const uint16_t channels = (uint16_t)GetChannels();
+		const uint32_t sampleRate = (uint32_t)GetSampleRate();
+		const uint16_t blockAlign = channels * sizeof(float);
+		const uint32_t dataSize = dataBytes > UINT32_MAX - 50 ? (UINT32_MAX - 50) / blockAlign * blockAlign : (uint32_t)dataBytes;
+
+		file.write("RIFF", 4);
+		WriteU32(file, 50 + dataSize);
+		file.write("WAVE", 4);
+
+		file.write("fmt ", 4);
+		WriteU32(file, 18);
+		WriteU16(file, 3); // WAVE_FORMAT_IEEE_FLOAT
+		WriteU16(file, channels);
+		WriteU32(file, sampleRate);
+		WriteU32(file, sampleRate * blockAlign);
+		WriteU16(file, blockAlign);
+		WriteU16(file, 32);
+		WriteU16(file, 0); // cbSize
+
+		file.write("fact", 4);
+		WriteU32(file, 4);
+		WriteU32(file, dataSize / blockAlign);
+
+		file.write("data", 4);
+		WriteU32(file, dataSize);
+	}
+
+	void WavFileAudioSink::OnConsume(const float* data, uint32_t frames) {
+		if (!file.is_open()) {
+			return;
+		}
+
+		size_t sampleCount = (size_t)frames * GetChannels();
+		if (data == nullptr) {
+			if (silence.size() < sampleCount) {
+				silence.resize(sampleCount, 0);
+			}
+			data = silence.data();
+		}
+
+		file.write((const char*)data, sampleCount * sizeof(float));
+		dataBytes += sampleCount * sizeof(float);
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <fstream>
+#include <vector>
+
+#include "NullAudioSink.h"
+
+namespace nv {
+	// 把本来要播放的数据原样录进 32 位 float 的 WAV 文件，时钟行为和 NullAudioSink 完全一致
+	// 欠载时录进去的是静音，音量不影响录制的数据（和 WASAPI 的会话音量一样）
+	class WavFileAudioSink : public NullAudioSink {
+	public:
+		WavFileAudioSink(const std::string& filePath_, bool realtime_ = true);
+
+		~WavFileAudioSink();
+
+		int Open(int nChannels_, int nSamplesPerSec_, double bufferSeconds) override;
+
+		// 回填 WAV 头里的长度并关闭文件，析构时也会调用
+		void Close();
+
+	protected:
+		void OnConsume(const float* data, uint32_t frames) override;
+
+	private:
+		void WriteHeader();
+
+		std::string filePath;
+		std::ofstream file;
+		uint64_t dataBytes;
+		std::vector<float> silence;
+	};
+}
@@ -0,0 +1,220 @@
+#include "WaveformPyramid.h"
+#include "CpuFeatures.h"
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+
+namespace nv {
+	namespace {
+		constexpr char fileMagic[4] = { 'N', 'V', 'W', 'F' };
+		constexpr uint32_t fileVersion = 1;
+
+		int16_t Quantize(float v) {
+			return (int16_t)std::lround(std::clamp(v, -1.0f, 1.0f) * 32767);
+		}
+
+		float Dequantize(int16_t v) {
+			return v / 32767.0f;
+		}
+	}
+
+	void ReduceSamples(const float* data, size_t count, float& min, float& max, double& sumSquares) {
+		size_t i = 0;
+		float mn = min, mx = max;
+		double ss = 0;
+
+#if defined(NV_SIMD_X86)
+		if (count >= 8) {
+			__m128 vmin = _mm_set1_ps(mn), vmax = _mm_set1_ps(mx);
+			__m128 vss0 = _mm_setzero_ps(), vss1 = _mm_setzero_ps();
+			for (; i + 8 <= count; i += 8) {
+				__m128 a = _mm_loadu_ps(data + i);
+				__m128 b = _mm_loadu_ps(data + i + 4);
+				vmin = _mm_min_ps(vmin, _mm_min_ps(a, b));
+				vmax = _mm_max_ps(vmax, _mm_max_ps(a, b));
+				vss0 = _mm_add_ps(vss0, _mm_mul_ps(a, a));
+				vss1 = _mm_add_ps(vss1, _mm_mul_ps(b, b));
+			}
+			alignas(16) float t[4];
+			_mm_store_ps(t, vmin);
+			mn = std::min(std::min(t[0], t[1]), std::min(t[2], t[3]));
+			_mm_store_ps(t, vmax);
+			mx = std::max(std::max(t[0], t[1]), std::max(t[2], t[3]));
+			_mm_store_ps(t, _mm_add_ps(vss0, vss1));
+			ss = (double)t[0] + t[1] + t[2] + t[3];
+		}
+#elif defined(NV_SIMD_NEON)
+		if (count >= 8) {
+			float32x4_t vmin = vdupq_n_f32(mn), vmax = vdupq_n_f32(mx);
+			float32x4_t vss0 = vdupq_n_f32(0), vss1 = vdupq_n_f32(0);
+			for (; i + 8 <= count; i += 8) {
+				float32x4_t a = vld1q_f32(data + i);
+				float32x4_t b = vld1q_f32(data + i + 4);
+				vmin = vminq_f32(vmin, vminq_f32(a, b));
+				vmax = vmaxq_f32(vmax, vmaxq_f32(a, b));
+				vss0 = vmlaq_f32(vss0, a, a);
+				vss1 = vmlaq_f32(vss1, b, b);
+			}
+			float t[4];
+			vst1q_f32(t, vmin);
+			mn = std::min(std::min(t[0], t[1]), std::min(t[2], t[3]));
+			vst1q_f32(t, vmax);
+			mx = std::max(std::max(t[0], t[1]), std::max(t[2], t[3]));
+			vst1q_f32(t, vaddq_f32(vss0, vss1));
+			ss = (double)t[0] + t[1] + t[2] + t[3];
+		}
+#endif
+
+		for (; i < count; i++) {
+			float v = data[i];
+			mn = std::min(mn, v);
+			mx = std::max(mx, v);
+			ss += (double)v * v;
+		}
+
+		min = mn;
+		max = mx;
+		sumSquares += ss;
+	}
+
+	WaveformPyramid::WaveformPyramid()
+		: sampleRate(0)
+	{
+	}
+
+	void WaveformPyramid::Build(const std::vector<WaveformPeak>& base, int sampleRate_) {
+		sampleRate = sampleRate_;
+		levels.clear();
+		levels.emplace_back(base.size());
+		for (size_t i = 0; i < base.size(); i++) {
+			levels[0][i] = { Quantize(base[i].min), Quantize(base[i].max), Quantize(base[i].rms) };
+		}
+		BuildLevels();
+	}
+
+	void WaveformPyramid::BuildLevels() {
+		levels.resize(1);
+		while (levels.back().size() > 1) {
+			auto& lower = levels.back();
+			std::vector<Bin> upper((lower.size() + 1) / 2);
+			for (size_t i = 0; i < upper.size(); i++) {
+				const Bin& a = lower[i * 2];
+				const Bin& b = i * 2 + 1 < lower.size() ? lower[i * 2 + 1] : a;
+				float rms = std::sqrt((Dequantize(a.rms) * Dequantize(a.rms) + Dequantize(b.rms) * Dequantize(b.rms)) / 2);
+				upper[i] = { std::min(a.min, b.min), std::max(a.max, b.max), Quantize(rms) };
+			}
+			levels.push_back(std::move(upper));
+		}
+	}
+
+	bool WaveformPyramid::IsEmpty() const {
+		return levels.empty() || levels[0].empty();
+	}
+
+	int WaveformPyramid::GetSampleRate() const {
+		return sampleRate;
+	}
+
+	int WaveformPyramid::GetLevelCount() const {
+		return (int)levels.size();
+	}
+
+	double WaveformPyramid::GetDuration() const {
+		if (IsEmpty() || sampleRate <= 0) {
+			return 0;
+		}
+		return (double)levels[0].size() * baseBinFrames / sampleRate;
+	}
+
+	void WaveformPyramid::Query(double startSecond, double endSecond, int columns, WaveformPeak* out) const {
+		if (columns <= 0) {
+			return;
+		}
+		if (IsEmpty() || endSecond <= startSecond) {
+			std::fill(out, out + columns, WaveformPeak{ 0, 0, 0 });
+			return;
+		}
+
+		// 选一层，让每列大约对应 1~2 个 bin
+		double basePerColumn = (endSecond - startSecond) * sampleRate / baseBinFrames / columns;
+		int level = basePerColumn <= 1 ? 0 : (int)std::floor(std::log2(basePerColumn));
+		level = std::clamp(level, 0, (int)levels.size() - 1);
+		auto& bins = levels[level];
+		double binsPerSecond = (double)sampleRate / ((int64_t)baseBinFrames << level);
+		double columnSeconds = (endSecond - startSecond) / columns;
+
+		for (int c = 0; c < columns; c++) {
+			int64_t b0 = (int64_t)std::floor((startSecond + c * columnSeconds) * binsPerSecond);
+			int64_t b1 = (int64_t)std::floor((startSecond + (c + 1) * columnSeconds) * binsPerSecond);
+			b0 = std::max<int64_t>(b0, 0);
+			b1 = std::min<int64_t>(std::max(b1, b0 + 1), (int64_t)bins.size());
+
+			if (b0 >= b1) {
+				out[c] = { 0, 0, 0 };
+				continue;
+			}
+
+			int16_t mn = bins[b0].min, mx = bins[b0].max;
+			float ss = 0;
+			for (int64_t b = b0; b < b1; b++) {
+				mn = std::min(mn, bins[b].min);
+				mx = std::max(mx, bins[b].max);
+				float rms = Dequantize(bins[b].rms);
+				ss += rms * rms;
+			}
+			out[c] = { Dequantize(mn), Dequantize(mx), std::sqrt(ss / (b1 - b0)) };
+		}
+	}
+
+	bool WaveformPyramid::Save(const std::string& path) const {
+		if (IsEmpty()) {
+			return false;
+		}
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			return false;
+		}
+
+		int32_t header[] = { sampleRate, baseBinFrames };
+		uint64_t count = levels[0].size();
+		file.write(fileMagic, sizeof(fileMagic));
+		file.write((const char*)&fileVersion, sizeof(fileVersion));
+		file.write((const char*)header, sizeof(header));
+		file.write((const char*)&count, sizeof(count));
+		file.write((const char*)levels[0].data(), count * sizeof(Bin));
+		return (bool)file;
+	}
+
+	bool WaveformPyramid::Load(const std::string& path) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			return false;
+		}
+
+		char magic[4] = {};
+		uint32_t version = 0;
+		int32_t header[2] = {};
+		uint64_t count = 0;
+		file.read(magic, sizeof(magic));
+		file.read((char*)&version, sizeof(version));
+		file.read((char*)header, sizeof(header));
+		file.read((char*)&count, sizeof(count));
+		if (!file || !std::equal(magic, magic + 4, fileMagic) || version != fileVersion ||
+			header[0] <= 0 || header[1] != baseBinFrames || count == 0 || count > (1ull << 32)) {
+			return false;
+		}
+
+		std::vector<Bin> base(count);
+		file.read((char*)base.data(), count * sizeof(Bin));
+		if (!file) {
+			return false;
+		}
+
+		sampleRate = header[0];
+		levels.clear();
+		levels.push_back(std::move(base));
+		BuildLevels();
+		return true;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace nv {
+	struct WaveformPeak {
+		float min;
+		float max;
+		float rms;
+	};
+
+	// 一段交错 float 的最小值、最大值和平方和，所有声道放在一起算
+	// min/max 传入目前为止的值并被更新，平方和累加到 sumSquares 上
+	void ReduceSamples(const float* data, size_t count, float& min, float& max, double& sumSquares);
+
+	// 音频波形的多分辨率金字塔：第 0 层每 baseBinFrames 帧一个 bin，往上每层两两合并
+	// 每个 bin 存 min/max/rms，量化成 int16
+	class WaveformPyramid {
+	public:
+		static constexpr int baseBinFrames = 1024;
+
+		WaveformPyramid();
+
+		// 由第 0 层生成整个金字塔
+		void Build(const std::vector<WaveformPeak>& base, int sampleRate_);
+
+		bool IsEmpty() const;
+
+		int GetSampleRate() const;
+
+		int GetLevelCount() const;
+
+		// 波形覆盖的时长（秒）
+		double GetDuration() const;
+
+		// 把 [startSecond, endSecond) 平均分成 columns 列，每列的峰值写进 out
+		// 每列只合并所选层里的 1~3 个 bin，开销只和列数有关
+		void Query(double startSecond, double endSecond, int columns, WaveformPeak* out) const;
+
+		// 只存第 0 层，读的时候再生成上面各层
+		bool Save(const std::string& path) const;
+
+		bool Load(const std::string& path);
+
+	private:
+		struct Bin {
+			int16_t min;
+			int16_t max;
+			int16_t rms;
+		};
+
+		void BuildLevels();
+
+		int sampleRate;
+		std::vector<std::vector<Bin>> levels;
+	};
+}
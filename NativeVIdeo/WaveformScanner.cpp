@@ -0,0 +1,266 @@
+#include "WaveformScanner.h"
+#include "SampleConvert.h"
+#include "MediaCache.h"
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+namespace nv {
+	void WaveformScanner::Bins::Resize(size_t size) {
+		min.resize(size, 0);
+		max.resize(size, 0);
+		sumSquares.resize(size, 0);
+		count.resize(size, 0);
+	}
+
+	WaveformScanner::WaveformScanner(const std::string& filePath_)
+		: filePath(filePath_), streamIndex(-1), sampleRate(0), startSecond(0), totalFrames(-1),
+		isCancelled(false), isDone(false), decodedFrames(0), isCached(false), speed(0)
+	{
+		cachePath = GetMediaCachePath(filePath, "waveform", ".bin");
+		if (!cachePath.empty()) {
+			auto cached = std::make_shared<WaveformPyramid>();
+			if (cached->Load(cachePath)) {
+				pyramid = cached;
+				isCached = true;
+				isDone = true;
+				return;
+			}
+		}
+
+		scanThread = std::thread(&WaveformScanner::Run, this);
+	}
+
+	WaveformScanner::~WaveformScanner() {
+		isCancelled = true;
+		if (scanThread.joinable()) {
+			scanThread.join();
+		}
+	}
+
+	bool WaveformScanner::IsDone() {
+		return isDone;
+	}
+
+	std::shared_ptr<const WaveformPyramid> WaveformScanner::GetPyramid() {
+		return isDone ? pyramid : nullptr;
+	}
+
+	float WaveformScanner::GetProgress() {
+		if (isDone) {
+			return 1;
+		}
+		if (totalFrames <= 0) {
+			return 0;
+		}
+		return std::min((float)decodedFrames / totalFrames, 1.0f);
+	}
+
+	bool WaveformScanner::IsCached() {
+		return isCached;
+	}
+
+	double WaveformScanner::GetSpeed() {
+		return isDone ? speed : 0;
+	}
+
+	void WaveformScanner::Run() {
+		auto startTime = std::chrono::steady_clock::now();
+
+		std::vector<WaveformPeak> base;
+		int rate = 0;
+		if (Scan(base, rate) && !base.empty()) {
+			auto result = std::make_shared<WaveformPyramid>();
+			result->Build(base, rate);
+			if (!cachePath.empty()) {
+				result->Save(cachePath);
+			}
+			pyramid = result;
+
+			double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+			speed = elapsed > 0 ? result->GetDuration() / elapsed : 0;
+		}
+		isDone = true;
+	}
+
+	bool WaveformScanner::Scan(std::vector<WaveformPeak>& base, int& rate) {
+		// 先打开一次拿到流的信息
+		AVFormatContext* fmtCtx = nullptr;
+		if (avformat_open_input(&fmtCtx, filePath.c_str(), NULL, NULL) < 0) {
+			return false;
+		}
+		if (avformat_find_stream_info(fmtCtx, NULL) < 0) {
+			avformat_close_input(&fmtCtx);
+			return false;
+		}
+		streamIndex = av_find_best_stream(fmtCtx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+		if (streamIndex >= 0) {
+			sampleRate = fmtCtx->streams[streamIndex]->codecpar->sample_rate;
+			startSecond = fmtCtx->start_time == AV_NOPTS_VALUE ? 0 : (double)fmtCtx->start_time / AV_TIME_BASE;
+			if (fmtCtx->duration != AV_NOPTS_VALUE && fmtCtx->duration > 0 && sampleRate > 0) {
+				totalFrames = (int64_t)std::ceil((double)fmtCtx->duration / AV_TIME_BASE * sampleRate);
+			}
+		}
+		avformat_close_input(&fmtCtx);
+		if (streamIndex < 0 || sampleRate <= 0) {
+			return false;
+		}
+
+		Bins bins;
+		if (totalFrames > 0) {
+			// 每段的边界对齐到 bin，这样各个线程写的 bin 不会重叠
+			constexpr int64_t minSegmentFrames = 60 * 48000;
+			int workers = std::clamp((int)std::thread::hardware_concurrency() / 2, 1, maxWorkers);
+			workers = (int)std::clamp<int64_t>(totalFrames / minSegmentFrames, 1, workers);
+
+			int64_t totalBins = (totalFrames + WaveformPyramid::baseBinFrames - 1) / WaveformPyramid::baseBinFrames;
+			// 时长可能估得偏短，多留一点
+			bins.Resize((size_t)(totalBins + totalBins / 100 + 64));
+
+			int64_t binsPerWorker = (totalBins + workers - 1) / workers;
+			std::vector<std::thread> threads;
+			for (int i = 0; i < workers; i++) {
+				int64_t beginFrame = i * binsPerWorker * WaveformPyramid::baseBinFrames;
+				// 最后一段一直解到文件结尾
+				int64_t endFrame = i == workers - 1 ? -1 : (i + 1) * binsPerWorker * WaveformPyramid::baseBinFrames;
+				threads.emplace_back(&WaveformScanner::ScanSegment, this, beginFrame, endFrame, std::ref(bins), false);
+			}
+			for (auto& t : threads) {
+				t.join();
+			}
+		}
+		else {
+			ScanSegment(0, -1, bins, true);
+		}
+
+		if (isCancelled) {
+			return false;
+		}
+
+		// 去掉末尾没有数据的 bin
+		size_t used = bins.count.size();
+		while (used > 0 && bins.count[used - 1] == 0) {
+			used--;
+		}
+
+		base.resize(used);
+		for (size_t i = 0; i < used; i++) {
+			if (bins.count[i] == 0) {
+				base[i] = { 0, 0, 0 };
+			}
+			else {
+				base[i] = { bins.min[i], bins.max[i], (float)std::sqrt(bins.sumSquares[i] / bins.count[i]) };
+			}
+		}
+		rate = sampleRate;
+		return true;
+	}
+
+	void WaveformScanner::ScanSegment(int64_t beginFrame, int64_t endFrame, Bins& bins, bool canGrow) {
+		AVFormatContext* fmtCtx = nullptr;
+		if (avformat_open_input(&fmtCtx, filePath.c_str(), NULL, NULL) < 0) {
+			return;
+		}
+		std::shared_ptr<AVFormatContext*> fmtGuard(&fmtCtx, [](AVFormatContext** p) { avformat_close_input(p); });
+		if (avformat_find_stream_info(fmtCtx, NULL) < 0 || streamIndex >= (int)fmtCtx->nb_streams) {
+			return;
+		}
+
+		for (unsigned i = 0; i < fmtCtx->nb_streams; i++) {
+			fmtCtx->streams[i]->discard = (int)i == streamIndex ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+		}
+
+		auto stream = fmtCtx->streams[streamIndex];
+		const AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
+		if (!codec) {
+			return;
+		}
+		AVCodecContext* codecCtx = avcodec_alloc_context3(codec);
+		std::shared_ptr<AVCodecContext*> codecGuard(&codecCtx, [](AVCodecContext** p) { avcodec_free_context(p); });
+		avcodec_parameters_to_context(codecCtx, stream->codecpar);
+		codecCtx->thread_count = 1;
+		if (avcodec_open2(codecCtx, codec, NULL) < 0) {
+			return;
+		}
+
+		double timeBase = (double)stream->time_base.num / stream->time_base.den;
+		if (beginFrame > 0) {
+			// 往前多 seek 一点，保证这一段的开头有数据
+			double second = std::max((double)beginFrame / sampleRate - 0.5, 0.0) + startSecond;
+			av_seek_frame(fmtCtx, streamIndex, (int64_t)(second / timeBase), AVSEEK_FLAG_BACKWARD);
+		}
+
+		AVPacket* packet = av_packet_alloc();
+		AVFrame* frame = av_frame_alloc();
+		std::vector<float> samples;
+		int64_t position = -1;
+		bool isFinished = false;
+
+		auto receiveFrames = [&]() {
+			while (!isFinished && avcodec_receive_frame(codecCtx, frame) == 0) {
+				auto convert = GetSampleConverter((AVSampleFormat)frame->format);
+				int channels = frame->channels;
+				int frames = frame->nb_samples;
+				if (convert && channels > 0 && frames > 0) {
+					int64_t first = position;
+					if (frame->best_effort_timestamp != AV_NOPTS_VALUE) {
+						first = std::llround((frame->best_effort_timestamp * timeBase - startSecond) * sampleRate);
+					}
+					first = std::max<int64_t>(first, 0);
+					position = first + frames;
+
+					if (endFrame >= 0 && first >= endFrame) {
+						isFinished = true;
+					}
+					else if (position > beginFrame) {
+						samples.resize((size_t)frames * channels);
+						convert(frame->extended_data, samples.data(), frames, channels);
+
+						// 只处理落在这一段里的样本，按 bin 切开
+						int64_t from = std::max(first, beginFrame);
+						int64_t to = endFrame >= 0 ? std::min(position, endFrame) : position;
+						while (from < to) {
+							size_t bin = (size_t)(from / WaveformPyramid::baseBinFrames);
+							int64_t binEnd = std::min(to, (int64_t)(bin + 1) * WaveformPyramid::baseBinFrames);
+							if (bin >= bins.count.size()) {
+								if (!canGrow) {
+									break;
+								}
+								bins.Resize(std::max(bin + 1, bins.count.size() * 2));
+							}
+
+							float mn = bins.count[bin] ? bins.min[bin] : INFINITY;
+							float mx = bins.count[bin] ? bins.max[bin] : -INFINITY;
+							ReduceSamples(&samples[(size_t)(from - first) * channels], (size_t)(binEnd - from) * channels, mn, mx, bins.sumSquares[bin]);
+							bins.min[bin] = mn;
+							bins.max[bin] = mx;
+							bins.count[bin] += (uint32_t)((binEnd - from) * channels);
+							from = binEnd;
+						}
+						decodedFrames += to - std::max(first, beginFrame);
+					}
+				}
+				av_frame_unref(frame);
+			}
+		};
+
+		while (!isCancelled && !isFinished && av_read_frame(fmtCtx, packet) == 0) {
+			if (packet->stream_index == streamIndex && avcodec_send_packet(codecCtx, packet) == 0) {
+				receiveFrames();
+			}
+			av_packet_unref(packet);
+		}
+		if (!isCancelled && !isFinished) {
+			avcodec_send_packet(codecCtx, NULL);
+			receiveFrames();
+		}
+
+		av_frame_free(&frame);
+		av_packet_free(&packet);
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
+
+#include "WaveformPyramid.h"
+
+namespace nv {
+	// 在后台解码整条音轨生成波形金字塔，结果按文件缓存
+	// 文件时长已知时把音轨切成几段，每段一个线程、一个单独的 demuxer 并行解码
+	class WaveformScanner {
+	public:
+		// filePath_ 是 UTF-8 路径
+		WaveformScanner(const std::string& filePath_);
+
+		// 没建完时会取消并等待后台线程退出
+		~WaveformScanner();
+
+		bool IsDone();
+
+		// 建好之前返回 nullptr
+		std::shared_ptr<const WaveformPyramid> GetPyramid();
+
+		// 0 ~ 1
+		float GetProgress();
+
+		bool IsCached();
+
+		// 建金字塔的速度，实时的多少倍，读缓存时为 0
+		double GetSpeed();
+
+		// 最多用几个线程解码
+		static constexpr int maxWorkers = 4;
+
+	private:
+		struct Bins {
+			std::vector<float> min;
+			std::vector<float> max;
+			std::vector<double> sumSquares;
+			std::vector<uint32_t> count;
+
+			void Resize(size_t size);
+		};
+
+		void Run();
+
+		bool Scan(std::vector<WaveformPeak>& base, int& sampleRate);
+
+		// 解码 [beginFrame, endFrame) 这一段，结果放进 bins 里对应的位置，endFrame < 0 表示到文件结尾
+		void ScanSegment(int64_t beginFrame, int64_t endFrame, Bins& bins, bool canGrow);
+
+		std::string filePath;
+		std::string cachePath;
+
+		int streamIndex;
+		int sampleRate;
+		double startSecond;
+		int64_t totalFrames; // 未知时为 -1
+
+		std::shared_ptr<const WaveformPyramid> pyramid;
+
+		std::thread scanThread;
+		std::atomic<bool> isCancelled;
+		std::atomic<bool> isDone;
+		std::atomic<int64_t> decodedFrames;
+		bool isCached;
+		double speed;
+	};
+}
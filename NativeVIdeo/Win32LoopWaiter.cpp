@@ -0,0 +1,66 @@
+#include "Win32LoopWaiter.h"
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+namespace nv {
+	Win32LoopWaiter::Win32LoopWaiter() {
+		timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	}
+
+	Win32LoopWaiter::~Win32LoopWaiter() {
+		if (timer) {
+			CloseHandle(timer);
+		}
+	}
+
+	void Win32LoopWaiter::AddEvent(HANDLE event) {
+		events.push_back(event);
+	}
+
+	void Win32LoopWaiter::RemoveEvent(HANDLE event) {
+		events.erase(std::remove(events.begin(), events.end(), event), events.end());
+	}
+
+	double Win32LoopWaiter::Now() {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	bool Win32LoopWaiter::Wait(double timeoutSeconds) {
+		auto handles = events;
+		DWORD timeoutMs = INFINITE;
+		bool isTimerSet = false;
+		if (timeoutSeconds == 0) {
+			timeoutMs = 0;
+		}
+		else if (timeoutSeconds > 0) {
+			LARGE_INTEGER dueTime;
+			dueTime.QuadPart = -(LONGLONG)(timeoutSeconds * 1e7); // 负数为相对时间，100ns
+			if (timer && SetWaitableTimer(timer, &dueTime, 0, NULL, NULL, FALSE)) {
+				handles.push_back(timer);
+				isTimerSet = true;
+			}
+			else {
+				timeoutMs = (DWORD)ceil(timeoutSeconds * 1000);
+			}
+		}
+
+		// MWMO_INPUTAVAILABLE：队列里已经有但还没取走的消息也算，不会漏掉
+		DWORD ret = MsgWaitForMultipleObjectsEx((DWORD)handles.size(), handles.data(), timeoutMs, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+		if (isTimerSet) {
+			CancelWaitableTimer(timer);
+		}
+
+		if (ret == WAIT_TIMEOUT) {
+			return false;
+		}
+		if (isTimerSet && ret == WAIT_OBJECT_0 + handles.size() - 1) {
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <Windows.h>
+#include <vector>
+
+#include "LoopScheduler.h"
+
+namespace nv {
+	// 用 MsgWaitForMultipleObjectsEx 同时等窗口消息和内核事件
+	// 超时用高精度的可等待计时器，不受 15.6ms 的系统计时器粒度影响，系统不支持时退回毫秒超时
+	class Win32LoopWaiter : public LoopWaiter {
+	public:
+		Win32LoopWaiter();
+
+		~Win32LoopWaiter();
+
+		Win32LoopWaiter(const Win32LoopWaiter&) = delete;
+		Win32LoopWaiter& operator=(const Win32LoopWaiter&) = delete;
+
+		// 一起等待的事件，由调用者负责关闭
+		void AddEvent(HANDLE event);
+
+		void RemoveEvent(HANDLE event);
+
+		double Now() override;
+
+		bool Wait(double timeoutSeconds) override;
+	private:
+		std::vector<HANDLE> events;
+		HANDLE timer;
+	};
+}
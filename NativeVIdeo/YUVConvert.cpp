@@ -0,0 +1,670 @@
+#include "YUVConvert.h"
+#include "CpuFeatures.h"
+#include "PixelFormat.h"
+#include <cmath>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <tuple>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+// 所有实现都走同一套整数运算：色度先纵向、再横向按 3:1 混合成 16 倍的样本值，再乘定点系数右移截断，
+// 每一步都是精确的整数运算，所以标量和 SIMD 的结果逐位相同
+namespace nv {
+	namespace {
+		// CPU 最多按 10 位计算，16 倍的色度样本才放得进 int16。更多位的格式在读样本时右移掉多出来的低位
+		constexpr int maxBitDepth = 10;
+
+		// 样本类型、色度的排列、横向和纵向是否缩小一半，样本右移几位得到参与计算的值（P010 为 6，yuv420p12 为 2）
+		template <typename T, bool isSemiPlanar_, bool isSubsampledX_, bool isSubsampledY_, int sampleShift_>
+		struct Fmt {
+			typedef T Type;
+			static constexpr bool isSemiPlanar = isSemiPlanar_;
+			static constexpr bool isSubsampledX = isSubsampledX_;
+			static constexpr bool isSubsampledY = isSubsampledY_;
+			static constexpr int sampleShift = sampleShift_;
+		};
+
+		// 一行的转换从 x = 0 开始，返回做到了哪里，剩下的交给标量实现
+		// cu/cv 是这一行用到的 4 倍色度，左右都有复制边缘的样本，cu[-1] 和 cu[chromaWidth] 可以读
+		typedef int (*RowFunc)(const uint8_t* srcY, const int16_t* cu, const int16_t* cv, uint8_t* dst, int width, const YUVCoeffs& k);
+
+		int RowNone(const uint8_t*, const int16_t*, const int16_t*, uint8_t*, int, const YUVCoeffs&) {
+			return 0;
+		}
+
+		// 横向上采样：偶数位置 3c[k] + c[k-1]，奇数位置 3c[k] + c[k+1]
+		template <class F>
+		int ChromaAt(const int16_t* c, int x) {
+			if constexpr (F::isSubsampledX) {
+				int k = x >> 1;
+				return 3 * c[k] + c[(x & 1) ? k + 1 : k - 1];
+			}
+			else {
+				return c[x] * 4;
+			}
+		}
+
+		int ShiftClamp(int acc, const YUVCoeffs& k) {
+			return std::clamp(acc >> k.shift, 0, k.maxValue);
+		}
+
+		template <class F, bool isRGB10>
+		void ConvertRowScalar(const uint8_t* srcY, const int16_t* cu, const int16_t* cv, uint8_t* dst, int x, int width, const YUVCoeffs& k) {
+			auto in = (const typename F::Type*)srcY;
+			for (; x < width; x++) {
+				int y = (in[x] >> F::sampleShift) * k.y;
+				int u = ChromaAt<F>(cu, x);
+				int v = ChromaAt<F>(cv, x);
+
+				int r = ShiftClamp(y + k.rv * v + k.r, k);
+				int g = ShiftClamp(y + k.gu * u + k.gv * v + k.g, k);
+				int b = ShiftClamp(y + k.bu * u + k.b, k);
+
+				if constexpr (isRGB10) {
+					((uint32_t*)dst)[x] = (uint32_t)r | ((uint32_t)g << 10) | ((uint32_t)b << 20) | (3u << 30);
+				}
+				else {
+					dst[x * 4 + 0] = (uint8_t)r;
+					dst[x * 4 + 1] = (uint8_t)g;
+					dst[x * 4 + 2] = (uint8_t)b;
+					dst[x * 4 + 3] = 255;
+				}
+			}
+		}
+
+		// 纵向：相邻两行色度按 3:1 混合，step 是同一分量相邻样本的间隔（交错的 UV 为 2）
+		template <class F>
+		void BlendChromaRows(const typename F::Type* nearRow, const typename F::Type* farRow, int count, int step, int16_t* out) {
+			for (int i = 0; i < count; i++) {
+				out[i] = (int16_t)(3 * (nearRow[i * step] >> F::sampleShift) + (farRow[i * step] >> F::sampleShift));
+			}
+		}
+
+		template <class F, bool isRGB10, RowFunc row>
+		void ConvertFrame(const uint8_t* const* data, const int* linesize, int width, int height, uint8_t* dst, int dstPitch, const YUVCoeffs& k) {
+			typedef typename F::Type T;
+			int chromaWidth = F::isSubsampledX ? (width + 1) / 2 : width;
+			int chromaHeight = F::isSubsampledY ? (height + 1) / 2 : height;
+
+			// 左边一个、右边 16 个复制边缘的样本，SIMD 一次多读一些也不会越界
+			constexpr int padding = 16;
+			std::vector<int16_t> bufferU(chromaWidth + 1 + padding);
+			std::vector<int16_t> bufferV(chromaWidth + 1 + padding);
+			int16_t* cu = bufferU.data() + 1;
+			int16_t* cv = bufferV.data() + 1;
+
+			for (int y = 0; y < height; y++) {
+				// 和横向一样，偶数行取上一行、奇数行取下一行做 3:1 混合
+				int nearRow = y, farRow = y;
+				if constexpr (F::isSubsampledY) {
+					nearRow = y >> 1;
+					farRow = std::clamp((y & 1) ? nearRow + 1 : nearRow - 1, 0, chromaHeight - 1);
+				}
+
+				if constexpr (F::isSemiPlanar) {
+					auto nearUV = (const T*)(data[1] + (size_t)nearRow * linesize[1]);
+					auto farUV = (const T*)(data[1] + (size_t)farRow * linesize[1]);
+					BlendChromaRows<F>(nearUV, farUV, chromaWidth, 2, cu);
+					BlendChromaRows<F>(nearUV + 1, farUV + 1, chromaWidth, 2, cv);
+				}
+				else {
+					BlendChromaRows<F>((const T*)(data[1] + (size_t)nearRow * linesize[1]), (const T*)(data[1] + (size_t)farRow * linesize[1]), chromaWidth, 1, cu);
+					BlendChromaRows<F>((const T*)(data[2] + (size_t)nearRow * linesize[2]), (const T*)(data[2] + (size_t)farRow * linesize[2]), chromaWidth, 1, cv);
+				}
+
+				cu[-1] = cu[0];
+				cv[-1] = cv[0];
+				std::fill(cu + chromaWidth, cu + chromaWidth + padding, cu[chromaWidth - 1]);
+				std::fill(cv + chromaWidth, cv + chromaWidth + padding, cv[chromaWidth - 1]);
+
+				const uint8_t* srcY = data[0] + (size_t)y * linesize[0];
+				uint8_t* out = dst + (size_t)y * dstPitch;
+				int x = row(srcY, cu, cv, out, width, k);
+				ConvertRowScalar<F, isRGB10>(srcY, cu, cv, out, x, width, k);
+			}
+		}
+
+		// madd 用的系数对，低 16 位对应 unpack 的第一个参数
+		int32_t CoeffPair(int16_t a, int16_t b) {
+			return (int32_t)((uint32_t)(uint16_t)a | ((uint32_t)(uint16_t)b << 16));
+		}
+
+#if defined(NV_SIMD_X86)
+		struct CoeffsSSE {
+			__m128i yv_r; // R = y * Y + rv * V
+			__m128i yu_b; // B = y * Y + bu * U
+			__m128i uv_g; // G = gu * U + gv * V + y * Y
+			__m128i y0;
+			__m128i r, g, b;
+			__m128i shift;
+			__m128i maxValue;
+		};
+
+		NV_TARGET_SSE41 inline CoeffsSSE MakeCoeffsSSE(const YUVCoeffs& k) {
+			CoeffsSSE c;
+			c.yv_r = _mm_set1_epi32(CoeffPair(k.y, k.rv));
+			c.yu_b = _mm_set1_epi32(CoeffPair(k.y, k.bu));
+			c.uv_g = _mm_set1_epi32(CoeffPair(k.gu, k.gv));
+			c.y0 = _mm_set1_epi32(CoeffPair(k.y, 0));
+			c.r = _mm_set1_epi32(k.r);
+			c.g = _mm_set1_epi32(k.g);
+			c.b = _mm_set1_epi32(k.b);
+			c.shift = _mm_cvtsi32_si128(k.shift);
+			c.maxValue = _mm_set1_epi16((int16_t)k.maxValue);
+			return c;
+		}
+
+		NV_TARGET_SSE41 inline __m128i ShiftClampSSE41(__m128i lo, __m128i hi, const CoeffsSSE& c) {
+			__m128i v = _mm_packs_epi32(_mm_sra_epi32(lo, c.shift), _mm_sra_epi32(hi, c.shift));
+			return _mm_min_epi16(_mm_max_epi16(v, _mm_setzero_si128()), c.maxValue);
+		}
+
+		// 8 个像素
+		NV_TARGET_SSE41 inline void YUVToRGBSSE41(__m128i y, __m128i u, __m128i v, const CoeffsSSE& c, __m128i& r, __m128i& g, __m128i& b) {
+			__m128i yvLo = _mm_unpacklo_epi16(y, v), yvHi = _mm_unpackhi_epi16(y, v);
+			__m128i yuLo = _mm_unpacklo_epi16(y, u), yuHi = _mm_unpackhi_epi16(y, u);
+			__m128i uvLo = _mm_unpacklo_epi16(u, v), uvHi = _mm_unpackhi_epi16(u, v);
+
+			r = ShiftClampSSE41(_mm_add_epi32(_mm_madd_epi16(yvLo, c.yv_r), c.r), _mm_add_epi32(_mm_madd_epi16(yvHi, c.yv_r), c.r), c);
+			b = ShiftClampSSE41(_mm_add_epi32(_mm_madd_epi16(yuLo, c.yu_b), c.b), _mm_add_epi32(_mm_madd_epi16(yuHi, c.yu_b), c.b), c);
+			__m128i gLo = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(uvLo, c.uv_g), _mm_madd_epi16(yvLo, c.y0)), c.g);
+			__m128i gHi = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(uvHi, c.uv_g), _mm_madd_epi16(yvHi, c.y0)), c.g);
+			g = ShiftClampSSE41(gLo, gHi, c);
+		}
+
+		template <class F>
+		NV_TARGET_SSE41 inline __m128i LoadYSSE41(const uint8_t* srcY, int x) {
+			if constexpr (sizeof(typename F::Type) == 1) {
+				return _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(srcY + x)));
+			}
+			else {
+				return _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(srcY + x * 2)), F::sampleShift);
+			}
+		}
+
+		// 8 个色度样本横向上采样成 16 个
+		NV_TARGET_SSE41 inline void UpsampleSSE41(const int16_t* c, __m128i& lo, __m128i& hi) {
+			__m128i a = _mm_loadu_si128((const __m128i*)c);
+			__m128i prev = _mm_loadu_si128((const __m128i*)(c - 1));
+			__m128i next = _mm_loadu_si128((const __m128i*)(c + 1));
+			__m128i a3 = _mm_add_epi16(a, _mm_add_epi16(a, a));
+			__m128i even = _mm_add_epi16(a3, prev);
+			__m128i odd = _mm_add_epi16(a3, next);
+			lo = _mm_unpacklo_epi16(even, odd);
+			hi = _mm_unpackhi_epi16(even, odd);
+		}
+
+		template <bool isRGB10>
+		NV_TARGET_SSE41 inline void StoreSSE41(uint8_t* dst, __m128i r, __m128i g, __m128i b) {
+			if constexpr (isRGB10) {
+				__m128i zero = _mm_setzero_si128();
+				__m128i alpha = _mm_set1_epi32((int32_t)(3u << 30));
+				__m128i lo = _mm_or_si128(_mm_or_si128(_mm_cvtepu16_epi32(r), _mm_slli_epi32(_mm_cvtepu16_epi32(g), 10)), _mm_or_si128(_mm_slli_epi32(_mm_cvtepu16_epi32(b), 20), alpha));
+				__m128i hi = _mm_or_si128(_mm_or_si128(_mm_unpackhi_epi16(r, zero), _mm_slli_epi32(_mm_unpackhi_epi16(g, zero), 10)), _mm_or_si128(_mm_slli_epi32(_mm_unpackhi_epi16(b, zero), 20), alpha));
+				_mm_storeu_si128((__m128i*)dst, lo);
+				_mm_storeu_si128((__m128i*)(dst + 16), hi);
+			}
+			else {
+				__m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+				__m128i ba = _mm_or_si128(b, _mm_set1_epi16((int16_t)0xFF00));
+				_mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi16(rg, ba));
+				_mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(rg, ba));
+			}
+		}
+
+		template <class F, bool isRGB10>
+		NV_TARGET_SSE41 int ConvertRowSSE41(const uint8_t* srcY, const int16_t* cu, const int16_t* cv, uint8_t* dst, int width, const YUVCoeffs& k) {
+			CoeffsSSE c = MakeCoeffsSSE(k);
+			__m128i r, g, b;
+			int x = 0;
+			if constexpr (F::isSubsampledX) {
+				for (; x + 16 <= width; x += 16) {
+					__m128i u0, u1, v0, v1;
+					UpsampleSSE41(cu + x / 2, u0, u1);
+					UpsampleSSE41(cv + x / 2, v0, v1);
+					YUVToRGBSSE41(LoadYSSE41<F>(srcY, x), u0, v0, c, r, g, b);
+					StoreSSE41<isRGB10>(dst + x * 4, r, g, b);
+					YUVToRGBSSE41(LoadYSSE41<F>(srcY, x + 8), u1, v1, c, r, g, b);
+					StoreSSE41<isRGB10>(dst + (x + 8) * 4, r, g, b);
+				}
+			}
+			else {
+				for (; x + 8 <= width; x += 8) {
+					__m128i u = _mm_slli_epi16(_mm_loadu_si128((const __m128i*)(cu + x)), 2);
+					__m128i v = _mm_slli_epi16(_mm_loadu_si128((const __m128i*)(cv + x)), 2);
+					YUVToRGBSSE41(LoadYSSE41<F>(srcY, x), u, v, c, r, g, b);
+					StoreSSE41<isRGB10>(dst + x * 4, r, g, b);
+				}
+			}
+			return x;
+		}
+
+		struct CoeffsAVX2 {
+			__m256i yv_r;
+			__m256i yu_b;
+			__m256i uv_g;
+			__m256i y0;
+			__m256i r, g, b;
+			__m128i shift;
+			__m256i maxValue;
+		};
+
+		NV_TARGET_AVX2 inline CoeffsAVX2 MakeCoeffsAVX2(const YUVCoeffs& k) {
+			CoeffsAVX2 c;
+			c.yv_r = _mm256_set1_epi32(CoeffPair(k.y, k.rv));
+			c.yu_b = _mm256_set1_epi32(CoeffPair(k.y, k.bu));
+			c.uv_g = _mm256_set1_epi32(CoeffPair(k.gu, k.gv));
+			c.y0 = _mm256_set1_epi32(CoeffPair(k.y, 0));
+			c.r = _mm256_set1_epi32(k.r);
+			c.g = _mm256_set1_epi32(k.g);
+			c.b = _mm256_set1_epi32(k.b);
+			c.shift = _mm_cvtsi32_si128(k.shift);
+			c.maxValue = _mm256_set1_epi16((int16_t)k.maxValue);
+			return c;
+		}
+
+		NV_TARGET_AVX2 inline __m256i ShiftClampAVX2(__m256i lo, __m256i hi, const CoeffsAVX2& c) {
+			__m256i v = _mm256_packs_epi32(_mm256_sra_epi32(lo, c.shift), _mm256_sra_epi32(hi, c.shift));
+			return _mm256_min_epi16(_mm256_max_epi16(v, _mm256_setzero_si256()), c.maxValue);
+		}
+
+		// 16 个像素。unpack 和 pack 都只在 128 位内进行，两者抵消，像素顺序不变
+		NV_TARGET_AVX2 inline void YUVToRGBAVX2(__m256i y, __m256i u, __m256i v, const CoeffsAVX2& c, __m256i& r, __m256i& g, __m256i& b) {
+			__m256i yvLo = _mm256_unpacklo_epi16(y, v), yvHi = _mm256_unpackhi_epi16(y, v);
+			__m256i yuLo = _mm256_unpacklo_epi16(y, u), yuHi = _mm256_unpackhi_epi16(y, u);
+			__m256i uvLo = _mm256_unpacklo_epi16(u, v), uvHi = _mm256_unpackhi_epi16(u, v);
+
+			r = ShiftClampAVX2(_mm256_add_epi32(_mm256_madd_epi16(yvLo, c.yv_r), c.r), _mm256_add_epi32(_mm256_madd_epi16(yvHi, c.yv_r), c.r), c);
+			b = ShiftClampAVX2(_mm256_add_epi32(_mm256_madd_epi16(yuLo, c.yu_b), c.b), _mm256_add_epi32(_mm256_madd_epi16(yuHi, c.yu_b), c.b), c);
+			__m256i gLo = _mm256_add_epi32(_mm256_add_epi32(_mm256_madd_epi16(uvLo, c.uv_g), _mm256_madd_epi16(yvLo, c.y0)), c.g);
+			__m256i gHi = _mm256_add_epi32(_mm256_add_epi32(_mm256_madd_epi16(uvHi, c.uv_g), _mm256_madd_epi16(yvHi, c.y0)), c.g);
+			g = ShiftClampAVX2(gLo, gHi, c);
+		}
+
+		template <class F>
+		NV_TARGET_AVX2 inline __m256i LoadYAVX2(const uint8_t* srcY, int x) {
+			if constexpr (sizeof(typename F::Type) == 1) {
+				return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(srcY + x)));
+			}
+			else {
+				return _mm256_srli_epi16(_mm256_loadu_si256((const __m256i*)(srcY + x * 2)), F::sampleShift);
+			}
+		}
+
+		// 16 个色度样本横向上采样成 32 个
+		NV_TARGET_AVX2 inline void UpsampleAVX2(const int16_t* c, __m256i& lo, __m256i& hi) {
+			__m256i a = _mm256_loadu_si256((const __m256i*)c);
+			__m256i prev = _mm256_loadu_si256((const __m256i*)(c - 1));
+			__m256i next = _mm256_loadu_si256((const __m256i*)(c + 1));
+			__m256i a3 = _mm256_add_epi16(a, _mm256_add_epi16(a, a));
+			__m256i even = _mm256_add_epi16(a3, prev);
+			__m256i odd = _mm256_add_epi16(a3, next);
+			__m256i l = _mm256_unpacklo_epi16(even, odd);
+			__m256i h = _mm256_unpackhi_epi16(even, odd);
+			lo = _mm256_permute2x128_si256(l, h, 0x20);
+			hi = _mm256_permute2x128_si256(l, h, 0x31);
+		}
+
+		template <bool isRGB10>
+		NV_TARGET_AVX2 inline void StoreAVX2(uint8_t* dst, __m256i r, __m256i g, __m256i b) {
+			if constexpr (isRGB10) {
+				__m256i alpha = _mm256_set1_epi32((int32_t)(3u << 30));
+				__m256i r0 = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(r)), r1 = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(r, 1));
+				__m256i g0 = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(g)), g1 = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(g, 1));
+				__m256i b0 = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(b)), b1 = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(b, 1));
+				__m256i lo = _mm256_or_si256(_mm256_or_si256(r0, _mm256_slli_epi32(g0, 10)), _mm256_or_si256(_mm256_slli_epi32(b0, 20), alpha));
+				__m256i hi = _mm256_or_si256(_mm256_or_si256(r1, _mm256_slli_epi32(g1, 10)), _mm256_or_si256(_mm256_slli_epi32(b1, 20), alpha));
+				_mm256_storeu_si256((__m256i*)dst, lo);
+				_mm256_storeu_si256((__m256i*)(dst + 32), hi);
+			}
+			else {
+				__m256i rg = _mm256_or_si256(r, _mm256_slli_epi16(g, 8));
+				__m256i ba = _mm256_or_si256(b, _mm256_set1_epi16((int16_t)0xFF00));
+				__m256i p0 = _mm256_unpacklo_epi16(rg, ba);
+				__m256i p1 = _mm256_unpackhi_epi16(rg, ba);
+				_mm256_storeu_si256((__m256i*)dst, _mm256_permute2x128_si256(p0, p1, 0x20));
+				_mm256_storeu_si256((__m256i*)(dst + 32), _mm256_permute2x128_si256(p0, p1, 0x31));
+			}
+		}
+
+		template <class F, bool isRGB10>
+		NV_TARGET_AVX2 int ConvertRowAVX2(const uint8_t* srcY, const int16_t* cu, const int16_t* cv, uint8_t* dst, int width, const YUVCoeffs& k) {
+			CoeffsAVX2 c = MakeCoeffsAVX2(k);
+			__m256i r, g, b;
+			int x = 0;
+			if constexpr (F::isSubsampledX) {
+				for (; x + 32 <= width; x += 32) {
+					__m256i u0, u1, v0, v1;
+					UpsampleAVX2(cu + x / 2, u0, u1);
+					UpsampleAVX2(cv + x / 2, v0, v1);
+					YUVToRGBAVX2(LoadYAVX2<F>(srcY, x), u0, v0, c, r, g, b);
+					StoreAVX2<isRGB10>(dst + x * 4, r, g, b);
+					YUVToRGBAVX2(LoadYAVX2<F>(srcY, x + 16), u1, v1, c, r, g, b);
+					StoreAVX2<isRGB10>(dst + (x + 16) * 4, r, g, b);
+				}
+			}
+			else {
+				for (; x + 16 <= width; x += 16) {
+					__m256i u = _mm256_slli_epi16(_mm256_loadu_si256((const __m256i*)(cu + x)), 2);
+					__m256i v = _mm256_slli_epi16(_mm256_loadu_si256((const __m256i*)(cv + x)), 2);
+					YUVToRGBAVX2(LoadYAVX2<F>(srcY, x), u, v, c, r, g, b);
+					StoreAVX2<isRGB10>(dst + x * 4, r, g, b);
+				}
+			}
+			return x;
+		}
+#elif defined(NV_SIMD_NEON)
+		inline int16x8_t ShiftClampNEON(int32x4_t lo, int32x4_t hi, const YUVCoeffs& k) {
+			int32x4_t shift = vdupq_n_s32(-k.shift);
+			int16x8_t v = vcombine_s16(vqmovn_s32(vshlq_s32(lo, shift)), vqmovn_s32(vshlq_s32(hi, shift)));
+			return vminq_s16(vmaxq_s16(v, vdupq_n_s16(0)), vdupq_n_s16((int16_t)k.maxValue));
+		}
+
+		// 8 个像素
+		inline void YUVToRGBNEON(int16x8_t y, int16x8_t u, int16x8_t v, const YUVCoeffs& k, int16x8_t& r, int16x8_t& g, int16x8_t& b) {
+			int16x4_t yLo = vget_low_s16(y), yHi = vget_high_s16(y);
+			int16x4_t uLo = vget_low_s16(u), uHi = vget_high_s16(u);
+			int16x4_t vLo = vget_low_s16(v), vHi = vget_high_s16(v);
+			int32x4_t yTermLo = vmull_n_s16(yLo, k.y), yTermHi = vmull_n_s16(yHi, k.y);
+
+			r = ShiftClampNEON(vmlal_n_s16(vaddq_s32(yTermLo, vdupq_n_s32(k.r)), vLo, k.rv), vmlal_n_s16(vaddq_s32(yTermHi, vdupq_n_s32(k.r)), vHi, k.rv), k);
+			b = ShiftClampNEON(vmlal_n_s16(vaddq_s32(yTermLo, vdupq_n_s32(k.b)), uLo, k.bu), vmlal_n_s16(vaddq_s32(yTermHi, vdupq_n_s32(k.b)), uHi, k.bu), k);
+			int32x4_t gLo = vmlal_n_s16(vmlal_n_s16(vaddq_s32(yTermLo, vdupq_n_s32(k.g)), uLo, k.gu), vLo, k.gv);
+			int32x4_t gHi = vmlal_n_s16(vmlal_n_s16(vaddq_s32(yTermHi, vdupq_n_s32(k.g)), uHi, k.gu), vHi, k.gv);
+			g = ShiftClampNEON(gLo, gHi, k);
+		}
+
+		template <class F>
+		inline int16x8_t LoadYNEON(const uint8_t* srcY, int x) {
+			if constexpr (sizeof(typename F::Type) == 1) {
+				return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(srcY + x)));
+			}
+			else {
+				uint16x8_t v = vld1q_u16((const uint16_t*)srcY + x);
+				return vreinterpretq_s16_u16(vshlq_u16(v, vdupq_n_s16(-F::sampleShift)));
+			}
+		}
+
+		// 8 个色度样本横向上采样成 16 个
+		inline int16x8x2_t UpsampleNEON(const int16_t* c) {
+			int16x8_t a3 = vmulq_n_s16(vld1q_s16(c), 3);
+			return vzipq_s16(vaddq_s16(a3, vld1q_s16(c - 1)), vaddq_s16(a3, vld1q_s16(c + 1)));
+		}
+
+		template <bool isRGB10>
+		inline void StoreNEON(uint8_t* dst, int16x8_t r, int16x8_t g, int16x8_t b) {
+			if constexpr (isRGB10) {
+				uint16x8_t ur = vreinterpretq_u16_s16(r), ug = vreinterpretq_u16_s16(g), ub = vreinterpretq_u16_s16(b);
+				uint32x4_t alpha = vdupq_n_u32(3u << 30);
+				uint32x4_t lo = vorrq_u32(vorrq_u32(vmovl_u16(vget_low_u16(ur)), vshlq_n_u32(vmovl_u16(vget_low_u16(ug)), 10)), vorrq_u32(vshlq_n_u32(vmovl_u16(vget_low_u16(ub)), 20), alpha));
+				uint32x4_t hi = vorrq_u32(vorrq_u32(vmovl_u16(vget_high_u16(ur)), vshlq_n_u32(vmovl_u16(vget_high_u16(ug)), 10)), vorrq_u32(vshlq_n_u32(vmovl_u16(vget_high_u16(ub)), 20), alpha));
+				vst1q_u32((uint32_t*)dst, lo);
+				vst1q_u32((uint32_t*)dst + 4, hi);
+			}
+			else {
+				uint8x8x4_t rgba = { { vqmovun_s16(r), vqmovun_s16(g), vqmovun_s16(b), vdup_n_u8(255) } };
+				vst4_u8(dst, rgba);
+			}
+		}
+
+		template <class F, bool isRGB10>
+		int ConvertRowNEON(const uint8_t* srcY, const int16_t* cu, const int16_t* cv, uint8_t* dst, int width, const YUVCoeffs& k) {
+			int16x8_t r, g, b;
+			int x = 0;
+			if constexpr (F::isSubsampledX) {
+				for (; x + 16 <= width; x += 16) {
+					int16x8x2_t u = UpsampleNEON(cu + x / 2);
+					int16x8x2_t v = UpsampleNEON(cv + x / 2);
+					YUVToRGBNEON(LoadYNEON<F>(srcY, x), u.val[0], v.val[0], k, r, g, b);
+					StoreNEON<isRGB10>(dst + x * 4, r, g, b);
+					YUVToRGBNEON(LoadYNEON<F>(srcY, x + 8), u.val[1], v.val[1], k, r, g, b);
+					StoreNEON<isRGB10>(dst + (x + 8) * 4, r, g, b);
+				}
+			}
+			else {
+				for (; x + 8 <= width; x += 8) {
+					int16x8_t u = vshlq_n_s16(vld1q_s16(cu + x), 2);
+					int16x8_t v = vshlq_n_s16(vld1q_s16(cv + x), 2);
+					YUVToRGBNEON(LoadYNEON<F>(srcY, x), u, v, k, r, g, b);
+					StoreNEON<isRGB10>(dst + x * 4, r, g, b);
+				}
+			}
+			return x;
+		}
+#endif
+
+		template <class F, bool isRGB10>
+		YUVConvertFunc SelectRef() {
+			return ConvertFrame<F, isRGB10, RowNone>;
+		}
+
+		// 参考实现、当前 CPU 不用 AVX2 时最快的、用 AVX2 的，cpu::DisableAVX2 在后两个之间切换
+		enum class KernelLevel {
+			Ref,
+			SIMD,
+			AVX2,
+		};
+
+		// AVX2 的内核只有在 cpu::HasAVX2() 时才会被取用
+		template <class F, bool isRGB10>
+		YUVConvertFunc SelectFast(KernelLevel level) {
+#if defined(NV_SIMD_X86)
+			if (level == KernelLevel::AVX2) {
+				return ConvertFrame<F, isRGB10, ConvertRowAVX2<F, isRGB10>>;
+			}
+			if (cpu::HasSSE41()) {
+				return ConvertFrame<F, isRGB10, ConvertRowSSE41<F, isRGB10>>;
+			}
+#elif defined(NV_SIMD_NEON)
+			return ConvertFrame<F, isRGB10, ConvertRowNEON<F, isRGB10>>;
+#endif
+			return SelectRef<F, isRGB10>();
+		}
+
+		template <class F>
+		YUVConvertFunc Select(RGBFormat dstFormat, KernelLevel level) {
+			if (dstFormat == RGBFormat::RGB10A2) {
+				return level == KernelLevel::Ref ? SelectRef<F, true>() : SelectFast<F, true>(level);
+			}
+			return level == KernelLevel::Ref ? SelectRef<F, false>() : SelectFast<F, false>(level);
+		}
+
+		template <typename T, bool isSemiPlanar, int sampleShift>
+		YUVConvertFunc SelectSubsampling(const PixelFormatDesc& desc, RGBFormat dstFormat, KernelLevel level) {
+			if (desc.chromaShiftX == 1 && desc.chromaShiftY == 1) {
+				return Select<Fmt<T, isSemiPlanar, true, true, sampleShift>>(dstFormat, level);
+			}
+			if (desc.chromaShiftX == 1 && desc.chromaShiftY == 0) {
+				return Select<Fmt<T, isSemiPlanar, true, false, sampleShift>>(dstFormat, level);
+			}
+			if (desc.chromaShiftX == 0 && desc.chromaShiftY == 0) {
+				return Select<Fmt<T, isSemiPlanar, false, false, sampleShift>>(dstFormat, level);
+			}
+			return nullptr;
+		}
+
+		// 4:2:0、4:2:2、4:4:4 的平面和半平面 YUV。半平面的 U 要在 V 前面（NV21 这类不支持）
+		YUVConvertFunc SelectYUV(const PixelFormatDesc& desc, RGBFormat dstFormat, KernelLevel level) {
+			auto& c = desc.components;
+			bool isSemiPlanar = desc.planeCount == 2 && c[0].plane == 0 && c[1].plane == 1 && c[1].channel == 0 && c[2].plane == 1;
+			bool isPlanar = desc.planeCount == 3 && c[0].plane == 0 && c[1].plane == 1 && c[2].plane == 2;
+			if ((!isSemiPlanar && !isPlanar) || desc.planes[0].channels != 1) {
+				return nullptr;
+			}
+
+			if (desc.planes[0].bytesPerChannel == 1) {
+				return isSemiPlanar ? SelectSubsampling<uint8_t, true, 0>(desc, dstFormat, level) : SelectSubsampling<uint8_t, false, 0>(desc, dstFormat, level);
+			}
+
+			// 16 位容器的半平面格式（P010、P012、P016）有效位都在高位，右移 6 位正好剩 10 位
+			int shift = desc.sampleShift + std::max(desc.bitDepth - maxBitDepth, 0);
+			if (isSemiPlanar) {
+				return shift == 6 ? SelectSubsampling<uint16_t, true, 6>(desc, dstFormat, level) : nullptr;
+			}
+
+			switch (shift) {
+			case 0:
+				return SelectSubsampling<uint16_t, false, 0>(desc, dstFormat, level);
+			case 2:
+				return SelectSubsampling<uint16_t, false, 2>(desc, dstFormat, level);
+			case 4:
+				return SelectSubsampling<uint16_t, false, 4>(desc, dstFormat, level);
+			case 6:
+				return SelectSubsampling<uint16_t, false, 6>(desc, dstFormat, level);
+			}
+			return nullptr;
+		}
+
+		// 打包 RGB 只重排通道，不用系数。r、g、b 是各分量在 4 个字节里的位置
+		template <int r, int g, int b, bool isRGB10>
+		void ConvertPackedRGB(const uint8_t* const* data, const int* linesize, int width, int height, uint8_t* dst, int dstPitch, const YUVCoeffs&) {
+			for (int y = 0; y < height; y++) {
+				const uint8_t* in = data[0] + (size_t)y * linesize[0];
+				uint8_t* out = dst + (size_t)y * dstPitch;
+				for (int x = 0; x < width; x++, in += 4) {
+					if constexpr (isRGB10) {
+						// 8 位扩展到 10 位，0 和 255 分别对应 0 和 1023
+						auto expand = [](uint32_t v) { return (v << 2) | (v >> 6); };
+						((uint32_t*)out)[x] = expand(in[r]) | (expand(in[g]) << 10) | (expand(in[b]) << 20) | (3u << 30);
+					}
+					else {
+						out[x * 4 + 0] = in[r];
+						out[x * 4 + 1] = in[g];
+						out[x * 4 + 2] = in[b];
+						out[x * 4 + 3] = 255;
+					}
+				}
+			}
+		}
+
+		template <bool isRGB10>
+		YUVConvertFunc SelectPackedRGB(const PixelFormatDesc& desc) {
+			static const std::map<std::tuple<int, int, int>, YUVConvertFunc> channelOrderMap = {
+				{ { 0, 1, 2 }, ConvertPackedRGB<0, 1, 2, isRGB10> }, // RGBA、RGB0
+				{ { 2, 1, 0 }, ConvertPackedRGB<2, 1, 0, isRGB10> }, // BGRA、BGR0
+				{ { 1, 2, 3 }, ConvertPackedRGB<1, 2, 3, isRGB10> }, // ARGB、0RGB
+				{ { 3, 2, 1 }, ConvertPackedRGB<3, 2, 1, isRGB10> }, // ABGR、0BGR
+			};
+
+			auto& c = desc.components;
+			if (desc.planeCount != 1 || desc.planes[0].channels != 4 || desc.planes[0].bytesPerChannel != 1) {
+				return nullptr;
+			}
+			auto it = channelOrderMap.find({ c[0].channel, c[1].channel, c[2].channel });
+			return it == channelOrderMap.end() ? nullptr : it->second;
+		}
+
+		YUVConvertFunc SelectFormat(const PixelFormatDesc& desc, RGBFormat dstFormat, KernelLevel level) {
+			if (desc.isRGB) {
+				return dstFormat == RGBFormat::RGB10A2 ? SelectPackedRGB<true>(desc) : SelectPackedRGB<false>(desc);
+			}
+			return SelectYUV(desc, dstFormat, level);
+		}
+
+		typedef std::map<std::pair<AVPixelFormat, RGBFormat>, YUVConvertFunc> ConverterTable;
+
+		// libavutil 认识的格式里，平面布局有对应实现的都登记进来
+		ConverterTable BuildTable(KernelLevel level) {
+			ConverterTable table;
+			for (auto pixDesc = av_pix_fmt_desc_next(nullptr); pixDesc; pixDesc = av_pix_fmt_desc_next(pixDesc)) {
+				PixelFormatDesc desc;
+				if (!GetPixelFormatDesc(av_pix_fmt_desc_get_id(pixDesc), desc)) {
+					continue;
+				}
+
+				for (auto dstFormat : { RGBFormat::RGBA8, RGBFormat::RGB10A2 }) {
+					auto func = SelectFormat(desc, dstFormat, level);
+					if (func) {
+						table[{ desc.format, dstFormat }] = func;
+					}
+				}
+			}
+			return table;
+		}
+
+		YUVConvertFunc Find(const ConverterTable& table, AVPixelFormat format, RGBFormat dstFormat) {
+			auto it = table.find({ format, dstFormat });
+			return it == table.end() ? nullptr : it->second;
+		}
+	}
+
+	int GetYUVBitDepth(AVPixelFormat format) {
+		PixelFormatDesc desc;
+		if (!GetYUVConverterRef(format, RGBFormat::RGBA8) || !GetPixelFormatDesc(format, desc)) {
+			return 0;
+		}
+		return std::min(desc.bitDepth, maxBitDepth);
+	}
+
+	bool GetYUVCoeffs(AVPixelFormat format, RGBFormat dstFormat, const YUVMatrix& matrix, YUVCoeffs& coeffs) {
+		int bitDepth = GetYUVBitDepth(format);
+		if (bitDepth == 0) {
+			return false;
+		}
+
+		// 和 matrix 的约定一致：超过 8 位的样本按放在 16 位高位后的值来算
+		int maxValue = dstFormat == RGBFormat::RGB10A2 ? 1023 : 255;
+		double scale = (bitDepth > 8 ? (1 << (16 - bitDepth)) / 65535.0 : 1.0 / 255) * maxValue;
+
+		// 每个样本值对输出的贡献，色度是 16 倍的样本值
+		auto& m = matrix.matrix;
+		double y = m[0][0] * scale;
+		double rv = m[2][0] * scale / 16;
+		double gu = m[1][1] * scale / 16;
+		double gv = m[2][1] * scale / 16;
+		double bu = m[1][2] * scale / 16;
+		double offset[3];
+		for (int c = 0; c < 3; c++) {
+			offset[c] = -((double)m[0][c] * matrix.offset[0] + (double)m[1][c] * matrix.offset[1] + (double)m[2][c] * matrix.offset[2]) * maxValue;
+		}
+
+		// 在系数不超出 int16 的前提下尽量多留小数位
+		double largest = std::max({ std::abs(y), std::abs(rv), std::abs(gu), std::abs(gv), std::abs(bu) });
+		int shift = 0;
+		while (shift < 16 && std::lround(largest * (1 << (shift + 1))) <= 32767) {
+			shift++;
+		}
+
+		double one = 1 << shift;
+		int32_t rounding = 1 << (shift - 1);
+		coeffs.y = (int16_t)std::lround(y * one);
+		coeffs.rv = (int16_t)std::lround(rv * one);
+		coeffs.gu = (int16_t)std::lround(gu * one);
+		coeffs.gv = (int16_t)std::lround(gv * one);
+		coeffs.bu = (int16_t)std::lround(bu * one);
+		coeffs.r = (int32_t)std::lround(offset[0] * one) + rounding;
+		coeffs.g = (int32_t)std::lround(offset[1] * one) + rounding;
+		coeffs.b = (int32_t)std::lround(offset[2] * one) + rounding;
+		coeffs.shift = shift;
+		coeffs.maxValue = maxValue;
+		return true;
+	}
+
+	YUVConvertFunc GetYUVConverter(AVPixelFormat format, RGBFormat dstFormat) {
+		// 两张表都在第一次调用时建好，之后按 cpu::HasAVX2() 选，cpu::DisableAVX2 马上生效
+		static const ConverterTable tables[] = { BuildTable(KernelLevel::SIMD), BuildTable(KernelLevel::AVX2) };
+		return Find(tables[cpu::HasAVX2() ? 1 : 0], format, dstFormat);
+	}
+
+	YUVConvertFunc GetYUVConverterRef(AVPixelFormat format, RGBFormat dstFormat) {
+		static const auto table = BuildTable(KernelLevel::Ref);
+		return Find(table, format, dstFormat);
+	}
+
+	const char* GetYUVConverterName() {
+#if defined(NV_SIMD_X86)
+		if (cpu::HasAVX2()) {
+			return "avx2";
+		}
+		return cpu::HasSSE41() ? "sse4.1" : "scalar";
+#elif defined(NV_SIMD_NEON)
+		return "neon";
+#else
+		return "scalar";
+#endif
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+#include "ColorSpace.h"
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+
+namespace nv {
+	enum class RGBFormat {
+		RGBA8,   // DXGI_FORMAT_R8G8B8A8_UNORM
+		RGB10A2, // DXGI_FORMAT_R10G10B10A2_UNORM，R 在低位
+	};
+
+	// 定点系数：c = clamp((y * Y + u * U + v * V + offset) >> shift, 0, maxValue)
+	// Y 是样本值，U/V 是上采样后 16 倍的色度样本值，偏移和舍入都已经算进 offset
+	struct YUVCoeffs {
+		int16_t y;
+		int16_t rv;
+		int16_t gu;
+		int16_t gv;
+		int16_t bu;
+		int32_t r;
+		int32_t g;
+		int32_t b;
+		int shift;
+		int maxValue;
+	};
+
+	// CPU 计算用的位深（8 到 10，超过 10 位的格式只用高 10 位），不支持的格式返回 0
+	int GetYUVBitDepth(AVPixelFormat format);
+
+	// 把 matrix（GPU 常量缓冲用的同一份）按源格式的位深和目标格式换算成定点系数，同一个流只需要算一次
+	// matrix 要按 GetYUVBitDepth(format) 的位深生成，超过 8 位时 sampleShift 为 16 - 位深。不支持的格式返回 false
+	// 打包 RGB 直接重排通道，不用系数
+	bool GetYUVCoeffs(AVPixelFormat format, RGBFormat dstFormat, const YUVMatrix& matrix, YUVCoeffs& coeffs);
+
+	// 把 width x height 的一帧 YUV 转成 RGB，data/linesize 对应 AVFrame
+	// 缩小了一半的方向上色度按和亮度中心对齐的双线性（3:1 权重）上采样，和着色器对色度平面的采样一致
+	typedef void (*YUVConvertFunc)(const uint8_t* const* data, const int* linesize, int width, int height, uint8_t* dst, int dstPitch, const YUVCoeffs& coeffs);
+
+	// 按当前 CPU 选出的最快实现。支持的格式按 GetPixelFormatDesc 的平面布局选：
+	// 4:2:0、4:2:2、4:4:4 的平面 YUV（8 到 16 位）、NV12 这类半平面 YUV（包括 P010、P016）、每像素 4 字节的打包 RGB
+	// 其他格式返回 nullptr
+	YUVConvertFunc GetYUVConverter(AVPixelFormat format, RGBFormat dstFormat);
+
+	// 标量参考实现，SIMD 版本的结果必须和它逐位相同
+	YUVConvertFunc GetYUVConverterRef(AVPixelFormat format, RGBFormat dstFormat);
+
+	// 当前选用的实现名字，例如 "avx2"
+	const char* GetYUVConverterName();
+}
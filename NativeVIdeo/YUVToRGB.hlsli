@@ -0,0 +1,39 @@
+// YUVToRGB.hlsli
+// Filled by the CPU from the frame's colorspace, range and pixel format (nv::GetYUVMatrix, nv::PixelFormatDesc)
+cbuffer ColorConstants : register(b0)
+{
+    float4 yuvToRgb[3];    // rows of the matrix, w unused
+    float4 yuvOffset;      // black level and chroma centre, w unused
+    float4 planeSelect[9]; // [component * 3 + plane], one-hot mask picking the component's channel
+    float4 texScale;       // xy: size, zw: offset of the shown part of the texture. Decoder surfaces are padded and auto crop cuts the black bars
+};
+
+// Up to three planes: Y/UV for NV12 and P010, Y/U/V for planar formats, one RGBA plane for packed RGB.
+// t2 is taken by the tone map LUT
+Texture2D<float4> plane0 : register(t0);
+Texture2D<float4> plane1 : register(t1);
+Texture2D<float4> plane2 : register(t3);
+
+float3 SampleYUV(SamplerState splr, float2 tc)
+{
+    tc = tc * texScale.xy + texScale.zw;
+    float4 p0 = plane0.Sample(splr, tc);
+    float4 p1 = plane1.Sample(splr, tc);
+    float4 p2 = plane2.Sample(splr, tc);
+
+    float3 yuv;
+    [unroll]
+    for (int c = 0; c < 3; c++)
+    {
+        yuv[c] = dot(p0, planeSelect[c * 3]) + dot(p1, planeSelect[c * 3 + 1]) + dot(p2, planeSelect[c * 3 + 2]);
+    }
+    return yuv;
+}
+
+float3 ConvertYUVtoRGB(float3 yuv)
+{
+    yuv -= yuvOffset.xyz;
+    float3 rgb = yuv.x * yuvToRgb[0].xyz + yuv.y * yuvToRgb[1].xyz + yuv.z * yuvToRgb[2].xyz;
+
+    return saturate(rgb);
+}
@@ -7,6 +7,8 @@
 #include <map>
 #include <memory>
 #include <regex>
+#include <algorithm>
+#include <array>
 
 #include <Windows.h>
 #include <windowsx.h>
@@ -17,7 +19,7 @@
 #pragma comment(lib, "d3d9.lib")
 #include <d3d11.h>
 #pragma comment(lib, "d3d11.lib")
-#include <dxgi1_4.h>
+#include <dxgi1_6.h>
 
 #include <d2d1.h>
 #pragma comment(lib, "d2d1.lib")
@@ -35,6 +37,7 @@ extern "C" {
 #pragma comment(lib, "avformat.lib")
 
 #include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
 #include <libavutil/hwcontext_d3d11va.h>
 #pragma comment(lib, "avutil.lib")
 
@@ -50,8 +53,36 @@ extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg
 #include "VertexShader.h"
 #include "PixelShader.h"
 #include "PixelShader_Subtitle.h"
+#include "PixelShader_ToneMap.h"
+#include "PixelShader_ScaleH.h"
+#include "PixelShader_ScaleV.h"
 
 #include "AudioPlayer.h"
+#include "WasapiAudioSink.h"
+#include "NullAudioSink.h"
+#include "WavFileAudioSink.h"
+#include "LoudnessScanner.h"
+#include "AudioScrubCache.h"
+#include "WaveformScanner.h"
+#include "SoftwareRenderer.h"
+#include "YUVConvert.h"
+#include "ColorSpace.h"
+#include "PixelFormat.h"
+#include "ToneMapping.h"
+#include "Scaler.h"
+#include "Dither.h"
+#include "FrameQueue.h"
+#include "D3D11RenderDevice.h"
+#include "RenderStateCache.h"
+#include "D3D11GpuTimer.h"
+#include "Win32LoopWaiter.h"
+#include "PresentClock.h"
+#include "DxgiPresentTarget.h"
+#include "FrameCapture.h"
+#include "D3D11FrameCapture.h"
+#include "CropDetector.h"
+#include "D3D11LumaReadback.h"
+#include "DuplicateFrameDetector.h"
 #include "CustomTextRenderer.h"
 
 using Microsoft::WRL::ComPtr;
@@ -82,6 +113,12 @@ struct MediaFrame {
 	double pts; // second
 };
 
+// 视频解码最多比呈现提前几帧
+constexpr int videoQueueSize = 4;
+
+// 鼠标停下多久之后隐藏控件
+constexpr auto hideMouseDelay = 1s;
+
 string w2s(const wstring& wstr) {
 	int len = WideCharToMultiByte(CP_ACP, 0, wstr.c_str(), wstr.size(), NULL, 0, NULL, NULL);
 	string str(len, '\0');
@@ -119,7 +156,7 @@ std::wstring AskVideoFilePath() {
 	CoCreateInstance(CLSID_FileOpenDialog, NULL, CLSCTX_ALL,
 		IID_IFileOpenDialog, reinterpret_cast<void**>(fileDialog.GetAddressOf()));
 
-	fileDialog->SetTitle(L"ѡƵļ");
+	fileDialog->SetTitle(L"选择视频文件");
 
 	COMDLG_FILTERSPEC rgSpec[] =
 	{
@@ -144,7 +181,7 @@ std::wstring AskVideoFilePath() {
 
 struct Subtitle {
 	std::wstring text;
-	double timeleft; // ʣʱ
+	double timeleft; // 剩余时间
 };
 
 struct DecoderParam
@@ -160,8 +197,21 @@ struct DecoderParam
 	int subtitleStreamIndex;
 	std::map<int, AVCodecContext*> codecMap;
 	shared_ptr<nv::AudioPlayer> audioPlayer;
+	shared_ptr<nv::LoudnessScanner> loudnessScanner;
+	bool normalizeLoudness;
+	shared_ptr<nv::AudioScrubCache> scrubCache;
+	bool isScrubbing; // 正在拖动进度条
+	bool wasScrubbing;
+	double lastGrainSecond;
+	vector<float> grainBuffer;
+	shared_ptr<nv::WaveformScanner> waveformScanner;
+	float waveformZoom; // 进度条的缩放倍数，1 为整个文件
+	float waveformViewStart;
+	vector<nv::WaveformPeak> waveformColumns;
 
 	double subtitleTimeBase;
+	double audioTimeBase;
+	double startSecond; // 文件第一个时间戳，音频时钟从这里算起
 	float durationSecond;
 	float currentSecond;
 	bool isJumpProgress;
@@ -171,27 +221,102 @@ struct DecoderParam
 
 };
 
+// 主循环每秒醒来多少次、进程占用多少 CPU（100% 为一个核）
+struct LoopStats {
+	int wakeups;
+	steady_clock::time_point windowStart;
+	uint64_t windowCpuTime; // 100ns
+	double wakeupsPerSecond;
+	double cpuPercent;
+
+	// 屏幕刷新了多少次按经过的时间和刷新率算，其中多少次真的合成并 Present 了
+	double displayFreq;
+	int composites;
+	double compositePercent;
+};
+
+// 每一层自上次合成以来有没有变化，都没变时不重画也不 Present，屏幕上留着上一次合成的画面
+struct Damage {
+	bool video;
+	bool subtitle;
+	bool ui;
+};
+
+// 一帧各平面的着色器资源，依次绑定到 t0、t1、t3（t2 是色调映射的 LUT）
+typedef std::array<ComPtr<ID3D11ShaderResourceView>, nv::PixelFormatDesc::maxPlanes> PlaneViews;
+
 struct ScenceParam {
 	ComPtr<ID3D11Buffer> pVertexBuffer;
 	ComPtr<ID3D11Buffer> pIndexBuffer;
 	ComPtr<ID3D11Buffer> pConstantBuffer;
 	ComPtr<ID3D11Buffer> pConstantBufferSub;
+	ComPtr<ID3D11Buffer> pColorConstantBuffer; // YUV 转 RGB 矩阵，帧的色彩属性变了才更新
+	nv::ColorDescription colorDesc;
 	ComPtr<ID3D11InputLayout> pInputLayout;
 	ComPtr<ID3D11VertexShader> pVertexShader;
 
+	// 解码器纹理不能直接采样时拷到 texture，软件解码的帧按平面上传到 planeTextures，格式或大小变了才重建
 	ComPtr<ID3D11Texture2D> texture;
+	ComPtr<ID3D11Texture2D> planeTextures[nv::PixelFormatDesc::maxPlanes];
+	PlaneViews textureViews;
+	PlaneViews planeTextureViews;
 	ComPtr<ID3D11Texture2D> subTexture;
 
-	ComPtr<ID3D11ShaderResourceView> srvY;
-	ComPtr<ID3D11ShaderResourceView> srvUV;
+	// 当前帧的平面布局和各平面的着色器资源，frameSource 是帧怎么到 GPU 的，显示用
+	nv::PixelFormatDesc pixelFormat;
+	PlaneViews planeViews;
+	const char* frameSource;
 	ComPtr<ID3D11ShaderResourceView> subSrv;
 
+	// 解码好的帧排在这里，当前帧就是正在显示的帧
+	// 换上来的帧和上一帧差不多时不标脏，不转换、不上传也不合成。只看系统内存里的帧，硬件解码的帧照常换
+	shared_ptr<nv::FrameQueue> frameQueue;
+	bool isFrameDirty;
+	nv::DuplicateFrameDetector duplicateDetector;
+
+	// 直接采样解码器纹理数组的某一层，不再拷贝到 texture。每层的着色器资源建一次，纹理数组换了就清掉
+	ID3D11Texture2D* sliceTexture;
+	map<int, PlaneViews> sliceViews;
+
 	ComPtr<ID3D11SamplerState> pSampler;
 	ComPtr<ID3D11PixelShader> pPixelShader;
 	ComPtr<ID3D11PixelShader> pPixelShader_Subtitle;
 
+	// PQ/HLG 的帧换用 pPixelShader_ToneMap，查 3D LUT 转成 SDR
+	ComPtr<ID3D11PixelShader> pPixelShader_ToneMap;
+	ComPtr<ID3D11SamplerState> pLutSampler;
+	ComPtr<ID3D11Texture3D> lutTexture;
+	ComPtr<ID3D11ShaderResourceView> lutSrv;
+	nv::ToneMapCurve toneMapCurve;
+	nv::HDRMetadata hdrMetadata;
+	shared_ptr<nv::ToneMapper> toneMapper; // SDR 的帧为 nullptr
+
 	ComPtr<ID3D11BlendState> blendState;
 
+	// 不是双线性时视频分两遍缩放：先按原大小转成 RGB 画到 scaleSource，横向缩放到 scaleTemp（视图宽、视频高），
+	// 再纵向缩放到后台缓冲。权重表按视频和视图大小缓存，前两遍只在视频或大小变了时重做
+	nv::ScaleFilter scaleFilter;
+	nv::ScaleWeightCache scaleWeights;
+	shared_ptr<const nv::ScaleWeights> columnWeights;
+	shared_ptr<const nv::ScaleWeights> rowWeights;
+	ComPtr<ID3D11ShaderResourceView> columnWeightSrv;
+	ComPtr<ID3D11ShaderResourceView> rowWeightSrv;
+	ComPtr<ID3D11Texture2D> scaleSource;
+	ComPtr<ID3D11ShaderResourceView> scaleSourceSrv;
+	ComPtr<ID3D11Texture2D> scaleTemp;
+	ComPtr<ID3D11ShaderResourceView> scaleTempSrv;
+	bool isScaleValid;
+	ComPtr<ID3D11PixelShader> pPixelShader_ScaleH;
+	ComPtr<ID3D11PixelShader> pPixelShader_ScaleV;
+	shared_ptr<nv::D3D11GpuTimer> scaleTimer; // 三遍加起来的 GPU 耗时
+
+	// 画到后台缓冲的最后一遍按显示器的位深抖动量化，常量缓冲绑在 b1，阈值表绑在 t4
+	// 中间的几遍不绑 b1，读到的是 0，不抖动
+	nv::DitherMode ditherMode;
+	int displayBitsPerColor;
+	ComPtr<ID3D11Buffer> ditherConstantBuffer;
+	ComPtr<ID3D11ShaderResourceView> ditherMatrixSrv;
+
 	const UINT16 indices[6]{ 0,1,2, 0,2,3 };
 
 	int viewWidth;
@@ -200,6 +325,14 @@ struct ScenceParam {
 	DXGI_MODE_DESC1 fullScreenModeDesc;
 
 	list<Subtitle> subtitles;
+	// 字幕层上画着的字幕，字幕纹理重建后 isSubtitleLayerValid 为 false
+	vector<wstring> subtitleLayerTexts;
+	bool isSubtitleLayerValid;
+
+	// 自上次合成以来哪些层变了，界面的变化靠比较 ImGui 绘制数据的哈希
+	Damage damage;
+	uint64_t uiHash;
+	bool isAlwaysComposite;
 
 	// D2D
 	ComPtr<ID2D1Factory> d2dfa;
@@ -207,6 +340,40 @@ struct ScenceParam {
 	ComPtr<IDWriteTextFormat> textFormat;
 	ComPtr<ID2D1RenderTarget> d2drt;
 	ComPtr<DWriteColorTextRenderer::CustomTextRenderer> textRenderer;
+
+	LoopStats loopStats;
+
+	// 绘制都经过 renderCache，只下发变了的状态。后台缓冲和它的大小记下来，每帧不用再问交换链
+	shared_ptr<nv::D3D11RenderDevice> renderDevice;
+	shared_ptr<nv::RenderStateCache> renderCache;
+	ComPtr<ID3D11Texture2D> backBuffer;
+	int backBufferWidth;
+	int backBufferHeight;
+
+	// 交换链最多排 maxFrameLatency 帧，合成之前等到能排了再选帧；presentClock 从帧统计测出选帧到显示的延迟
+	int maxFrameLatency;
+	shared_ptr<nv::DxgiPresentTarget> presentTarget;
+	shared_ptr<nv::PresentClock> presentClock;
+
+	// Ctrl+S 抓图：合成时在画界面之前抓下视频和字幕，存在视频旁边，文件名带播放位置
+	// GPU 画视频时 d3dCapture 和 frameCapture 是同一个，后台缓冲重建之后要告诉它
+	string capturePrefix;
+	bool isCaptureRequested;
+	shared_ptr<nv::FrameCapture> frameCapture;
+	shared_ptr<nv::D3D11FrameCapture> d3dCapture;
+
+	// 自动裁黑边：隔几帧看一次亮度，videoRect 是当前帧要显示的部分，采样、两遍缩放和 FitQuadSize 都只用这一块
+	// 硬件解码的帧先经 lumaReadback 回读，结果晚两帧才用上
+	bool isAutoCropEnabled;
+	nv::CropDetector cropDetector;
+	shared_ptr<nv::D3D11LumaReadback> lumaReadback;
+	nv::CropRect videoRect;
+
+	// NV_RENDER=cpu 时视频由 SoftwareRenderer 在 CPU 上画好，上传到 cpuTexture 再铺满屏幕，视图大小变了要重画
+	shared_ptr<nv::SoftwareRenderer> softwareRenderer;
+	ComPtr<ID3D11Texture2D> cpuTexture;
+	ComPtr<ID3D11ShaderResourceView> cpuSrv;
+	ComPtr<ID3D11Texture2D> subStaging; // 读回字幕层用
 };
 
 void CreateD2DRenderTarget(ID2D1Factory* d2dfa, ID3D11Texture2D* texture, ID2D1RenderTarget** d2drt) {
@@ -230,7 +397,7 @@ void CreateSubTexture(ID3D11Device* d3ddevice, int width, int height, ID3D11Text
 
 	d3ddevice->CreateTexture2D(&subDesc, NULL, subTexture);
 
-	// ɫԴ
+	// 创建着色器资源
 	D3D11_SHADER_RESOURCE_VIEW_DESC const srvDesc = CD3D11_SHADER_RESOURCE_VIEW_DESC(
 		*subTexture,
 		D3D11_SRV_DIMENSION_TEXTURE2D,
@@ -276,6 +443,236 @@ void SetSubtitlesNextState (list<Subtitle>& subtitles, double second) {
 	}
 }
 
+// 环境变量的值，没有设置时为空
+string GetEnv(const char* name) {
+	char* value = nullptr;
+	size_t length = 0;
+	_dupenv_s(&value, &length, name);
+	string result = value ? value : "";
+	free(value);
+	return result;
+}
+
+// 环境变量的值在 choices 里时返回对应的选项，否则返回 defaultValue
+template<typename T>
+T GetEnvChoice(const char* name, const std::map<string, T>& choices, T defaultValue) {
+	auto it = choices.find(GetEnv(name));
+	return it == choices.end() ? defaultValue : it->second;
+}
+
+// 通过环境变量 NV_AUDIO_SINK 选择音频输出：null 不发声，wav:路径 录制到文件，默认走 WASAPI
+// null:1.001 这样可以让模拟的设备时钟偏快或偏慢，用来观察漂移补偿
+shared_ptr<nv::AudioSink> CreateAudioSink() {
+	string sinkSpec = GetEnv("NV_AUDIO_SINK");
+	if (sinkSpec == "null") {
+		return make_shared<nv::NullAudioSink>();
+	}
+	else if (sinkSpec.rfind("null:", 0) == 0) {
+		auto sink = make_shared<nv::NullAudioSink>();
+		double clockRate = atof(sinkSpec.substr(5).c_str());
+		if (clockRate > 0) {
+			sink->SetClockRate(clockRate);
+		}
+		return sink;
+	}
+	else if (sinkSpec.rfind("wav:", 0) == 0) {
+		return make_shared<nv::WavFileAudioSink>(sinkSpec.substr(4));
+	}
+	return make_shared<nv::WasapiAudioSink>();
+}
+
+// NV_COMPOSITE=always 时每次刷新都重画并 Present，用来和按变化合成的开销做对比
+bool IsAlwaysCompositeRequested() {
+	return GetEnv("NV_COMPOSITE") == "always";
+}
+
+// 通过环境变量 NV_RENDER=cpu 改用 SoftwareRenderer 画视频，用来核对 GPU 的输出、测量转换开销
+bool IsSoftwareRenderRequested() {
+	return GetEnv("NV_RENDER") == "cpu";
+}
+
+// NV_TONEMAP=hable 换成 Hable 曲线，默认 BT.2390
+nv::ToneMapCurve GetRequestedToneMapCurve() {
+	return GetEnv("NV_TONEMAP") == "hable" ? nv::ToneMapCurve::Hable : nv::ToneMapCurve::BT2390;
+}
+
+// NV_FRAME_LATENCY=1..3 交换链最多排几帧，默认 1，延迟最低
+int GetRequestedFrameLatency() {
+	return GetEnvChoice<int>("NV_FRAME_LATENCY", { { "1", 1 }, { "2", 2 }, { "3", 3 } }, 1);
+}
+
+// NV_AUTOCROP=1 自动裁掉画面里的黑边，默认不裁
+bool IsAutoCropRequested() {
+	return GetEnv("NV_AUTOCROP") == "1";
+}
+
+// NV_DEDUP=off 和上一帧一样的帧也照常转换、上传和合成，用来对比开销
+bool IsDuplicateSkipRequested() {
+	return GetEnv("NV_DEDUP") != "off";
+}
+
+// NV_CAPTURE=png/qoi/raw 选抓图的格式，默认 PNG
+nv::ImageFormat GetRequestedImageFormat() {
+	return GetEnvChoice<nv::ImageFormat>("NV_CAPTURE", {
+		{ "png", nv::ImageFormat::PNG },
+		{ "qoi", nv::ImageFormat::QOI },
+		{ "raw", nv::ImageFormat::Raw },
+	}, nv::ImageFormat::PNG);
+}
+
+// NV_SCALER=bilinear/bicubic/lanczos/catmullrom 选视频缩放的核，默认 Catmull-Rom，bilinear 是单遍的纹理采样
+nv::ScaleFilter GetRequestedScaleFilter() {
+	return GetEnvChoice<nv::ScaleFilter>("NV_SCALER", {
+		{ "bilinear", nv::ScaleFilter::Bilinear },
+		{ "catmullrom", nv::ScaleFilter::CatmullRom },
+		{ "bicubic", nv::ScaleFilter::Bicubic },
+		{ "lanczos", nv::ScaleFilter::Lanczos3 },
+	}, nv::ScaleFilter::CatmullRom);
+}
+
+// NV_DITHER=none/ordered/bluenoise 选量化到显示器位深时的抖动，默认蓝噪声
+nv::DitherMode GetRequestedDitherMode() {
+	return GetEnvChoice<nv::DitherMode>("NV_DITHER", {
+		{ "none", nv::DitherMode::None },
+		{ "ordered", nv::DitherMode::Ordered },
+		{ "bluenoise", nv::DitherMode::BlueNoise },
+	}, nv::DitherMode::BlueNoise);
+}
+
+// 显示器每个通道的位数，拿不到时按 8 位
+int GetDisplayBitsPerColor(IDXGIOutput* output) {
+	ComPtr<IDXGIOutput6> output6;
+	DXGI_OUTPUT_DESC1 desc = {};
+	if (!output || FAILED(output->QueryInterface<IDXGIOutput6>(&output6)) || FAILED(output6->GetDesc1(&desc)) || desc.BitsPerColor == 0) {
+		return 8;
+	}
+	return desc.BitsPerColor;
+}
+
+// 响度归一化：优先用后台预扫描（或缓存）的整片响度，还没扫完时先用播放中测到的
+void UpdateLoudnessGain(DecoderParam& param) {
+	auto& audioPlayer = param.audioPlayer;
+	if (!audioPlayer) {
+		return;
+	}
+
+	if (!param.normalizeLoudness) {
+		audioPlayer->SetGain(1);
+		return;
+	}
+
+	constexpr double targetLoudness = -18; // LUFS
+	constexpr double minPlaybackSeconds = 10; // 播放中测量至少要这么久才拿来用
+	constexpr double maxBoost = 12, maxCut = -20; // dB
+
+	double lufs = 0;
+	if (!(param.loudnessScanner && param.loudnessScanner->GetLoudness(lufs))) {
+		auto meter = audioPlayer->GetLoudnessMeter();
+		if (!meter->HasResult() || meter->GetMeasuredSeconds() < minPlaybackSeconds) {
+			return;
+		}
+		lufs = meter->GetIntegratedLoudness();
+	}
+
+	double gainDb = std::clamp(targetLoudness - lufs, maxCut, maxBoost);
+	audioPlayer->SetGain(pow(10, gainDb / 20));
+}
+
+// 拖动进度条时从已经解码好的 PCM 里取一小段（颗粒）播放，鼠标不动就不出声
+// 不拖动时让缓存跟着播放位置走，这样开始拖动时附近的音频已经准备好了
+void UpdateScrubAudio(DecoderParam& param) {
+	auto& cache = param.scrubCache;
+	auto& audioPlayer = param.audioPlayer;
+	if (!cache || !audioPlayer) {
+		return;
+	}
+
+	if (!param.isScrubbing) {
+		if (param.wasScrubbing) {
+			// 松开之后从鼠标位置重新开始正常播放
+			param.wasScrubbing = false;
+			param.isJumpProgress = true;
+			audioPlayer->SetScrubbing(false);
+		}
+		double clock = audioPlayer->GetClock();
+		if (clock >= 0) {
+			cache->SetCenter(clock);
+		}
+		return;
+	}
+
+	double cursor = param.currentSecond;
+	cache->SetCenter(cursor);
+
+	if (!param.wasScrubbing) {
+		// 开始拖动，还没播放的音频不要了
+		param.wasScrubbing = true;
+		param.lastGrainSecond = -1;
+		audioPlayer->Flush();
+		audioPlayer->SetScrubbing(true);
+	}
+
+	constexpr double grainSeconds = 0.08;
+	constexpr double fadeSeconds = 0.015;
+	int channels = cache->GetChannels();
+	int sampleRate = cache->GetSampleRate();
+	uint32_t grainFrames = grainSeconds * sampleRate;
+
+	// 上一个颗粒快播完了才接下一个
+	if (audioPlayer->GetBufferedFrames() > grainFrames / 2 || std::abs(cursor - param.lastGrainSecond) < 0.001) {
+		return;
+	}
+
+	auto& grain = param.grainBuffer;
+	grain.resize((size_t)grainFrames * channels);
+	if (!cache->Read(cursor, grainFrames, grain.data())) {
+		return;
+	}
+
+	// 两头淡入淡出，颗粒之间不会有咔哒声
+	uint32_t fadeFrames = fadeSeconds * sampleRate;
+	for (uint32_t i = 0; i < fadeFrames; i++) {
+		float w = 0.5f - 0.5f * cos(dx::XM_PI * i / fadeFrames);
+		for (int c = 0; c < channels; c++) {
+			grain[(size_t)i * channels + c] *= w;
+			grain[(size_t)(grainFrames - 1 - i) * channels + c] *= w;
+		}
+	}
+
+	const uint8_t* data[] = { (const uint8_t*)grain.data() };
+	audioPlayer->Write(data, AV_SAMPLE_FMT_FLT, channels, cache->GetChannelLayout(), grainFrames, cursor);
+	param.lastGrainSecond = cursor;
+}
+
+// 解码器的纹理数组要能直接当着色器资源采样，池子大小已经按 extra_hw_frames 多留出 FrameQueue 引用着的帧
+// 创建失败时退回默认的纹理数组，呈现时再拷贝
+AVPixelFormat GetHwFormat(AVCodecContext* ctx, const AVPixelFormat* formats) {
+	for (auto p = formats; *p != AV_PIX_FMT_NONE; p++) {
+		if (*p != AV_PIX_FMT_D3D11) {
+			continue;
+		}
+
+		AVBufferRef* framesRef = nullptr;
+		if (avcodec_get_hw_frames_parameters(ctx, ctx->hw_device_ctx, AV_PIX_FMT_D3D11, &framesRef) < 0) {
+			break;
+		}
+
+		auto framesCtx = reinterpret_cast<AVHWFramesContext*>(framesRef->data);
+		auto d3d11FramesCtx = reinterpret_cast<AVD3D11VAFramesContext*>(framesCtx->hwctx);
+		d3d11FramesCtx->BindFlags |= D3D11_BIND_SHADER_RESOURCE;
+
+		if (av_hwframe_ctx_init(framesRef) < 0) {
+			av_buffer_unref(&framesRef);
+			break;
+		}
+
+		ctx->hw_frames_ctx = framesRef;
+		return AV_PIX_FMT_D3D11;
+	}
+
+	return avcodec_default_get_format(ctx, formats);
+}
+
 void InitDecoder(const char* filePath, DecoderParam& param, ID3D11Device* d3d_device, ID3D11DeviceContext* d3d_device_ctx) {
 
 	AVFormatContext* fmtCtx = nullptr;
@@ -285,7 +682,15 @@ void InitDecoder(const char* filePath, DecoderParam& param, ID3D11Device* d3d_de
 	AVCodecContext* vcodecCtx = nullptr;
 	AVCodecContext* acodecCtx = nullptr;
 	AVCodecContext* subcodecCtx = nullptr;
+	param.videoStreamIndex = -1;
+	param.audioStreamIndex = -1;
+	param.subtitleStreamIndex = -1;
 	for (int i = 0; i < fmtCtx->nb_streams; i++) {
+		// 音乐文件里的封面图也是一个视频流，不当作视频播放
+		if (fmtCtx->streams[i]->disposition & AV_DISPOSITION_ATTACHED_PIC) {
+			continue;
+		}
+
 		const AVCodec* codec = avcodec_find_decoder(fmtCtx->streams[i]->codecpar->codec_id);
 		if (codec) {
 			switch (codec->type) {
@@ -305,12 +710,19 @@ void InitDecoder(const char* filePath, DecoderParam& param, ID3D11Device* d3d_de
 				avcodec_open2(acodecCtx, codec, NULL);
 				param.codecMap[i] = acodecCtx;
 
-				// ʼ AudioPlayerι̶ʹ˫
-				param.audioPlayer = make_shared<nv::AudioPlayer>(2, acodecCtx->sample_rate);
+				auto audioTimebase = fmtCtx->streams[i]->time_base;
+				param.audioTimeBase = (double)audioTimebase.num / audioTimebase.den;
+
+				// 初始化 AudioPlayer，使用设备原生的声道数，上下混音在 AudioPlayer 里完成
+				param.audioPlayer = make_shared<nv::AudioPlayer>(CreateAudioSink(), 0, acodecCtx->sample_rate);
 				param.audioPlayer->Start();
 				constexpr float defaultVolume = 0.5;
 				param.audioPlayer->SetVolume(defaultVolume);
 				param.audioVolume = defaultVolume;
+
+				// 后台扫描整个文件的响度，结果按文件缓存
+				param.loudnessScanner = make_shared<nv::LoudnessScanner>(filePath);
+				param.normalizeLoudness = true;
 				break;
 			}
 			case AVMEDIA_TYPE_SUBTITLE: {
@@ -334,7 +746,35 @@ void InitDecoder(const char* filePath, DecoderParam& param, ID3D11Device* d3d_de
 		}
 	}
 
-	// Ӳ
+	param.fmtCtx = fmtCtx;
+	param.vcodecCtx = vcodecCtx;
+	param.startSecond = fmtCtx->start_time == AV_NOPTS_VALUE ? 0 : (double)fmtCtx->start_time / AV_TIME_BASE;
+
+	// 拖动进度条时用的音频缓存，单独开一个 demuxer 在后台解码
+	if (acodecCtx) {
+		param.scrubCache = make_shared<nv::AudioScrubCache>(filePath, param.audioStreamIndex, param.startSecond);
+	}
+
+	// 进度条上的波形，也是后台生成、按文件缓存
+	if (acodecCtx) {
+		param.waveformScanner = make_shared<nv::WaveformScanner>(filePath);
+	}
+	param.waveformZoom = 1;
+
+	// 纯音频文件
+	if (vcodecCtx == nullptr) {
+		return;
+	}
+
+	param.width = vcodecCtx->width;
+	param.height = vcodecCtx->height;
+
+	// CPU 渲染要的是系统内存里的帧，不启用硬件解码
+	if (IsSoftwareRenderRequested()) {
+		return;
+	}
+
+	// 启用硬件解码器
 	AVBufferRef* hw_device_ctx = av_hwdevice_ctx_alloc(AV_HWDEVICE_TYPE_D3D11VA);
 	AVHWDeviceContext* device_ctx = reinterpret_cast<AVHWDeviceContext*>(hw_device_ctx->data);
 	AVD3D11VADeviceContext* d3d11va_device_ctx = reinterpret_cast<AVD3D11VADeviceContext*>(device_ctx->hwctx);
@@ -343,10 +783,9 @@ void InitDecoder(const char* filePath, DecoderParam& param, ID3D11Device* d3d_de
 	vcodecCtx->hw_device_ctx = av_buffer_ref(hw_device_ctx);
 	av_hwdevice_ctx_init(vcodecCtx->hw_device_ctx);
 
-	param.fmtCtx = fmtCtx;
-	param.vcodecCtx = vcodecCtx;
-	param.width = vcodecCtx->width;
-	param.height = vcodecCtx->height;
+	// 排队的帧加上正在显示的一帧
+	vcodecCtx->extra_hw_frames = videoQueueSize + 1;
+	vcodecCtx->get_format = GetHwFormat;
 }
 
 MediaFrame RequestFrame(DecoderParam& param) {
@@ -406,8 +845,146 @@ void ReleaseDecoder(DecoderParam& param) {
 	avformat_close_input(&param.fmtCtx);
 }
 
+// 和 YUVToRGB.hlsli 的 ColorConstants 对应
+struct ColorConstants {
+	float yuvToRgb[3][4];
+	float yuvOffset[4];
+	float planeSelect[3][nv::PixelFormatDesc::maxPlanes][4]; // [分量][平面]，和平面的采样结果点乘得到这个分量
+	float texScale[4];
+};
+
+// rect 是要显示的部分在纹理里的位置（纹理坐标），解码器的纹理按编码尺寸对齐，可能比帧大，裁掉黑边时还要再小一些
+ColorConstants GetColorConstants(const nv::ColorDescription& desc, const nv::PixelFormatDesc& format, const float rect[4]) {
+	auto m = nv::GetYUVMatrix(desc);
+
+	ColorConstants constants = {};
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			constants.yuvToRgb[i][j] = m.matrix[i][j];
+		}
+		constants.yuvOffset[i] = m.offset[i];
+
+		auto& comp = format.components[i];
+		constants.planeSelect[i][comp.plane][comp.channel] = 1;
+	}
+	constants.texScale[0] = rect[2];
+	constants.texScale[1] = rect[3];
+	constants.texScale[2] = rect[0];
+	constants.texScale[3] = rect[1];
+	return constants;
+}
+
+// 纹理里样本的位深和对齐来自像素格式，RGB 的帧只换算到 0..1
+nv::ColorDescription GetColorDescription(AVColorSpace colorspace, AVColorRange range, AVColorPrimaries primaries, int height, const nv::PixelFormatDesc& format) {
+	return { format.isRGB ? AVCOL_SPC_RGB : colorspace, range, primaries, height, format.bitDepth, format.sampleShift };
+}
+
+void InitColorConstants(ID3D11Device* device, ScenceParam& param, const DecoderParam& decoderParam) {
+	// 第一帧之前先按解码器的参数算，解码器的格式不支持时先按 NV12
+	auto vcodecCtx = decoderParam.vcodecCtx;
+	if (!nv::GetPixelFormatDesc(vcodecCtx->pix_fmt, param.pixelFormat)) {
+		nv::GetPixelFormatDesc(AV_PIX_FMT_NV12, param.pixelFormat);
+	}
+	param.colorDesc = GetColorDescription(vcodecCtx->colorspace, vcodecCtx->color_range, vcodecCtx->color_primaries, vcodecCtx->height, param.pixelFormat);
+
+	const float rect[4] = { 0, 0, 1, 1 };
+	auto constants = GetColorConstants(param.colorDesc, param.pixelFormat, rect);
+	D3D11_BUFFER_DESC cbd = {};
+	cbd.Usage = D3D11_USAGE_DEFAULT;
+	cbd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	cbd.ByteWidth = sizeof(constants);
+	D3D11_SUBRESOURCE_DATA csd = {};
+	csd.pSysMem = &constants;
+
+	device->CreateBuffer(&cbd, &csd, &param.pColorConstantBuffer);
+}
+
+// 每帧都算，内容没变时 renderCache 不会真正更新
+void UpdateColorConstants(const AVFrame* frame, const nv::PixelFormatDesc& format, const float rect[4], ScenceParam& param) {
+	param.colorDesc = GetColorDescription(frame->colorspace, frame->color_range, frame->color_primaries, frame->height, format);
+	param.pixelFormat = format;
+
+	auto constants = GetColorConstants(param.colorDesc, format, rect);
+	param.renderCache->UpdateConstantBuffer(param.pColorConstantBuffer.Get(), &constants, sizeof(constants));
+}
+
+// 阈值表做成 R8_UNORM 纹理，不抖动时常量是 0，着色器直接输出
+void InitDither(ID3D11Device* device, ScenceParam& param) {
+	float constants[4] = {};
+	if (param.ditherMode != nv::DitherMode::None) {
+		constants[0] = (float)((1 << param.displayBitsPerColor) - 1);
+	}
+	D3D11_BUFFER_DESC cbd = {};
+	cbd.Usage = D3D11_USAGE_IMMUTABLE;
+	cbd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	cbd.ByteWidth = sizeof(constants);
+	D3D11_SUBRESOURCE_DATA csd = {};
+	csd.pSysMem = constants;
+
+	device->CreateBuffer(&cbd, &csd, &param.ditherConstantBuffer);
+
+	D3D11_TEXTURE2D_DESC tdesc = {};
+	tdesc.Format = DXGI_FORMAT_R8_UNORM;
+	tdesc.ArraySize = 1;
+	tdesc.MipLevels = 1;
+	tdesc.SampleDesc = { 1, 0 };
+	tdesc.Width = nv::ditherSize;
+	tdesc.Height = nv::ditherSize;
+	tdesc.Usage = D3D11_USAGE_IMMUTABLE;
+	tdesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	D3D11_SUBRESOURCE_DATA tsd = {};
+	tsd.pSysMem = nv::GetDitherMatrix(param.ditherMode);
+	tsd.SysMemPitch = nv::ditherSize;
+
+	ComPtr<ID3D11Texture2D> texture;
+	if (SUCCEEDED(device->CreateTexture2D(&tdesc, &tsd, &texture))) {
+		device->CreateShaderResourceView(texture.Get(), nullptr, &param.ditherMatrixSrv);
+	}
+}
+
+// HDR 元数据变了才重建 LUT，通常一个流只建一次
+void UpdateToneMapLut(ID3D11Device* device, const AVFrame* frame, ScenceParam& param) {
+	if (!nv::UpdateHDRMetadata(frame, param.hdrMetadata)) {
+		return;
+	}
+
+	param.lutTexture = nullptr;
+	param.lutSrv = nullptr;
+	param.toneMapper = nullptr;
+	if (!nv::IsHDRTransfer(param.hdrMetadata.transfer)) {
+		return;
+	}
+
+	auto toneMapper = make_shared<nv::ToneMapper>(param.hdrMetadata, param.toneMapCurve);
+	const int lutSize = nv::ToneMapper::lutSize;
+
+	D3D11_TEXTURE3D_DESC tdesc = {};
+	tdesc.Width = lutSize;
+	tdesc.Height = lutSize;
+	tdesc.Depth = lutSize;
+	tdesc.MipLevels = 1;
+	tdesc.Format = DXGI_FORMAT_R16G16B16A16_UNORM;
+	tdesc.Usage = D3D11_USAGE_IMMUTABLE;
+	tdesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	D3D11_SUBRESOURCE_DATA tsd = {};
+	tsd.pSysMem = toneMapper->GetLUT().data();
+	tsd.SysMemPitch = lutSize * 4 * sizeof(uint16_t);
+	tsd.SysMemSlicePitch = tsd.SysMemPitch * lutSize;
+
+	if (FAILED(device->CreateTexture3D(&tdesc, &tsd, &param.lutTexture))) {
+		return;
+	}
+	device->CreateShaderResourceView(param.lutTexture.Get(), nullptr, &param.lutSrv);
+	param.renderCache->AddCreations(2);
+	param.toneMapper = toneMapper;
+}
+
 void InitScence(ID3D11Device* device, ID3D11DeviceContext* ctx, ScenceParam& param, const DecoderParam& decoderParam) {
-	// 
+	param.renderDevice = make_shared<nv::D3D11RenderDevice>(device, ctx);
+	param.renderCache = make_shared<nv::RenderStateCache>(param.renderDevice.get());
+	param.isAlwaysComposite = IsAlwaysCompositeRequested();
+
+	// 顶点输入
 	const Vertex vertices[] = {
 		{-1,	1,	0,	0,	0},
 		{1,		1,	0,	1,	0},
@@ -433,7 +1010,7 @@ void InitScence(ID3D11Device* device, ID3D11DeviceContext* ctx, ScenceParam& par
 
 	device->CreateBuffer(&ibd, &isd, &param.pIndexBuffer);
 
-	// 
+	// 常量缓冲区
 	auto constant = dx::XMMatrixScaling(1, 1, 1);
 	constant = dx::XMMatrixTranspose(constant);
 	D3D11_BUFFER_DESC cbd = {};
@@ -448,7 +1025,7 @@ void InitScence(ID3D11Device* device, ID3D11DeviceContext* ctx, ScenceParam& par
 	device->CreateBuffer(&cbd, &csd, &param.pConstantBuffer);
 	device->CreateBuffer(&cbd, &csd, &param.pConstantBufferSub);
 
-	// ɫ
+	// 顶点着色器
 	D3D11_INPUT_ELEMENT_DESC ied[] = {
 		{"POSITION", 0, DXGI_FORMAT::DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
 		{"TEXCOORD", 0, DXGI_FORMAT::DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0}
@@ -457,63 +1034,40 @@ void InitScence(ID3D11Device* device, ID3D11DeviceContext* ctx, ScenceParam& par
 	device->CreateInputLayout(ied, std::size(ied), g_main_VS, sizeof(g_main_VS), &param.pInputLayout);
 	device->CreateVertexShader(g_main_VS, sizeof(g_main_VS), nullptr, &param.pVertexShader);
 
-	AVPixelFormat pixelForamt = decoderParam.vcodecCtx->pix_fmt;
-
-	// 
-	static const std::map<AVPixelFormat, DXGI_FORMAT> textureForamtMap = {
-		{ AV_PIX_FMT_YUV420P, DXGI_FORMAT_NV12 },
-		{ AV_PIX_FMT_YUV420P10, DXGI_FORMAT_P010 },
-		{ AV_PIX_FMT_YUV444P10LE, DXGI_FORMAT_P010 }
-	};
-	D3D11_TEXTURE2D_DESC tdesc = {};
-	tdesc.Format = textureForamtMap.at(pixelForamt);
-	tdesc.Usage = D3D11_USAGE_DEFAULT;
-	tdesc.MiscFlags = D3D11_RESOURCE_MISC_SHARED;
-	tdesc.ArraySize = 1;
-	tdesc.MipLevels = 1;
-	tdesc.SampleDesc = { 1, 0 };
-	tdesc.Height = decoderParam.height;
-	tdesc.Width = decoderParam.width;
-	tdesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-	device->CreateTexture2D(&tdesc, nullptr, &param.texture);
-
-	// ɫԴ
-	static const std::map<AVPixelFormat, DXGI_FORMAT> srvYForamt = {
-		{ AV_PIX_FMT_YUV420P, DXGI_FORMAT_R8_UNORM },
-		{ AV_PIX_FMT_YUV420P10, DXGI_FORMAT_R16_UNORM },
-		{ AV_PIX_FMT_YUV444P10LE, DXGI_FORMAT_R16_UNORM }
-	};
-	static const std::map<AVPixelFormat, DXGI_FORMAT> srvUVFormat = {
-		{ AV_PIX_FMT_YUV420P, DXGI_FORMAT_R8G8_UNORM },
-		{ AV_PIX_FMT_YUV420P10, DXGI_FORMAT_R16G16_UNORM },
-		{ AV_PIX_FMT_YUV444P10LE, DXGI_FORMAT_R16_UNORM }
-	};
-
-	D3D11_SHADER_RESOURCE_VIEW_DESC const YPlaneDesc = CD3D11_SHADER_RESOURCE_VIEW_DESC(
-		param.texture.Get(),
-		D3D11_SRV_DIMENSION_TEXTURE2D,
-		srvYForamt.at(pixelForamt)
-	);
-
-	device->CreateShaderResourceView(
-		param.texture.Get(),
-		&YPlaneDesc,
-		&param.srvY
-	);
-
-	D3D11_SHADER_RESOURCE_VIEW_DESC const UVPlaneDesc = CD3D11_SHADER_RESOURCE_VIEW_DESC(
-		param.texture.Get(),
-		D3D11_SRV_DIMENSION_TEXTURE2D,
-		srvUVFormat.at(pixelForamt)
-	);
+	// 视频纹理等第一帧出来按它的格式创建，CPU 渲染的纹理等画出第一帧再按视图大小创建
+	param.toneMapCurve = GetRequestedToneMapCurve();
+	param.scaleFilter = GetRequestedScaleFilter();
+	param.ditherMode = GetRequestedDitherMode();
+	param.isAutoCropEnabled = IsAutoCropRequested();
+	param.duplicateDetector.SetEnabled(IsDuplicateSkipRequested());
+	if (decoderParam.vcodecCtx) {
+		param.frameQueue = make_shared<nv::FrameQueue>(videoQueueSize);
+	}
+	if (decoderParam.vcodecCtx && IsSoftwareRenderRequested()) {
+		param.softwareRenderer = make_shared<nv::SoftwareRenderer>();
+		param.softwareRenderer->SetToneMapCurve(param.toneMapCurve);
+		param.softwareRenderer->SetScaleFilter(param.scaleFilter);
+		param.softwareRenderer->SetDitherMode(param.ditherMode);
+	}
+	else if (decoderParam.vcodecCtx) {
+		InitColorConstants(device, param, decoderParam);
+		param.scaleTimer = make_shared<nv::D3D11GpuTimer>(device, ctx);
+		InitDither(device, param);
+		if (param.isAutoCropEnabled) {
+			param.lumaReadback = make_shared<nv::D3D11LumaReadback>(device, ctx);
+		}
+	}
 
-	device->CreateShaderResourceView(
-		param.texture.Get(),
-		&UVPlaneDesc,
-		&param.srvUV
-	);
+	auto imageFormat = GetRequestedImageFormat();
+	if (param.softwareRenderer) {
+		param.frameCapture = make_shared<nv::SoftwareFrameCapture>(param.softwareRenderer, imageFormat);
+	}
+	else {
+		param.d3dCapture = make_shared<nv::D3D11FrameCapture>(device, ctx, imageFormat);
+		param.frameCapture = param.d3dCapture;
+	}
 
-	// 
+	// 创建采样器
 	D3D11_SAMPLER_DESC samplerDesc = {};
 	samplerDesc.Filter = D3D11_FILTER::D3D11_FILTER_ANISOTROPIC;
 	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
@@ -523,11 +1077,23 @@ void InitScence(ID3D11Device* device, ID3D11DeviceContext* ctx, ScenceParam& par
 
 	device->CreateSamplerState(&samplerDesc, &param.pSampler);
 
-	// ɫ
+	// LUT 按格点三线性插值，不能绕回
+	D3D11_SAMPLER_DESC lutSamplerDesc = {};
+	lutSamplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	lutSamplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	lutSamplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	lutSamplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+
+	device->CreateSamplerState(&lutSamplerDesc, &param.pLutSampler);
+
+	// 像素着色器
 	device->CreatePixelShader(g_main_PS, sizeof(g_main_PS), nullptr, &param.pPixelShader);
 	device->CreatePixelShader(g_main_PS_Sub, sizeof(g_main_PS_Sub), nullptr, &param.pPixelShader_Subtitle);
+	device->CreatePixelShader(g_main_PS_ToneMap, sizeof(g_main_PS_ToneMap), nullptr, &param.pPixelShader_ToneMap);
+	device->CreatePixelShader(g_main_PS_ScaleH, sizeof(g_main_PS_ScaleH), nullptr, &param.pPixelShader_ScaleH);
+	device->CreatePixelShader(g_main_PS_ScaleV, sizeof(g_main_PS_ScaleV), nullptr, &param.pPixelShader_ScaleV);
 
-	// ͸״̬
+	// 创建透明混合状态
 	D3D11_BLEND_DESC omDesc = {};
 	omDesc.RenderTarget[0].BlendEnable = true;
 	omDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
@@ -558,30 +1124,54 @@ void InitScence(ID3D11Device* device, ID3D11DeviceContext* ctx, ScenceParam& par
 	param.textRenderer = new DWriteColorTextRenderer::CustomTextRenderer(param.d2dfa, param.d2drt);
 }
 
-// ͨڱƵļ㣬óʵžд볣塣
+// 通过窗口比例与视频比例的计算，得出合适的缩放矩阵，写入常量缓冲。
 void FitQuadSize(
-	ID3D11DeviceContext* ctx, ID3D11Buffer* constant,
+	nv::RenderStateCache& rc, ID3D11Buffer* constant,
 	int videoWidth, int videoHeight, int viewWidth, int viewHeight
 ) {
-	double videoRatio = (double)videoWidth / videoHeight;
-	double viewRatio = (double)viewWidth / viewHeight;
-	dx::XMMATRIX matrix;
+	double scaleX, scaleY;
+	nv::GetFitScale(videoWidth, videoHeight, viewWidth, viewHeight, scaleX, scaleY);
+
+	dx::XMMATRIX matrix = dx::XMMatrixScaling((float)scaleX, (float)scaleY, 1);
+	matrix = dx::XMMatrixTranspose(matrix);
+
+	// 视图和视频大小不变时内容也不变，缓存会省掉这次更新
+	rc.UpdateConstantBuffer(constant, &matrix, sizeof(matrix));
+}
 
-	if (videoRatio > viewRatio) {
-		matrix = dx::XMMatrixScaling(1, viewRatio / videoRatio, 1);
+// 在进度条上画 [startSecond, endSecond) 的波形，每个像素一列
+void DrawWaveform(DecoderParam& param, ImVec2 rectMin, ImVec2 rectMax, double startSecond, double endSecond) {
+	auto& scanner = param.waveformScanner;
+	if (!scanner) {
+		return;
 	}
-	else if (videoRatio < viewRatio) {
-		matrix = dx::XMMatrixScaling(videoRatio / viewRatio, 1, 1);
+
+	auto drawList = ImGui::GetWindowDrawList();
+	auto pyramid = scanner->GetPyramid();
+	if (!pyramid) {
+		// 还没建好，在底部画一条进度
+		float x = rectMin.x + (rectMax.x - rectMin.x) * scanner->GetProgress();
+		drawList->AddRectFilled({ rectMin.x, rectMax.y - 2 }, { x, rectMax.y }, IM_COL32(255, 255, 255, 64));
+		return;
 	}
-	else {
-		matrix = dx::XMMatrixScaling(1, 1, 1);
+
+	int columns = (int)(rectMax.x - rectMin.x);
+	if (columns <= 0) {
+		return;
 	}
-	matrix = dx::XMMatrixTranspose(matrix);
 
-	D3D11_MAPPED_SUBRESOURCE mapped;
-	ctx->Map(constant, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
-	memcpy(mapped.pData, &matrix, sizeof(matrix));
-	ctx->Unmap(constant, 0);
+	auto& peaks = param.waveformColumns;
+	peaks.resize(columns);
+	pyramid->Query(startSecond, endSecond, columns, peaks.data());
+
+	float mid = (rectMin.y + rectMax.y) / 2;
+	float half = (rectMax.y - rectMin.y) / 2;
+	for (int i = 0; i < columns; i++) {
+		float x = rectMin.x + i;
+		auto& peak = peaks[i];
+		drawList->AddRectFilled({ x, mid - peak.max * half }, { x + 1, mid - peak.min * half + 1 }, IM_COL32(120, 170, 255, 90));
+		drawList->AddRectFilled({ x, mid - peak.rms * half }, { x + 1, mid + peak.rms * half + 1 }, IM_COL32(170, 210, 255, 120));
+	}
 }
 
 void DrawImgui(
@@ -592,19 +1182,25 @@ void DrawImgui(
 	ImGui_ImplWin32_NewFrame();
 	ImGui::NewFrame();
 
-	// ￪ʼд߼
+	// 这里开始写界面逻辑
 	// ImGui::ShowDemoWindow();
 	auto& io = ImGui::GetIO();
 
-	// ȫڿ
+	// 全屏窗口控制
 	auto isEnterDown = io.KeysDownDuration[VK_RETURN] == 0.0f;
 	if (isEnterDown) {
 		param.triggerFullScreen = true;
 	}
 
-	// ֿԵ
+	// 画面没变时也要合成一次才抓得到
+	if (io.KeyCtrl && io.KeysDownDuration['S'] == 0.0f) {
+		param.isCaptureRequested = true;
+		param.damage.video = true;
+	}
+
+	// 滚轮可以调整音量，按住 Ctrl 时留给进度条缩放
 	auto& audioVolume = decoderParam.audioVolume;
-	if (io.MouseWheel != 0) {
+	if (io.MouseWheel != 0 && !io.KeyCtrl) {
 		audioVolume += io.MouseWheel * 0.05;
 		if (audioVolume < 0) audioVolume = 0;
 		if (audioVolume > 1) audioVolume = 1;
@@ -616,9 +1212,10 @@ void DrawImgui(
 		mouseStopTime = system_clock::now();
 	}
 
-	constexpr auto hideMouseDelay = 1s;
-	bool isShowWidgets = ((system_clock::now() - mouseStopTime) < hideMouseDelay) || io.WantCaptureMouse;
+	// 纯音频时没有画面可看，控件一直显示
+	bool isShowWidgets = ((system_clock::now() - mouseStopTime) < hideMouseDelay) || io.WantCaptureMouse || decoderParam.vcodecCtx == nullptr;
 
+	decoderParam.isScrubbing = false;
 	if (isShowWidgets) {
 		if (ImGui::Begin("Play")) {
 			auto& playStatus = decoderParam.playStatus;
@@ -636,13 +1233,103 @@ void DrawImgui(
 			}
 			ImGui::SameLine();
 
+			// 放大后进度条只覆盖当前位置附近的一段，拖动时不跟着移动
+			auto& durationSecond = decoderParam.durationSecond;
+			auto& zoom = decoderParam.waveformZoom;
+			float viewStart = 0, viewEnd = durationSecond;
+			if (zoom > 1) {
+				float span = durationSecond / zoom;
+				if (!decoderParam.wasScrubbing) {
+					decoderParam.waveformViewStart = std::clamp(decoderParam.currentSecond - span / 2, 0.0f, durationSecond - span);
+				}
+				viewStart = decoderParam.waveformViewStart;
+				viewEnd = viewStart + span;
+			}
+
 			ImGui::PushItemWidth(700);
-			if (ImGui::SliderFloat("time", &decoderParam.currentSecond, 0, decoderParam.durationSecond)) {
+			ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, { 4, 10 });
+			if (ImGui::SliderFloat("time", &decoderParam.currentSecond, viewStart, viewEnd)) {
 				decoderParam.isJumpProgress = true;
 			}
+			ImGui::PopStyleVar();
+			decoderParam.isScrubbing = ImGui::IsItemActive();
+			DrawWaveform(decoderParam, ImGui::GetItemRectMin(), ImGui::GetItemRectMax(), viewStart, viewEnd);
+
+			// Ctrl + 滚轮缩放进度条
+			if (ImGui::IsItemHovered() && io.KeyCtrl && io.MouseWheel != 0) {
+				zoom = std::clamp(zoom * powf(2, io.MouseWheel), 1.0f, 4096.0f);
+			}
 			ImGui::PopItemWidth();
 			ImGui::SameLine();
 			ImGui::Text("%.3f", decoderParam.durationSecond);
+
+			// 统计信息默认收起，排查性能问题时再展开
+			if (ImGui::CollapsingHeader("Stats")) {
+				auto& stats = param.loopStats;
+				ImGui::Text("%.0f wakeups/s, CPU %.1f%%, composited %.0f%% of refreshes", stats.wakeupsPerSecond, stats.cpuPercent, stats.compositePercent);
+
+				auto& presentClock = *param.presentClock;
+				ImGui::Text("present: %.1f ms to screen (last %.1f ms), max frame latency %d, %.2f Hz measured",
+					presentClock.GetLatency() * 1000, presentClock.GetLastLatency() * 1000, param.maxFrameLatency, presentClock.GetRefreshRate());
+
+				auto& counters = param.renderCache->GetFrameCounters();
+				ImGui::Text("last frame: %d state changes (%d skipped), %d buffer updates (%d skipped), %d creations, %d draws",
+					counters.stateChanges, counters.redundantChanges, counters.bufferUpdates, counters.redundantUpdates, counters.creations, counters.draws);
+
+				if (param.softwareRenderer) {
+					auto& timings = param.softwareRenderer->GetTimings();
+					ImGui::Text("cpu render (%s): convert %.2f ms, tone map %.2f ms, dither %.2f ms, scale %.2f ms, blend %.2f ms, total %.2f ms", nv::GetYUVConverterName(), timings.convert, timings.toneMap, timings.dither, timings.scale, timings.blend, timings.total);
+				}
+				else if (param.pColorConstantBuffer) {
+					ImGui::Text("color: %s", nv::GetColorSpaceName(param.colorDesc));
+				}
+
+				if (param.softwareRenderer) {
+					ImGui::Text("scale: %s (%s)", nv::GetScaleFilterName(param.softwareRenderer->GetScaleFilter()), nv::GetScalerName());
+				}
+				else if (param.scaleTimer) {
+					ImGui::Text("scale: %s, gpu %.2f ms", nv::GetScaleFilterName(param.scaleFilter), param.scaleTimer->GetMilliseconds());
+				}
+
+				if (param.softwareRenderer) {
+					ImGui::Text("dither: %s to 8 bits", nv::GetDitherModeName(param.ditherMode));
+				}
+				else if (param.ditherConstantBuffer) {
+					ImGui::Text("dither: %s to %d bits", nv::GetDitherModeName(param.ditherMode), param.displayBitsPerColor);
+				}
+
+				auto& duplicates = param.duplicateDetector;
+				if (duplicates.IsEnabled() && duplicates.GetFrameCount() > 0) {
+					ImGui::Text("duplicate frames (NV_DEDUP): %.1f%% of %llu skipped, signature %.2f ms", 100.0 * duplicates.GetDuplicateCount() / duplicates.GetFrameCount(),
+						duplicates.GetFrameCount(), duplicates.GetMilliseconds());
+				}
+
+				if (param.isAutoCropEnabled) {
+					auto& rect = param.videoRect;
+					ImGui::Text("auto crop (NV_AUTOCROP): %dx%d at (%d, %d), scan %.3f ms", rect.width, rect.height, rect.x, rect.y, param.cropDetector.GetMilliseconds());
+				}
+
+				auto captureStats = param.frameCapture->GetStats();
+				ImGui::Text("capture (Ctrl+S): %s, %llu saved, %llu dropped, %llu failed, last %.1f ms", nv::GetImageFormatName(param.frameCapture->GetFormat()),
+					captureStats.writer.written, captureStats.dropped, captureStats.failed + captureStats.writer.failed, captureStats.writer.encodeMilliseconds);
+
+				if (param.frameQueue) {
+					auto& queue = *param.frameQueue;
+					if (param.frameSource) {
+						ImGui::Text("frame queue %d/%d, %s, %s", queue.GetSize(), queue.GetCapacity(), av_get_pix_fmt_name(param.pixelFormat.format), param.frameSource);
+					}
+					else {
+						ImGui::Text("frame queue %d/%d", queue.GetSize(), queue.GetCapacity());
+					}
+				}
+
+				auto toneMapper = param.softwareRenderer ? param.softwareRenderer->GetToneMapper() : param.toneMapper;
+				if (toneMapper) {
+					auto& metadata = toneMapper->GetMetadata();
+					const char* transferName = metadata.transfer == AVCOL_TRC_ARIB_STD_B67 ? "HLG" : "PQ";
+					ImGui::Text("HDR %s %.0f nits -> SDR, %s", transferName, metadata.peakLuminance, nv::GetToneMapCurveName(toneMapper->GetCurve()));
+				}
+			}
 		}
 		ImGui::End();
 
@@ -652,15 +1339,54 @@ void DrawImgui(
 				decoderParam.audioPlayer->SetVolume(audioVolume);
 			}
 			ImGui::PopItemWidth();
+
+			ImGui::Checkbox("Normalize", &decoderParam.normalizeLoudness);
+			double lufs = 0;
+			if (decoderParam.loudnessScanner && decoderParam.loudnessScanner->GetLoudness(lufs)) {
+				ImGui::Text("%.1f LUFS%s", lufs, decoderParam.loudnessScanner->IsCached() ? " (cached)" : "");
+			}
+			else {
+				ImGui::Text("scanning...");
+			}
 		}
 		ImGui::End();
 	}
 
 	ImGui::Render();
-	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
 }
 
-// лȫ״̬
+uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+	auto bytes = (const uint8_t*)data;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, bytes + i, 8);
+		hash = (hash ^ word) * 0x100000001b3;
+	}
+	for (; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 0x100000001b3;
+	}
+	return hash;
+}
+
+// 绘制数据一样画出来的界面就一样，悬停、文字、控件显隐的变化都会反映在顶点上
+uint64_t HashDrawData(const ImDrawData* drawData) {
+	uint64_t hash = 0xcbf29ce484222325;
+	hash = HashBytes(hash, &drawData->DisplaySize, sizeof(drawData->DisplaySize));
+	for (int i = 0; i < drawData->CmdListsCount; i++) {
+		auto cmdList = drawData->CmdLists[i];
+		hash = HashBytes(hash, cmdList->VtxBuffer.Data, cmdList->VtxBuffer.size_in_bytes());
+		hash = HashBytes(hash, cmdList->IdxBuffer.Data, cmdList->IdxBuffer.size_in_bytes());
+		for (auto& cmd : cmdList->CmdBuffer) {
+			hash = HashBytes(hash, &cmd.ClipRect, sizeof(cmd.ClipRect));
+			hash = HashBytes(hash, &cmd.TextureId, sizeof(cmd.TextureId));
+			hash = HashBytes(hash, &cmd.ElemCount, sizeof(cmd.ElemCount));
+		}
+	}
+	return hash;
+}
+
+// 切换全屏状态
 void SwitchFullScreen(IDXGISwapChain3* swapchain, ScenceParam& param) {
 	DXGI_SWAP_CHAIN_DESC swapDesc;
 	swapchain->GetDesc(&swapDesc);
@@ -676,7 +1402,210 @@ void SwitchFullScreen(IDXGISwapChain3* swapchain, ScenceParam& param) {
 	}
 }
 
-void Draw(
+// 用 SoftwareRenderer 画视频和字幕，结果铺满视图（黑边已经画在里面了）
+void DrawSoftwareFrame(ID3D11Device* device, ID3D11DeviceContext* ctx, ScenceParam& param) {
+	auto& renderer = param.softwareRenderer;
+	bool isResized = renderer->GetWidth() != param.viewWidth || renderer->GetHeight() != param.viewHeight;
+
+	auto frame = param.frameQueue->GetCurrent();
+	if (frame && (param.isFrameDirty || isResized)) {
+		// 视图大小变了重画同一帧时不再检测
+		if (param.isFrameDirty) {
+			param.videoRect = DetectVideoCrop(frame, param);
+			renderer->SetCrop(param.videoRect);
+		}
+		param.isFrameDirty = false;
+
+		// 字幕层是 D2D 在 GPU 上画的，有字幕时读回来交给 CPU 混合
+		const uint8_t* overlay = nullptr;
+		int overlayPitch = 0;
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		if (!param.subtitles.empty()) {
+			D3D11_TEXTURE2D_DESC subDesc;
+			param.subTexture->GetDesc(&subDesc);
+			D3D11_TEXTURE2D_DESC stagingDesc = {};
+			if (param.subStaging) {
+				param.subStaging->GetDesc(&stagingDesc);
+			}
+			if (stagingDesc.Width != subDesc.Width || stagingDesc.Height != subDesc.Height) {
+				subDesc.Usage = D3D11_USAGE_STAGING;
+				subDesc.BindFlags = 0;
+				subDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+				subDesc.MiscFlags = 0;
+				device->CreateTexture2D(&subDesc, nullptr, param.subStaging.ReleaseAndGetAddressOf());
+				param.renderCache->AddCreations(1);
+			}
+
+			ctx->CopyResource(param.subStaging.Get(), param.subTexture.Get());
+			if (SUCCEEDED(ctx->Map(param.subStaging.Get(), 0, D3D11_MAP_READ, 0, &mapped))) {
+				overlay = (const uint8_t*)mapped.pData;
+				overlayPitch = mapped.RowPitch;
+			}
+		}
+
+		int ret = renderer->Render(frame, param.viewWidth, param.viewHeight, overlay, overlayPitch);
+		if (overlay) {
+			ctx->Unmap(param.subStaging.Get(), 0);
+		}
+
+		if (ret == 0) {
+			D3D11_TEXTURE2D_DESC cpuDesc = {};
+			if (param.cpuTexture) {
+				param.cpuTexture->GetDesc(&cpuDesc);
+			}
+			if (cpuDesc.Width != renderer->GetWidth() || cpuDesc.Height != renderer->GetHeight()) {
+				cpuDesc = {};
+				cpuDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+				cpuDesc.ArraySize = 1;
+				cpuDesc.MipLevels = 1;
+				cpuDesc.SampleDesc = { 1, 0 };
+				cpuDesc.Width = renderer->GetWidth();
+				cpuDesc.Height = renderer->GetHeight();
+				cpuDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+				device->CreateTexture2D(&cpuDesc, nullptr, param.cpuTexture.ReleaseAndGetAddressOf());
+				device->CreateShaderResourceView(param.cpuTexture.Get(), nullptr, param.cpuSrv.ReleaseAndGetAddressOf());
+				param.renderCache->AddCreations(2);
+			}
+			ctx->UpdateSubresource(param.cpuTexture.Get(), 0, nullptr, renderer->GetFramebuffer(), renderer->GetWidth() * 4, 0);
+		}
+	}
+
+	if (!param.cpuSrv) {
+		return;
+	}
+
+	// 帧缓冲已经是视图大小，不缩放、不混合，直接采样出来
+	auto& rc = *param.renderCache;
+	rc.SetConstantBuffer(nv::ShaderStage::Vertex, 0, param.pConstantBufferSub.Get());
+	rc.SetShader(nv::ShaderStage::Pixel, param.pPixelShader_Subtitle.Get());
+	rc.SetShaderResource(0, param.cpuSrv.Get());
+	rc.SetBlendState(nullptr);
+	rc.DrawIndexed(std::size(param.indices));
+}
+
+// 权重表做成 R32_FLOAT 纹理，第 i 行是输出像素 i：第 0 个是第一个源像素的位置，后面是 taps 个权重
+bool CreateScaleWeightView(ID3D11Device* device, const nv::ScaleWeights& weights, ComPtr<ID3D11ShaderResourceView>& srv) {
+	int width = weights.taps + 1;
+	vector<float> texels((size_t)width * weights.dstSize);
+	for (int i = 0; i < weights.dstSize; i++) {
+		float* row = &texels[(size_t)i * width];
+		row[0] = (float)weights.offsets[i];
+		for (int k = 0; k < weights.taps; k++) {
+			row[k + 1] = weights.weights[(size_t)i * weights.taps + k] / (float)(1 << nv::ScaleWeights::weightBits);
+		}
+	}
+
+	D3D11_TEXTURE2D_DESC tdesc = {};
+	tdesc.Format = DXGI_FORMAT_R32_FLOAT;
+	tdesc.ArraySize = 1;
+	tdesc.MipLevels = 1;
+	tdesc.SampleDesc = { 1, 0 };
+	tdesc.Width = width;
+	tdesc.Height = weights.dstSize;
+	tdesc.Usage = D3D11_USAGE_IMMUTABLE;
+	tdesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	D3D11_SUBRESOURCE_DATA tsd = {};
+	tsd.pSysMem = texels.data();
+	tsd.SysMemPitch = width * sizeof(float);
+
+	ComPtr<ID3D11Texture2D> texture;
+	srv = nullptr;
+	return SUCCEEDED(device->CreateTexture2D(&tdesc, &tsd, &texture))
+		&& SUCCEEDED(device->CreateShaderResourceView(texture.Get(), nullptr, &srv));
+}
+
+bool CreateScaleTarget(ID3D11Device* device, DXGI_FORMAT format, int width, int height, ComPtr<ID3D11Texture2D>& texture, ComPtr<ID3D11ShaderResourceView>& srv) {
+	D3D11_TEXTURE2D_DESC tdesc = {};
+	tdesc.Format = format;
+	tdesc.ArraySize = 1;
+	tdesc.MipLevels = 1;
+	tdesc.SampleDesc = { 1, 0 };
+	tdesc.Width = width;
+	tdesc.Height = height;
+	tdesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+
+	srv = nullptr;
+	return SUCCEEDED(device->CreateTexture2D(&tdesc, nullptr, texture.ReleaseAndGetAddressOf()))
+		&& SUCCEEDED(device->CreateShaderResourceView(texture.Get(), nullptr, &srv));
+}
+
+// 按视频和视图大小准备两遍缩放的中间纹理和权重表，大小没变时什么都不做。失败时返回 false，退回单遍的纹理采样
+bool PrepareScaleTargets(ID3D11Device* device, ScenceParam& param, int videoWidth, int videoHeight) {
+	auto& rc = *param.renderCache;
+
+	D3D11_TEXTURE2D_DESC sourceDesc = {}, tempDesc = {};
+	if (param.scaleSource) {
+		param.scaleSource->GetDesc(&sourceDesc);
+	}
+	if (param.scaleTemp) {
+		param.scaleTemp->GetDesc(&tempDesc);
+	}
+	if (sourceDesc.Width != videoWidth || sourceDesc.Height != videoHeight || tempDesc.Width != param.viewWidth || tempDesc.Height != videoHeight) {
+		// 旧纹理的渲染目标一起释放，后台缓冲的渲染目标下次用到时重建
+		rc.ReleaseRenderTargets();
+		param.isScaleValid = false;
+
+		// 横向的结果用浮点保存，核的负瓣在纵向缩放之前不能被截掉；转好的 RGB 留 10 位，到最后一遍才抖动量化
+		bool isCreated = CreateScaleTarget(device, DXGI_FORMAT_R10G10B10A2_UNORM, videoWidth, videoHeight, param.scaleSource, param.scaleSourceSrv)
+			&& CreateScaleTarget(device, DXGI_FORMAT_R16G16B16A16_FLOAT, param.viewWidth, videoHeight, param.scaleTemp, param.scaleTempSrv);
+		rc.AddCreations(4);
+		if (!isCreated) {
+			param.scaleSource = nullptr;
+			param.scaleTemp = nullptr;
+			return false;
+		}
+	}
+
+	double scaleX, scaleY;
+	nv::GetFitScale(videoWidth, videoHeight, param.viewWidth, param.viewHeight, scaleX, scaleY);
+	auto columns = param.scaleWeights.Get(param.scaleFilter, videoWidth, param.viewWidth, scaleX);
+	auto rows = param.scaleWeights.Get(param.scaleFilter, videoHeight, param.viewHeight, scaleY);
+	if (columns != param.columnWeights) {
+		param.columnWeights = CreateScaleWeightView(device, *columns, param.columnWeightSrv) ? columns : nullptr;
+		param.isScaleValid = false;
+		rc.AddCreations(2);
+	}
+	if (rows != param.rowWeights) {
+		param.rowWeights = CreateScaleWeightView(device, *rows, param.rowWeightSrv) ? rows : nullptr;
+		rc.AddCreations(2);
+	}
+	return param.columnWeights && param.rowWeights;
+}
+
+// 两遍缩放的前两步：按原大小转成 RGB，再横向缩放到视图宽度
+// 先换渲染目标再绑着色器资源，同一个纹理同时绑成两者时 D3D 会悄悄解绑着色器资源，缓存里记的就不对了
+void DrawScalePasses(ScenceParam& param, int videoWidth, int videoHeight) {
+	auto& rc = *param.renderCache;
+	auto indicesSize = std::size(param.indices);
+	rc.SetConstantBuffer(nv::ShaderStage::Vertex, 0, param.pConstantBufferSub.Get());
+
+	rc.SetRenderTarget(rc.GetRenderTarget(param.scaleSource.Get()));
+	rc.SetViewport(videoWidth, videoHeight);
+	bool isToneMapped = param.toneMapper != nullptr;
+	rc.SetShader(nv::ShaderStage::Pixel, isToneMapped ? param.pPixelShader_ToneMap.Get() : param.pPixelShader.Get());
+	rc.SetShaderResource(0, param.planeViews[0].Get());
+	rc.SetShaderResource(1, param.planeViews[1].Get());
+	rc.SetShaderResource(3, param.planeViews[2].Get());
+	rc.SetSampler(0, param.pSampler.Get());
+	if (isToneMapped) {
+		rc.SetShaderResource(2, param.lutSrv.Get());
+		rc.SetSampler(1, param.pLutSampler.Get());
+	}
+	rc.SetConstantBuffer(nv::ShaderStage::Pixel, 0, param.pColorConstantBuffer.Get());
+	rc.SetConstantBuffer(nv::ShaderStage::Pixel, 1, nullptr);
+	rc.SetBlendState(nullptr);
+	rc.DrawIndexed(indicesSize);
+
+	rc.SetRenderTarget(rc.GetRenderTarget(param.scaleTemp.Get()));
+	rc.SetViewport(param.viewWidth, videoHeight);
+	rc.SetShader(nv::ShaderStage::Pixel, param.pPixelShader_ScaleH.Get());
+	rc.SetShaderResource(0, param.scaleSourceSrv.Get());
+	rc.SetShaderResource(1, param.columnWeightSrv.Get());
+	rc.DrawIndexed(indicesSize);
+}
+
+// 只在有层变了的时候合成，返回 false 表示这次什么都没画，不用 Present
+bool Draw(
 	ID3D11Device* device, ID3D11DeviceContext* ctx, IDXGISwapChain3* swapchain,
 	ScenceParam& param, DecoderParam& decoderParam
 ) {
@@ -684,98 +1613,374 @@ void Draw(
 		param.triggerFullScreen = false;
 
 		SwitchFullScreen(swapchain, param);
+		param.damage = { true, true, true };
 	}
-	// Ҫʱ´Ļ
-	DXGI_SWAP_CHAIN_DESC swapDesc;
-	swapchain->GetDesc(&swapDesc);
-	auto& bufferDesc = swapDesc.BufferDesc;
-	if (bufferDesc.Width != param.viewWidth || bufferDesc.Height != param.viewHeight) {
-		swapchain->ResizeBuffers(swapDesc.BufferCount, param.viewWidth, param.viewHeight, bufferDesc.Format, swapDesc.Flags);
+	auto& rc = *param.renderCache;
+	auto& damage = param.damage;
+
+	// 必要时重新创建交换链和字幕纹理
+	if (!param.backBuffer || param.backBufferWidth != param.viewWidth || param.backBufferHeight != param.viewHeight) {
+		// ResizeBuffers 要求后台缓冲没有任何引用
+		rc.ReleaseRenderTargets();
+		param.backBuffer = nullptr;
+
+		DXGI_SWAP_CHAIN_DESC swapDesc;
+		swapchain->GetDesc(&swapDesc);
+		auto& bufferDesc = swapDesc.BufferDesc;
+		if (bufferDesc.Width != param.viewWidth || bufferDesc.Height != param.viewHeight) {
+			swapchain->ResizeBuffers(swapDesc.BufferCount, param.viewWidth, param.viewHeight, bufferDesc.Format, swapDesc.Flags);
+
+			CreateSubTexture(device, param.viewWidth, param.viewHeight, &param.subTexture, &param.subSrv);
+			CreateD2DRenderTarget(param.d2dfa.Get(), param.subTexture.Get(), &param.d2drt);
+			CreateTextFormat(param.m_pDWriteFactory.Get(), param.viewHeight, &param.textFormat);
+			param.textRenderer = new DWriteColorTextRenderer::CustomTextRenderer(param.d2dfa, param.d2drt);
+			rc.AddCreations(2);
+			param.isSubtitleLayerValid = false;
+			param.subtitleLayerTexts.clear();
+		}
 
-		CreateSubTexture(device, param.viewWidth, param.viewHeight, &param.subTexture, &param.subSrv);
-		CreateD2DRenderTarget(param.d2dfa.Get(), param.subTexture.Get(), &param.d2drt);
-		CreateTextFormat(param.m_pDWriteFactory.Get(), param.viewHeight, &param.textFormat);
-		param.textRenderer = new DWriteColorTextRenderer::CustomTextRenderer(param.d2dfa, param.d2drt);
+		swapchain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&param.backBuffer);
+		if (param.d3dCapture) {
+			param.d3dCapture->SetSource(param.backBuffer.Get());
+		}
+		param.backBufferWidth = param.viewWidth;
+		param.backBufferHeight = param.viewHeight;
+		// 旧的字幕纹理可能还绑在管线上
+		rc.Invalidate();
+		damage = { true, true, true };
 	}
 
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0u;
-	ID3D11Buffer* vertexBuffers[] = { param.pVertexBuffer.Get() };
-	ctx->IASetVertexBuffers(0, 1, vertexBuffers, &stride, &offset);
+	DrawImgui(device, ctx, swapchain, param, decoderParam);
+	auto drawData = ImGui::GetDrawData();
+	auto uiHash = HashDrawData(drawData);
+	if (uiHash != param.uiHash) {
+		param.uiHash = uiHash;
+		damage.ui = true;
+	}
 
-	ctx->IASetIndexBuffer(param.pIndexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+	if (!damage.video && !damage.subtitle && !damage.ui && !param.isAlwaysComposite) {
+		return false;
+	}
+	bool isVideoChanged = damage.video;
+	damage = {};
+	rc.BeginFrame();
+
+	rc.SetVertexBuffer(param.pVertexBuffer.Get(), sizeof(Vertex));
+	rc.SetIndexBuffer(param.pIndexBuffer.Get());
+	rc.SetInputLayout(param.pInputLayout.Get());
+	rc.SetShader(nv::ShaderStage::Vertex, param.pVertexShader.Get());
+
+	bool hasVideo = decoderParam.vcodecCtx != nullptr;
+	bool isGpuVideo = hasVideo && !param.softwareRenderer;
+
+	// 第一帧出来之前按解码器的大小
+	int videoWidth = param.videoRect.width > 0 ? param.videoRect.width : decoderParam.width;
+	int videoHeight = param.videoRect.height > 0 ? param.videoRect.height : decoderParam.height;
+
+	// 只在视频变了的时候计时，界面单独重画时不会有新的结果，显示的数字不会自己引起重画
+	bool isTimed = isGpuVideo && isVideoChanged;
+	if (isTimed) {
+		param.scaleTimer->Begin();
+	}
 
-	ctx->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY::D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	bool isScaled = isGpuVideo && param.scaleFilter != nv::ScaleFilter::Bilinear
+		&& PrepareScaleTargets(device, param, videoWidth, videoHeight);
+	if (isScaled && (isVideoChanged || !param.isScaleValid)) {
+		DrawScalePasses(param, videoWidth, videoHeight);
+		param.isScaleValid = true;
+	}
 
-	ctx->IASetInputLayout(param.pInputLayout.Get());
+	if (isGpuVideo) {
+		FitQuadSize(rc, param.pConstantBuffer.Get(), videoWidth, videoHeight, param.viewWidth, param.viewHeight);
+	}
+	rc.SetConstantBuffer(nv::ShaderStage::Vertex, 0, param.pConstantBuffer.Get());
 
-	FitQuadSize(ctx, param.pConstantBuffer.Get(), decoderParam.width, decoderParam.height, param.viewWidth, param.viewHeight);
-	ID3D11Buffer* cbs[] = { param.pConstantBuffer.Get() };
-	ctx->VSSetConstantBuffers(0, 1, cbs);
+	// 输出合并
+	auto rtv = rc.GetRenderTarget(param.backBuffer.Get());
+	rc.SetRenderTarget(rtv);
+	rc.SetBlendState(nullptr);
 
-	ctx->VSSetShader(param.pVertexShader.Get(), 0, 0);
+	const FLOAT black[] = { 0, 0, 0, 1 };
+	rc.ClearRenderTarget(rtv, black);
 
-	// դ
-	D3D11_VIEWPORT viewPort = {};
-	viewPort.TopLeftX = 0;
-	viewPort.TopLeftY = 0;
-	viewPort.Width = param.viewWidth;
-	viewPort.Height = param.viewHeight;
-	viewPort.MaxDepth = 1;
-	viewPort.MinDepth = 0;
-	ctx->RSSetViewports(1, &viewPort);
+	// 光栅化
+	rc.SetViewport(param.viewWidth, param.viewHeight);
 
-	ctx->PSSetShader(param.pPixelShader.Get(), 0, 0);
+	if (isScaled) {
+		rc.SetShader(nv::ShaderStage::Pixel, param.pPixelShader_ScaleV.Get());
+		rc.SetShaderResource(0, param.scaleTempSrv.Get());
+		rc.SetShaderResource(1, param.rowWeightSrv.Get());
+		rc.SetSampler(0, param.pSampler.Get());
+	}
+	else {
+		bool isToneMapped = param.toneMapper != nullptr;
+		rc.SetShader(nv::ShaderStage::Pixel, isToneMapped ? param.pPixelShader_ToneMap.Get() : param.pPixelShader.Get());
+		rc.SetShaderResource(0, param.planeViews[0].Get());
+		rc.SetShaderResource(1, param.planeViews[1].Get());
+		rc.SetShaderResource(3, param.planeViews[2].Get());
+		rc.SetSampler(0, param.pSampler.Get());
+		if (isToneMapped) {
+			rc.SetShaderResource(2, param.lutSrv.Get());
+			rc.SetSampler(1, param.pLutSampler.Get());
+		}
+		rc.SetConstantBuffer(nv::ShaderStage::Pixel, 0, param.pColorConstantBuffer.Get());
+	}
+	if (isGpuVideo) {
+		rc.SetConstantBuffer(nv::ShaderStage::Pixel, 1, param.ditherConstantBuffer.Get());
+		rc.SetShaderResource(4, param.ditherMatrixSrv.Get());
+	}
 
-	ID3D11ShaderResourceView* srvs[] = { param.srvY.Get(), param.srvUV.Get() };
-	ctx->PSSetShaderResources(0, std::size(srvs), srvs);
+	// 纯音频时只画界面
+	if (hasVideo && param.softwareRenderer) {
+		DrawSoftwareFrame(device, ctx, param);
+	}
+	else if (hasVideo) {
+		// Draw Call
+		auto indicesSize = std::size(param.indices);
+		rc.DrawIndexed(indicesSize);
+		if (isTimed) {
+			param.scaleTimer->End();
+		}
 
-	ID3D11SamplerState* samplers[] = { param.pSampler.Get() };
-	ctx->PSSetSamplers(0, 1, samplers);
+		// Draw subTexture，没有字幕时字幕层是全透明的，不用画
+		if (!param.subtitleLayerTexts.empty()) {
+			rc.SetBlendState(param.blendState.Get());
+			rc.SetConstantBuffer(nv::ShaderStage::Vertex, 0, param.pConstantBufferSub.Get());
+			rc.SetShader(nv::ShaderStage::Pixel, param.pPixelShader_Subtitle.Get());
+			rc.SetShaderResource(0, param.subSrv.Get());
+			rc.DrawIndexed(indicesSize);
+		}
+	}
 
-	// ϲ
-	ComPtr<ID3D11Texture2D> backBuffer;
-	swapchain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&backBuffer);
+	if (param.isCaptureRequested) {
+		param.isCaptureRequested = false;
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), "_%.3f", decoderParam.currentSecond);
+		param.frameCapture->Capture(param.capturePrefix + suffix);
+	}
 
-	D3D11_TEXTURE2D_DESC backDesc;
-	backBuffer->GetDesc(&backDesc);
+	ImGui_ImplDX11_RenderDrawData(drawData);
+	return true;
+}
 
-	CD3D11_RENDER_TARGET_VIEW_DESC renderTargetViewDesc(D3D11_RTV_DIMENSION_TEXTURE2D, backDesc.Format);
-	ComPtr<ID3D11RenderTargetView>  rtv;
-	device->CreateRenderTargetView(backBuffer.Get(), &renderTargetViewDesc, &rtv);
-	ID3D11RenderTargetView* rtvs[] = { rtv.Get() };
-	ctx->OMSetRenderTargets(1, rtvs, nullptr);
+// 平面在着色器里的格式，按每个像素的通道数和每个通道的字节数选
+DXGI_FORMAT GetPlaneViewFormat(const nv::PlaneDesc& plane) {
+	static const std::map<std::pair<int, int>, DXGI_FORMAT> planeFormatMap = {
+		{ { 1, 1 }, DXGI_FORMAT_R8_UNORM },
+		{ { 2, 1 }, DXGI_FORMAT_R8G8_UNORM },
+		{ { 4, 1 }, DXGI_FORMAT_R8G8B8A8_UNORM },
+		{ { 1, 2 }, DXGI_FORMAT_R16_UNORM },
+		{ { 2, 2 }, DXGI_FORMAT_R16G16_UNORM },
+		{ { 4, 2 }, DXGI_FORMAT_R16G16B16A16_UNORM },
+	};
 
-	const FLOAT black[] = { 0, 0, 0, 1 };
-	ctx->ClearRenderTargetView(rtv.Get(), black);
+	auto it = planeFormatMap.find({ plane.channels, plane.bytesPerChannel });
+	return it == planeFormatMap.end() ? DXGI_FORMAT_UNKNOWN : it->second;
+}
 
-	// Draw Call
-	auto indicesSize = std::size(param.indices);
-	ctx->DrawIndexed(indicesSize, 0, 0);
+// 为 NV12、P010 这类多平面纹理的每个平面建着色器资源，D3D 按视图的格式选平面。arraySlice 为 -1 时是普通的二维纹理
+bool CreatePlaneViews(ID3D11Device* device, ID3D11Texture2D* texture, int arraySlice, const nv::PixelFormatDesc& format, PlaneViews& views) {
+	PlaneViews result;
+	for (int i = 0; i < format.planeCount; i++) {
+		auto viewFormat = GetPlaneViewFormat(format.planes[i]);
+		auto desc = arraySlice < 0
+			? CD3D11_SHADER_RESOURCE_VIEW_DESC(texture, D3D11_SRV_DIMENSION_TEXTURE2D, viewFormat)
+			: CD3D11_SHADER_RESOURCE_VIEW_DESC(texture, D3D11_SRV_DIMENSION_TEXTURE2DARRAY, viewFormat, 0, 1, arraySlice, 1);
+		if (viewFormat == DXGI_FORMAT_UNKNOWN || FAILED(device->CreateShaderResourceView(texture, &desc, &result[i]))) {
+			return false;
+		}
+	}
 
-	// Set BlendState
-	ctx->OMSetBlendState(param.blendState.Get(), 0, 0xFFFFFFFF);
+	views = result;
+	return true;
+}
 
-	// Draw subTexture
-	ID3D11ShaderResourceView* srvs2[] = { param.subSrv.Get() };
-	ID3D11Buffer* cbs2[] = { param.pConstantBufferSub.Get() };
-	ctx->VSSetConstantBuffers(0, 1, cbs2);
-	ctx->PSSetShader(param.pPixelShader_Subtitle.Get(), 0, 0);
-	ctx->PSSetShaderResources(0, std::size(srvs2), srvs2);
-	ctx->DrawIndexed(indicesSize, 0, 0);
+// 让 planeViews 指向解码器纹理数组的第 index 层，纹理数组不能当着色器资源时返回 false
+bool BindVideoSlice(ID3D11Device* device, ID3D11Texture2D* texture, int index, const nv::PixelFormatDesc& format, ScenceParam& param) {
+	if (texture != param.sliceTexture) {
+		param.sliceViews.clear();
+		param.sliceTexture = texture;
+	}
 
-	DrawImgui(device, ctx, swapchain, param, decoderParam);
+	auto it = param.sliceViews.find(index);
+	if (it == param.sliceViews.end()) {
+		D3D11_TEXTURE2D_DESC tdesc;
+		texture->GetDesc(&tdesc);
+		PlaneViews views;
+		if (!(tdesc.BindFlags & D3D11_BIND_SHADER_RESOURCE) || !CreatePlaneViews(device, texture, index, format, views)) {
+			param.sliceTexture = nullptr;
+			return false;
+		}
+
+		param.renderCache->AddCreations(format.planeCount);
+		it = param.sliceViews.emplace(index, views).first;
+	}
+
+	param.planeViews = it->second;
+	param.frameSource = "zero-copy";
+	return true;
+}
+
+// 解码器纹理不能直接采样时整层拷贝到和它同格式、同大小的 texture
+bool CopyVideoTexture(ID3D11Device* device, ID3D11DeviceContext* ctx, const AVFrame* frame, const nv::PixelFormatDesc& format, ScenceParam& param) {
+	auto frameTexture = (ID3D11Texture2D*)frame->data[0];
+	int index = (int)(intptr_t)frame->data[1];
+
+	D3D11_TEXTURE2D_DESC frameDesc;
+	frameTexture->GetDesc(&frameDesc);
+
+	D3D11_TEXTURE2D_DESC tdesc = {};
+	if (param.texture) {
+		param.texture->GetDesc(&tdesc);
+	}
+	if (!param.texture || tdesc.Format != frameDesc.Format || tdesc.Width != frameDesc.Width || tdesc.Height != frameDesc.Height) {
+		tdesc = {};
+		tdesc.Format = frameDesc.Format;
+		tdesc.Usage = D3D11_USAGE_DEFAULT;
+		tdesc.ArraySize = 1;
+		tdesc.MipLevels = 1;
+		tdesc.SampleDesc = { 1, 0 };
+		tdesc.Width = frameDesc.Width;
+		tdesc.Height = frameDesc.Height;
+		tdesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		param.texture = nullptr;
+		if (FAILED(device->CreateTexture2D(&tdesc, nullptr, &param.texture)) || !CreatePlaneViews(device, param.texture.Get(), -1, format, param.textureViews)) {
+			param.texture = nullptr;
+			return false;
+		}
+		param.renderCache->AddCreations(1 + format.planeCount);
+	}
+
+	ctx->CopySubresourceRegion(param.texture.Get(), 0, 0, 0, 0, frameTexture, index, 0);
+	param.planeViews = param.textureViews;
+	param.frameSource = "copy";
+	return true;
+}
+
+// 软件解码的帧每个平面上传到一张纹理，纹理的格式和大小按平面布局来
+bool UploadVideoPlanes(ID3D11Device* device, ID3D11DeviceContext* ctx, const AVFrame* frame, const nv::PixelFormatDesc& format, ScenceParam& param) {
+	PlaneViews views;
+	for (int i = 0; i < format.planeCount; i++) {
+		// 倒着存的帧（行距为负）不支持
+		if (frame->linesize[i] <= 0) {
+			return false;
+		}
+
+		auto& texture = param.planeTextures[i];
+		auto viewFormat = GetPlaneViewFormat(format.planes[i]);
+		UINT width = nv::GetPlaneWidth(format, i, frame->width);
+		UINT height = nv::GetPlaneHeight(format, i, frame->height);
+
+		D3D11_TEXTURE2D_DESC tdesc = {};
+		if (texture) {
+			texture->GetDesc(&tdesc);
+		}
+		if (!texture || tdesc.Format != viewFormat || tdesc.Width != width || tdesc.Height != height) {
+			tdesc = {};
+			tdesc.Format = viewFormat;
+			tdesc.Usage = D3D11_USAGE_DEFAULT;
+			tdesc.ArraySize = 1;
+			tdesc.MipLevels = 1;
+			tdesc.SampleDesc = { 1, 0 };
+			tdesc.Width = width;
+			tdesc.Height = height;
+			tdesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+			texture = nullptr;
+			param.planeTextureViews[i] = nullptr;
+			if (viewFormat == DXGI_FORMAT_UNKNOWN || FAILED(device->CreateTexture2D(&tdesc, nullptr, &texture))
+				|| FAILED(device->CreateShaderResourceView(texture.Get(), nullptr, &param.planeTextureViews[i]))) {
+				texture = nullptr;
+				return false;
+			}
+			param.renderCache->AddCreations(2);
+		}
+
+		ctx->UpdateSubresource(texture.Get(), 0, nullptr, frame->data[i], frame->linesize[i], 0);
+		views[i] = param.planeTextureViews[i];
+	}
+
+	param.planeViews = views;
+	param.frameSource = "upload";
+	return true;
+}
+
+// 轮到检测时看一眼帧的亮度，系统内存里的帧直接看，硬件解码的帧拷出来过两帧再看
+// 返回这一帧要显示的部分
+nv::CropRect DetectVideoCrop(const AVFrame* frame, ScenceParam& param) {
+	auto& detector = param.cropDetector;
+	if (!param.isAutoCropEnabled) {
+		return { 0, 0, frame->width, frame->height };
+	}
+
+	nv::PixelFormatDesc format;
+	if (frame->format == AV_PIX_FMT_D3D11 && param.lumaReadback && nv::GetPixelFormatDesc(nv::GetFramePixelFormat(frame), format)) {
+		param.lumaReadback->Poll([&](const nv::LumaPlane& plane) {
+			detector.Update(plane, frame->color_range);
+		});
+		if (detector.IsDue()) {
+			param.lumaReadback->Request((ID3D11Texture2D*)frame->data[0], (int)(intptr_t)frame->data[1], format, frame->width, frame->height);
+		}
+	}
+	else if (detector.IsDue()) {
+		nv::LumaPlane plane;
+		if (nv::GetLumaPlane(frame, plane)) {
+			detector.Update(plane, frame->color_range);
+		}
+	}
+	return detector.GetCrop(frame->width, frame->height);
 }
 
-void UpdateVideoTexture(AVFrame* frame, ID3D11Texture2D* texture, ID3D11DeviceContext* deviceCtx) {
-	ID3D11Texture2D* t_frame = (ID3D11Texture2D*)frame->data[0];
-	int t_index = (int)frame->data[1];
+// 换上队列的当前帧：解码器纹理能直接采样就只换着色器资源，否则拷贝；软件解码的帧按平面上传
+// 像素格式不支持时保留上一帧
+void ShowVideoFrame(ID3D11Device* device, ID3D11DeviceContext* ctx, ScenceParam& param) {
+	auto frame = param.frameQueue->GetCurrent();
+	nv::PixelFormatDesc format;
+	if (!frame || !nv::GetPixelFormatDesc(nv::GetFramePixelFormat(frame), format)) {
+		return;
+	}
 
-	deviceCtx->CopySubresourceRegion(texture, 0, 0, 0, 0, t_frame, t_index, 0);
+	int textureWidth = frame->width, textureHeight = frame->height;
+	bool isShown;
+	if (frame->format == AV_PIX_FMT_D3D11) {
+		auto texture = (ID3D11Texture2D*)frame->data[0];
+		int index = (int)(intptr_t)frame->data[1];
+		isShown = BindVideoSlice(device, texture, index, format, param) || CopyVideoTexture(device, ctx, frame, format, param);
+
+		D3D11_TEXTURE2D_DESC tdesc;
+		texture->GetDesc(&tdesc);
+		textureWidth = tdesc.Width;
+		textureHeight = tdesc.Height;
+	}
+	else {
+		isShown = UploadVideoPlanes(device, ctx, frame, format, param);
+	}
+
+	if (isShown) {
+		auto& rect = param.videoRect;
+		rect = DetectVideoCrop(frame, param);
+		const float texRect[4] = { (float)rect.x / textureWidth, (float)rect.y / textureHeight, (float)rect.width / textureWidth, (float)rect.height / textureHeight };
+		UpdateColorConstants(frame, format, texRect, param);
+		UpdateToneMapLut(device, frame, param);
+	}
 }
 
 void UpdateSubtitlesTexture(ScenceParam& param) {
+	// 要显示的字幕和字幕层上已经画好的一样时不用重画
+	auto& subtitles = param.subtitles;
+	subtitles.remove_if([](const Subtitle& sub) { return sub.timeleft <= 0; });
 
+	vector<wstring> texts;
+	for (auto& sub : subtitles) {
+		texts.push_back(sub.text);
+	}
+	if (param.isSubtitleLayerValid && texts == param.subtitleLayerTexts) {
+		return;
+	}
+	param.isSubtitleLayerValid = true;
+	param.subtitleLayerTexts = texts;
+	param.damage.subtitle = true;
 
 	auto& d2drt = param.d2drt;
 	d2drt->BeginDraw();
@@ -784,24 +1989,16 @@ void UpdateSubtitlesTexture(ScenceParam& param) {
 	ComPtr<ID2D1SolidColorBrush> brushWhite;
 	param.d2drt->CreateSolidColorBrush(D2D1::ColorF(1, 1, 1, 1), &brushWhite);
 
-	auto& subtitles = param.subtitles;
-	for (auto i = subtitles.begin(); i != subtitles.end();) {
-		auto& sub = *i;
-		if (sub.timeleft <= 0) {
-			subtitles.erase(i++);
-		}
-		else {
-			auto pos = D2D1::RectF(0, 0, param.viewWidth, param.viewHeight);
-			wstring& text = sub.text;
-			
-			ComPtr<IDWriteTextLayout> textLayout;
-			param.m_pDWriteFactory->CreateTextLayout(text.c_str(), text.size(), param.textFormat.Get(), param.viewWidth, param.viewHeight, &textLayout);
+	for (auto& text : texts) {
+		ComPtr<IDWriteTextLayout> textLayout;
+		param.m_pDWriteFactory->CreateTextLayout(text.c_str(), text.size(), param.textFormat.Get(), param.viewWidth, param.viewHeight, &textLayout);
 
-			textLayout->Draw(0, param.textRenderer.Get(), 0, 0);
-			i++;
-		}
+		textLayout->Draw(0, param.textRenderer.Get(), 0, 0);
 	}
 	d2drt->EndDraw();
+
+	// D2D 在同一个设备上画，字幕纹理作为渲染目标时会被解除着色器资源的绑定
+	param.renderCache->Invalidate();
 }
 
 void AddSubtitles(DecoderParam& param, AVSubtitle& sub, double pts, double duration) {
@@ -831,6 +2028,209 @@ double GetFrameFreq(const DecoderParam& param) {
 	}
 }
 
+uint64_t GetProcessCpuTime() {
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime);
+	auto toUInt64 = [](FILETIME t) { return ((uint64_t)t.dwHighDateTime << 32) | t.dwLowDateTime; };
+	return toUInt64(kernelTime) + toUInt64(userTime);
+}
+
+// 合成并 Present 一次调用一次
+void CountComposite(LoopStats& stats) {
+	stats.composites++;
+}
+
+// 主循环每醒来一次调用一次，每秒结算一次
+void UpdateLoopStats(LoopStats& stats) {
+	stats.wakeups++;
+
+	auto now = steady_clock::now();
+	double elapsed = duration<double>(now - stats.windowStart).count();
+	if (elapsed >= 1) {
+		auto cpuTime = GetProcessCpuTime();
+		if (stats.windowCpuTime != 0) {
+			stats.wakeupsPerSecond = stats.wakeups / elapsed;
+			stats.cpuPercent = (cpuTime - stats.windowCpuTime) / 1e7 / elapsed * 100;
+			stats.compositePercent = stats.composites * 100.0 / (elapsed * stats.displayFreq);
+		}
+		stats.wakeups = 0;
+		stats.composites = 0;
+		stats.windowStart = now;
+		stats.windowCpuTime = cpuTime;
+	}
+}
+
+void WriteAudioFrame(DecoderParam& param, AVFrame* frame) {
+	auto timestamp = frame->best_effort_timestamp;
+	double pts = timestamp == AV_NOPTS_VALUE ? -1 : std::max(timestamp * param.audioTimeBase - param.startSecond, 0.0);
+	param.audioPlayer->Write(frame->extended_data, (AVSampleFormat)frame->format, frame->channels, frame->channel_layout, frame->nb_samples, pts);
+}
+
+// 解码到下一个视频帧放进队列，中间遇到的音频和字幕照常处理，文件读完了返回 false
+bool DecodeVideoFrame(DecoderParam& param, nv::FrameQueue& queue) {
+	while (1) {
+		auto mediaFrame = RequestFrame(param);
+		auto& frame = mediaFrame.frame;
+
+		if (mediaFrame.type == AVMEDIA_TYPE_UNKNOWN) {
+			return false;
+		}
+
+		bool isVideo = mediaFrame.type == AVMEDIA_TYPE_VIDEO;
+		if (isVideo) {
+			queue.Push(frame);
+		}
+		else if (mediaFrame.type == AVMEDIA_TYPE_AUDIO) {
+			// 拖动中的声音由 UpdateScrubAudio 负责
+			if (!param.isScrubbing) {
+				WriteAudioFrame(param, frame);
+			}
+		}
+		else if (mediaFrame.type == AVMEDIA_TYPE_SUBTITLE) {
+			AddSubtitles(param, mediaFrame.sub, mediaFrame.pts, mediaFrame.duration);
+			avsubtitle_free(&mediaFrame.sub);
+		}
+
+		av_frame_free(&frame);
+
+		if (isVideo) {
+			return true;
+		}
+	}
+}
+
+// 取走所有窗口消息，收到 WM_QUIT 返回 false。输入之后多画几帧，让 ImGui 的悬停、拖动状态跟上
+bool DispatchMessages(nv::LoopScheduler& scheduler) {
+	MSG msg;
+	bool isQuit = false;
+	bool hasInput = false;
+	while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+		if (msg.message == WM_QUIT) {
+			isQuit = true;
+		}
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+		hasInput = true;
+	}
+
+	if (hasInput) {
+		scheduler.RequestFrames(3);
+	}
+	return !isQuit;
+}
+
+// 等交换链能再排一帧，之后 Present 不会阻塞，Present 的画面在 PresentClock::GetLatency 之后出现在屏幕上
+// 等到的名额一直留到真的 Present，没有要合成的东西时也不会浪费。超时（比如窗口被遮住）就照常往下走
+void WaitForPresentReady(ScenceParam& param) {
+	constexpr double presentWaitTimeout = 0.1;
+	param.presentTarget->WaitForReady(presentWaitTimeout);
+	param.presentClock->Update();
+}
+
+// 只在有层变了的时候合成并 Present，now 是决定画面内容的时间，用来测延迟
+// 抓图的回读按醒来的次数算，还有没读回来的时候 scheduler 不让主循环睡下去
+void Composite(ID3D11Device* device, ID3D11DeviceContext* ctx, IDXGISwapChain3* swapchain, ScenceParam& param, DecoderParam& decoderParam, nv::LoopScheduler& scheduler, double now) {
+	param.frameCapture->Poll();
+	if (param.frameCapture->IsPending()) {
+		scheduler.RequestFrames(1);
+	}
+
+	if (param.viewWidth <= 0 || param.viewHeight <= 0) {
+		return;
+	}
+
+	if (Draw(device, ctx, swapchain, param, decoderParam)) {
+		param.presentClock->Present(now);
+		CountComposite(param.loopStats);
+	}
+}
+
+// 控件在鼠标停下 hideMouseDelay 之后隐藏，到时候要醒来重画
+void RequestWidgetsHide(nv::LoopWaiter& waiter, nv::LoopScheduler& scheduler, const DecoderParam& param) {
+	auto left = param.mouseStopTime + hideMouseDelay - system_clock::now();
+	if (left > 0s) {
+		scheduler.RequestAt(waiter.Now() + duration<double>(left + 50ms).count());
+	}
+}
+
+// 纯音频文件的主循环，不按屏幕刷新率空转，只在这几种情况下醒来：
+// 环形缓冲区降到低水位需要解码、有窗口消息、播放中每 250ms 刷新一次进度
+void RunAudioOnly(ID3D11Device* device, ID3D11DeviceContext* ctx, IDXGISwapChain3* swapchain, ScenceParam& scenceParam, DecoderParam& decoderParam) {
+	auto& audioPlayer = decoderParam.audioPlayer;
+	if (!audioPlayer) {
+		return;
+	}
+
+	int sampleRate = decoderParam.acodecCtx->sample_rate;
+	uint32_t lowWaterFrames = sampleRate / 4;
+	uint32_t highWaterFrames = sampleRate / 2;
+
+	// 自动复位，初始有信号，先把缓冲区填上
+	HANDLE needDataEvent = CreateEvent(NULL, FALSE, TRUE, NULL);
+	audioPlayer->SetNeedDataCallback([needDataEvent] { SetEvent(needDataEvent); }, lowWaterFrames);
+
+	nv::Win32LoopWaiter waiter;
+	waiter.AddEvent(needDataEvent);
+	nv::LoopScheduler scheduler(&waiter);
+
+	// 播放中定时刷新进度，画面没变时 Draw 不会合成
+	constexpr double uiInterval = 0.25;
+
+	while (1) {
+		scheduler.Wait();
+		UpdateLoopStats(scenceParam.loopStats);
+
+		if (!DispatchMessages(scheduler)) {
+			break;
+		}
+
+		WaitForPresentReady(scenceParam);
+		double now = waiter.Now();
+
+		if (decoderParam.isJumpProgress) {
+			decoderParam.isJumpProgress = false;
+			int64_t jumpTimeStamp = (decoderParam.currentSecond + decoderParam.startSecond) / decoderParam.audioTimeBase;
+			av_seek_frame(decoderParam.fmtCtx, decoderParam.audioStreamIndex, jumpTimeStamp, AVSEEK_FLAG_BACKWARD);
+			// 拖动中播放的是缓存里的颗粒，不能清掉
+			if (!decoderParam.isScrubbing) {
+				audioPlayer->Flush();
+			}
+		}
+
+		// 解码到高水位，文件读完了就等着。拖动中不解码
+		while (!decoderParam.isScrubbing && audioPlayer->GetBufferedFrames() < highWaterFrames) {
+			auto mediaFrame = RequestFrame(decoderParam);
+			if (mediaFrame.type == AVMEDIA_TYPE_UNKNOWN) {
+				break;
+			}
+			if (mediaFrame.type == AVMEDIA_TYPE_AUDIO) {
+				WriteAudioFrame(decoderParam, mediaFrame.frame);
+			}
+			else if (mediaFrame.type == AVMEDIA_TYPE_SUBTITLE) {
+				avsubtitle_free(&mediaFrame.sub);
+			}
+			av_frame_free(&mediaFrame.frame);
+		}
+
+		UpdateLoudnessGain(decoderParam);
+		UpdateScrubAudio(decoderParam);
+
+		double audioClock = audioPlayer->GetClock();
+		if (decoderParam.playStatus == 0 && !decoderParam.isScrubbing && audioClock >= 0) {
+			decoderParam.currentSecond = audioClock;
+		}
+
+		Composite(device, ctx, swapchain, scenceParam, decoderParam, scheduler, now);
+
+		if (decoderParam.playStatus == 0) {
+			scheduler.RequestAt(waiter.Now() + uiInterval);
+		}
+	}
+
+	audioPlayer->SetNeedDataCallback(nullptr, 0);
+	CloseHandle(needDataEvent);
+}
+
 int WINAPI WinMain(
 	_In_ HINSTANCE hInstance,
 	_In_opt_ HINSTANCE hPrevInstance,
@@ -905,11 +2305,13 @@ int WINAPI WinMain(
 	swapChainDesc.Stereo = FALSE;
 	swapChainDesc.SampleDesc = { 1, 0 };
 	swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	swapChainDesc.BufferCount = 2;
+	// 每次合成都重画所有层，不需要保留上一帧的内容；多一个缓冲给正在显示的那一帧
+	scenceParam.maxFrameLatency = GetRequestedFrameLatency();
+	swapChainDesc.BufferCount = scenceParam.maxFrameLatency + 1;
 	swapChainDesc.Scaling = DXGI_SCALING_STRETCH;
-	swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
+	swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
 	swapChainDesc.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED;
-	swapChainDesc.Flags = 0;
+	swapChainDesc.Flags = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
 
 	UINT flags = D3D11_CREATE_DEVICE_BGRA_SUPPORT;
 
@@ -933,8 +2335,8 @@ int WINAPI WinMain(
 	ComPtr<IDXGISwapChain3> swapChain3;
 	swapChain1->QueryInterface<IDXGISwapChain3>(&swapChain3);
 
-	ComPtr<IDXGISwapChain> swapchain;
-	swapChain1.As(&swapchain);
+	scenceParam.presentTarget = make_shared<nv::DxgiPresentTarget>(swapChain3.Get(), scenceParam.maxFrameLatency);
+	scenceParam.presentClock = make_shared<nv::PresentClock>(scenceParam.presentTarget.get());
 
 	// swapChain3->SetColorSpace1(DXGI_COLOR_SPACE_RGB_FULL_G2084_NONE_P2020);
 
@@ -953,112 +2355,161 @@ int WINAPI WinMain(
 
 	pIDXGIOutput1->FindClosestMatchingMode1(&modeDesc, &modeDesc, 0);
 	scenceParam.fullScreenModeDesc = modeDesc;
+	scenceParam.displayBitsPerColor = GetDisplayBitsPerColor(pIDXGIOutput.Get());
 
 	scenceParam.viewWidth = clientWidth;
 	scenceParam.viewHeight = clientHeight;
 
+	// 去掉视频文件的扩展名
+	auto nameStart = filePath.find_last_of("\\/");
+	auto extensionStart = filePath.rfind('.');
+	bool hasExtension = extensionStart != string::npos && (nameStart == string::npos || extensionStart > nameStart);
+	scenceParam.capturePrefix = hasExtension ? filePath.substr(0, extensionStart) : filePath;
+
 	auto imguiCtx = ImGui::CreateContext();
 	ImGui_ImplWin32_Init(window);
 
 	InitDecoder(filePath.c_str(), decoderParam, d3ddeivce.Get(), d3ddeviceCtx.Get());
 	InitScence(d3ddeivce.Get(), d3ddeviceCtx.Get(), scenceParam, decoderParam);
 
-	// Ļˢ
+	// 屏幕刷新率
 	auto displayFreq = (double)modeDesc.RefreshRate.Numerator / modeDesc.RefreshRate.Denominator;
 
-	// ¼Ļ˶֡
-	int displayCount = 1;
-	// ¼Ƶ˶֡
+	// 记录视频播放了多少帧
 	int frameCount = 1;
 
 	decoderParam.durationSecond = (double)fmtCtx->duration / AV_TIME_BASE;
-	auto videoTimeBase = fmtCtx->streams[decoderParam.videoStreamIndex]->time_base;
+	scenceParam.loopStats.displayFreq = displayFreq;
+
+	bool isAudioOnly = vcodecCtx == nullptr;
+	if (isAudioOnly) {
+		RunAudioOnly(d3ddeivce.Get(), d3ddeviceCtx.Get(), swapChain3.Get(), scenceParam, decoderParam);
+	}
+
+	AVRational videoTimeBase = isAudioOnly ? AVRational{ 1, 1 } : fmtCtx->streams[decoderParam.videoStreamIndex]->time_base;
 	double videoTimeBaseDouble = (double)videoTimeBase.num / videoTimeBase.den;
 
-	MSG msg;
-	while (1) {
-		BOOL hasMsg = PeekMessage(&msg, NULL, 0, 0, PM_REMOVE);
-		if (hasMsg) {
-			if (msg.message == WM_QUIT) {
-				break;
-			}
-			TranslateMessage(&msg);
-			DispatchMessage(&msg);
+	// 没有消息、没有到期的帧时一直睡，暂停中完全不醒
+	nv::Win32LoopWaiter waiter;
+	nv::LoopScheduler scheduler(&waiter);
+	// 记录屏幕呈现了多少帧
+	nv::DisplayClock displayClock(displayFreq);
+	displayClock.Reset(waiter.Now(), 1);
+	// 视频解码完了，播放中也不用再按帧醒来
+	bool isVideoEnd = false;
+
+	while (!isAudioOnly) {
+		scheduler.Wait();
+		UpdateLoopStats(scenceParam.loopStats);
+
+		if (!DispatchMessages(scheduler)) {
+			break;
 		}
-		else {
-			double frameFreq = GetFrameFreq(decoderParam);
-			double freqRatio = displayFreq / frameFreq;
-			double countRatio = (double)displayCount / frameCount;
-
-			while (frameCount == 1 || (freqRatio < countRatio && decoderParam.playStatus == 0)) {
-				if (decoderParam.isJumpProgress) {
-					decoderParam.isJumpProgress = false;
-					auto& current = decoderParam.currentSecond;
-					int64_t jumpTimeStamp = current / videoTimeBaseDouble;
-					av_seek_frame(fmtCtx, decoderParam.videoStreamIndex, jumpTimeStamp, 0);
-
-					frameCount = current * frameFreq;
-					displayCount = current * displayFreq;
-				}
 
-				auto mediaFrame = RequestFrame(decoderParam);
-				auto& frame = mediaFrame.frame;
+		// 这一轮选的帧要过 presentLatency 才出现在屏幕上，按那时的刷新次数选，画面和音频在屏幕上对齐
+		WaitForPresentReady(scenceParam);
+		double presentLatency = scenceParam.presentClock->GetLatency();
+		double now = waiter.Now();
+		if (decoderParam.playStatus == 0) {
+			displayClock.Resume(now);
+		}
+		else {
+			displayClock.Pause(now);
+		}
 
-				if (mediaFrame.type == AVMEDIA_TYPE_UNKNOWN) {
-					break;
+		double frameFreq = GetFrameFreq(decoderParam);
+		double freqRatio = displayFreq / frameFreq;
+		int displayCount = displayClock.GetCount(now + presentLatency);
+		double countRatio = (double)displayCount / frameCount;
+
+		while (frameCount == 1 || (freqRatio < countRatio && decoderParam.playStatus == 0)) {
+			if (decoderParam.isJumpProgress) {
+				decoderParam.isJumpProgress = false;
+				auto& current = decoderParam.currentSecond;
+				int64_t jumpTimeStamp = current / videoTimeBaseDouble;
+				av_seek_frame(fmtCtx, decoderParam.videoStreamIndex, jumpTimeStamp, 0);
+				scenceParam.frameQueue->Flush();
+				isVideoEnd = false;
+				// 拖动中播放的是缓存里的颗粒，不能清掉
+				if (!decoderParam.isScrubbing) {
+					decoderParam.audioPlayer->Flush();
 				}
 
-				if (mediaFrame.type == AVMEDIA_TYPE_VIDEO) {
-					frameCount++;
-					countRatio = (double)displayCount / frameCount;
-
-					decoderParam.currentSecond = frameCount / frameFreq;
+				frameCount = current * frameFreq;
+				displayCount = current * displayFreq;
+				displayClock.Reset(now, displayCount);
+			}
 
-					if (freqRatio >= countRatio) {
-						UpdateVideoTexture(frame, scenceParam.texture.Get(), d3ddeviceCtx.Get());
-						
-						int isChange = 0;
-						
-						SetSubtitlesNextState(scenceParam.subtitles, 1 / frameFreq);
-						UpdateSubtitlesTexture(scenceParam);
-					}
-				}
-				else if (mediaFrame.type == AVMEDIA_TYPE_AUDIO) {
-					if (frame->format == AV_SAMPLE_FMT_FLTP) {
-						decoderParam.audioPlayer->WriteFLTP((float*)frame->data[0], (float*)frame->data[1], frame->nb_samples);
-					}
-					else if (frame->format == AV_SAMPLE_FMT_S16) {
-						decoderParam.audioPlayer->WriteS16((short*)frame->data[0], frame->nb_samples);
-					}
-				}
-				else if (mediaFrame.type == AVMEDIA_TYPE_SUBTITLE) {
-					auto& sub = mediaFrame.sub;
-					auto& duration = mediaFrame.duration;
-					auto& pts = mediaFrame.pts;
-					AddSubtitles(decoderParam, sub, pts, duration);
-					avsubtitle_free(&sub);
-				}
+			auto& frameQueue = *scenceParam.frameQueue;
+			if (frameQueue.GetSize() == 0 && !DecodeVideoFrame(decoderParam, frameQueue)) {
+				isVideoEnd = true;
+				break;
+			}
 
-				av_frame_free(&mediaFrame.frame);
+			// 被跳过的帧也要先换成当前帧，把上一帧占着的解码器纹理还回去，所以当前帧总是要显示的那一帧
+			frameQueue.Pop();
+			if (!scenceParam.duplicateDetector.IsDuplicate(frameQueue.GetCurrent())) {
+				scenceParam.isFrameDirty = true;
+				scenceParam.damage.video = true;
 			}
+			frameCount++;
+			countRatio = (double)displayCount / frameCount;
+
+			decoderParam.currentSecond = frameCount / frameFreq;
 
-			if (scenceParam.viewWidth > 0 && scenceParam.viewHeight > 0) {
-				Draw(d3ddeivce.Get(), d3ddeviceCtx.Get(), swapChain3.Get(), scenceParam, decoderParam);
+			if (freqRatio >= countRatio) {
+				SetSubtitlesNextState(scenceParam.subtitles, 1 / frameFreq);
+				UpdateSubtitlesTexture(scenceParam);
 			}
-			
+		}
 
-			// pIDXGIOutput1->WaitForVBlank();
-			swapchain->Present(1, 0);
+		if (scenceParam.isFrameDirty && !scenceParam.softwareRenderer) {
+			scenceParam.isFrameDirty = false;
+			ShowVideoFrame(d3ddeivce.Get(), d3ddeviceCtx.Get(), scenceParam);
+		}
+
+		UpdateLoudnessGain(decoderParam);
+		UpdateScrubAudio(decoderParam);
 
-			if (decoderParam.playStatus == 0) {
-				displayCount++;
+		// 没有合成时不 Present，屏幕上留着上一帧
+		Composite(d3ddeivce.Get(), d3ddeviceCtx.Get(), swapChain3.Get(), scenceParam, decoderParam, scheduler, now);
+
+		// 趁等下一帧的空闲把队列解码满，音频也跟着解码出来写进环形缓冲区
+		while (!scenceParam.frameQueue->IsFull() && DecodeVideoFrame(decoderParam, *scenceParam.frameQueue)) {
+		}
+
+		RequestWidgetsHide(waiter, scheduler, decoderParam);
+
+		if (decoderParam.playStatus == 0) {
+			// 界面上刚点了播放
+			now = waiter.Now();
+			displayClock.Resume(now);
+
+			// 以音频时钟（已扣除输出延迟）为准校正画面进度，偏差超过两次刷新才调整，避免来回抖动
+			double audioClock = decoderParam.audioPlayer ? decoderParam.audioPlayer->GetClock() : -1;
+			if (audioClock >= 0) {
+				int audioDisplayCount = audioClock * displayFreq;
+				if (abs(audioDisplayCount - displayClock.GetCount(now)) > 2) {
+					displayClock.Reset(now, audioDisplayCount);
+				}
+			}
+
+			// 下一帧到期的那次刷新：displayCount / frameCount 超过 freqRatio 时，提前一个延迟醒来画它
+			if (!isVideoEnd) {
+				int nextDisplayCount = (int)floor(frameCount * freqRatio) + 1;
+				scheduler.RequestAt(displayClock.GetTime(nextDisplayCount) - presentLatency);
 			}
 		}
 	}
 
+	// 还没读回、没写完的抓图
+	scenceParam.frameCapture->Flush();
+
 	ImGui_ImplDX11_Shutdown();
 	ImGui_ImplWin32_Shutdown();
 
+	// 队列里的帧引用着解码器的纹理，要先于解码器释放
+	scenceParam.frameQueue = nullptr;
 	ReleaseDecoder(decoderParam);
 
 	CoUninitialize();
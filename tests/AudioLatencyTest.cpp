@@ -0,0 +1,143 @@
+#include "Check.h"
+#include "AudioPlayer.h"
+#include "NullAudioSink.h"
+#include <math.h>
+#include <chrono>
+#include <thread>
+#include <functional>
+
+// 用手动推进时钟的 NullAudioSink 检查 AudioPlayer 的延迟统计：环形缓冲区 + 设备缓冲区 + 设备自身的延迟，以及由它算出来的音频时钟
+using namespace nv;
+
+namespace {
+	constexpr int sampleRate = 48000;
+	constexpr double streamLatency = 0.005;
+	constexpr double bufferSeconds = 0.02;
+
+	// 音频线程在自己的节奏里把数据从环形缓冲区搬到设备缓冲区，搬的中途两边都不算这部分。
+	// 时钟不动时结果是确定的，等音频线程搬完，最多等 2 秒
+	bool WaitUntil(const std::function<bool()>& condition) {
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+		while (!condition()) {
+			if (std::chrono::steady_clock::now() > deadline) {
+				return false;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return true;
+	}
+
+	// 误差不超过一帧
+	bool IsNear(double value, double expected) {
+		return fabs(value - expected) <= 1.0 / sampleRate;
+	}
+
+	void CheckLatency(AudioPlayer& player, double latency, double clock) {
+		if (!NV_CHECK(WaitUntil([&] { return IsNear(player.GetLatency(), latency) && IsNear(player.GetClock(), clock); }))) {
+			printf("  latency %.6f (expected %.6f), clock %.6f (expected %.6f)\n", player.GetLatency(), latency, player.GetClock(), clock);
+		}
+	}
+
+	// 推进时钟之前等音频线程把设备缓冲区填满（或者数据已经全交给设备），不然推进的时间里会欠载
+	void WaitForFill(AudioPlayer& player, NullAudioSink& sink) {
+		NV_CHECK(WaitUntil([&] { return sink.GetPadding() == sink.GetBufferFrames() || player.GetBufferedFrames() == 0; }));
+	}
+
+	void Write(AudioPlayer& player, double seconds, double pts) {
+		int frames = (int)lround(seconds * sampleRate);
+		std::vector<float> left(frames, 0.1f), right(frames, -0.1f);
+		const uint8_t* data[] = { (const uint8_t*)left.data(), (const uint8_t*)right.data() };
+		player.Write(data, AV_SAMPLE_FMT_FLTP, 2, 0, frames, pts);
+	}
+
+	void TestBufferNegotiation() {
+		// 比设备周期还小的请求按周期算
+		auto sink = std::make_shared<NullAudioSink>(false);
+		AudioPlayer player(sink, 2, sampleRate, 0.001);
+		NV_CHECK(sink->GetBufferFrames() == (uint32_t)(NullAudioSink::periodSeconds * sampleRate));
+
+		auto larger = std::make_shared<NullAudioSink>(false);
+		AudioPlayer largerPlayer(larger, 2, sampleRate, 0.1);
+		NV_CHECK(larger->GetBufferFrames() == (uint32_t)(0.1 * sampleRate));
+	}
+
+	void TestLatency() {
+		auto sink = std::make_shared<NullAudioSink>(false);
+		sink->SetStreamLatency(streamLatency);
+		AudioPlayer player(sink, 2, sampleRate, bufferSeconds);
+		player.Start();
+
+		NV_CHECK(player.GetClock() < 0);
+
+		// 从 1 秒开始写 0.1 秒。都还没播放：延迟就是写入的时长加设备的延迟，正在听到的是 1 秒之前
+		Write(player, 0.1, 1.0);
+		CheckLatency(player, 0.1 + streamLatency, 1.0 - streamLatency);
+
+		// 时钟每走 10ms，延迟少 10ms，音频时钟多 10ms
+		for (int step = 1; step <= 8; step++) {
+			WaitForFill(player, *sink);
+			sink->AdvanceClock(0.01);
+			CheckLatency(player, 0.1 + streamLatency - 0.01 * step, 1.0 - streamLatency + 0.01 * step);
+		}
+		NV_CHECK(sink->GetUnderrunFrames() == 0);
+
+		// 接着写，不带时间戳就接在上一帧后面
+		Write(player, 0.05, -1);
+		CheckLatency(player, 0.07 + streamLatency, 1.08 - streamLatency);
+
+		// 全部放完之后只剩设备自身的延迟，欠载时放的静音不会让时钟往前走
+		for (int step = 0; step < 10; step++) {
+			WaitForFill(player, *sink);
+			sink->AdvanceClock(0.01);
+		}
+		NV_CHECK(sink->GetUnderrunFrames() > 0);
+		CheckLatency(player, streamLatency, 1.15 - streamLatency);
+
+		// 设备延迟变了马上反映出来
+		sink->SetStreamLatency(0.03);
+		CheckLatency(player, 0.03, 1.15 - 0.03);
+
+		// Flush 之后没有时间可用，直到写入新的数据；设备缓冲区里等着被清掉的旧数据不算
+		Write(player, 0.015, 5.0);
+		WaitForFill(player, *sink);
+		player.Flush();
+		NV_CHECK(player.GetClock() < 0);
+		Write(player, 0.05, 2.0);
+		CheckLatency(player, 0.05 + 0.03, 2.05 - 0.05 - 0.03);
+		// 手动时钟下音频线程要等一次 AdvanceClock 才会醒来处理 Flush
+		sink->AdvanceClock(0);
+		WaitForFill(player, *sink);
+		sink->AdvanceClock(0.01);
+		CheckLatency(player, 0.04 + 0.03, 2.05 - 0.04 - 0.03);
+	}
+
+	// 打不开的设备（没有声卡）
+	class BrokenSink : public NullAudioSink {
+	public:
+		BrokenSink() : NullAudioSink(false) {}
+
+		int Open(int, int, double) override {
+			return -1;
+		}
+	};
+
+	void TestOpenFailure() {
+		// 换成空设备，声道数、环形缓冲区都是好的，写进去的数据照样会被播放
+		auto broken = std::make_shared<BrokenSink>();
+		AudioPlayer player(broken, 6, sampleRate, bufferSeconds);
+		NV_CHECK(player.GetSink() != broken.get());
+		NV_CHECK(dynamic_cast<NullAudioSink*>(player.GetSink()) != nullptr);
+		NV_CHECK(player.GetChannels() == 6);
+		NV_CHECK(player.Start() == 0);
+		Write(player, 0.1, 0);
+		NV_CHECK(WaitUntil([&] { return player.GetBufferedFrames() < (uint32_t)(0.1 * sampleRate); }));
+		NV_CHECK(player.GetOverflowCount() == 0);
+	}
+}
+
+int main() {
+	TestBufferNegotiation();
+	TestOpenFailure();
+	TestLatency();
+	return test::Result();
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <random>
+
+// 测试用的最小断言：失败时打印位置和表达式，接着跑完剩下的检查，main 最后返回 nv::test::Result()
+#define NV_CHECK(expr) nv::test::Check((expr), #expr, __FILE__, __LINE__)
+
+namespace nv {
+	namespace test {
+		inline int& GetFailureCount() {
+			static int count = 0;
+			return count;
+		}
+
+		// 返回 ok，失败时调用方可以接着打印更多信息
+		inline bool Check(bool ok, const char* expr, const char* file, int line) {
+			if (!ok) {
+				GetFailureCount()++;
+				printf("%s:%d: check failed: %s\n", file, line, expr);
+			}
+			return ok;
+		}
+
+		inline int Result() {
+			if (GetFailureCount() > 0) {
+				printf("%d check(s) failed\n", GetFailureCount());
+				return 1;
+			}
+			printf("all checks passed\n");
+			return 0;
+		}
+
+		// 固定种子，每个平台生成的数据都一样（标准规定了 mt19937 的输出）
+		inline std::mt19937& GetRandom() {
+			static std::mt19937 random(20241018);
+			return random;
+		}
+
+		inline void FillRandom(std::vector<uint8_t>& data) {
+			auto& random = GetRandom();
+			for (auto& v : data) {
+				v = (uint8_t)random();
+			}
+		}
+	}
+}
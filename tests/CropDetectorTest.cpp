@@ -0,0 +1,226 @@
+#include "Check.h"
+#include "TestFrame.h"
+#include "CropDetector.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+
+// 黑边检测：SIMD 内核和标量参考实现结果相同，加了黑边的画面检测出的正是画面的位置，CropDetector 放大马上跟、缩小要等 stableScans 次
+using namespace nv;
+
+namespace {
+	// 亮度平面，样本是 8 位的值左移 shift（两字节时再加上低位的噪声），每行多留 padding 字节
+	struct TestPlane {
+		std::vector<uint8_t> data;
+		LumaPlane plane;
+	};
+
+	// content 之外是 16 附近的噪声（有限范围的黑），content 里从 level 开始往上随机
+	TestPlane MakePlane(int width, int height, int bytesPerSample, int shift, CropRect content, int level, int padding = 0) {
+		auto& random = test::GetRandom();
+		TestPlane result;
+		int pitch = width * bytesPerSample + padding;
+		result.data.assign((size_t)pitch * height, 0xCD);
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				bool isContent = x >= content.x && x < content.x + content.width && y >= content.y && y < content.y + content.height;
+				int v = isContent ? level + (int)(random() % 60) : 16 + (int)(random() % 5) - 2;
+				v = std::clamp(v, 0, 255);
+				uint8_t* p = &result.data[(size_t)y * pitch + x * bytesPerSample];
+				if (bytesPerSample == 1) {
+					*p = (uint8_t)v;
+				}
+				else {
+					// 8 位以下的部分是噪声，右移 shift 之后又回到 v
+					uint16_t sample = (uint16_t)(v << shift | (random() & ((1 << shift) - 1)));
+					memcpy(p, &sample, 2);
+				}
+			}
+		}
+		result.plane = { result.data.data(), pitch, width, height, bytesPerSample, shift };
+		return result;
+	}
+
+	bool IsSameWithEveryKernel(const LumaPlane& plane, int black, CropRect& ref) {
+		ref = DetectCropRef(plane, black);
+		bool isSame = DetectCrop(plane, black) == ref;
+		if (cpu::HasAVX2()) {
+			cpu::DisableAVX2(true);
+			isSame &= DetectCrop(plane, black) == ref;
+			cpu::DisableAVX2(false);
+		}
+		return isSame;
+	}
+
+	void TestKernels() {
+		// 各种宽度（SIMD 处理到一半的行尾）、位深、黑电平，包括超出 255 要截断的 16 位样本
+		auto& random = test::GetRandom();
+		int failures = 0;
+		for (int i = 0; i < 300; i++) {
+			int width = 1 + random() % 300;
+			int height = 1 + random() % 200;
+			int bytesPerSample = 1 + random() % 2;
+			int shift = bytesPerSample == 1 ? 0 : (random() % 2 ? 8 : 2);
+			CropRect content = { (int)(random() % (width / 3 + 1)), (int)(random() % (height / 3 + 1)), 0, 0 };
+			content.width = width - 2 * content.x;
+			content.height = height - 2 * content.y;
+			auto test = MakePlane(width, height, bytesPerSample, shift, content, 10 + random() % 100, random() % 2 ? 0 : 24);
+			if (bytesPerSample == 2 && shift == 2) {
+				for (int k = 0; k < 50; k++) {
+					uint16_t garbage = (uint16_t)(random() & 0x7FFF);
+					memcpy(&test.data[(size_t)(random() % height) * test.plane.pitch + (random() % width) * 2], &garbage, 2);
+				}
+			}
+			int black = random() % 40;
+			CropRect ref;
+			if (!IsSameWithEveryKernel(test.plane, black, ref) && failures++ < 5) {
+				printf("  %dx%d, %d byte(s), shift %d, black %d: kernels differ from the reference (%d, %d, %d, %d)\n",
+					width, height, bytesPerSample, shift, black, ref.x, ref.y, ref.width, ref.height);
+			}
+		}
+		NV_CHECK(failures == 0);
+	}
+
+	void TestLetterbox() {
+		struct Case {
+			int width;
+			int height;
+			int bytesPerSample;
+			int shift;
+			CropRect content;
+		};
+		const Case cases[] = {
+			// 2.39:1 的电影放在 16:9 里
+			{ 1920, 1080, 1, 0, { 0, 138, 1920, 804 } },
+			// P010 和 yuv420p10
+			{ 1920, 1080, 2, 8, { 0, 138, 1920, 804 } },
+			{ 1280, 720, 2, 2, { 0, 93, 1280, 534 } },
+			// 4:3 放在 16:9 里，左右有黑边
+			{ 1280, 720, 1, 0, { 160, 0, 960, 720 } },
+			// 四边都有，边界不在 rowStep 和 SIMD 宽度的整数倍上
+			{ 721, 405, 1, 0, { 37, 29, 640, 347 } },
+			{ 721, 405, 2, 8, { 37, 29, 640, 347 } },
+			{ 640, 360, 1, 0, { 0, 0, 640, 360 } },
+		};
+		for (auto& test : cases) {
+			auto plane = MakePlane(test.width, test.height, test.bytesPerSample, test.shift, test.content, 40, 16);
+			CropRect ref;
+			NV_CHECK(IsSameWithEveryKernel(plane.plane, 24, ref));
+			if (!NV_CHECK(ref == test.content)) {
+				printf("  %dx%d: detected (%d, %d, %d, %d), expected (%d, %d, %d, %d)\n", test.width, test.height, ref.x, ref.y, ref.width, ref.height,
+					test.content.x, test.content.y, test.content.width, test.content.height);
+			}
+		}
+
+		// 整帧都是黑的
+		auto black = MakePlane(320, 180, 1, 0, {}, 40);
+		NV_CHECK(DetectCrop(black.plane, 24).width == 0 && DetectCrop(black.plane, 24).height == 0);
+	}
+
+	void TestHysteresis() {
+		constexpr int width = 640, height = 360;
+		auto letterbox = MakePlane(width, height, 1, 0, { 0, 45, width, 270 }, 40);
+		auto dark = MakePlane(width, height, 1, 0, { 0, 100, width, 160 }, 40);
+		auto shifted = MakePlane(width, height, 1, 0, { 0, 60, width, 240 }, 40);
+		auto full = MakePlane(width, height, 1, 0, { 0, 0, width, height }, 40);
+		auto mostlyBlack = MakePlane(width, height, 1, 0, { 0, 160, width, 40 }, 40);
+		const CropRect fullRect = { 0, 0, width, height };
+		const CropRect letterboxRect = { 0, 44, width, 272 }; // 往外对齐到偶数
+
+		CropDetector detector(1, 8);
+		auto update = [&](const TestPlane& plane, int count) {
+			int changes = 0;
+			for (int i = 0; i < count; i++) {
+				changes += detector.Update(plane.plane, AVCOL_RANGE_MPEG);
+			}
+			return changes;
+		};
+
+		// 还没检测过的大小是整帧
+		NV_CHECK(detector.GetCrop(width, height) == fullRect);
+
+		// 缩小要连续 8 次
+		NV_CHECK(update(letterbox, 7) == 0);
+		NV_CHECK(detector.GetCrop(width, height) == fullRect);
+		NV_CHECK(update(letterbox, 1) == 1);
+		NV_CHECK(detector.GetCrop(width, height) == letterboxRect);
+
+		// 暗场景看起来黑边更宽，几次不会缩
+		NV_CHECK(update(dark, 5) == 0);
+		NV_CHECK(detector.GetCrop(width, height) == letterboxRect);
+
+		// 大半是黑的帧（淡入淡出）不算
+		NV_CHECK(update(mostlyBlack, 20) == 0);
+		NV_CHECK(detector.GetCrop(width, height) == letterboxRect);
+
+		// 两种结果交替出现时谁也攒不够次数
+		for (int i = 0; i < 10; i++) {
+			NV_CHECK(update(dark, 1) == 0);
+			NV_CHECK(update(shifted, 1) == 0);
+		}
+		NV_CHECK(detector.GetCrop(width, height) == letterboxRect);
+
+		// 放大马上跟
+		NV_CHECK(update(full, 1) == 1);
+		NV_CHECK(detector.GetCrop(width, height) == fullRect);
+
+		// 帧的大小变了从整帧开始，别的大小一直是整帧
+		NV_CHECK(detector.GetCrop(1280, 720) == (CropRect{ 0, 0, 1280, 720 }));
+		auto small = MakePlane(320, 180, 1, 0, { 0, 20, 320, 140 }, 40);
+		NV_CHECK(detector.Update(small.plane, AVCOL_RANGE_MPEG) == false);
+		NV_CHECK(detector.GetCrop(320, 180) == (CropRect{ 0, 0, 320, 180 }));
+
+		// 全范围的黑电平是 0，16 附近的黑边就算画面了
+		CropDetector fullRange(1, 1);
+		fullRange.Update(letterbox.plane, AVCOL_RANGE_JPEG);
+		NV_CHECK(fullRange.GetCrop(width, height) == fullRect);
+	}
+
+	void TestInterval() {
+		CropDetector detector(12, 8);
+		int due = 0;
+		for (int i = 0; i < 36; i++) {
+			bool isDue = detector.IsDue();
+			due += isDue;
+			NV_CHECK(isDue == (i % 12 == 0));
+		}
+		NV_CHECK(due == 3);
+		detector.Reset();
+		NV_CHECK(detector.IsDue());
+	}
+
+	void TestLumaPlane() {
+		struct Case {
+			AVPixelFormat format;
+			bool isSupported;
+			int bytesPerSample;
+			int shift;
+		};
+		const Case cases[] = {
+			{ AV_PIX_FMT_YUV420P, true, 1, 0 },
+			{ AV_PIX_FMT_NV12, true, 1, 0 },
+			{ AV_PIX_FMT_P010LE, true, 2, 8 },
+			{ AV_PIX_FMT_YUV420P10LE, true, 2, 2 },
+			{ AV_PIX_FMT_BGRA, false, 0, 0 },
+		};
+		for (auto& test : cases) {
+			auto frame = test::MakeFrame(test.format, 64, 32, [](int, int, int) { return 0; }, 8);
+			LumaPlane plane;
+			bool isSupported = GetLumaPlane(&frame.frame, plane);
+			NV_CHECK(isSupported == test.isSupported);
+			if (isSupported) {
+				NV_CHECK(plane.data == frame.frame.data[0] && plane.pitch == frame.frame.linesize[0]);
+				NV_CHECK(plane.width == 64 && plane.height == 32);
+				NV_CHECK(plane.bytesPerSample == test.bytesPerSample && plane.shift == test.shift);
+			}
+		}
+	}
+}
+
+int main() {
+	TestKernels();
+	TestLetterbox();
+	TestHysteresis();
+	TestInterval();
+	TestLumaPlane();
+	return test::Result();
+}
@@ -0,0 +1,163 @@
+#include "Check.h"
+#include "Dither.h"
+#include "CpuFeatures.h"
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <functional>
+
+// Dither 的检查：
+// 1. 各种宽度、带行尾填充、原地处理时 SIMD 实现和标量参考实现逐位相同
+// 2. 10 位的横向渐变量化到 8 位：抖动后每个 8x8 块的平均值和真实值差不到 0.5，截断和四舍五入是一级一级的台阶
+using namespace nv;
+
+namespace {
+	const DitherMode modes[] = { DitherMode::None, DitherMode::Ordered, DitherMode::BlueNoise };
+
+	uint32_t PackRGB10A2(int r, int g, int b) {
+		return (uint32_t)r | ((uint32_t)g << 10) | ((uint32_t)b << 20) | (3u << 30);
+	}
+
+	struct Image {
+		int width;
+		int height;
+		int pitch;
+		std::vector<uint8_t> data;
+
+		uint32_t& At(int x, int y) {
+			return *(uint32_t*)&data[(size_t)y * pitch + x * 4];
+		}
+	};
+
+	// 每行末尾多留 12 字节，检查没有读写出界
+	Image MakeRandomImage(int width, int height) {
+		Image image = { width, height, width * 4 + 12 };
+		image.data.resize((size_t)image.pitch * height);
+		test::FillRandom(image.data);
+		return image;
+	}
+
+	Image Dither(void (*dither)(const uint8_t*, int, int, int, uint8_t*, int, DitherMode), const Image& src, DitherMode mode) {
+		Image dst = { src.width, src.height, src.pitch };
+		dst.data.assign(src.data.size(), 0x5A);
+		dither(src.data.data(), src.pitch, src.width, src.height, dst.data.data(), dst.pitch, mode);
+		// 行尾的填充应该没动过，换成源的再和原地处理的结果比
+		int padding = src.pitch - src.width * 4;
+		for (int y = 0; y < src.height; y++) {
+			uint8_t* end = &dst.data[(size_t)y * dst.pitch + src.width * 4];
+			NV_CHECK(std::all_of(end, end + padding, [](uint8_t v) { return v == 0x5A; }));
+			memcpy(end, &src.data[(size_t)y * src.pitch + src.width * 4], padding);
+		}
+		return dst;
+	}
+
+	void TestKernels() {
+		int mismatches = 0;
+		for (auto mode : modes) {
+			for (int width : { 1, 3, 4, 5, 7, 8, 9, 15, 17, 63, 64, 65, 130 }) {
+				auto src = MakeRandomImage(width, 67);
+				auto expected = Dither(DitherRGB10A2Ref, src, mode);
+				auto actual = Dither(DitherRGB10A2, src, mode);
+
+				// 原地处理，SoftwareRenderer 就是这样用的
+				auto inPlace = src;
+				DitherRGB10A2(inPlace.data.data(), inPlace.pitch, width, inPlace.height, inPlace.data.data(), inPlace.pitch, mode);
+				if (actual.data != expected.data || inPlace.data != expected.data) {
+					mismatches++;
+					printf("%s dither, width %d differs from the reference\n", GetDitherModeName(mode), width);
+				}
+			}
+		}
+		NV_CHECK(mismatches == 0);
+	}
+
+	struct Banding {
+		double maxError; // 8x8 块的平均值和真实值差得最多的
+		double rmsError;
+		int plateau;     // 块的平均值连续不变的最长距离（块数）
+	};
+
+	// 10 位横向渐变，每 8 列加 1，每个 8x8 块是同一个 10 位的值；height 行取满蓝噪声的一个周期
+	// 统计每个块量化后的平均值和 v * 255 / 1023 差多少
+	Banding MeasureBanding(const std::function<int(int v, int x, int y)>& quantize) {
+		constexpr int tile = 8;
+		Banding banding = {};
+		double sumSquares = 0;
+		int tiles = 0, run = 0;
+		double lastMean = -1;
+		for (int v = 0; v < 1024; v++) {
+			for (int ty = 0; ty < ditherSize / tile; ty++) {
+				double sum = 0;
+				for (int y = ty * tile; y < (ty + 1) * tile; y++) {
+					for (int x = v * tile; x < (v + 1) * tile; x++) {
+						sum += quantize(v, x, y);
+					}
+				}
+				double error = sum / (tile * tile) - v * 255.0 / 1023;
+				banding.maxError = std::max(banding.maxError, fabs(error));
+				sumSquares += error * error;
+				tiles++;
+			}
+
+			// 第一行块沿着渐变方向的台阶
+			double mean = 0;
+			for (int y = 0; y < tile; y++) {
+				for (int x = v * tile; x < (v + 1) * tile; x++) {
+					mean += quantize(v, x, y);
+				}
+			}
+			run = mean == lastMean ? run + 1 : 1;
+			lastMean = mean;
+			banding.plateau = std::max(banding.plateau, run);
+		}
+		banding.rmsError = sqrt(sumSquares / tiles);
+		return banding;
+	}
+
+	void TestGradient() {
+		constexpr int width = 1024 * 8, height = ditherSize;
+		Image src = { width, height, width * 4 };
+		src.data.resize((size_t)src.pitch * height);
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				int v = x / 8;
+				src.At(x, y) = PackRGB10A2(v, v, v);
+			}
+		}
+
+		// 直接截断：平均偏低半级，一级 8 位台阶横跨 4 个块
+		auto truncated = MeasureBanding([](int v, int, int) { return v * 255 / 1023; });
+		NV_CHECK(truncated.maxError > 0.9 && truncated.rmsError > 0.5 && truncated.plateau >= 4);
+
+		for (auto mode : modes) {
+			auto dst = Dither(DitherRGB10A2, src, mode);
+			auto banding = MeasureBanding([&](int, int x, int y) {
+				uint32_t pixel = dst.At(x, y);
+				// 三个通道一样，alpha 是 255
+				NV_CHECK((pixel & 0xFF) == ((pixel >> 8) & 0xFF) && (pixel & 0xFF) == ((pixel >> 16) & 0xFF) && (pixel >> 24) == 255);
+				return (int)(pixel & 0xFF);
+			});
+			bool ok = mode == DitherMode::None
+				// 四舍五入不偏了，但还是台阶
+				? banding.maxError <= 0.5 && banding.maxError > 0.45 && banding.plateau >= 4
+				// 抖动后每个块的平均值都跟着渐变走，没有台阶
+				: banding.maxError < 0.5 && banding.rmsError < truncated.rmsError / 4 && banding.plateau <= 2;
+			if (!NV_CHECK(ok)) {
+				printf("  %s: max error %.3f, rms %.3f, longest plateau %d tiles\n", GetDitherModeName(mode), banding.maxError, banding.rmsError, banding.plateau);
+			}
+		}
+	}
+}
+
+int main() {
+	TestKernels();
+	// 有 AVX2 时再关掉它测一遍 SSE4.1
+	if (cpu::HasAVX2()) {
+		cpu::DisableAVX2(true);
+		TestKernels();
+		cpu::DisableAVX2(false);
+	}
+
+	TestGradient();
+	return test::Result();
+}
@@ -0,0 +1,243 @@
+#include "Check.h"
+#include "DriftController.h"
+#include "AudioRemixer.h"
+#include "SampleConvert.h"
+#include "AudioPlayer.h"
+#include "NullAudioSink.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// 时钟漂移补偿：PI 控制器对着模拟的设备时钟收敛、被限幅，AudioRemixer 只在补偿超出死区时才走重采样器
+using namespace nv;
+
+namespace {
+	constexpr int sampleRate = 48000;
+
+	struct SimResult {
+		double meanCorrection;
+		double lastCorrection;
+		double meanError; // 秒
+		double maxError;
+		double minBuffered; // 帧
+	};
+
+	// 媒体按墙上时钟写入，设备按 clockRate 倍的标称采样率取走，写入的帧数按补偿值伸缩，和播放时一样
+	// 统计最后 statSeconds 秒
+	SimResult Simulate(double clockRate, double seconds, double statSeconds) {
+		constexpr int chunk = 1024;
+		constexpr double step = 0.01;
+		constexpr double lead = 0.2;
+
+		DriftController drift(sampleRate);
+		double written = 0, consumed = 0, media = 0, correction = 0;
+		SimResult result = { 0, 0, 0, 0, 1e30 };
+		int count = 0;
+		for (double t = 0; t < seconds; t += step) {
+			consumed += step * sampleRate * clockRate;
+			while (media < t + lead) {
+				written += chunk * (1 + correction / 1e6);
+				media += (double)chunk / sampleRate;
+				correction = drift.Update(written - consumed, (double)chunk / sampleRate);
+			}
+			result.minBuffered = std::min(result.minBuffered, written - consumed);
+
+			if (t >= seconds - statSeconds) {
+				result.meanCorrection += correction;
+				result.meanError += drift.GetError();
+				result.maxError = std::max(result.maxError, fabs(drift.GetError()));
+				count++;
+			}
+		}
+		result.meanCorrection /= count;
+		result.meanError /= count;
+		result.lastCorrection = correction;
+		return result;
+	}
+
+	void TestConvergence() {
+		// 设备快了就要多产生样本，慢了就少产生；稳定之后补偿等于时钟误差，水位回到目标
+		for (double ppm : { 1000.0, -1000.0, 20.0 }) {
+			auto result = Simulate(1 + ppm / 1e6, 900, 300);
+			bool ok = NV_CHECK(fabs(result.meanCorrection - ppm) < 5);
+			ok &= NV_CHECK(fabs(result.meanError) < 0.0001);
+			ok &= NV_CHECK(result.maxError < 0.001);
+			ok &= NV_CHECK(result.minBuffered > 0);
+			if (!ok) {
+				printf("  clock %+.0f ppm: correction %.1f ppm, error mean %.3f ms max %.3f ms, min buffered %.0f frames\n",
+					ppm, result.meanCorrection, result.meanError * 1000, result.maxError * 1000, result.minBuffered);
+			}
+		}
+	}
+
+	void TestClamp() {
+		// 超出补偿范围的时钟误差只能补到上限，不会越过去
+		for (double ppm : { 3000.0, -3000.0 }) {
+			auto result = Simulate(1 + ppm / 1e6, 300, 100);
+			double limit = ppm > 0 ? DriftController::maxCorrection : -DriftController::maxCorrection;
+			if (!NV_CHECK(result.lastCorrection == limit && result.meanCorrection == limit)) {
+				printf("  clock %+.0f ppm: correction %.1f ppm\n", ppm, result.lastCorrection);
+			}
+		}
+	}
+
+	struct Block {
+		std::vector<float> data;
+		int frames;
+	};
+
+	Block Convert(AudioRemixer& remixer, const std::vector<float>& input, int frames) {
+		const uint8_t* src[] = { (const uint8_t*)input.data() };
+		const float* out = nullptr;
+		int ret = remixer.Convert(src, AV_SAMPLE_FMT_FLT, 0, 2, sampleRate, frames, &out);
+		Block block = { {}, ret };
+		if (ret > 0) {
+			block.data.assign(out, out + (size_t)ret * 2);
+		}
+		return block;
+	}
+
+	void TestDeadband() {
+		constexpr int frames = 480;
+		AudioRemixer remixer(0, 2, sampleRate);
+		std::vector<float> input((size_t)frames * 2);
+		double phase = 0;
+		auto next = [&] {
+			for (int i = 0; i < frames; i++) {
+				input[i * 2] = input[i * 2 + 1] = (float)sin(phase);
+				phase += 2 * M_PI * 440 / sampleRate;
+			}
+		};
+		auto isDirect = [&](const Block& block) {
+			// 和 SampleConvert 的结果逐位相同
+			std::vector<float> expected((size_t)frames * 2);
+			const uint8_t* src[] = { (const uint8_t*)input.data() };
+			GetSampleConverter(AV_SAMPLE_FMT_FLT)(src, expected.data(), frames, 2);
+			return block.frames == frames && memcmp(block.data.data(), expected.data(), expected.size() * sizeof(float)) == 0;
+		};
+
+		uint64_t in = 0, out = 0;
+		auto run = [&](double ppm, int count, bool expectDirect) {
+			remixer.SetCompensation(ppm);
+			for (int i = 0; i < count; i++) {
+				next();
+				auto block = Convert(remixer, input, frames);
+				in += frames;
+				out += std::max(block.frames, 0);
+				if (!NV_CHECK(isDirect(block) == expectDirect && (remixer.GetDelay() == 0) == expectDirect)) {
+					printf("  %+.0f ppm, block %d: %d frames, delay %d\n", ppm, i, block.frames, remixer.GetDelay());
+					return;
+				}
+			}
+		};
+		// 输入的帧数 = 输出 + 还在重采样器里的 + 补偿多出来（或少掉）的，补偿的部分不超过几帧
+		auto checkConserved = [&] {
+			int64_t missing = (int64_t)in - (int64_t)out - remixer.GetDelay();
+			if (!NV_CHECK(std::abs(missing) <= 3)) {
+				printf("  in %llu out %llu delay %d\n", (unsigned long long)in, (unsigned long long)out, remixer.GetDelay());
+			}
+		};
+
+		// 死区以内直接转换，一个 SwrContext 都不创建
+		run(0, 10, true);
+		run(-AudioRemixer::deadband, 10, true);
+		NV_CHECK(remixer.GetContextCount() == 0);
+
+		// 超出死区走重采样器，回到死区以内但没到一半时保持不变
+		run(50, 20, false);
+		run(AudioRemixer::deadband * 0.75, 10, false);
+		checkConserved();
+
+		// 回到一半以内时切回来：切换的那一块带着重采样器剩下的样本，之后逐位等于直接转换
+		remixer.SetCompensation(5);
+		next();
+		auto block = Convert(remixer, input, frames);
+		in += frames;
+		out += block.frames;
+		NV_CHECK(block.frames > frames && remixer.GetDelay() == 0);
+		checkConserved();
+		run(5, 10, true);
+		run(-AudioRemixer::deadband * 0.75, 10, true);
+
+		// 反方向再进入一次，用的还是同一个 SwrContext
+		run(-100, 10, false);
+		checkConserved();
+
+		// Reset 丢掉重采样器里的样本，回到直接转换
+		remixer.Reset();
+		NV_CHECK(remixer.GetDelay() == 0);
+		run(0, 5, true);
+		NV_CHECK(remixer.GetContextCount() == 1);
+	}
+
+	void TestContinuity() {
+		// 来回切换的过程中输出的波形不跳变：440Hz 正弦波相邻样本的差不超过正常的一步
+		constexpr int frames = 480;
+		AudioRemixer remixer(0, 2, sampleRate);
+		std::vector<float> input((size_t)frames * 2);
+		double phase = 0;
+		double maxStep = 2 * M_PI * 440 / sampleRate;
+		float previous = 0;
+		bool hasPrevious = false;
+		double maxJump = 0;
+		for (double ppm : { 0.0, 100.0, 0.0, -500.0, 3.0, 2000.0, 0.0 }) {
+			remixer.SetCompensation(ppm);
+			for (int block = 0; block < 20; block++) {
+				for (int i = 0; i < frames; i++) {
+					input[i * 2] = input[i * 2 + 1] = (float)sin(phase);
+					phase += maxStep;
+				}
+				auto out = Convert(remixer, input, frames);
+				for (int i = 0; i < out.frames; i++) {
+					if (hasPrevious) {
+						maxJump = std::max(maxJump, (double)fabsf(out.data[i * 2] - previous));
+					}
+					previous = out.data[i * 2];
+					hasPrevious = true;
+				}
+			}
+		}
+		if (!NV_CHECK(maxJump < maxStep * 1.1)) {
+			printf("  max jump %.5f, expected below %.5f\n", maxJump, maxStep * 1.1);
+		}
+	}
+
+	void TestScrubbing() {
+		// 拖动进度条时一段段写入 80ms 的颗粒，鼠标时快时慢，缓冲区水位跟着变，但和时钟漂移无关，补偿不能跟着动
+		constexpr int grainFrames = sampleRate * 8 / 100;
+		auto sink = std::make_shared<NullAudioSink>(false);
+		AudioPlayer player(sink, 2, sampleRate, 0.2);
+		player.Start();
+		player.SetScrubbing(true);
+		std::vector<float> left(grainFrames, 0.1f), right(grainFrames, -0.1f);
+		const uint8_t* data[] = { (const uint8_t*)left.data(), (const uint8_t*)right.data() };
+		for (int i = 0; i < 80; i++) {
+			player.Write(data, AV_SAMPLE_FMT_FLTP, 2, 0, grainFrames, i * 0.1);
+			// 等音频线程把颗粒搬进设备缓冲区，最多等 2 秒
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+			while (sink->GetPadding() != sink->GetBufferFrames() && player.GetBufferedFrames() > 0 && std::chrono::steady_clock::now() < deadline) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			// 前一半每个颗粒都播完了才接下一个，后一半接得比播得快，缓冲区越积越多
+			sink->AdvanceClock(i < 40 ? 0.1 : 0.04);
+		}
+		if (!NV_CHECK(player.GetDriftCorrection() == 0 && player.GetDriftError() == 0)) {
+			printf("  after scrubbing: correction %.1f ppm, error %.3f ms\n", player.GetDriftCorrection(), player.GetDriftError() * 1000);
+		}
+
+		// 松开之后补偿还是拖动前的值，不会跳
+		player.SetScrubbing(false);
+		NV_CHECK(player.GetDriftCorrection() == 0);
+	}
+}
+
+int main() {
+	TestConvergence();
+	TestClamp();
+	TestDeadband();
+	TestContinuity();
+	TestScrubbing();
+	return test::Result();
+}
@@ -0,0 +1,213 @@
+#include "Check.h"
+#include "TestFrame.h"
+#include "SyntheticCorpus.h"
+#include "DuplicateFrameDetector.h"
+#include "CpuFeatures.h"
+#include <string.h>
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+// 重复帧检测：SIMD 算出的指纹和标量参考实现逐位相同，参考实现和按定义逐块相加的结果相同；
+// 合成片源上跳过的帧数正好是重复的那些，实拍一帧也不跳
+using namespace nv;
+
+namespace {
+	// 按 FrameSignature 的定义直接算：每个平面的每个通道样本按块加起来，16 位的换成 8 位
+	std::vector<uint32_t> ComputeExpectedSums(const AVFrame* frame) {
+		PixelFormatDesc desc;
+		GetPixelFormatDesc((AVPixelFormat)frame->format, desc);
+		constexpr int blockSize = FrameSignature::blockSize;
+		std::vector<uint32_t> sums;
+		for (int i = 0; i < desc.planeCount; i++) {
+			int count = GetPlaneWidth(desc, i, frame->width) * desc.planes[i].channels;
+			int height = GetPlaneHeight(desc, i, frame->height);
+			int blocksPerRow = (count + blockSize - 1) / blockSize;
+			size_t start = sums.size();
+			sums.resize(start + (size_t)blocksPerRow * ((height + blockSize - 1) / blockSize), 0);
+			int shift = std::max(desc.bitDepth + desc.sampleShift - 8, 1);
+			for (int y = 0; y < height; y++) {
+				const uint8_t* row = frame->data[i] + (size_t)y * frame->linesize[i];
+				for (int x = 0; x < count; x++) {
+					int v;
+					if (desc.planes[i].bytesPerChannel == 1) {
+						v = row[x];
+					}
+					else {
+						uint16_t sample;
+						memcpy(&sample, row + x * 2, 2);
+						v = std::min(sample >> shift, 255);
+					}
+					sums[start + (size_t)(y / blockSize) * blocksPerRow + x / blockSize] += v;
+				}
+			}
+		}
+		return sums;
+	}
+
+	void TestSignatureKernels() {
+		// 8 位和 16 位、平面和打包、各种不是块大小整数倍的宽高，样本是随机的，16 位的包括超出位深、要截到 255 的值
+		const AVPixelFormat formats[] = {
+			AV_PIX_FMT_YUV420P, AV_PIX_FMT_NV12, AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV444P,
+			AV_PIX_FMT_P010LE, AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_BGRA,
+		};
+		auto& random = test::GetRandom();
+		int failures = 0;
+		for (auto format : formats) {
+			for (int i = 0; i < 30; i++) {
+				int width = 1 + random() % 150;
+				int height = 1 + random() % 80;
+				auto frame = test::MakeFrame(format, width, height, [](int, int, int) { return 0; }, (int)(random() % 3) * 8);
+				for (auto& plane : frame.planes) {
+					for (auto& v : plane) {
+						v = (uint8_t)random();
+					}
+				}
+
+				FrameSignature ref, fast;
+				bool ok = NV_CHECK(ComputeFrameSignatureRef(&frame.frame, ref)) && NV_CHECK(ComputeFrameSignature(&frame.frame, fast));
+				ok = ok && ref.sums == ComputeExpectedSums(&frame.frame) && fast.sums == ref.sums;
+				if (ok && cpu::HasAVX2()) {
+					cpu::DisableAVX2(true);
+					ok = ComputeFrameSignature(&frame.frame, fast) && fast.sums == ref.sums;
+					cpu::DisableAVX2(false);
+				}
+				if (!ok && failures++ < 5) {
+					printf("  %s %dx%d: signature differs\n", av_get_pix_fmt_name(format), width, height);
+				}
+			}
+		}
+		NV_CHECK(failures == 0);
+
+		// 硬件帧和没有数据的帧算不了
+		auto frame = test::MakeFrame(AV_PIX_FMT_NV12, 16, 16, [](int, int, int) { return 0; });
+		FrameSignature signature;
+		frame.frame.format = AV_PIX_FMT_D3D11;
+		NV_CHECK(!ComputeFrameSignature(&frame.frame, signature));
+		frame.frame.format = AV_PIX_FMT_NV12;
+		frame.frame.data[1] = nullptr;
+		NV_CHECK(!ComputeFrameSignature(&frame.frame, signature));
+	}
+
+	void TestSimilarity() {
+		test::DrawingCache drawings(320, 180);
+		test::CorpusFrame a(320, 180), b(320, 180);
+		test::CopyFrame(drawings.Get(1), a);
+		int tolerance = FrameSignature::blockSize * FrameSignature::blockSize / 4;
+		FrameSignature sa, sb;
+		ComputeFrameSignature(&a.frame, sa);
+
+		// 每个像素 ±1 的噪声在容差里
+		test::CopyFrame(a, b);
+		test::AddNoise(b, 1);
+		ComputeFrameSignature(&b.frame, sb);
+		NV_CHECK(IsSimilarFrame(sa, sb, tolerance));
+
+		// 一块里改了 1x16 的一条竖线（闪烁的光标）就不一样
+		test::CopyFrame(a, b);
+		for (int y = 100; y < 116; y++) {
+			b.planes[0][(size_t)y * 320 + 150] = 235;
+		}
+		ComputeFrameSignature(&b.frame, sb);
+		NV_CHECK(!IsSimilarFrame(sa, sb, tolerance));
+
+		// 只改了色度也不一样
+		test::CopyFrame(a, b);
+		for (int i = 0; i < 64; i++) {
+			b.planes[2][i] = 200;
+		}
+		ComputeFrameSignature(&b.frame, sb);
+		NV_CHECK(!IsSimilarFrame(sa, sb, tolerance));
+
+		// 大小不同
+		test::CorpusFrame c(320, 160);
+		ComputeFrameSignature(&c.frame, sb);
+		NV_CHECK(!IsSimilarFrame(sa, sb, tolerance));
+	}
+
+	void TestDetector() {
+		test::DrawingCache drawings(320, 180);
+		test::CorpusFrame frame(320, 180);
+		DuplicateFrameDetector detector;
+
+		// 第一帧没有可比的
+		test::CopyFrame(drawings.Get(5), frame);
+		NV_CHECK(!detector.IsDuplicate(&frame.frame));
+		NV_CHECK(detector.IsDuplicate(&frame.frame));
+
+		// 缓慢的淡入每帧只差一点，但总是和上一次显示的帧比，攒够了差别还是会显示
+		int shown = 0;
+		auto base = frame.planes[0];
+		for (int i = 1; i <= 40; i++) {
+			for (size_t k = 0; k < base.size(); k++) {
+				frame.planes[0][k] = (uint8_t)std::min(base[k] + i / 4, 255);
+			}
+			shown += !detector.IsDuplicate(&frame.frame);
+		}
+		NV_CHECK(shown > 0 && shown < 40);
+
+		// 算不了指纹的帧之后从头开始
+		uint64_t frameCount = detector.GetFrameCount();
+		frame.frame.format = AV_PIX_FMT_D3D11;
+		NV_CHECK(!detector.IsDuplicate(&frame.frame));
+		NV_CHECK(detector.GetFrameCount() == frameCount);
+		frame.frame.format = AV_PIX_FMT_YUV420P;
+		NV_CHECK(!detector.IsDuplicate(&frame.frame));
+		NV_CHECK(detector.IsDuplicate(&frame.frame));
+
+		// 关掉之后一律不算重复，再打开也从头开始
+		detector.SetEnabled(false);
+		NV_CHECK(!detector.IsDuplicate(&frame.frame));
+		detector.SetEnabled(true);
+		NV_CHECK(!detector.IsDuplicate(&frame.frame));
+		NV_CHECK(detector.IsDuplicate(&frame.frame));
+		NV_CHECK(!detector.IsDuplicate(nullptr));
+	}
+
+	void TestCorpus() {
+		// 1080p，按片源的构成算出来应该跳过的帧数
+		struct Expected {
+			int duplicates;
+			const char* reason;
+		};
+		const Expected expected[] = {
+			{ 160, "80 drawings held 3 frames" },
+			{ 120, "120 drawings held 2 frames, noise within tolerance" },
+			// 每张的 120 帧静止画面里有 119 帧重复，淡化的最后一帧和下一张几乎一样，也算重复
+			{ 480, "4 slides: 119 held frames + 1 at the end of each crossfade" },
+			// 光标每 15 帧闪一次，每 150 帧里鼠标动 30 帧
+			{ 448, "caret toggles every 15 frames, cursor moves 30 of 150 frames" },
+			{ 0, "every frame differs" },
+		};
+
+		test::DrawingCache drawings(1920, 1080);
+		auto clips = test::MakeCorpus(drawings);
+		uint64_t total = 0, skipped = 0;
+		for (size_t i = 0; i < clips.size(); i++) {
+			auto& clip = clips[i];
+			test::CorpusFrame frame(1920, 1080);
+			DuplicateFrameDetector detector;
+			for (int k = 0; k < clip.frameCount; k++) {
+				clip.render(frame, k);
+				detector.IsDuplicate(&frame.frame);
+			}
+			int duplicates = (int)detector.GetDuplicateCount();
+			if (!NV_CHECK(duplicates == expected[i].duplicates)) {
+				printf("  %s: %d of %d skipped, expected %d (%s)\n", clip.name, duplicates, clip.frameCount, expected[i].duplicates, expected[i].reason);
+			}
+			total += clip.frameCount;
+			skipped += duplicates;
+		}
+		printf("synthetic corpus: %.1f%% of %llu frames skipped\n", 100.0 * skipped / total, (unsigned long long)total);
+	}
+}
+
+int main() {
+	TestSignatureKernels();
+	TestSimilarity();
+	TestDetector();
+	TestCorpus();
+	return test::Result();
+}
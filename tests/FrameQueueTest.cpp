@@ -0,0 +1,203 @@
+#include "Check.h"
+#include "FrameQueue.h"
+#include <string.h>
+#include <stdlib.h>
+#include <map>
+
+// 解码和呈现之间的帧队列：先进先出、最多排 capacity 帧、满了不再引用新帧、Flush 和析构把引用全部放掉
+// 硬件解码时解码器只能复用没人引用的纹理，按 main.cpp 的 extra_hw_frames = capacity + 1 留出的纹理一直够用
+// av_frame_* 换成下面按 data[0] 记引用数的实现（链接时可执行文件里的定义优先），和 libavutil 里 AVFrame 的实际布局无关
+using namespace nv;
+
+namespace {
+	// 每个“纹理”（data[0]）被引用的次数，解码器自己那一份不算
+	std::map<const uint8_t*, int> references;
+	int allocatedFrames = 0;
+	bool failNextRef = false;
+
+	int GetReferenced() {
+		int count = 0;
+		for (auto& reference : references) {
+			count += reference.second > 0;
+		}
+		return count;
+	}
+}
+
+extern "C" {
+	AVFrame* av_frame_alloc(void) {
+		allocatedFrames++;
+		return (AVFrame*)calloc(1, sizeof(AVFrame));
+	}
+
+	void av_frame_unref(AVFrame* frame) {
+		if (frame->data[0]) {
+			references[frame->data[0]]--;
+		}
+		memset(frame, 0, sizeof(AVFrame));
+	}
+
+	void av_frame_free(AVFrame** frame) {
+		if (!*frame) {
+			return;
+		}
+		av_frame_unref(*frame);
+		free(*frame);
+		*frame = nullptr;
+		allocatedFrames--;
+	}
+
+	int av_frame_ref(AVFrame* dst, const AVFrame* src) {
+		if (failNextRef) {
+			failNextRef = false;
+			return -12; // AVERROR(ENOMEM)
+		}
+		memcpy(dst, src, sizeof(AVFrame));
+		references[src->data[0]]++;
+		return 0;
+	}
+}
+
+namespace {
+	// 解码器的纹理池，只把没人引用的纹理拿来解下一帧
+	struct SurfacePool {
+		std::vector<uint8_t> surfaces;
+		AVFrame frame;
+
+		SurfacePool(int size) : surfaces(size), frame{} {}
+
+		// 解出一帧，没有空闲的纹理时返回 nullptr
+		const AVFrame* Decode(int64_t pts) {
+			for (auto& surface : surfaces) {
+				if (references[&surface] == 0) {
+					frame.data[0] = &surface;
+					frame.pts = pts;
+					return &frame;
+				}
+			}
+			return nullptr;
+		}
+	};
+
+	void TestOrder() {
+		SurfacePool pool(8);
+		{
+			FrameQueue queue(4);
+			NV_CHECK(queue.GetCapacity() == 4 && queue.GetSize() == 0 && !queue.IsFull());
+			NV_CHECK(queue.Pop() == nullptr && queue.GetCurrent() == nullptr);
+
+			// 按放进去的顺序出来，出来的帧在下一次 Pop 之前一直引用着
+			for (int i = 0; i < 3; i++) {
+				NV_CHECK(queue.Push(pool.Decode(i)) == 0);
+			}
+			NV_CHECK(queue.GetSize() == 3 && GetReferenced() == 3);
+			for (int i = 0; i < 3; i++) {
+				auto frame = queue.Pop();
+				NV_CHECK(frame != nullptr && frame->pts == i && queue.GetCurrent() == frame);
+				NV_CHECK(GetReferenced() == 3 - i);
+			}
+
+			// 空了之后 Pop 返回 nullptr，当前帧不变
+			auto current = queue.GetCurrent();
+			NV_CHECK(queue.Pop() == nullptr && queue.GetCurrent() == current && current->pts == 2);
+			NV_CHECK(GetReferenced() == 1);
+		}
+		// 析构放掉所有引用，分配的 AVFrame 都释放了
+		NV_CHECK(GetReferenced() == 0 && allocatedFrames == 0);
+	}
+
+	void TestFull() {
+		SurfacePool pool(8);
+		{
+			FrameQueue queue(3);
+			for (int i = 0; i < 3; i++) {
+				NV_CHECK(queue.Push(pool.Decode(i)) == 0);
+			}
+			NV_CHECK(queue.IsFull());
+
+			// 满了返回 -1，不引用新帧，队列不变
+			int referenced = GetReferenced();
+			NV_CHECK(queue.Push(pool.Decode(3)) == -1);
+			NV_CHECK(queue.GetSize() == 3 && GetReferenced() == referenced);
+			NV_CHECK(queue.Pop()->pts == 0);
+
+			// 引用失败也返回 -1，不漏掉分配的 AVFrame
+			failNextRef = true;
+			int allocated = allocatedFrames;
+			NV_CHECK(queue.Push(pool.Decode(3)) == -1);
+			NV_CHECK(allocatedFrames == allocated && queue.GetSize() == 2);
+		}
+		NV_CHECK(GetReferenced() == 0 && allocatedFrames == 0);
+	}
+
+	void TestFlush() {
+		SurfacePool pool(8);
+		FrameQueue queue(4);
+		for (int i = 0; i < 4; i++) {
+			queue.Push(pool.Decode(i));
+		}
+		queue.Pop();
+
+		// 排队的帧全部放掉，当前帧留到新的帧出来
+		queue.Flush();
+		NV_CHECK(queue.GetSize() == 0 && !queue.IsFull());
+		NV_CHECK(GetReferenced() == 1 && queue.GetCurrent()->pts == 0);
+		NV_CHECK(queue.Pop() == nullptr && queue.GetCurrent()->pts == 0);
+
+		NV_CHECK(queue.Push(pool.Decode(100)) == 0);
+		NV_CHECK(queue.Pop()->pts == 100 && GetReferenced() == 1);
+		queue.Flush();
+		NV_CHECK(GetReferenced() == 1);
+	}
+
+	void TestSurfaceBudget() {
+		// 和主循环一样：队列没满就一直解码，每次刷新取一帧，中间随机跳转。解码器额外留出 capacity + 1 个纹理，任何时候都有空闲的
+		auto& random = test::GetRandom();
+		for (int capacity : { 1, 2, 3, 5 }) {
+			SurfacePool pool(capacity + 1);
+			FrameQueue queue(capacity);
+			int64_t pts = 0;
+			int starved = 0, maxReferenced = 0;
+			for (int refresh = 0; refresh < 2000; refresh++) {
+				while (!queue.IsFull()) {
+					auto frame = pool.Decode(pts++);
+					if (!frame) {
+						starved++;
+						break;
+					}
+					queue.Push(frame);
+				}
+				maxReferenced = std::max(maxReferenced, GetReferenced());
+
+				// 有时候这次刷新不取帧（暂停、帧率低于刷新率），有时候跳转
+				int action = random() % 10;
+				if (action < 7) {
+					queue.Pop();
+				}
+				else if (action == 9) {
+					queue.Flush();
+				}
+			}
+			if (!NV_CHECK(starved == 0 && maxReferenced == capacity + 1)) {
+				printf("  capacity %d: starved %d times, up to %d surfaces referenced\n", capacity, starved, maxReferenced);
+			}
+		}
+		NV_CHECK(GetReferenced() == 0 && allocatedFrames == 0);
+
+		// 只留 capacity 个纹理就不够：队列满了再加上当前帧
+		SurfacePool pool(2);
+		FrameQueue queue(2);
+		queue.Push(pool.Decode(0));
+		queue.Push(pool.Decode(1));
+		queue.Pop();
+		NV_CHECK(pool.Decode(2) == nullptr);
+	}
+}
+
+int main() {
+	TestOrder();
+	TestFull();
+	TestFlush();
+	TestSurfaceBudget();
+	return test::Result();
+}
@@ -0,0 +1,212 @@
+#include "Check.h"
+#include "FrameWriter.h"
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <zlib.h>
+
+// PNG 编码用 zlib 解压回来、反过滤之后和原图逐字节比较，检查各种过滤方式和 LZ77 匹配都写对了，也检查压缩率
+// 加 --bench 测 1080p 的编码耗时和文件大小
+using namespace nv;
+
+namespace {
+	uint32_t GetBE32(const uint8_t* p) {
+		return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+	}
+
+	int Paeth(int a, int b, int c) {
+		int p = a + b - c;
+		int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+		return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+	}
+
+	// 只认 EncodePNG 写的 8 位 RGB、不隔行，解出来是 RGB
+	bool DecodePNG(const std::vector<uint8_t>& png, int& width, int& height, std::vector<uint8_t>& rgb, int filterCounts[5]) {
+		static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		if (png.size() < 8 || memcmp(png.data(), signature, 8) != 0) {
+			return false;
+		}
+
+		std::vector<uint8_t> compressed;
+		bool hasEnd = false;
+		width = height = 0;
+		size_t offset = 8;
+		while (offset + 12 <= png.size() && !hasEnd) {
+			uint32_t size = GetBE32(&png[offset]);
+			if (offset + 12 + size > png.size()) {
+				return false;
+			}
+			const uint8_t* type = &png[offset + 4];
+			const uint8_t* data = type + 4;
+			if (crc32(0, type, size + 4) != GetBE32(data + size)) {
+				return false;
+			}
+			if (memcmp(type, "IHDR", 4) == 0) {
+				const uint8_t expected[5] = { 8, 2, 0, 0, 0 };
+				if (size != 13 || memcmp(data + 8, expected, 5) != 0) {
+					return false;
+				}
+				width = (int)GetBE32(data);
+				height = (int)GetBE32(data + 4);
+			}
+			else if (memcmp(type, "IDAT", 4) == 0) {
+				compressed.insert(compressed.end(), data, data + size);
+			}
+			else if (memcmp(type, "IEND", 4) == 0) {
+				hasEnd = true;
+			}
+			offset += 12 + size;
+		}
+		if (!hasEnd || width <= 0 || height <= 0) {
+			return false;
+		}
+
+		// uncompress 会检查 zlib 头和 Adler-32，输出必须正好是这么长
+		size_t rowSize = (size_t)width * 3;
+		std::vector<uint8_t> filtered((rowSize + 1) * height);
+		uLongf filteredSize = (uLongf)filtered.size();
+		if (uncompress(filtered.data(), &filteredSize, compressed.data(), (uLong)compressed.size()) != Z_OK || filteredSize != filtered.size()) {
+			return false;
+		}
+
+		rgb.assign(rowSize * height, 0);
+		for (int y = 0; y < height; y++) {
+			const uint8_t* src = &filtered[(rowSize + 1) * y];
+			uint8_t* row = &rgb[rowSize * y];
+			const uint8_t* above = y > 0 ? row - rowSize : nullptr;
+			int type = src[0];
+			if (type > 4) {
+				return false;
+			}
+			filterCounts[type]++;
+			for (size_t x = 0; x < rowSize; x++) {
+				int a = x >= 3 ? row[x - 3] : 0;
+				int b = above ? above[x] : 0;
+				int c = above && x >= 3 ? above[x - 3] : 0;
+				int predicted = type == 0 ? 0 : type == 1 ? a : type == 2 ? b : type == 3 ? (a + b) / 2 : Paeth(a, b, c);
+				row[x] = (uint8_t)(src[x + 1] + predicted);
+			}
+		}
+		return true;
+	}
+
+	struct TestImage {
+		const char* name;
+		int width;
+		int height;
+		std::vector<uint8_t> rgba;
+		int pitch;
+	};
+
+	// 平滑的渐变加几块纯色和细线，像视频和界面截图；alpha 随便填，编码时应该被忽略
+	TestImage MakeImage(const char* name, int width, int height, int kind) {
+		TestImage image = { name, width, height, {}, width * 4 + (kind == 1 ? 12 : 0) };
+		image.rgba.assign((size_t)image.pitch * height, 0xCD);
+		auto& random = test::GetRandom();
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				uint8_t* p = &image.rgba[(size_t)y * image.pitch + x * 4];
+				if (kind == 0) {
+					// 噪声，压不下去
+					for (int c = 0; c < 4; c++) {
+						p[c] = (uint8_t)random();
+					}
+					continue;
+				}
+				double fx = (double)x / width, fy = (double)y / height;
+				p[0] = (uint8_t)(255 * fx);
+				p[1] = (uint8_t)(128 + 100 * sin(fx * 6 + fy * 3));
+				p[2] = (uint8_t)(255 * fy);
+				if (x > width / 4 && x < width / 2 && y > height / 4 && y < height / 2) {
+					p[0] = 30, p[1] = 60, p[2] = 90;
+				}
+				if (y % 16 == 0) {
+					p[0] = p[1] = p[2] = 255;
+				}
+				p[3] = (uint8_t)random();
+			}
+		}
+		return image;
+	}
+
+	void TestPNG() {
+		TestImage images[] = {
+			MakeImage("1x1", 1, 1, 2),
+			MakeImage("noise 3x2", 3, 2, 0),
+			MakeImage("noise 97x31", 97, 31, 0),
+			MakeImage("smooth 17x5 padded", 17, 5, 1),
+			MakeImage("smooth 640x360", 640, 360, 2),
+			MakeImage("smooth 1280x720 padded", 1280, 720, 1),
+		};
+		// 一整片相同的颜色，匹配全是最长的 258
+		TestImage flat = { "flat 300x200", 300, 200, std::vector<uint8_t>(300 * 200 * 4, 77), 300 * 4 };
+
+		for (auto* image : { &images[0], &images[1], &images[2], &images[3], &images[4], &images[5], &flat }) {
+			std::vector<uint8_t> png;
+			EncodeImage(ImageFormat::PNG, image->rgba.data(), image->pitch, image->width, image->height, png);
+
+			int width, height;
+			std::vector<uint8_t> rgb;
+			int filterCounts[5] = {};
+			if (!NV_CHECK(DecodePNG(png, width, height, rgb, filterCounts))) {
+				printf("  %s: not a valid PNG\n", image->name);
+				continue;
+			}
+			if (!NV_CHECK(width == image->width && height == image->height)) {
+				continue;
+			}
+			int mismatches = 0;
+			for (int y = 0; y < height; y++) {
+				for (int x = 0; x < width; x++) {
+					mismatches += memcmp(&rgb[((size_t)y * width + x) * 3], &image->rgba[(size_t)y * image->pitch + x * 4], 3) != 0;
+				}
+			}
+			if (!NV_CHECK(mismatches == 0)) {
+				printf("  %s: %d pixel(s) differ\n", image->name, mismatches);
+			}
+
+			// 平滑的画面至少压到 RGB 的四分之一，纯色的几乎不占地方；噪声也不能比 RGB 大太多
+			double ratio = (double)png.size() / rgb.size();
+			bool isSmooth = strncmp(image->name, "smooth", 6) == 0 && width >= 640;
+			bool isNoise = strncmp(image->name, "noise", 5) == 0;
+			if (!NV_CHECK(isSmooth ? ratio < 0.25 : image == &flat ? ratio < 0.01 : !isNoise || png.size() < rgb.size() * 1.15 + 100)) {
+				printf("  %s: %zu bytes, %.1f%% of RGB\n", image->name, png.size(), ratio * 100);
+			}
+			// 平滑的画面上行间预测比不过滤好，应该用到了 0 之外的过滤方式
+			if (isSmooth) {
+				NV_CHECK(filterCounts[0] < height);
+			}
+		}
+	}
+
+	void TestSuffix() {
+		NV_CHECK(GetImageFileSuffix(ImageFormat::PNG, 4, 2) == ".png");
+		NV_CHECK(GetImageFileSuffix(ImageFormat::QOI, 4, 2) == ".qoi");
+		NV_CHECK(GetImageFileSuffix(ImageFormat::Raw, 4, 2) == "_4x2.rgba");
+	}
+
+	void Bench() {
+		auto image = MakeImage("smooth 1920x1080", 1920, 1080, 2);
+		printf("%-6s %10s %10s  (1920x1080, RGB is %d bytes)\n", "format", "ms", "bytes", 1920 * 1080 * 3);
+		for (auto format : { ImageFormat::PNG, ImageFormat::QOI, ImageFormat::Raw }) {
+			std::vector<uint8_t> out;
+			double best = 1e30;
+			for (int i = 0; i < 5; i++) {
+				auto start = std::chrono::steady_clock::now();
+				EncodeImage(format, image.rgba.data(), image.pitch, image.width, image.height, out);
+				best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+			}
+			printf("%-6s %10.1f %10zu\n", GetImageFormatName(format), best, out.size());
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+		Bench();
+		return 0;
+	}
+	TestPNG();
+	TestSuffix();
+	return test::Result();
+}
@@ -0,0 +1,252 @@
+#include "Check.h"
+#include "LoopScheduler.h"
+#include <math.h>
+#include <deque>
+#include <algorithm>
+
+// 主循环的唤醒次数：暂停且没有事件时一直睡，播放时每个要换帧的刷新醒一次，解码器、音频低水位的事件到了马上醒
+// LoopWaiter 换成模拟时钟，Wait 直接跳到超时或者下一个事件，一小时的播放瞬间跑完
+using namespace nv;
+
+namespace {
+	class FakeWaiter : public LoopWaiter {
+	public:
+		FakeWaiter(double end_) : now(0), end(end_) {}
+
+		double Now() override {
+			return now;
+		}
+
+		bool Wait(double timeoutSeconds) override {
+			double until = timeoutSeconds < 0 ? end : std::min(now + timeoutSeconds, end);
+			if (!events.empty() && events.front() <= until) {
+				now = std::max(now, events.front());
+				events.pop_front();
+				return true;
+			}
+			now = until;
+			return false;
+		}
+
+		// 在 time 触发一次事件
+		void Signal(double time) {
+			events.insert(std::upper_bound(events.begin(), events.end(), time), time);
+		}
+
+		// 过了 end 就结束模拟
+		bool IsOver() {
+			return now >= end;
+		}
+
+		double now;
+		double end;
+		std::deque<double> events;
+	};
+
+	// 跑主循环直到模拟结束，返回每次醒来的时间，结束时那一次不算
+	// 登记的时间到了却没清掉会在同一时刻空转，转了 100 次就算失败
+	template<typename Body>
+	std::vector<double> Run(FakeWaiter& waiter, LoopScheduler& scheduler, Body body) {
+		std::vector<double> times;
+		int spins = 0;
+		while (1) {
+			scheduler.Wait();
+			if (waiter.IsOver()) {
+				break;
+			}
+			spins = !times.empty() && times.back() == waiter.now ? spins + 1 : 0;
+			if (!NV_CHECK(spins < 100)) {
+				printf("  spinning at %.6f s\n", waiter.now);
+				break;
+			}
+			times.push_back(waiter.now);
+			body();
+		}
+		return times;
+	}
+
+	// main.cpp 里播放视频的那部分：按 presentLatency 之后的刷新次数换帧，登记下一帧到期的刷新
+	struct Player {
+		FakeWaiter& waiter;
+		LoopScheduler& scheduler;
+		DisplayClock clock;
+		double freqRatio;
+		double presentLatency;
+		int frameCount;
+		bool isPlaying;
+		// 每次醒来时的刷新次数，和其中换了帧的那些
+		std::vector<int> counts;
+		std::vector<int> frameCounts;
+
+		Player(FakeWaiter& waiter_, LoopScheduler& scheduler_, double displayFreq, double frameFreq)
+			: waiter(waiter_), scheduler(scheduler_), clock(displayFreq), freqRatio(displayFreq / frameFreq),
+			presentLatency(0.02), frameCount(1), isPlaying(true) {
+			clock.Reset(waiter.Now(), 1);
+		}
+
+		void Update() {
+			double now = waiter.Now();
+			if (isPlaying) {
+				clock.Resume(now);
+			}
+			else {
+				clock.Pause(now);
+			}
+
+			int displayCount = clock.GetCount(now + presentLatency);
+			counts.push_back(displayCount);
+			bool isNewFrame = false;
+			while (frameCount == 1 || (freqRatio < (double)displayCount / frameCount && isPlaying)) {
+				frameCount++;
+				isNewFrame = true;
+			}
+			if (isNewFrame) {
+				frameCounts.push_back(displayCount);
+			}
+
+			if (isPlaying) {
+				int nextDisplayCount = (int)floor(frameCount * freqRatio) + 1;
+				scheduler.RequestAt(clock.GetTime(nextDisplayCount) - presentLatency);
+			}
+		}
+	};
+
+	// 从第 first 次刷新起逐次刷新地推，要换帧的那些刷新
+	std::vector<int> GetFrameDeadlines(double freqRatio, int first, int last) {
+		std::vector<int> deadlines;
+		int frameCount = 1;
+		for (int count = first; count <= last; count++) {
+			bool isNewFrame = false;
+			while (frameCount == 1 || freqRatio < (double)count / frameCount) {
+				frameCount++;
+				isNewFrame = true;
+			}
+			if (isNewFrame) {
+				deadlines.push_back(count);
+			}
+		}
+		return deadlines;
+	}
+
+	void TestPausedIdle() {
+		FakeWaiter waiter(3600);
+		LoopScheduler scheduler(&waiter);
+		// 启动时画一帧，之后暂停着没有任何事件，一小时都不该再醒
+		auto times = Run(waiter, scheduler, [] {});
+		NV_CHECK(times.size() == 1 && times[0] == 0);
+		NV_CHECK(scheduler.GetWakeups() == 2 && scheduler.GetEventWakeups() == 0);
+
+		// 一次输入（窗口消息也是事件）之后多画 3 帧，然后接着睡
+		FakeWaiter inputWaiter(3600);
+		LoopScheduler inputScheduler(&inputWaiter);
+		inputWaiter.Signal(100);
+		uint64_t eventWakeups = 0;
+		times = Run(inputWaiter, inputScheduler, [&] {
+			if (inputScheduler.GetEventWakeups() > eventWakeups) {
+				eventWakeups = inputScheduler.GetEventWakeups();
+				inputScheduler.RequestFrames(3);
+			}
+		});
+		NV_CHECK(times.size() == 5 && times.back() == 100);
+	}
+
+	void TestPlaying() {
+		struct Case {
+			double displayFreq;
+			double frameFreq;
+		};
+		for (auto c : { Case{ 60, 24 }, Case{ 60, 24000 / 1001.0 }, Case{ 60, 60 }, Case{ 144, 60 }, Case{ 59.94, 29.97 }, Case{ 50, 60 } }) {
+			constexpr double pauseTime = 60;
+			FakeWaiter waiter(3600);
+			LoopScheduler scheduler(&waiter);
+			Player player(waiter, scheduler, c.displayFreq, c.frameFreq);
+			// 一分钟后点暂停
+			waiter.Signal(pauseTime);
+			auto times = Run(waiter, scheduler, [&] {
+				if (waiter.now == pauseTime) {
+					player.isPlaying = false;
+				}
+				player.Update();
+			});
+
+			// 播放中每次醒来都换了帧（暂停那次是点击），也没有漏掉哪次要换帧的刷新
+			size_t beforePause = std::count_if(times.begin(), times.end(), [&](double t) { return t < pauseTime; });
+			std::vector<int> playing(player.counts.begin(), player.counts.begin() + beforePause);
+			auto deadlines = GetFrameDeadlines(player.freqRatio, playing.front(), playing.back());
+			if (!NV_CHECK(playing == deadlines)) {
+				printf("  %.3f Hz display, %.3f fps: %zu wakeups, %zu frame deadlines\n",
+					c.displayFreq, c.frameFreq, playing.size(), deadlines.size());
+			}
+
+			// 暂停之后，最多还有一次之前登记的换帧时间，然后一直睡到结束
+			size_t afterPause = std::count_if(times.begin(), times.end(), [&](double t) { return t > pauseTime; });
+			NV_CHECK(afterPause <= 1);
+			NV_CHECK(std::none_of(times.begin(), times.end(), [&](double t) { return t > pauseTime + 1 / c.frameFreq; }));
+		}
+	}
+
+	void TestEvents() {
+		// 暂停时音频在播（只有音频的文件）：每次低于低水位醒一次去解码，别的时候不醒
+		{
+			FakeWaiter waiter(3600);
+			LoopScheduler scheduler(&waiter);
+			for (int i = 1; i <= 40; i++) {
+				waiter.Signal(i * 0.25);
+			}
+			auto times = Run(waiter, scheduler, [] {});
+			NV_CHECK(times.size() == 41);
+			NV_CHECK(scheduler.GetEventWakeups() == 40);
+			for (int i = 1; i < (int)times.size(); i++) {
+				NV_CHECK(times[i] == i * 0.25);
+			}
+		}
+
+		// 播放视频时解码器有帧了、音频低于低水位都会在两次换帧中间醒来，换帧的刷新一次不多一次不少
+		{
+			FakeWaiter waiter(30);
+			LoopScheduler scheduler(&waiter);
+			Player player(waiter, scheduler, 60, 24);
+			int events = 0;
+			for (double t = 0.013; t < 30; t += 0.1) {
+				waiter.Signal(t);
+				events++;
+			}
+			for (double t = 0.107; t < 30; t += 0.25) {
+				waiter.Signal(t);
+				events++;
+			}
+			auto times = Run(waiter, scheduler, [&] { player.Update(); });
+
+			auto deadlines = GetFrameDeadlines(player.freqRatio, player.counts.front(), player.counts.back());
+			NV_CHECK(player.frameCounts == deadlines);
+			NV_CHECK((int)scheduler.GetEventWakeups() == events);
+			NV_CHECK(times.size() == deadlines.size() + events);
+		}
+	}
+
+	void TestDisplayClock() {
+		DisplayClock clock(60);
+		clock.Reset(10, 100);
+		NV_CHECK(clock.GetCount(10) == 100);
+		// 刚好在 GetTime 的时刻取次数，不能因为舍入少算
+		for (int count = 100; count < 10000; count++) {
+			if (!NV_CHECK(clock.GetCount(clock.GetTime(count)) == count)) {
+				break;
+			}
+		}
+
+		// 暂停时停走，GetTime 为无穷大；继续后从暂停的次数接着数
+		clock.Pause(11);
+		NV_CHECK(clock.GetCount(20) == 160 && std::isinf(clock.GetTime(161)));
+		clock.Resume(20);
+		NV_CHECK(clock.GetCount(20.5) == 190);
+	}
+}
+
+int main() {
+	TestPausedIdle();
+	TestPlaying();
+	TestEvents();
+	TestDisplayClock();
+	return test::Result();
+}
@@ -0,0 +1,168 @@
+#include "Check.h"
+#include "LoudnessMeter.h"
+#include <math.h>
+#include <complex>
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+}
+
+// EBU R128 响度计：K 加权滤波的频率响应和 BS.1770 给出的 48 kHz 系数一致，其它采样率的响应也一样；
+// EBU Tech 3341 的最小要求测试信号（case 1~6）测出来在 ±0.1 LU 以内；LFE 不计，环绕声道按 1.41 计；分多少次喂数据结果都一样
+using namespace nv;
+
+namespace {
+	constexpr double pi = 3.14159265358979323846;
+
+	// 一段正弦：每个声道的峰值（dBFS，-999 表示静音）和时长
+	struct Segment {
+		std::vector<double> levels;
+		double seconds;
+	};
+
+	// 按 chunk 帧一次喂给响度计，chunk 为 0 时一次喂完
+	double Measure(LoudnessMeter& meter, int sampleRate, double frequency, const std::vector<Segment>& segments, uint32_t chunk = 0) {
+		int channels = (int)segments[0].levels.size();
+		std::vector<float> data;
+		uint64_t t = 0;
+		for (auto& segment : segments) {
+			uint64_t frames = (uint64_t)llround(segment.seconds * sampleRate);
+			for (uint64_t i = 0; i < frames; i++, t++) {
+				float v = (float)sin(2 * pi * frequency * t / sampleRate);
+				for (int c = 0; c < channels; c++) {
+					data.push_back(segment.levels[c] < -900 ? 0.0f : v * (float)pow(10, segment.levels[c] / 20));
+				}
+			}
+		}
+
+		uint32_t total = (uint32_t)(data.size() / channels);
+		for (uint32_t done = 0; done < total;) {
+			uint32_t n = chunk == 0 ? total : std::min(chunk, total - done);
+			meter.Process(&data[(size_t)done * channels], n);
+			done += n;
+		}
+		return meter.GetIntegratedLoudness();
+	}
+
+	double MeasureStereo(int sampleRate, const std::vector<std::pair<double, double>>& levels) {
+		LoudnessMeter meter(2, sampleRate, AV_CH_LAYOUT_STEREO);
+		std::vector<Segment> segments;
+		for (auto& level : levels) {
+			segments.push_back({ { level.first, level.first }, level.second });
+		}
+		return Measure(meter, sampleRate, 1000, segments);
+	}
+
+	bool CheckLoudness(const char* name, double measured, double expected, double tolerance = 0.1) {
+		bool ok = NV_CHECK(fabs(measured - expected) <= tolerance);
+		if (!ok) {
+			printf("  %s: %.3f LUFS, expected %.3f\n", name, measured, expected);
+		}
+		return ok;
+	}
+
+	void TestTech3341() {
+		// 1 kHz 的立体声正弦，每个声道的峰值和时长
+		for (int sampleRate : { 44100, 48000, 96000 }) {
+			CheckLoudness("case 1", MeasureStereo(sampleRate, { { -23, 20 } }), -23);
+			CheckLoudness("case 2", MeasureStereo(sampleRate, { { -33, 20 } }), -33);
+			// 相对门限把前后安静的部分去掉
+			CheckLoudness("case 3", MeasureStereo(sampleRate, { { -36, 10 }, { -23, 60 }, { -36, 10 } }), -23);
+			// 绝对门限去掉 -72 的部分，相对门限去掉 -36 的部分
+			CheckLoudness("case 4", MeasureStereo(sampleRate, { { -72, 10 }, { -36, 10 }, { -23, 60 }, { -36, 10 }, { -72, 10 } }), -23);
+			// 三段的能量平均
+			CheckLoudness("case 5", MeasureStereo(sampleRate, { { -26, 20.1 }, { -20, 20.1 }, { -26, 20.1 } }), -23);
+		}
+
+		// case 6：5.0，L/R 是 -28 dBFS，C 是 -24 dBFS，环绕是 -30 dBFS，环绕按 1.41 的权重加起来是 -23
+		const uint64_t layout50 = AV_CH_LAYOUT_STEREO | 0x4 | AV_CH_SIDE_LEFT | AV_CH_SIDE_RIGHT;
+		LoudnessMeter meter(5, 48000, layout50);
+		CheckLoudness("case 6", Measure(meter, 48000, 1000, { { { -28, -28, -24, -30, -30 }, 20 } }), -23);
+	}
+
+	void TestKWeighting() {
+		// BS.1770-4 表 1、表 2 的 48 kHz 系数
+		const double shelf[5] = { 1.53512485958697, -2.69169618940638, 1.19839281085285, -1.69065929318241, 0.73248077421585 };
+		const double highPass[5] = { 1.0, -2.0, 1.0, -1.99004745483398, 0.99007225036621 };
+		auto response = [](const double* c, double w) {
+			std::complex<double> z1 = std::polar(1.0, -w), z2 = std::polar(1.0, -2 * w);
+			return std::abs((c[0] + c[1] * z1 + c[2] * z2) / (1.0 + c[3] * z1 + c[4] * z2));
+		};
+
+		// 单声道满幅正弦的响度 = -0.691 + 10 log10(|H|^2 / 2)，各采样率都应该和 48 kHz 的标准系数一样（高频离奈奎斯特远的部分）
+		for (int sampleRate : { 44100, 48000, 96000 }) {
+			for (double frequency : { 40.0, 100.0, 500.0, 1000.0, 2000.0, 5000.0, 10000.0 }) {
+				double w = 2 * pi * frequency / 48000;
+				double gain = response(shelf, w) * response(highPass, w);
+				double expected = -0.691 + 10 * log10(gain * gain / 2);
+				LoudnessMeter meter(1, sampleRate, 0);
+				double measured = Measure(meter, sampleRate, frequency, { { { 0 }, 5 } });
+				if (!NV_CHECK(fabs(measured - expected) <= 0.05)) {
+					printf("  %d Hz at %d Hz: %.3f LUFS, expected %.3f\n", (int)frequency, sampleRate, measured, expected);
+				}
+			}
+		}
+	}
+
+	void TestGating() {
+		// 全部低于绝对门限：没有结果
+		LoudnessMeter quiet(2, 48000, AV_CH_LAYOUT_STEREO);
+		Measure(quiet, 48000, 1000, { { { -75, -75 }, 5 } });
+		NV_CHECK(!quiet.HasResult());
+		NV_CHECK(quiet.GetIntegratedLoudness() == -70);
+
+		// 不到 400ms 也没有结果
+		LoudnessMeter shortMeter(2, 48000, AV_CH_LAYOUT_STEREO);
+		Measure(shortMeter, 48000, 1000, { { { -23, -23 }, 0.35 } });
+		NV_CHECK(!shortMeter.HasResult());
+		Measure(shortMeter, 48000, 1000, { { { -23, -23 }, 0.1 } });
+		NV_CHECK(shortMeter.HasResult());
+		NV_CHECK(fabs(shortMeter.GetMeasuredSeconds() - 0.45) < 1e-9);
+
+		// Reset 之后从头开始
+		shortMeter.Reset();
+		NV_CHECK(!shortMeter.HasResult() && shortMeter.GetMeasuredSeconds() == 0);
+	}
+
+	void TestChannelWeights() {
+		// 5.1 的 LFE 不计：只有 LFE 有声音时低于门限
+		const uint64_t layout51 = AV_CH_LAYOUT_STEREO | 0x4 | AV_CH_LOW_FREQUENCY | AV_CH_SIDE_LEFT | AV_CH_SIDE_RIGHT;
+		LoudnessMeter lfe(6, 48000, layout51);
+		Measure(lfe, 48000, 1000, { { { -999, -999, -999, 0, -999, -999 }, 2 } });
+		NV_CHECK(!lfe.HasResult());
+
+		// 同样的信号放在环绕声道上比放在前置声道上大 10 log10(1.41) = 1.49 LU
+		LoudnessMeter front(6, 48000, layout51), surround(6, 48000, layout51);
+		double a = Measure(front, 48000, 1000, { { { -20, -999, -999, -999, -999, -999 }, 5 } });
+		double b = Measure(surround, 48000, 1000, { { { -999, -999, -999, -999, -20, -999 }, 5 } });
+		CheckLoudness("surround weight", b - a, 10 * log10(1.41), 0.01);
+
+		// 布局为 0 或者和声道数对不上时都按 1 计
+		LoudnessMeter unknown(6, 48000, 0);
+		double c = Measure(unknown, 48000, 1000, { { { -999, -999, -999, -999, -20, -999 }, 5 } });
+		CheckLoudness("no layout", c, a, 0.01);
+	}
+
+	void TestChunking() {
+		// 和子块边界对不齐的各种长度，结果和一次喂完相同
+		double reference = 0;
+		for (uint32_t chunk : { 0u, 1u, 7u, 480u, 1023u, 4801u }) {
+			LoudnessMeter meter(6, 48000, 0);
+			double measured = Measure(meter, 48000, 997, { { { -20, -25, -30, -35, -40, -45 }, 3 }, { { -30, -20, -25, -40, -35, -45 }, 3 } }, chunk);
+			if (chunk == 0) {
+				reference = measured;
+			}
+			NV_CHECK(fabs(measured - reference) < 1e-9);
+		}
+	}
+}
+
+int main() {
+	TestTech3341();
+	TestKWeighting();
+	TestGating();
+	TestChannelWeights();
+	TestChunking();
+	return test::Result();
+}
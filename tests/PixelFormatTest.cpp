@@ -0,0 +1,271 @@
+#include "Check.h"
+#include "PixelFormat.h"
+#include "YUVConvert.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+// 像素格式的一致性检查：
+// 1. GetPixelFormatDesc 推出的布局和手写的表一致（yuv444p10 以前被当成 P010），不支持的格式返回 false
+// 2. 每个平面的行宽、行数和 libavutil 的 av_image_fill_linesizes、av_image_fill_plane_sizes 一致
+// 3. 用 libswscale 把同一张 RGB 参考图编码成每种格式（平面按 av_image_* 分配，不经过 GetPixelFormatDesc），
+//    再按 GetPixelFormatDesc 选的 CPU 转换解码回 RGBA，和 libswscale 自己解码的结果、原图比较
+using namespace nv;
+
+namespace {
+	struct Layout {
+		AVPixelFormat format;
+		bool isRGB;
+		int bitDepth;
+		int sampleShift;
+		int chromaShiftX;
+		int chromaShiftY;
+		int planeCount;
+		PlaneDesc planes[PixelFormatDesc::maxPlanes];
+		ComponentDesc components[3];
+	};
+
+	constexpr PlaneDesc luma8 = { 1, 1, 0, 0 }, luma16 = { 1, 2, 0, 0 };
+	constexpr ComponentDesc planar[3] = { { 0, 0 }, { 1, 0 }, { 2, 0 } };
+	constexpr ComponentDesc semiPlanar[3] = { { 0, 0 }, { 1, 0 }, { 1, 1 } };
+
+	const Layout layouts[] = {
+		{ AV_PIX_FMT_YUV420P, false, 8, 0, 1, 1, 3, { luma8, { 1, 1, 1, 1 }, { 1, 1, 1, 1 } }, { planar[0], planar[1], planar[2] } },
+		{ AV_PIX_FMT_YUV422P, false, 8, 0, 1, 0, 3, { luma8, { 1, 1, 1, 0 }, { 1, 1, 1, 0 } }, { planar[0], planar[1], planar[2] } },
+		{ AV_PIX_FMT_YUV444P, false, 8, 0, 0, 0, 3, { luma8, luma8, luma8 }, { planar[0], planar[1], planar[2] } },
+		{ AV_PIX_FMT_YUV420P10LE, false, 10, 0, 1, 1, 3, { luma16, { 1, 2, 1, 1 }, { 1, 2, 1, 1 } }, { planar[0], planar[1], planar[2] } },
+		{ AV_PIX_FMT_YUV422P10LE, false, 10, 0, 1, 0, 3, { luma16, { 1, 2, 1, 0 }, { 1, 2, 1, 0 } }, { planar[0], planar[1], planar[2] } },
+		{ AV_PIX_FMT_YUV444P10LE, false, 10, 0, 0, 0, 3, { luma16, luma16, luma16 }, { planar[0], planar[1], planar[2] } },
+		{ AV_PIX_FMT_YUV420P12LE, false, 12, 0, 1, 1, 3, { luma16, { 1, 2, 1, 1 }, { 1, 2, 1, 1 } }, { planar[0], planar[1], planar[2] } },
+		{ AV_PIX_FMT_YUV422P12LE, false, 12, 0, 1, 0, 3, { luma16, { 1, 2, 1, 0 }, { 1, 2, 1, 0 } }, { planar[0], planar[1], planar[2] } },
+		{ AV_PIX_FMT_YUV444P12LE, false, 12, 0, 0, 0, 3, { luma16, luma16, luma16 }, { planar[0], planar[1], planar[2] } },
+		{ AV_PIX_FMT_YUV420P16LE, false, 16, 0, 1, 1, 3, { luma16, { 1, 2, 1, 1 }, { 1, 2, 1, 1 } }, { planar[0], planar[1], planar[2] } },
+		{ AV_PIX_FMT_NV12, false, 8, 0, 1, 1, 2, { luma8, { 2, 1, 1, 1 } }, { semiPlanar[0], semiPlanar[1], semiPlanar[2] } },
+		{ AV_PIX_FMT_NV21, false, 8, 0, 1, 1, 2, { luma8, { 2, 1, 1, 1 } }, { { 0, 0 }, { 1, 1 }, { 1, 0 } } },
+		{ AV_PIX_FMT_NV16, false, 8, 0, 1, 0, 2, { luma8, { 2, 1, 1, 0 } }, { semiPlanar[0], semiPlanar[1], semiPlanar[2] } },
+		{ AV_PIX_FMT_P010LE, false, 10, 6, 1, 1, 2, { luma16, { 2, 2, 1, 1 } }, { semiPlanar[0], semiPlanar[1], semiPlanar[2] } },
+		{ AV_PIX_FMT_P016LE, false, 16, 0, 1, 1, 2, { luma16, { 2, 2, 1, 1 } }, { semiPlanar[0], semiPlanar[1], semiPlanar[2] } },
+		{ AV_PIX_FMT_P210LE, false, 10, 6, 1, 0, 2, { luma16, { 2, 2, 1, 0 } }, { semiPlanar[0], semiPlanar[1], semiPlanar[2] } },
+		{ AV_PIX_FMT_P410LE, false, 10, 6, 0, 0, 2, { luma16, { 2, 2, 0, 0 } }, { semiPlanar[0], semiPlanar[1], semiPlanar[2] } },
+		{ AV_PIX_FMT_RGBA, true, 8, 0, 0, 0, 1, { { 4, 1, 0, 0 } }, { { 0, 0 }, { 0, 1 }, { 0, 2 } } },
+		{ AV_PIX_FMT_BGRA, true, 8, 0, 0, 0, 1, { { 4, 1, 0, 0 } }, { { 0, 2 }, { 0, 1 }, { 0, 0 } } },
+		{ AV_PIX_FMT_ARGB, true, 8, 0, 0, 0, 1, { { 4, 1, 0, 0 } }, { { 0, 1 }, { 0, 2 }, { 0, 3 } } },
+		{ AV_PIX_FMT_ABGR, true, 8, 0, 0, 0, 1, { { 4, 1, 0, 0 } }, { { 0, 3 }, { 0, 2 }, { 0, 1 } } },
+		{ AV_PIX_FMT_RGB0, true, 8, 0, 0, 0, 1, { { 4, 1, 0, 0 } }, { { 0, 0 }, { 0, 1 }, { 0, 2 } } },
+		{ AV_PIX_FMT_BGR0, true, 8, 0, 0, 0, 1, { { 4, 1, 0, 0 } }, { { 0, 2 }, { 0, 1 }, { 0, 0 } } },
+		// 平面 RGB 的平面顺序是 G、B、R
+		{ AV_PIX_FMT_GBRP, true, 8, 0, 0, 0, 3, { luma8, luma8, luma8 }, { { 2, 0 }, { 0, 0 }, { 1, 0 } } },
+	};
+
+	bool operator==(const PlaneDesc& a, const PlaneDesc& b) {
+		return a.channels == b.channels && a.bytesPerChannel == b.bytesPerChannel && a.widthShift == b.widthShift && a.heightShift == b.heightShift;
+	}
+
+	bool operator==(const ComponentDesc& a, const ComponentDesc& b) {
+		return a.plane == b.plane && a.channel == b.channel;
+	}
+
+	void TestLayouts() {
+		for (auto& layout : layouts) {
+			PixelFormatDesc desc;
+			if (!NV_CHECK(GetPixelFormatDesc(layout.format, desc))) {
+				printf("  %s is not supported\n", av_get_pix_fmt_name(layout.format));
+				continue;
+			}
+			bool ok = desc.format == layout.format && desc.isRGB == layout.isRGB && desc.bitDepth == layout.bitDepth
+				&& desc.sampleShift == layout.sampleShift && desc.chromaShiftX == layout.chromaShiftX
+				&& desc.chromaShiftY == layout.chromaShiftY && desc.planeCount == layout.planeCount;
+			for (int i = 0; i < layout.planeCount; i++) {
+				ok = ok && desc.planes[i] == layout.planes[i];
+			}
+			for (int c = 0; c < 3; c++) {
+				ok = ok && desc.components[c] == layout.components[c];
+			}
+			if (!NV_CHECK(ok)) {
+				printf("  %s: layout differs\n", av_get_pix_fmt_name(layout.format));
+			}
+		}
+
+		// 调色板、打包的 24 位 RGB、亮度色度交错、硬件帧、10 位打包 RGB、只有亮度的格式都不支持
+		for (auto format : { AV_PIX_FMT_PAL8, AV_PIX_FMT_RGB24, AV_PIX_FMT_YUYV422, AV_PIX_FMT_D3D11, AV_PIX_FMT_X2RGB10LE, AV_PIX_FMT_GRAY8, AV_PIX_FMT_NONE }) {
+			PixelFormatDesc desc;
+			if (!NV_CHECK(!GetPixelFormatDesc(format, desc))) {
+				printf("  %s should not be supported\n", av_get_pix_fmt_name(format));
+			}
+		}
+	}
+
+	// 按 libavutil 分配的一帧，每行多留 padding 字节，空白处写成 0xCD
+	struct ImageBuffer {
+		int linesize[4];
+		std::vector<uint8_t> planes[4];
+		uint8_t* data[4];
+	};
+
+	bool AllocImage(AVPixelFormat format, int width, int height, int padding, ImageBuffer& image) {
+		if (av_image_fill_linesizes(image.linesize, format, width) < 0) {
+			return false;
+		}
+		ptrdiff_t linesizes[4];
+		for (int i = 0; i < 4; i++) {
+			image.linesize[i] += image.linesize[i] ? padding : 0;
+			linesizes[i] = image.linesize[i];
+		}
+		size_t sizes[4];
+		if (av_image_fill_plane_sizes(sizes, format, height, linesizes) < 0) {
+			return false;
+		}
+		for (int i = 0; i < 4; i++) {
+			image.planes[i].assign(sizes[i], 0xCD);
+			image.data[i] = sizes[i] ? image.planes[i].data() : nullptr;
+		}
+		return true;
+	}
+
+	// 各种宽高（包括奇数，色度平面向上取整）下 GetPlaneWidth/GetPlaneHeight 和 libavutil 分配的平面一样大
+	void TestPlaneSizes() {
+		for (auto& layout : layouts) {
+			PixelFormatDesc desc;
+			if (!GetPixelFormatDesc(layout.format, desc)) {
+				continue;
+			}
+			for (auto size : { std::make_pair(1, 1), std::make_pair(2, 2), std::make_pair(127, 71), std::make_pair(1920, 1080), std::make_pair(3840, 2161) }) {
+				ImageBuffer image;
+				if (!NV_CHECK(AllocImage(layout.format, size.first, size.second, 0, image))) {
+					continue;
+				}
+				bool ok = image.linesize[desc.planeCount] == 0 || desc.planeCount == PixelFormatDesc::maxPlanes;
+				for (int i = 0; i < desc.planeCount; i++) {
+					auto& plane = desc.planes[i];
+					int rowBytes = GetPlaneWidth(desc, i, size.first) * plane.channels * plane.bytesPerChannel;
+					ok = ok && image.linesize[i] == rowBytes
+						&& image.planes[i].size() == (size_t)rowBytes * GetPlaneHeight(desc, i, size.second);
+				}
+				if (!NV_CHECK(ok)) {
+					printf("  %s %dx%d: plane sizes differ from libavutil\n", av_get_pix_fmt_name(layout.format), size.first, size.second);
+				}
+			}
+		}
+	}
+
+	// 平滑的参考图：R 横向、G 纵向渐变，B 两个方向都起伏
+	std::vector<uint8_t> MakeReference(int width, int height) {
+		std::vector<uint8_t> rgba((size_t)width * height * 4);
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				uint8_t* p = &rgba[((size_t)y * width + x) * 4];
+				p[0] = (uint8_t)lround(20 + 215.0 * x / (width - 1));
+				p[1] = (uint8_t)lround(230 - 200.0 * y / (height - 1));
+				p[2] = (uint8_t)lround(128 + 90 * sin(6.28 * x / width) * cos(3.14 * y / height));
+				p[3] = 0xFF;
+			}
+		}
+		return rgba;
+	}
+
+	// RGB 和 YUV 之间按有限范围 BT.709 转换。accurate 的标志和 YUVConvertTest 一样：色度按全分辨率插值、精确取整
+	SwsContext* CreateSws(AVPixelFormat src, AVPixelFormat dst, int width, int height) {
+		auto sws = sws_getContext(width, height, src, width, height, dst, SWS_BILINEAR | SWS_ACCURATE_RND | SWS_FULL_CHR_H_INT | SWS_FULL_CHR_H_INP, nullptr, nullptr, nullptr);
+		if (sws) {
+			auto coefficients = sws_getCoefficients(SWS_CS_ITU709);
+			sws_setColorspaceDetails(sws, coefficients, src == AV_PIX_FMT_RGBA ? 1 : 0, coefficients, dst == AV_PIX_FMT_RGBA ? 1 : 0, 0, 1 << 16, 1 << 16);
+		}
+		return sws;
+	}
+
+	struct Diff {
+		int max;
+		double mean;
+	};
+
+	Diff Compare(const std::vector<uint8_t>& a, int aPitch, const std::vector<uint8_t>& b, int bPitch, int width, int height) {
+		Diff diff = {};
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				for (int c = 0; c < 3; c++) {
+					int d = abs(a[(size_t)y * aPitch + x * 4 + c] - b[(size_t)y * bPitch + x * 4 + c]);
+					diff.max = std::max(diff.max, d);
+					diff.mean += d;
+				}
+			}
+		}
+		diff.mean /= (double)width * height * 3;
+		return diff;
+	}
+
+	void TestRoundTrip() {
+		constexpr int width = 255, height = 143;
+		auto reference = MakeReference(width, height);
+		const uint8_t* referenceData[4] = { reference.data() };
+		int referenceLinesize[4] = { width * 4 };
+
+		for (auto& layout : layouts) {
+			auto format = layout.format;
+			PixelFormatDesc desc;
+			auto convert = GetYUVConverter(format, RGBFormat::RGBA8);
+			// 平面 RGB 和 NV21 只走 GPU
+			if (!GetPixelFormatDesc(format, desc) || !convert) {
+				NV_CHECK(format == AV_PIX_FMT_GBRP || format == AV_PIX_FMT_NV21);
+				continue;
+			}
+
+			// 编码
+			ImageBuffer image;
+			auto encoder = CreateSws(AV_PIX_FMT_RGBA, format, width, height);
+			if (!NV_CHECK(encoder && AllocImage(format, width, height, 24, image))) {
+				sws_freeContext(encoder);
+				continue;
+			}
+			sws_scale(encoder, referenceData, referenceLinesize, 0, height, image.data, image.linesize);
+			sws_freeContext(encoder);
+
+			// 按 GetPixelFormatDesc 解码，和 SoftwareRenderer 一样按 CPU 计算的位深生成系数
+			YUVCoeffs coeffs = {};
+			int bitDepth = GetYUVBitDepth(format);
+			ColorDescription colorDesc = { desc.isRGB ? AVCOL_SPC_RGB : AVCOL_SPC_BT709, AVCOL_RANGE_MPEG, AVCOL_PRI_BT709, height, bitDepth, bitDepth > 8 ? 16 - bitDepth : 0 };
+			if (!desc.isRGB && !NV_CHECK(GetYUVCoeffs(format, RGBFormat::RGBA8, GetYUVMatrix(colorDesc), coeffs))) {
+				continue;
+			}
+			int pitch = width * 4 + 12;
+			std::vector<uint8_t> ours((size_t)pitch * height, 0x5A);
+			convert(image.data, image.linesize, width, height, ours.data(), pitch, coeffs);
+
+			// libswscale 解码同一份数据
+			std::vector<uint8_t> theirs((size_t)width * height * 4);
+			auto decoder = CreateSws(format, AV_PIX_FMT_RGBA, width, height);
+			if (!NV_CHECK(decoder)) {
+				continue;
+			}
+			uint8_t* theirsData[4] = { theirs.data() };
+			int theirsLinesize[4] = { width * 4 };
+			sws_scale(decoder, image.data, image.linesize, 0, height, theirsData, theirsLinesize);
+			sws_freeContext(decoder);
+
+			// 4:4:4 和 libswscale 只差取整。二次采样的格式两边色度的位置和插值不一样，在渐变上差一两个值，B 受 U 的影响最大；
+			// 和原图还多了编码时色度下采样、8 位的量化。平面或通道弄错时差几十
+			bool isSubsampled = layout.chromaShiftX || layout.chromaShiftY;
+			auto swsDiff = Compare(ours, pitch, theirs, width * 4, width, height);
+			auto referenceDiff = Compare(ours, pitch, reference, width * 4, width, height);
+			bool ok = desc.isRGB ? swsDiff.max == 0 && referenceDiff.max == 0
+				: isSubsampled ? swsDiff.max <= 3 && referenceDiff.max <= 4 && swsDiff.mean < 1 && referenceDiff.mean < 1
+				: swsDiff.max <= 1 && referenceDiff.max <= 2;
+			if (!NV_CHECK(ok)) {
+				printf("  %s: differs from libswscale by %d (mean %.3f), from the reference by %d (mean %.3f)\n", av_get_pix_fmt_name(format),
+					swsDiff.max, swsDiff.mean, referenceDiff.max, referenceDiff.mean);
+			}
+		}
+	}
+}
+
+int main() {
+	TestLayouts();
+	TestPlaneSizes();
+	TestRoundTrip();
+	return test::Result();
+}
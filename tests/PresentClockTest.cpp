@@ -0,0 +1,169 @@
+#include "Check.h"
+#include "PresentClock.h"
+#include <math.h>
+#include <algorithm>
+
+// 用 SimulatedPresentTarget 跑主循环的节奏（等名额、取统计、决定画面、渲染、Present），检查 PresentClock 测出的延迟和刷新率，
+// 以及每次刷新正好显示一帧，不重复也不跳帧
+using namespace nv;
+
+namespace {
+	constexpr double refreshPeriod = 1.0 / 60;
+
+	bool IsNear(double a, double b, double tolerance = 1e-9) {
+		return fabs(a - b) <= tolerance;
+	}
+
+	struct LoopResult {
+		double latency;
+		double lastLatency;
+		double refreshRate;
+		int repeatedRefreshes; // 有帧排着却没有新帧显示的刷新
+		int skippedPresents;   // 提交了但从来没显示出来的帧
+	};
+
+	// 每一轮和 main.cpp 的 WaitForPresentReady + Composite 一样：等到能排帧，Update，在 now 决定画面，花 renderTime 画完再 Present
+	LoopResult RunLoop(int maxFrameLatency, double renderTime, int frames) {
+		SimulatedPresentTarget target(refreshPeriod, maxFrameLatency);
+		PresentClock clock(&target);
+		LoopResult result = {};
+		PresentStatistics last = {};
+		bool hasLast = false;
+		for (int i = 0; i < frames; i++) {
+			target.WaitForReady(0.1);
+			clock.Update();
+			double now = target.Now();
+			target.Advance(renderTime);
+			clock.Present(now);
+
+			PresentStatistics stats;
+			if (target.GetStatistics(stats)) {
+				// 前 10 帧是填满队列的过程
+				if (hasLast && i > 10 && stats.presentCount != last.presentCount) {
+					result.skippedPresents += stats.presentCount - last.presentCount - 1;
+					result.repeatedRefreshes += (stats.syncRefreshCount - last.syncRefreshCount) - (stats.presentCount - last.presentCount);
+				}
+				last = stats;
+				hasLast = true;
+			}
+		}
+		result.latency = clock.GetLatency();
+		result.lastLatency = clock.GetLastLatency();
+		result.refreshRate = clock.GetRefreshRate();
+		return result;
+	}
+
+	void TestSteadyLatency() {
+		// 画得比刷新快时，排队的帧正好等 maxFrameLatency 次刷新：在一次刷新之后决定画面，第 maxFrameLatency 次刷新时显示
+		for (int maxFrameLatency = 1; maxFrameLatency <= 3; maxFrameLatency++) {
+			for (double renderTime : { 0.0, 0.002, 0.015 }) {
+				auto result = RunLoop(maxFrameLatency, renderTime, 300);
+				bool ok = NV_CHECK(IsNear(result.lastLatency, maxFrameLatency * refreshPeriod));
+				ok &= NV_CHECK(IsNear(result.latency, maxFrameLatency * refreshPeriod, 1e-6));
+				ok &= NV_CHECK(IsNear(result.refreshRate, 60, 1e-6));
+				ok &= NV_CHECK(result.repeatedRefreshes == 0 && result.skippedPresents == 0);
+				if (!ok) {
+					printf("  latency %d, render %.3f: %.3f ms (last %.3f ms), %.3f Hz, %d repeated, %d skipped\n", maxFrameLatency, renderTime,
+						result.latency * 1000, result.lastLatency * 1000, result.refreshRate, result.repeatedRefreshes, result.skippedPresents);
+				}
+			}
+		}
+	}
+
+	void TestSlowRender() {
+		// 画一帧要 1.5 个刷新周期：每 3 次刷新显示 2 帧，有重复的刷新，但不丢帧；刷新率按经过的刷新次数算，仍然是 60
+		auto result = RunLoop(2, refreshPeriod * 1.5, 300);
+		NV_CHECK(result.skippedPresents == 0);
+		NV_CHECK(result.repeatedRefreshes > 0);
+		NV_CHECK(IsNear(result.refreshRate, 60, 1e-6));
+		// 排不满队列，画完之后下一次刷新就显示，延迟在 1.5 到 2.5 个周期之间
+		NV_CHECK(result.lastLatency >= refreshPeriod * 1.5 - 1e-9 && result.lastLatency <= refreshPeriod * 2.5 + 1e-9);
+		NV_CHECK(result.latency >= refreshPeriod * 1.5 - 1e-9 && result.latency <= refreshPeriod * 2.5 + 1e-9);
+	}
+
+	void TestLatencyChange() {
+		// 延迟突然变长：最近一次的马上跟上，平滑后的逐渐跟上
+		SimulatedPresentTarget target(refreshPeriod, 1);
+		PresentClock clock(&target);
+		for (int i = 0; i < 100; i++) {
+			target.WaitForReady(0.1);
+			clock.Update();
+			clock.Present(target.Now());
+		}
+		NV_CHECK(IsNear(clock.GetLatency(), refreshPeriod, 1e-6));
+
+		// 画面按一个周期之前的时间决定，延迟多出一个周期
+		for (int i = 0; i < 3; i++) {
+			target.WaitForReady(0.1);
+			clock.Update();
+			clock.Present(target.Now() - refreshPeriod);
+		}
+		target.Advance(refreshPeriod);
+		clock.Update();
+		NV_CHECK(IsNear(clock.GetLastLatency(), refreshPeriod * 2));
+		NV_CHECK(clock.GetLatency() > refreshPeriod * 1.1 && clock.GetLatency() < refreshPeriod * 2);
+	}
+
+	void TestNoStatistics() {
+		SimulatedPresentTarget target(refreshPeriod, 2);
+		PresentClock clock(&target);
+		clock.Update();
+		NV_CHECK(clock.GetLatency() == 0 && clock.GetLastLatency() == 0 && clock.GetRefreshRate() == 0);
+
+		// 第一帧显示出来之前没有延迟，只有一次统计也算不出刷新率
+		clock.Present(target.Now());
+		clock.Update();
+		NV_CHECK(clock.GetLatency() == 0);
+		target.Advance(refreshPeriod);
+		clock.Update();
+		NV_CHECK(IsNear(clock.GetLastLatency(), refreshPeriod));
+		NV_CHECK(clock.GetRefreshRate() == 0);
+	}
+
+	void TestMissedStatistics() {
+		// 主循环很久没取统计（窗口被遮住时），攒下的提交只对最近显示的那一次算延迟，之前的丢掉
+		SimulatedPresentTarget target(refreshPeriod, 3);
+		PresentClock clock(&target);
+		for (int i = 0; i < 40; i++) {
+			double now = target.Now();
+			clock.Present(now);
+		}
+		target.Advance(refreshPeriod * 10);
+		clock.Update();
+		// 没有先等名额，Present 排满之后会阻塞：最后一帧在第 36 次刷新时决定，阻塞到第 37 次才提交，第 40 次显示。阻塞的时间也算进延迟
+		NV_CHECK(IsNear(clock.GetLastLatency(), refreshPeriod * 4));
+
+		// 之后照常测
+		for (int i = 0; i < 50; i++) {
+			target.WaitForReady(0.1);
+			clock.Update();
+			clock.Present(target.Now());
+		}
+		NV_CHECK(IsNear(clock.GetLastLatency(), refreshPeriod * 3));
+		NV_CHECK(IsNear(clock.GetRefreshRate(), 60, 1e-6));
+	}
+
+	void TestWaitTimeout() {
+		// 队列满时等不到下一次刷新就超时，时间推进到超时的那一刻
+		SimulatedPresentTarget target(refreshPeriod, 1);
+		target.Present();
+		NV_CHECK(!target.WaitForReady(refreshPeriod / 4));
+		NV_CHECK(IsNear(target.Now(), refreshPeriod / 4));
+		NV_CHECK(target.WaitForReady(refreshPeriod));
+		NV_CHECK(IsNear(target.Now(), refreshPeriod));
+
+		// 有名额的时候不等
+		NV_CHECK(target.WaitForReady(0));
+		NV_CHECK(IsNear(target.Now(), refreshPeriod));
+	}
+}
+
+int main() {
+	TestSteadyLatency();
+	TestSlowRender();
+	TestLatencyChange();
+	TestNoStatistics();
+	TestMissedStatistics();
+	TestWaitTimeout();
+	return test::Result();
+}
@@ -0,0 +1,288 @@
+#include "Check.h"
+#include "RenderStateCache.h"
+#include <string.h>
+#include <map>
+#include <string>
+
+// 用一个只计数的 RenderDevice 检查 RenderStateCache 省掉了重复的绑定和缓冲更新，Invalidate、BeginFrame 之后会重新下发
+using namespace nv;
+
+namespace {
+	// 资源指针只用来比较，随便给几个不同的地址
+	void* Handle(int id) {
+		return (void*)(uintptr_t)(0x1000 + id * 0x10);
+	}
+
+	// 记录每种调用下发了几次和最后一次的参数
+	class CountingDevice : public RenderDevice {
+	public:
+		std::map<std::string, int> calls;
+		std::map<std::string, void*> bound;
+		int created = 0;
+		int released = 0;
+
+		int Total() {
+			int total = 0;
+			for (auto& [name, count] : calls) {
+				total += count;
+			}
+			return total;
+		}
+
+		void SetVertexBuffer(void* buffer, uint32_t stride) override {
+			Record("vb", buffer);
+		}
+
+		void SetIndexBuffer(void* buffer) override {
+			Record("ib", buffer);
+		}
+
+		void SetInputLayout(void* layout) override {
+			Record("layout", layout);
+		}
+
+		void SetShader(ShaderStage stage, void* shader) override {
+			Record(stage == ShaderStage::Vertex ? "vs" : "ps", shader);
+		}
+
+		void SetConstantBuffer(ShaderStage stage, int slot, void* buffer) override {
+			Record((stage == ShaderStage::Vertex ? "vcb" : "pcb") + std::to_string(slot), buffer);
+		}
+
+		void SetShaderResource(int slot, void* view) override {
+			Record("srv" + std::to_string(slot), view);
+		}
+
+		void SetSampler(int slot, void* sampler) override {
+			Record("sampler" + std::to_string(slot), sampler);
+		}
+
+		void SetBlendState(void* state) override {
+			Record("blend", state);
+		}
+
+		void SetViewport(int width, int height) override {
+			Record("viewport", nullptr);
+		}
+
+		void SetRenderTarget(void* view) override {
+			Record("rtv", view);
+		}
+
+		void ClearRenderTarget(void* view, const float color[4]) override {
+			Record("clear", view);
+		}
+
+		void DrawIndexed(int indexCount) override {
+			Record("draw", nullptr);
+		}
+
+		void UpdateBuffer(void* buffer, const void* data, int size) override {
+			Record("update", buffer);
+		}
+
+		void* CreateRenderTarget(void* texture) override {
+			created++;
+			return (uint8_t*)texture + 1;
+		}
+
+		void ReleaseRenderTarget(void* view) override {
+			released++;
+		}
+
+	private:
+		void Record(const std::string& name, void* value) {
+			calls[name]++;
+			bound[name] = value;
+		}
+	};
+
+	struct Constants {
+		float scale[4];
+		float offset[4];
+	};
+
+	// 播放器一帧里的典型调用：画视频，再画一层字幕
+	void DrawFrame(RenderStateCache& cache, void* backBuffer, const Constants& constants) {
+		cache.BeginFrame();
+		void* rtv = cache.GetRenderTarget(backBuffer);
+		cache.SetRenderTarget(rtv);
+		cache.SetViewport(1920, 1080);
+		cache.SetVertexBuffer(Handle(1), 16);
+		cache.SetIndexBuffer(Handle(2));
+		cache.SetInputLayout(Handle(3));
+		cache.SetShader(ShaderStage::Vertex, Handle(4));
+		cache.SetConstantBuffer(ShaderStage::Pixel, 0, Handle(5));
+		cache.UpdateConstantBuffer(Handle(5), &constants, sizeof(constants));
+		cache.SetSampler(0, Handle(6));
+
+		cache.SetShader(ShaderStage::Pixel, Handle(7));
+		cache.SetShaderResource(0, Handle(8));
+		cache.SetShaderResource(1, Handle(9));
+		cache.SetBlendState(nullptr);
+		cache.DrawIndexed(6);
+
+		cache.SetShader(ShaderStage::Pixel, Handle(10));
+		cache.SetShaderResource(0, Handle(11));
+		cache.SetShaderResource(1, nullptr);
+		cache.SetBlendState(Handle(12));
+		cache.DrawIndexed(6);
+	}
+
+	void TestRedundantBinds() {
+		CountingDevice device;
+		RenderStateCache cache(&device);
+
+		// 第一次设置一定下发，哪怕是 nullptr
+		cache.SetShader(ShaderStage::Pixel, nullptr);
+		cache.SetShaderResource(2, Handle(1));
+		cache.SetVertexBuffer(Handle(2), 16);
+		cache.SetViewport(640, 480);
+		NV_CHECK(device.calls["ps"] == 1 && device.bound["ps"] == nullptr);
+		NV_CHECK(device.calls["srv2"] == 1 && device.bound["srv2"] == Handle(1));
+		NV_CHECK(device.calls["vb"] == 1);
+		NV_CHECK(device.calls["viewport"] == 1);
+
+		// 同样的值不再下发
+		int total = device.Total();
+		for (int i = 0; i < 3; i++) {
+			cache.SetShader(ShaderStage::Pixel, nullptr);
+			cache.SetShaderResource(2, Handle(1));
+			cache.SetVertexBuffer(Handle(2), 16);
+			cache.SetViewport(640, 480);
+		}
+		NV_CHECK(device.Total() == total);
+
+		// 值变了才下发，而且各个槽、各个阶段分开记
+		cache.SetShaderResource(2, Handle(3));
+		cache.SetShaderResource(3, Handle(3));
+		cache.SetShader(ShaderStage::Vertex, nullptr);
+		cache.SetVertexBuffer(Handle(2), 32);
+		cache.SetViewport(640, 360);
+		NV_CHECK(device.calls["srv2"] == 2 && device.bound["srv2"] == Handle(3));
+		NV_CHECK(device.calls["srv3"] == 1);
+		NV_CHECK(device.calls["vs"] == 1 && device.calls["ps"] == 1);
+		NV_CHECK(device.calls["vb"] == 2);
+		NV_CHECK(device.calls["viewport"] == 2);
+
+		// 画和清除不经过缓存，每次都下发
+		const float black[4] = {};
+		cache.DrawIndexed(6);
+		cache.DrawIndexed(6);
+		cache.ClearRenderTarget(Handle(4), black);
+		cache.ClearRenderTarget(Handle(4), black);
+		NV_CHECK(device.calls["draw"] == 2 && device.calls["clear"] == 2);
+	}
+
+	void TestInvalidate() {
+		CountingDevice device;
+		RenderStateCache cache(&device);
+		Constants constants = { { 1, 2, 3, 4 }, { 5, 6, 7, 8 } };
+		DrawFrame(cache, Handle(100), constants);
+		auto first = device.calls;
+
+		// 绕过缓存改了管线之后，同样的状态也要全部重新下发
+		cache.Invalidate();
+		cache.SetShader(ShaderStage::Pixel, Handle(10));
+		cache.SetShaderResource(0, Handle(11));
+		cache.SetShaderResource(1, nullptr);
+		cache.SetBlendState(Handle(12));
+		cache.SetViewport(1920, 1080);
+		NV_CHECK(device.calls["ps"] == first["ps"] + 1);
+		NV_CHECK(device.calls["srv0"] == first["srv0"] + 1);
+		NV_CHECK(device.calls["srv1"] == first["srv1"] + 1 && device.bound["srv1"] == nullptr);
+		NV_CHECK(device.calls["blend"] == first["blend"] + 1);
+		NV_CHECK(device.calls["viewport"] == first["viewport"] + 1);
+
+		// Invalidate 只管绑定，缓冲内容没变照样不更新
+		cache.UpdateConstantBuffer(Handle(5), &constants, sizeof(constants));
+		NV_CHECK(device.calls["update"] == first["update"]);
+	}
+
+	void TestSteadyFrames() {
+		CountingDevice device;
+		RenderStateCache cache(&device);
+		Constants constants = { { 1, 2, 3, 4 }, { 5, 6, 7, 8 } };
+		DrawFrame(cache, Handle(100), constants);
+		auto first = device.calls;
+		NV_CHECK(device.created == 1);
+
+		// 第二帧的状态和第一帧结束时相比，只有视频那一遍的像素着色器、纹理和混合要换回来；渲染目标因为翻转模型每帧重新绑
+		int total = device.Total();
+		DrawFrame(cache, Handle(100), constants);
+		int issued = device.Total() - total;
+		NV_CHECK(device.created == 1);
+		NV_CHECK(device.calls["rtv"] == first["rtv"] + 1);
+		NV_CHECK(device.calls["vb"] == first["vb"] && device.calls["ib"] == first["ib"] && device.calls["layout"] == first["layout"]);
+		NV_CHECK(device.calls["vs"] == first["vs"] && device.calls["pcb0"] == first["pcb0"] && device.calls["sampler0"] == first["sampler0"]);
+		NV_CHECK(device.calls["viewport"] == first["viewport"]);
+		NV_CHECK(device.calls["update"] == first["update"]);
+		NV_CHECK(device.calls["ps"] == first["ps"] + 2);
+		NV_CHECK(device.calls["srv0"] == first["srv0"] + 2 && device.calls["srv1"] == first["srv1"] + 2);
+		NV_CHECK(device.calls["blend"] == first["blend"] + 2);
+
+		// 计数和实际下发的一致：每帧 16 次状态设置，两遍之间各换 4 个，加上渲染目标下发 9 次，另外两次画
+		cache.BeginFrame();
+		auto& counters = cache.GetFrameCounters();
+		NV_CHECK(issued == 9 + 2);
+		NV_CHECK(counters.stateChanges == 9 && counters.redundantChanges == 7);
+		NV_CHECK(counters.bufferUpdates == 0 && counters.redundantUpdates == 1);
+		NV_CHECK(counters.creations == 0 && counters.draws == 2);
+
+		// 常量变了要更新
+		constants.offset[3] = 9;
+		DrawFrame(cache, Handle(100), constants);
+		NV_CHECK(device.calls["update"] == first["update"] + 1);
+	}
+
+	void TestConstantBuffers() {
+		CountingDevice device;
+		RenderStateCache cache(&device);
+		uint8_t data[32] = {};
+		cache.UpdateConstantBuffer(Handle(1), data, 32);
+		cache.UpdateConstantBuffer(Handle(1), data, 32);
+		NV_CHECK(device.calls["update"] == 1);
+
+		// 内容按缓冲分开记，大小不同也算变了
+		cache.UpdateConstantBuffer(Handle(2), data, 32);
+		cache.UpdateConstantBuffer(Handle(1), data, 16);
+		NV_CHECK(device.calls["update"] == 3);
+
+		data[15] = 1;
+		cache.UpdateConstantBuffer(Handle(1), data, 16);
+		cache.UpdateConstantBuffer(Handle(1), data, 16);
+		NV_CHECK(device.calls["update"] == 4);
+	}
+
+	void TestRenderTargets() {
+		CountingDevice device;
+		{
+			RenderStateCache cache(&device);
+			void* a = cache.GetRenderTarget(Handle(1));
+			void* b = cache.GetRenderTarget(Handle(2));
+			NV_CHECK(a != b && cache.GetRenderTarget(Handle(1)) == a);
+			NV_CHECK(device.created == 2);
+
+			// 释放之前先从管线上解绑
+			cache.SetRenderTarget(a);
+			cache.ReleaseRenderTargets();
+			NV_CHECK(device.released == 2);
+			NV_CHECK(device.bound["rtv"] == nullptr);
+
+			// 交换链重建之后重新创建
+			NV_CHECK(cache.GetRenderTarget(Handle(1)) != nullptr);
+			NV_CHECK(device.created == 3);
+		}
+		// 析构时释放剩下的
+		NV_CHECK(device.released == 3);
+	}
+}
+
+int main() {
+	TestRedundantBinds();
+	TestInvalidate();
+	TestSteadyFrames();
+	TestConstantBuffers();
+	TestRenderTargets();
+	return test::Result();
+}
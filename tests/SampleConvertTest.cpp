@@ -0,0 +1,179 @@
+#include "Check.h"
+#include "SampleConvert.h"
+#include "CpuFeatures.h"
+#include <string.h>
+#include <limits>
+#include <type_traits>
+
+// 每种格式、打包和平面、1 到 8 声道、各种不是 SIMD 宽度整数倍的长度、不对齐的指针，SIMD 内核的结果都要和标量参考实现逐位相同
+using namespace nv;
+
+namespace {
+	const AVSampleFormat formats[] = {
+		AV_SAMPLE_FMT_U8, AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_S32, AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_DBL, AV_SAMPLE_FMT_S64,
+		AV_SAMPLE_FMT_U8P, AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_S32P, AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_DBLP, AV_SAMPLE_FMT_S64P,
+	};
+
+	const int lengths[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 100, 257 };
+
+	// 输出后面留几个哨兵，检查没有写出界
+	constexpr int guardCount = 9;
+	constexpr uint32_t guardBits = 0x7FC0DEAD;
+
+	int GetBytesPerSample(AVSampleFormat format) {
+		switch (av_get_packed_sample_fmt(format)) {
+		case AV_SAMPLE_FMT_U8:
+			return 1;
+		case AV_SAMPLE_FMT_S16:
+			return 2;
+		case AV_SAMPLE_FMT_S32:
+		case AV_SAMPLE_FMT_FLT:
+			return 4;
+		default:
+			return 8;
+		}
+	}
+
+	template <class T>
+	void FillValues(uint8_t* data, int count, const std::vector<T>& specials) {
+		auto& random = test::GetRandom();
+		for (int i = 0; i < count; i++) {
+			T v;
+			if (random() % 8 == 0) {
+				v = specials[random() % specials.size()];
+			}
+			else if constexpr (std::is_floating_point_v<T>) {
+				// 大多在 -1..1，偶尔超出
+				v = (T)((int32_t)random() / 1073741824.0 + (T)(int32_t)random() * 1e-12);
+			}
+			else {
+				uint64_t bits = ((uint64_t)random() << 32) | random();
+				memcpy(&v, &bits, sizeof(T));
+			}
+			memcpy(data + (size_t)i * sizeof(T), &v, sizeof(T));
+		}
+	}
+
+	void FillSamples(AVSampleFormat format, uint8_t* data, int count) {
+		switch (av_get_packed_sample_fmt(format)) {
+		case AV_SAMPLE_FMT_U8:
+			FillValues<uint8_t>(data, count, { 0, 1, 127, 128, 129, 255 });
+			break;
+		case AV_SAMPLE_FMT_S16:
+			FillValues<int16_t>(data, count, { -32768, -32767, -1, 0, 1, 32767 });
+			break;
+		case AV_SAMPLE_FMT_S32:
+			FillValues<int32_t>(data, count, { INT32_MIN, INT32_MIN + 1, -1, 0, 1, INT32_MAX, 0x40000001 });
+			break;
+		case AV_SAMPLE_FMT_FLT:
+			FillValues<float>(data, count, { -1.0f, 0.0f, -0.0f, 1.0f, 1e-40f, 3.5f, -std::numeric_limits<float>::infinity() });
+			break;
+		case AV_SAMPLE_FMT_DBL:
+			FillValues<double>(data, count, { -1.0, 0.0, 1.0, 1e-300, 0.1, 1.0 - 1e-17, 1e40 });
+			break;
+		default:
+			FillValues<int64_t>(data, count, { INT64_MIN, -1, 0, 1, INT64_MAX });
+			break;
+		}
+	}
+
+	// 源指针比对齐的地址错开 misalign 个样本，dst 错开 dstMisalign 个 float
+	bool Compare(AVSampleFormat format, SampleConvertFunc fast, SampleConvertFunc ref, int nbSamples, int nbChannels, int misalign, int dstMisalign) {
+		bool isPlanar = av_sample_fmt_is_planar(format);
+		int bytesPerSample = GetBytesPerSample(format);
+		int planeCount = isPlanar ? nbChannels : 1;
+		int samplesPerPlane = isPlanar ? nbSamples : nbSamples * nbChannels;
+
+		std::vector<std::vector<uint8_t>> planes(planeCount);
+		std::vector<const uint8_t*> src(planeCount);
+		for (int i = 0; i < planeCount; i++) {
+			// vector 的内存至少 16 字节对齐，错开之后一定不对齐
+			planes[i].resize((size_t)(samplesPerPlane + misalign) * bytesPerSample + 64);
+			src[i] = planes[i].data() + (size_t)misalign * bytesPerSample;
+			FillSamples(format, (uint8_t*)src[i], samplesPerPlane);
+		}
+
+		size_t total = (size_t)nbSamples * nbChannels;
+		std::vector<float> fastOut(dstMisalign + total + guardCount);
+		std::vector<float> refOut(total + guardCount);
+		for (int i = 0; i < guardCount; i++) {
+			memcpy(&fastOut[dstMisalign + total + i], &guardBits, 4);
+		}
+
+		fast(src.data(), fastOut.data() + dstMisalign, nbSamples, nbChannels);
+		ref(src.data(), refOut.data(), nbSamples, nbChannels);
+
+		bool isSame = memcmp(fastOut.data() + dstMisalign, refOut.data(), total * sizeof(float)) == 0;
+		bool isGuardKept = true;
+		for (int i = 0; i < guardCount; i++) {
+			isGuardKept &= memcmp(&fastOut[dstMisalign + total + i], &guardBits, 4) == 0;
+		}
+		return isSame && isGuardKept;
+	}
+
+	void TestKernels(const char* name) {
+		int mismatches = 0;
+		for (auto format : formats) {
+			auto fast = GetSampleConverter(format);
+			auto ref = GetSampleConverterRef(format);
+			if (!NV_CHECK(fast && ref)) {
+				continue;
+			}
+
+			for (int channels = 1; channels <= 8; channels++) {
+				for (int length : lengths) {
+					for (int misalign = 0; misalign < 3; misalign++) {
+						if (!Compare(format, fast, ref, length, channels, misalign, misalign)) {
+							mismatches++;
+							printf("%s %s: %d channels, %d samples, misalign %d differs from the reference\n",
+								name, av_get_sample_fmt_name(format), channels, length, misalign);
+						}
+					}
+				}
+			}
+		}
+		NV_CHECK(mismatches == 0);
+	}
+
+	// 几个确定的值，参考实现本身也要对
+	void TestKnownValues() {
+		int16_t s16[] = { -32768, 0, 16384, 32767 };
+		const uint8_t* src[] = { (const uint8_t*)s16 };
+		float out[4];
+		GetSampleConverterRef(AV_SAMPLE_FMT_S16)(src, out, 2, 2);
+		NV_CHECK(out[0] == -1.0f && out[1] == 0.0f && out[2] == 0.5f && out[3] == 32767.0f / 32768);
+
+		uint8_t u8[] = { 0, 128, 192, 255 };
+		src[0] = u8;
+		GetSampleConverterRef(AV_SAMPLE_FMT_U8)(src, out, 4, 1);
+		NV_CHECK(out[0] == -1.0f && out[1] == 0.0f && out[2] == 0.5f && out[3] == 127.0f / 128);
+
+		// 平面转交错
+		float left[] = { 0.25f, 0.5f };
+		float right[] = { -0.25f, -0.5f };
+		const uint8_t* planes[] = { (const uint8_t*)left, (const uint8_t*)right };
+		GetSampleConverter(AV_SAMPLE_FMT_FLTP)(planes, out, 2, 2);
+		NV_CHECK(out[0] == 0.25f && out[1] == -0.25f && out[2] == 0.5f && out[3] == -0.5f);
+
+		NV_CHECK(GetSampleConverter(AV_SAMPLE_FMT_NONE) == nullptr);
+	}
+}
+
+int main() {
+	TestKnownValues();
+
+	bool hasAVX2 = cpu::HasAVX2();
+	TestKernels(GetSampleConverterName());
+
+	// 有 AVX2 时再关掉它测一遍 SSE2，关掉之后取到的内核要跟着变
+	if (hasAVX2) {
+		auto avx2Kernel = GetSampleConverter(AV_SAMPLE_FMT_S16P);
+		cpu::DisableAVX2(true);
+		NV_CHECK(GetSampleConverter(AV_SAMPLE_FMT_S16P) != avx2Kernel);
+		TestKernels(GetSampleConverterName());
+		cpu::DisableAVX2(false);
+		NV_CHECK(GetSampleConverter(AV_SAMPLE_FMT_S16P) == avx2Kernel);
+	}
+
+	return test::Result();
+}
@@ -0,0 +1,180 @@
+#include "Check.h"
+#include "Scaler.h"
+#include "SoftwareRenderer.h"
+#include "CpuFeatures.h"
+#include <string.h>
+#include <algorithm>
+
+// Scaler 的检查：
+// 1. 每种核、放大缩小、奇数宽高、带黑边、行尾有填充时 SIMD 实现和标量参考实现逐位相同
+// 2. 权重表每个输出像素的和正好是 1，纯色画面缩放后颜色不变，黑边是不透明的黑
+// 3. ScaleWeightCache 逐帧复用同一份权重表，改变大小时重新生成，改回去时还在缓存里，满了丢掉最久没用过的
+using namespace nv;
+
+namespace {
+	const ScaleFilter filters[] = { ScaleFilter::Bilinear, ScaleFilter::CatmullRom, ScaleFilter::Bicubic, ScaleFilter::Lanczos3 };
+
+	struct ScaleCase {
+		int srcWidth;
+		int srcHeight;
+		int dstWidth;
+		int dstHeight;
+	};
+
+	// 缩放比例按 GetFitScale 算，宽高比不同时上下或左右留黑边
+	const ScaleCase cases[] = {
+		{ 64, 36, 64, 36 },
+		{ 64, 36, 16, 9 },
+		{ 97, 41, 23, 17 },
+		{ 33, 19, 101, 57 },
+		{ 40, 30, 121, 35 },
+		{ 127, 3, 5, 7 },
+		{ 1, 1, 9, 5 },
+		{ 2, 2, 1, 1 },
+		{ 320, 180, 77, 300 },
+	};
+
+	struct Image {
+		int width;
+		int height;
+		int pitch;
+		std::vector<uint8_t> data;
+	};
+
+	// 每行末尾多留 12 字节，源里写成随机值，输出里写成 0x5A，检查没有读写出界
+	Image MakeRandomImage(int width, int height) {
+		Image image = { width, height, width * 4 + 12 };
+		image.data.resize((size_t)image.pitch * height);
+		test::FillRandom(image.data);
+		return image;
+	}
+
+	Image Scale(void (*scale)(const ScaleWeights&, const ScaleWeights&, const uint8_t*, int, uint8_t*, int, std::vector<int16_t>&),
+		const ScaleWeights& columns, const ScaleWeights& rows, const Image& src) {
+		Image dst = { columns.dstSize, rows.dstSize, columns.dstSize * 4 + 12 };
+		dst.data.assign((size_t)dst.pitch * dst.height, 0x5A);
+		std::vector<int16_t> temp;
+		scale(columns, rows, src.data.data(), src.pitch, dst.data.data(), dst.pitch, temp);
+		return dst;
+	}
+
+	void TestKernels() {
+		int mismatches = 0;
+		for (auto filter : filters) {
+			for (auto& c : cases) {
+				double scaleX, scaleY;
+				GetFitScale(c.srcWidth, c.srcHeight, c.dstWidth, c.dstHeight, scaleX, scaleY);
+				auto columns = MakeScaleWeights(filter, c.srcWidth, c.dstWidth, scaleX);
+				auto rows = MakeScaleWeights(filter, c.srcHeight, c.dstHeight, scaleY);
+				auto src = MakeRandomImage(c.srcWidth, c.srcHeight);
+				if (Scale(ScaleRGBA, *columns, *rows, src).data != Scale(ScaleRGBARef, *columns, *rows, src).data) {
+					mismatches++;
+					printf("%s %s, %dx%d to %dx%d differs from the reference\n", GetScalerName(), GetScaleFilterName(filter),
+						c.srcWidth, c.srcHeight, c.dstWidth, c.dstHeight);
+				}
+			}
+		}
+		NV_CHECK(mismatches == 0);
+	}
+
+	void TestWeights() {
+		const int one = 1 << ScaleWeights::weightBits;
+		for (auto filter : filters) {
+			for (auto& c : cases) {
+				double scaleX, scaleY;
+				GetFitScale(c.srcWidth, c.srcHeight, c.dstWidth, c.dstHeight, scaleX, scaleY);
+				for (auto weights : { MakeScaleWeights(filter, c.srcWidth, c.dstWidth, scaleX), MakeScaleWeights(filter, c.srcHeight, c.dstHeight, scaleY) }) {
+					bool ok = weights->taps >= 1 && weights->taps <= weights->srcSize && weights->begin <= weights->end;
+					for (int i = 0; i < weights->dstSize; i++) {
+						int sum = 0;
+						for (int k = 0; k < weights->taps; k++) {
+							sum += weights->weights[(size_t)i * weights->taps + k];
+						}
+						bool isVideo = i >= weights->begin && i < weights->end;
+						ok = ok && sum == (isVideo ? one : 0) && weights->offsets[i] >= 0 && weights->offsets[i] + weights->taps <= weights->srcSize;
+					}
+					if (!NV_CHECK(ok)) {
+						printf("  %s, %d to %d: bad weights\n", GetScaleFilterName(filter), weights->srcSize, weights->dstSize);
+					}
+				}
+
+				// 纯色的画面缩放后每个像素还是同一个颜色（权重和为 1，整数运算没有误差），黑边之外都是这个颜色
+				auto columns = MakeScaleWeights(filter, c.srcWidth, c.dstWidth, scaleX);
+				auto rows = MakeScaleWeights(filter, c.srcHeight, c.dstHeight, scaleY);
+				auto src = MakeRandomImage(c.srcWidth, c.srcHeight);
+				const uint8_t color[4] = { 200, 17, 96, 255 };
+				for (int y = 0; y < src.height; y++) {
+					for (int x = 0; x < src.width; x++) {
+						memcpy(&src.data[(size_t)y * src.pitch + x * 4], color, 4);
+					}
+				}
+				auto dst = Scale(ScaleRGBA, *columns, *rows, src);
+				int wrong = 0;
+				for (int y = 0; y < dst.height; y++) {
+					for (int x = 0; x < dst.width; x++) {
+						bool isVideo = x >= columns->begin && x < columns->end && y >= rows->begin && y < rows->end;
+						const uint8_t black[4] = { 0, 0, 0, 255 };
+						wrong += memcmp(&dst.data[(size_t)y * dst.pitch + x * 4], isVideo ? color : black, 4) != 0;
+					}
+				}
+				if (!NV_CHECK(wrong == 0)) {
+					printf("  %s, %dx%d to %dx%d: %d pixels changed colour\n", GetScaleFilterName(filter), c.srcWidth, c.srcHeight, c.dstWidth, c.dstHeight, wrong);
+				}
+			}
+		}
+	}
+
+	bool IsSame(const ScaleWeights& a, const ScaleWeights& b) {
+		return a.srcSize == b.srcSize && a.dstSize == b.dstSize && a.taps == b.taps && a.begin == b.begin && a.end == b.end
+			&& a.offsets == b.offsets && a.weights == b.weights;
+	}
+
+	void TestCache() {
+		ScaleWeightCache cache;
+
+		// 逐帧播放：大小不变时每帧拿到的都是同一份
+		auto columns = cache.Get(ScaleFilter::Lanczos3, 1920, 1280, 1.0);
+		auto rows = cache.Get(ScaleFilter::Lanczos3, 1080, 720, 1.0);
+		NV_CHECK(IsSame(*columns, *MakeScaleWeights(ScaleFilter::Lanczos3, 1920, 1280, 1.0)));
+		for (int frame = 0; frame < 100; frame++) {
+			NV_CHECK(cache.Get(ScaleFilter::Lanczos3, 1920, 1280, 1.0) == columns);
+			NV_CHECK(cache.Get(ScaleFilter::Lanczos3, 1080, 720, 1.0) == rows);
+		}
+
+		// 改变窗口大小、核或者比例都要重新生成
+		auto resized = cache.Get(ScaleFilter::Lanczos3, 1920, 1281, 1.0);
+		NV_CHECK(resized != columns && IsSame(*resized, *MakeScaleWeights(ScaleFilter::Lanczos3, 1920, 1281, 1.0)));
+		NV_CHECK(cache.Get(ScaleFilter::CatmullRom, 1920, 1280, 1.0) != columns);
+		NV_CHECK(cache.Get(ScaleFilter::Lanczos3, 1920, 1280, 0.75) != columns);
+
+		// 改回原来的大小还在缓存里
+		NV_CHECK(cache.Get(ScaleFilter::Lanczos3, 1920, 1280, 1.0) == columns);
+		NV_CHECK(cache.Get(ScaleFilter::Lanczos3, 1080, 720, 1.0) == rows);
+
+		// 拖动窗口时一直在用的两份留着，更早的被挤掉，再用时重新生成
+		auto dragged = cache.Get(ScaleFilter::Lanczos3, 1920, 1300, 1.0);
+		for (int width = 1301; width < 1301 + ScaleWeightCache::capacity; width++) {
+			cache.Get(ScaleFilter::Lanczos3, 1920, width, 1.0);
+			NV_CHECK(cache.Get(ScaleFilter::Lanczos3, 1920, 1280, 1.0) == columns);
+			NV_CHECK(cache.Get(ScaleFilter::Lanczos3, 1080, 720, 1.0) == rows);
+		}
+		auto rebuilt = cache.Get(ScaleFilter::Lanczos3, 1920, 1300, 1.0);
+		NV_CHECK(rebuilt != dragged && IsSame(*rebuilt, *dragged));
+		NV_CHECK(cache.Get(ScaleFilter::Lanczos3, 1920, 1281, 1.0) != resized);
+	}
+}
+
+int main() {
+	TestKernels();
+	// 有 AVX2 时再关掉它测一遍 SSE4.1
+	if (cpu::HasAVX2()) {
+		cpu::DisableAVX2(true);
+		NV_CHECK(strcmp(GetScalerName(), "avx2") != 0);
+		TestKernels();
+		cpu::DisableAVX2(false);
+	}
+
+	TestWeights();
+	TestCache();
+	return test::Result();
+}
@@ -0,0 +1,221 @@
+#include "Check.h"
+#include "TestFrame.h"
+#include "SoftwareRenderer.h"
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <fstream>
+#include <sstream>
+
+// 用合成的帧跑 SoftwareRenderer 的整条流程（YUVConvert、ColorSpace、ToneMapping、Dither、Scaler、字幕混合），和 golden/ 里的图逐像素比较
+// 色调映射的 LUT 是浮点算的，不同的编译器和数学库可能差一点，允许每个通道差 1
+// 改了渲染结果之后用 --update-goldens 重新生成，看过图没问题再提交
+using namespace nv;
+
+namespace {
+	constexpr int tolerance = 1;
+
+	struct GoldenCase {
+		const char* name;
+		AVPixelFormat format;
+		int width;
+		int height;
+		AVColorSpace colorspace;
+		AVColorRange range;
+		AVColorPrimaries primaries;
+		AVColorTransferCharacteristic transfer;
+		int viewWidth;
+		int viewHeight;
+		ScaleFilter filter;
+		DitherMode dither;
+		ToneMapCurve curve;
+		CropRect crop;
+		bool hasOverlay;
+	};
+
+	const GoldenCase cases[] = {
+		{ "yuv420p_bt709", AV_PIX_FMT_YUV420P, 64, 36, AVCOL_SPC_BT709, AVCOL_RANGE_MPEG, AVCOL_PRI_BT709, AVCOL_TRC_BT709,
+			80, 60, ScaleFilter::CatmullRom, DitherMode::None, ToneMapCurve::BT2390, {}, false },
+		// 没有标注色彩空间，按分辨率猜是 BT.601
+		{ "nv12_unspecified_overlay", AV_PIX_FMT_NV12, 48, 36, AVCOL_SPC_UNSPECIFIED, AVCOL_RANGE_UNSPECIFIED, AVCOL_PRI_UNSPECIFIED, AVCOL_TRC_UNSPECIFIED,
+			64, 64, ScaleFilter::Bilinear, DitherMode::None, ToneMapCurve::BT2390, {}, true },
+		{ "p010_ordered_bicubic", AV_PIX_FMT_P010LE, 64, 48, AVCOL_SPC_BT709, AVCOL_RANGE_MPEG, AVCOL_PRI_BT709, AVCOL_TRC_BT709,
+			96, 40, ScaleFilter::Bicubic, DitherMode::Ordered, ToneMapCurve::BT2390, {}, false },
+		{ "yuv420p10_pq_bt2390", AV_PIX_FMT_YUV420P10LE, 64, 36, AVCOL_SPC_BT2020_NCL, AVCOL_RANGE_MPEG, AVCOL_PRI_BT2020, AVCOL_TRC_SMPTE2084,
+			72, 48, ScaleFilter::Lanczos3, DitherMode::None, ToneMapCurve::BT2390, {}, false },
+		{ "yuv420p10_hlg_hable", AV_PIX_FMT_YUV420P10LE, 64, 36, AVCOL_SPC_BT2020_NCL, AVCOL_RANGE_MPEG, AVCOL_PRI_BT2020, AVCOL_TRC_ARIB_STD_B67,
+			72, 48, ScaleFilter::CatmullRom, DitherMode::Ordered, ToneMapCurve::Hable, {}, false },
+		{ "yuv444p_full_crop", AV_PIX_FMT_YUV444P, 64, 48, AVCOL_SPC_BT709, AVCOL_RANGE_JPEG, AVCOL_PRI_BT709, AVCOL_TRC_BT709,
+			64, 64, ScaleFilter::CatmullRom, DitherMode::None, ToneMapCurve::BT2390, { 8, 6, 48, 36 }, false },
+		{ "bgra", AV_PIX_FMT_BGRA, 40, 40, AVCOL_SPC_RGB, AVCOL_RANGE_JPEG, AVCOL_PRI_BT709, AVCOL_TRC_BT709,
+			48, 32, ScaleFilter::Lanczos3, DitherMode::None, ToneMapCurve::BT2390, {}, false },
+	};
+
+	// 亮度是斜向的渐变，中间有一块棋盘格考验缩放，色度是两个方向的渐变，覆盖整个色域。整数公式，每个平台都一样
+	int Sample(const GoldenCase& test, int bitDepth, int component, int x, int y) {
+		PixelFormatDesc desc;
+		GetPixelFormatDesc(test.format, desc);
+		bool isChroma = component > 0 && !desc.isRGB;
+		int w = isChroma ? (test.width + (1 << desc.chromaShiftX) - 1) >> desc.chromaShiftX : test.width;
+		int h = isChroma ? (test.height + (1 << desc.chromaShiftY) - 1) >> desc.chromaShiftY : test.height;
+		int maxValue = (1 << bitDepth) - 1;
+
+		int value;
+		if (component == 0) {
+			bool isChecker = x * 4 > w && x * 4 < w * 2 && y * 3 > h && y * 3 < h * 2;
+			value = isChecker ? (((x ^ y) & 1) ? maxValue * 7 / 8 : maxValue / 8) : (x * h + y * w) * maxValue / (2 * w * h);
+		}
+		else if (component == 1) {
+			value = x * maxValue / std::max(w - 1, 1);
+		}
+		else {
+			value = y * maxValue / std::max(h - 1, 1);
+		}
+		// 限定范围的 YUV 压到 16..235（色度 16..240）附近，超出一点也要能处理
+		if (test.range == AVCOL_RANGE_MPEG && !desc.isRGB) {
+			int shift = bitDepth - 8;
+			int low = 16 << shift;
+			int high = (component == 0 ? 235 : 240) << shift;
+			value = low + value * (high - low) / maxValue;
+		}
+		return value;
+	}
+
+	// 字幕层：一块半透明的红色和一条不透明的白边，预乘过
+	std::vector<uint8_t> MakeOverlay(int width, int height) {
+		std::vector<uint8_t> overlay((size_t)width * height * 4, 0);
+		for (int y = height / 2; y < height * 3 / 4; y++) {
+			for (int x = width / 4; x < width * 3 / 4; x++) {
+				uint8_t* p = &overlay[((size_t)y * width + x) * 4];
+				bool isEdge = y == height / 2 || x == width / 4;
+				p[0] = isEdge ? 255 : 96;
+				p[1] = isEdge ? 255 : 0;
+				p[2] = isEdge ? 255 : 0;
+				p[3] = isEdge ? 255 : 96;
+			}
+		}
+		return overlay;
+	}
+
+	std::string GetGoldenPath(const char* name) {
+		return std::string(NV_GOLDEN_DIR) + "/" + name + ".pam";
+	}
+
+	// PAM（P7）保存 RGBA，字幕混合之后 alpha 不全是 255
+	bool WritePAM(const std::string& path, const uint8_t* rgba, int width, int height) {
+		std::ofstream file(path, std::ios::binary);
+		file << "P7\nWIDTH " << width << "\nHEIGHT " << height << "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+		file.write((const char*)rgba, (std::streamsize)width * height * 4);
+		return (bool)file;
+	}
+
+	bool ReadPAM(const std::string& path, std::vector<uint8_t>& rgba, int& width, int& height) {
+		std::ifstream file(path, std::ios::binary);
+		std::string line;
+		if (!std::getline(file, line) || line != "P7") {
+			return false;
+		}
+		width = height = 0;
+		int depth = 0;
+		while (std::getline(file, line) && line != "ENDHDR") {
+			std::istringstream fields(line);
+			std::string key;
+			fields >> key;
+			if (key == "WIDTH") {
+				fields >> width;
+			}
+			else if (key == "HEIGHT") {
+				fields >> height;
+			}
+			else if (key == "DEPTH") {
+				fields >> depth;
+			}
+		}
+		if (width <= 0 || height <= 0 || depth != 4) {
+			return false;
+		}
+		rgba.resize((size_t)width * height * 4);
+		file.read((char*)rgba.data(), (std::streamsize)rgba.size());
+		return file.gcount() == (std::streamsize)rgba.size();
+	}
+
+	void TestGolden(const GoldenCase& test, bool update) {
+		int bitDepth = GetYUVBitDepth(test.format);
+		if (!NV_CHECK(SoftwareRenderer::IsSupported(test.format) && bitDepth > 0)) {
+			return;
+		}
+		// 超过 10 位的格式 CPU 只用高 10 位，样本按格式本身的位深生成
+		PixelFormatDesc desc;
+		GetPixelFormatDesc(test.format, desc);
+		auto frame = test::MakeFrame(test.format, test.width, test.height, [&](int c, int x, int y) {
+			return Sample(test, desc.bitDepth, c, x, y);
+		}, 16);
+		frame.frame.colorspace = test.colorspace;
+		frame.frame.color_range = test.range;
+		frame.frame.color_primaries = test.primaries;
+		frame.frame.color_trc = test.transfer;
+
+		SoftwareRenderer renderer;
+		renderer.SetScaleFilter(test.filter);
+		renderer.SetDitherMode(test.dither);
+		renderer.SetToneMapCurve(test.curve);
+		renderer.SetCrop(test.crop);
+		auto overlay = MakeOverlay(test.viewWidth, test.viewHeight);
+		if (!NV_CHECK(renderer.Render(&frame.frame, test.viewWidth, test.viewHeight, test.hasOverlay ? overlay.data() : nullptr, test.viewWidth * 4) == 0)) {
+			return;
+		}
+		const uint8_t* actual = renderer.GetFramebuffer();
+
+		auto path = GetGoldenPath(test.name);
+		if (update) {
+			NV_CHECK(WritePAM(path, actual, test.viewWidth, test.viewHeight));
+			printf("wrote %s\n", path.c_str());
+			return;
+		}
+
+		std::vector<uint8_t> expected;
+		int width, height;
+		if (!NV_CHECK(ReadPAM(path, expected, width, height))) {
+			printf("  %s: can't read %s, run with --update-goldens to create it\n", test.name, path.c_str());
+			return;
+		}
+		if (!NV_CHECK(width == test.viewWidth && height == test.viewHeight)) {
+			printf("  %s: golden is %dx%d, rendered %dx%d\n", test.name, width, height, test.viewWidth, test.viewHeight);
+			return;
+		}
+
+		int maxDiff = 0;
+		int differing = 0;
+		int firstX = -1, firstY = -1;
+		for (size_t i = 0; i < expected.size(); i++) {
+			int diff = abs((int)actual[i] - (int)expected[i]);
+			if (diff > tolerance && differing++ == 0) {
+				firstX = (int)(i / 4 % width);
+				firstY = (int)(i / 4 / width);
+			}
+			maxDiff = std::max(maxDiff, diff);
+		}
+		if (!NV_CHECK(differing == 0)) {
+			printf("  %s: %d channel(s) differ by more than %d (max %d), first at (%d, %d)\n", test.name, differing, tolerance, maxDiff, firstX, firstY);
+			// 留一份实际的结果在当前目录，方便和 golden 对比
+			WritePAM(std::string(test.name) + ".actual.pam", actual, test.viewWidth, test.viewHeight);
+		}
+	}
+
+	void TestUnsupported() {
+		auto frame = test::MakeFrame(AV_PIX_FMT_NV12, 16, 16, [](int, int, int) { return 128; });
+		SoftwareRenderer renderer;
+		NV_CHECK(renderer.Render(&frame.frame, 0, 16) == -1);
+		frame.frame.format = AV_PIX_FMT_NONE;
+		NV_CHECK(renderer.Render(&frame.frame, 16, 16) == -1);
+	}
+}
+
+int main(int argc, char** argv) {
+	bool update = argc > 1 && strcmp(argv[1], "--update-goldens") == 0;
+	for (auto& test : cases) {
+		TestGolden(test, update);
+	}
+	TestUnsupported();
+	return test::Result();
+}
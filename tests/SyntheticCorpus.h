@@ -0,0 +1,164 @@
+#pragma once
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include <list>
+#include <functional>
+#include <algorithm>
+#include "Check.h"
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// 合成的几类片源，用来统计 DuplicateFrameDetector 能省掉多少帧：一拍三和一拍二的动画、幻灯片、录屏、实拍
+// 都是 yuv420p，内容和噪声由固定的公式和 test::GetRandom 生成，每个平台的结果都一样
+namespace nv {
+	namespace test {
+		struct CorpusFrame {
+			int width;
+			int height;
+			std::vector<uint8_t> planes[3];
+			AVFrame frame;
+
+			CorpusFrame(int width_, int height_) : width(width_), height(height_), frame{} {
+				planes[0].assign((size_t)width * height, 16);
+				planes[1].assign((size_t)width * height / 4, 128);
+				planes[2].assign((size_t)width * height / 4, 128);
+				frame.format = AV_PIX_FMT_YUV420P;
+				frame.width = width;
+				frame.height = height;
+				for (int i = 0; i < 3; i++) {
+					frame.data[i] = planes[i].data();
+					frame.linesize[i] = i == 0 ? width : width / 2;
+				}
+			}
+		};
+
+		// 一张“原画”：亮度是斜纹加正弦的起伏，色度随 seed 变。最近用过的几张留着，一拍二、一拍三的重复帧不用重画
+		class DrawingCache {
+		public:
+			DrawingCache(int width_, int height_) : width(width_), height(height_) {}
+
+			// 返回的引用在之后再取 maxCached 张不同的原画之前一直有效
+			const CorpusFrame& Get(int seed) {
+				for (auto it = drawings.begin(); it != drawings.end(); it++) {
+					if (it->first == seed) {
+						drawings.splice(drawings.end(), drawings, it);
+						return drawings.back().second;
+					}
+				}
+
+				if (drawings.size() >= maxCached) {
+					drawings.pop_front();
+				}
+				auto& drawing = drawings.emplace_back(seed, CorpusFrame(width, height)).second;
+				std::vector<int> wave(width);
+				for (int x = 0; x < width; x++) {
+					wave[x] = (int)(40 * sin((x + seed * 13) * 0.01));
+				}
+				for (int y = 0; y < height; y++) {
+					uint8_t* row = &drawing.planes[0][(size_t)y * width];
+					for (int x = 0; x < width; x++) {
+						row[x] = (uint8_t)(40 + ((x * seed / 7 + y * (seed % 5 + 1) + wave[x]) & 127));
+					}
+				}
+				auto& u = drawing.planes[1];
+				for (size_t i = 0; i < u.size(); i++) {
+					u[i] = (uint8_t)(110 + (seed * 3 + i / 97) % 30);
+				}
+				return drawing;
+			}
+		private:
+			static constexpr size_t maxCached = 4;
+
+			int width;
+			int height;
+			std::list<std::pair<int, CorpusFrame>> drawings;
+		};
+
+		inline void CopyFrame(const CorpusFrame& src, CorpusFrame& dst) {
+			for (int i = 0; i < 3; i++) {
+				dst.planes[i] = src.planes[i];
+				dst.frame.data[i] = dst.planes[i].data();
+			}
+		}
+
+		// 亮度加上 [-amplitude, amplitude] 的随机噪声，有损编码的残差、摄像机的噪点
+		// 每帧的种子从 GetRandom 取，逐像素用 xorshift，不然 1080p 的片源光生成噪声就要好几秒
+		inline void AddNoise(CorpusFrame& frame, int amplitude) {
+			uint32_t state = (uint32_t)GetRandom()() | 1;
+			for (auto& v : frame.planes[0]) {
+				state ^= state << 13;
+				state ^= state >> 17;
+				state ^= state << 5;
+				v = (uint8_t)std::clamp((int)v + (int)((state >> 8) % (2 * amplitude + 1)) - amplitude, 0, 255);
+			}
+		}
+
+		struct CorpusClip {
+			const char* name;
+			int frameCount;
+			// 把第 index 帧画进 frame，整段用的是同一个 frame
+			std::function<void(CorpusFrame& frame, int index)> render;
+		};
+
+		inline std::vector<CorpusClip> MakeCorpus(DrawingCache& drawings) {
+			std::vector<CorpusClip> clips;
+
+			// 24 fps 的动画，每张原画停 3 帧，解码出来完全一样
+			clips.push_back({ "anime on threes", 240, [&](CorpusFrame& frame, int i) {
+				CopyFrame(drawings.Get(i / 3 + 1), frame);
+			} });
+
+			// 每张停 2 帧，重复的那帧带着有损编码的 ±1 残差
+			clips.push_back({ "anime on twos, +-1 noise", 240, [&](CorpusFrame& frame, int i) {
+				CopyFrame(drawings.Get(i / 2 + 1), frame);
+				if (i % 2) {
+					AddNoise(frame, 1);
+				}
+			} });
+
+			// 30 fps，每张停 4 秒，再用 1 秒交叉淡化到下一张
+			clips.push_back({ "slideshow, 5 s per slide, 1 s crossfade", 600, [&](CorpusFrame& frame, int i) {
+				int slide = i / 150, offset = i % 150;
+				auto& a = drawings.Get(slide * 11 + 3);
+				auto& b = drawings.Get(slide * 11 + 14);
+				CopyFrame(a, frame);
+				if (offset >= 120) {
+					int t = (offset - 120) * 256 / 30;
+					for (size_t k = 0; k < frame.planes[0].size(); k++) {
+						frame.planes[0][k] = (uint8_t)((a.planes[0][k] * (256 - t) + b.planes[0][k] * t) >> 8);
+					}
+				}
+			} });
+
+			// 静止的桌面，光标每 15 帧闪一次，每 5 秒里鼠标移动 1 秒
+			clips.push_back({ "screen recording, caret and cursor", 600, [&](CorpusFrame& frame, int i) {
+				CopyFrame(drawings.Get(42), frame);
+				auto& y = frame.planes[0];
+				int width = frame.width;
+				if ((i / 15) % 2) {
+					for (int row = 500 * frame.height / 1080; row < 500 * frame.height / 1080 + 16; row++) {
+						y[(size_t)row * width + width * 5 / 12] = 235;
+					}
+				}
+				int cursorX = (i % 150) < 30 ? width / 6 + (i % 150) * 10 : width / 6 + 300;
+				int cursorY = frame.height * 10 / 27;
+				for (int row = 0; row < 12; row++) {
+					for (int x = 0; x <= row / 2; x++) {
+						y[(size_t)(cursorY + row) * width + cursorX + x] = 235;
+					}
+				}
+			} });
+
+			// 实拍：每帧都不一样，还有摄像机噪点
+			clips.push_back({ "live action", 240, [&](CorpusFrame& frame, int i) {
+				CopyFrame(drawings.Get(i + 1000), frame);
+				AddNoise(frame, 2);
+			} });
+
+			return clips;
+		}
+	}
+}
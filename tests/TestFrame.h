@@ -0,0 +1,82 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <functional>
+#include "PixelFormat.h"
+
+// 测试用的视频帧：按 GetPixelFormatDesc 的平面布局生成任意支持格式的 AVFrame，内存归 TestFrame 管
+namespace nv {
+	namespace test {
+		struct TestFrame {
+			AVFrame frame;
+			std::vector<std::vector<uint8_t>> planes;
+		};
+
+		// sample(component, x, y) 返回分量 component（YUV 的 Y/U/V 或 RGB 的 R/G/B）在它自己平面里 (x, y) 的样本值，bitDepth 位
+		// 每行末尾多留 padding 字节，检查实现按 linesize 而不是宽度走
+		inline TestFrame MakeFrame(AVPixelFormat format, int width, int height, const std::function<int(int, int, int)>& sample, int padding = 0) {
+			TestFrame result = {};
+			PixelFormatDesc desc;
+			if (!GetPixelFormatDesc(format, desc)) {
+				return result;
+			}
+
+			auto& frame = result.frame;
+			frame.format = format;
+			frame.width = width;
+			frame.height = height;
+			result.planes.resize(desc.planeCount);
+			for (int i = 0; i < desc.planeCount; i++) {
+				auto& plane = desc.planes[i];
+				frame.linesize[i] = GetPlaneWidth(desc, i, width) * plane.channels * plane.bytesPerChannel + padding;
+				// 填充的部分写成 0xCD，读到了结果会明显不对
+				result.planes[i].assign((size_t)frame.linesize[i] * GetPlaneHeight(desc, i, height), 0xCD);
+				frame.data[i] = result.planes[i].data();
+			}
+
+			for (int c = 0; c < 3; c++) {
+				auto& component = desc.components[c];
+				auto& plane = desc.planes[component.plane];
+				int planeWidth = GetPlaneWidth(desc, component.plane, width);
+				int planeHeight = GetPlaneHeight(desc, component.plane, height);
+				for (int y = 0; y < planeHeight; y++) {
+					uint8_t* row = frame.data[component.plane] + (size_t)y * frame.linesize[component.plane];
+					for (int x = 0; x < planeWidth; x++) {
+						uint8_t* p = row + ((size_t)x * plane.channels + component.channel) * plane.bytesPerChannel;
+						int value = sample(c, x, y) << desc.sampleShift;
+						if (plane.bytesPerChannel == 1) {
+							*p = (uint8_t)value;
+						}
+						else {
+							uint16_t v = (uint16_t)value;
+							memcpy(p, &v, 2);
+						}
+					}
+				}
+			}
+
+			// 打包 RGB 的第 4 个通道（alpha 或填充）不用，给个固定值
+			for (int i = 0; i < desc.planeCount; i++) {
+				if (desc.planes[i].channels != 4) {
+					continue;
+				}
+				int used = 0;
+				for (auto& component : desc.components) {
+					used |= component.plane == i ? 1 << component.channel : 0;
+				}
+				for (int channel = 0; channel < 4; channel++) {
+					if (used & (1 << channel)) {
+						continue;
+					}
+					for (int y = 0; y < height; y++) {
+						for (int x = 0; x < width; x++) {
+							frame.data[i][(size_t)y * frame.linesize[i] + x * 4 + channel] = 0xFF;
+						}
+					}
+				}
+			}
+			return result;
+		}
+	}
+}
@@ -0,0 +1,150 @@
+#include "Check.h"
+#include "WavFileAudioSink.h"
+#include <string.h>
+#include <math.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+// 用手动推进时钟的 WavFileAudioSink 录一段，再按 RIFF 的规则读回来：IEEE float 的 fmt 块带 cbSize，fact 块记着帧数，
+// data 里正好是播放的数据，欠载的部分是静音，音量不影响录下的数据
+using namespace nv;
+
+namespace {
+	uint32_t GetU32(const uint8_t* p) {
+		return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+	}
+
+	uint16_t GetU16(const uint8_t* p) {
+		return (uint16_t)(p[0] | p[1] << 8);
+	}
+
+	struct WavFile {
+		uint16_t formatTag;
+		uint16_t channels;
+		uint32_t sampleRate;
+		uint32_t byteRate;
+		uint16_t blockAlign;
+		uint16_t bitsPerSample;
+		bool hasFact;
+		uint32_t factFrames;
+		std::vector<float> samples;
+	};
+
+	// 按块读，块的顺序不做要求，但 RIFF 的长度、每个块的长度都必须和文件对得上
+	bool ReadWav(const std::string& path, WavFile& wav) {
+		std::ifstream file(path, std::ios::binary);
+		std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if (data.size() < 12 || memcmp(&data[0], "RIFF", 4) != 0 || memcmp(&data[8], "WAVE", 4) != 0 || GetU32(&data[4]) != data.size() - 8) {
+			return false;
+		}
+
+		wav = {};
+		bool hasFormat = false, hasData = false;
+		size_t offset = 12;
+		while (offset + 8 <= data.size()) {
+			const uint8_t* id = &data[offset];
+			uint32_t size = GetU32(&data[offset + 4]);
+			const uint8_t* body = id + 8;
+			if (offset + 8 + size > data.size()) {
+				return false;
+			}
+			if (memcmp(id, "fmt ", 4) == 0) {
+				// 非 PCM 的 fmt 块至少 18 字节，最后是扩展部分的长度
+				if (size < 18 || GetU16(body + 16) != size - 18) {
+					return false;
+				}
+				wav.formatTag = GetU16(body);
+				wav.channels = GetU16(body + 2);
+				wav.sampleRate = GetU32(body + 4);
+				wav.byteRate = GetU32(body + 8);
+				wav.blockAlign = GetU16(body + 12);
+				wav.bitsPerSample = GetU16(body + 14);
+				hasFormat = true;
+			}
+			else if (memcmp(id, "fact", 4) == 0) {
+				if (size < 4) {
+					return false;
+				}
+				wav.hasFact = true;
+				wav.factFrames = GetU32(body);
+			}
+			else if (memcmp(id, "data", 4) == 0) {
+				wav.samples.resize(size / sizeof(float));
+				memcpy(wav.samples.data(), body, wav.samples.size() * sizeof(float));
+				hasData = true;
+			}
+			offset += 8 + size + (size & 1);
+		}
+		return hasFormat && hasData && offset == data.size();
+	}
+
+	void TestRoundTrip(int channels, int sampleRate) {
+		auto path = (std::filesystem::temp_directory_path() / ("nv_wav_test_" + std::to_string(channels) + ".wav")).string();
+		std::vector<float> expected;
+		{
+			WavFileAudioSink sink(path, false);
+			NV_CHECK(sink.Open(channels, sampleRate, 0.02) == 0);
+			NV_CHECK(sink.GetChannels() == channels);
+			sink.SetVolume(0.5f);
+			sink.Start();
+
+			// 写半个缓冲区，时钟走一个缓冲区：后一半欠载，录进去的是静音
+			uint32_t half = sink.GetBufferFrames() / 2;
+			float* buffer = sink.GetBuffer(half);
+			NV_CHECK(buffer != nullptr);
+			for (uint32_t i = 0; i < half * channels; i++) {
+				buffer[i] = (float)sin(i * 0.01) * 0.9f;
+			}
+			expected.assign(buffer, buffer + half * channels);
+			sink.ReleaseBuffer(half);
+			sink.AdvanceClock((double)sink.GetBufferFrames() / sampleRate);
+			expected.resize((size_t)sink.GetBufferFrames() * channels, 0);
+
+			// 再写 100 帧正好播完
+			buffer = sink.GetBuffer(100);
+			for (int i = 0; i < 100 * channels; i++) {
+				buffer[i] = -1.0f + i * 0.001f;
+			}
+			expected.insert(expected.end(), buffer, buffer + 100 * channels);
+			sink.ReleaseBuffer(100);
+			sink.AdvanceClock(100.0 / sampleRate);
+			NV_CHECK(sink.GetPlayedFrames() * channels == expected.size());
+		}
+
+		WavFile wav;
+		if (!NV_CHECK(ReadWav(path, wav))) {
+			return;
+		}
+		NV_CHECK(wav.formatTag == 3);
+		NV_CHECK(wav.channels == channels && wav.sampleRate == (uint32_t)sampleRate);
+		NV_CHECK(wav.bitsPerSample == 32 && wav.blockAlign == channels * 4 && wav.byteRate == (uint32_t)sampleRate * channels * 4);
+		NV_CHECK(wav.hasFact && wav.factFrames * channels == expected.size());
+		NV_CHECK(wav.samples == expected);
+		std::filesystem::remove(path);
+	}
+
+	void TestEmpty() {
+		// 打开了没播放也是完整的文件
+		auto path = (std::filesystem::temp_directory_path() / "nv_wav_test_empty.wav").string();
+		{
+			WavFileAudioSink sink(path, false);
+			NV_CHECK(sink.Open(2, 44100, 0.05) == 0);
+		}
+		WavFile wav;
+		NV_CHECK(ReadWav(path, wav));
+		NV_CHECK(wav.hasFact && wav.factFrames == 0 && wav.samples.empty());
+		std::filesystem::remove(path);
+
+		// 打不开文件时 Open 失败
+		WavFileAudioSink bad((std::filesystem::temp_directory_path() / "nv_no_such_dir" / "a.wav").string(), false);
+		NV_CHECK(bad.Open(2, 44100, 0.05) < 0);
+	}
+}
+
+int main() {
+	TestRoundTrip(2, 48000);
+	TestRoundTrip(6, 44100);
+	TestEmpty();
+	return test::Result();
+}
@@ -0,0 +1,351 @@
+#include "Check.h"
+#include "TestFrame.h"
+#include "YUVConvert.h"
+#include "CpuFeatures.h"
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+#include <string>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+// YUVConvert 的三项检查：
+// 1. 每种格式、各种宽高、带行尾填充时 SIMD 内核和标量参考实现逐位相同
+// 2. 和 PixelShader.hlsl 的浮点运算（UNORM 采样、双线性的色度、(yuv - offset) * M、saturate、四舍五入）差不超过 1
+// 3. 和 libswscale 转出来的 RGBA 差不超过 1
+// 加 --bench 时再测 1080p 和 4K 的吞吐，和 libswscale 对比
+using namespace nv;
+
+namespace {
+	const int sizes[][2] = { { 1, 1 }, { 2, 2 }, { 3, 5 }, { 7, 3 }, { 16, 4 }, { 17, 9 }, { 31, 2 }, { 33, 7 }, { 64, 3 }, { 97, 5 } };
+
+	struct ConvertCase {
+		AVPixelFormat format;
+		RGBFormat dstFormat;
+		PixelFormatDesc desc;
+		ColorDescription colorDesc;
+		YUVCoeffs coeffs;
+	};
+
+	std::vector<ConvertCase> GetCases(AVColorSpace colorspace, AVColorRange range) {
+		std::vector<ConvertCase> cases;
+		for (auto pixDesc = av_pix_fmt_desc_next(nullptr); pixDesc; pixDesc = av_pix_fmt_desc_next(pixDesc)) {
+			auto format = av_pix_fmt_desc_get_id(pixDesc);
+			for (auto dstFormat : { RGBFormat::RGBA8, RGBFormat::RGB10A2 }) {
+				ConvertCase test = { format, dstFormat };
+				if (!GetYUVConverterRef(format, dstFormat) || !GetPixelFormatDesc(format, test.desc)) {
+					continue;
+				}
+				// 和 SoftwareRenderer 一样按 CPU 计算的位深生成矩阵
+				int bitDepth = GetYUVBitDepth(format);
+				test.colorDesc = { test.desc.isRGB ? AVCOL_SPC_RGB : colorspace, range, AVCOL_PRI_UNSPECIFIED, 1080, bitDepth, bitDepth > 8 ? 16 - bitDepth : 0 };
+				if (!test.desc.isRGB && !NV_CHECK(GetYUVCoeffs(format, dstFormat, GetYUVMatrix(test.colorDesc), test.coeffs))) {
+					continue;
+				}
+				cases.push_back(test);
+			}
+		}
+		return cases;
+	}
+
+	test::TestFrame MakeRandomFrame(const ConvertCase& test, int width, int height) {
+		auto& random = test::GetRandom();
+		int maxValue = (1 << test.desc.bitDepth) - 1;
+		return test::MakeFrame(test.format, width, height, [&](int, int, int) { return (int)(random() % (maxValue + 1)); }, 8);
+	}
+
+	std::vector<uint8_t> Convert(YUVConvertFunc convert, const ConvertCase& test, const AVFrame& frame) {
+		// 输出也留行尾和哨兵，检查没有写出界
+		int pitch = frame.width * 4 + 12;
+		std::vector<uint8_t> out((size_t)pitch * frame.height + 16, 0x5A);
+		convert(frame.data, frame.linesize, frame.width, frame.height, out.data(), pitch, test.coeffs);
+		return out;
+	}
+
+	void TestKernels() {
+		int mismatches = 0;
+		for (auto& test : GetCases(AVCOL_SPC_BT709, AVCOL_RANGE_MPEG)) {
+			auto fast = GetYUVConverter(test.format, test.dstFormat);
+			auto ref = GetYUVConverterRef(test.format, test.dstFormat);
+			if (!NV_CHECK(fast)) {
+				continue;
+			}
+			for (auto& size : sizes) {
+				auto frame = MakeRandomFrame(test, size[0], size[1]);
+				if (Convert(fast, test, frame.frame) != Convert(ref, test, frame.frame)) {
+					mismatches++;
+					printf("%s %s to %s, %dx%d differs from the reference\n", GetYUVConverterName(), av_get_pix_fmt_name(test.format),
+						test.dstFormat == RGBFormat::RGBA8 ? "rgba8" : "rgb10a2", size[0], size[1]);
+				}
+			}
+		}
+		NV_CHECK(mismatches == 0);
+	}
+
+	// PixelShader.hlsl 的算法，全部用 double：纹理的 UNORM 值、亮度像素中心采样色度的双线性过滤（边缘 clamp）、矩阵、saturate
+	// 着色器用的矩阵按格式本身的位深和样本位置生成，和 main.cpp 的 GetColorDescription 一样
+	void ShaderReference(const ConvertCase& test, const AVFrame& frame, int x, int y, double rgb[3]) {
+		auto& desc = test.desc;
+		ColorDescription gpuDesc = test.colorDesc;
+		gpuDesc.bitDepth = desc.bitDepth;
+		gpuDesc.sampleShift = desc.sampleShift;
+		auto m = GetYUVMatrix(gpuDesc);
+
+		auto texel = [&](int component, int tx, int ty) {
+			auto& c = desc.components[component];
+			auto& plane = desc.planes[c.plane];
+			tx = std::clamp(tx, 0, GetPlaneWidth(desc, c.plane, frame.width) - 1);
+			ty = std::clamp(ty, 0, GetPlaneHeight(desc, c.plane, frame.height) - 1);
+			const uint8_t* p = frame.data[c.plane] + (size_t)ty * frame.linesize[c.plane] + ((size_t)tx * plane.channels + c.channel) * plane.bytesPerChannel;
+			if (plane.bytesPerChannel == 1) {
+				return *p / 255.0;
+			}
+			uint16_t v;
+			memcpy(&v, p, 2);
+			return v / 65535.0;
+		};
+
+		double yuv[3];
+		for (int c = 0; c < 3; c++) {
+			bool isChroma = c > 0 && !desc.isRGB;
+			int shiftX = isChroma ? desc.chromaShiftX : 0;
+			int shiftY = isChroma ? desc.chromaShiftY : 0;
+			// 亮度像素中心在这个平面的纹理坐标里的位置，减 0.5 得到双线性的左上角
+			double u = (x + 0.5) / (1 << shiftX) - 0.5;
+			double v = (y + 0.5) / (1 << shiftY) - 0.5;
+			int x0 = (int)floor(u), y0 = (int)floor(v);
+			double fx = u - x0, fy = v - y0;
+			yuv[c] = (texel(c, x0, y0) * (1 - fx) + texel(c, x0 + 1, y0) * fx) * (1 - fy)
+				+ (texel(c, x0, y0 + 1) * (1 - fx) + texel(c, x0 + 1, y0 + 1) * fx) * fy;
+		}
+
+		for (int c = 0; c < 3; c++) {
+			double sum = 0;
+			for (int i = 0; i < 3; i++) {
+				sum += (yuv[i] - m.offset[i]) * m.matrix[i][c];
+			}
+			rgb[c] = std::clamp(sum, 0.0, 1.0);
+		}
+	}
+
+	void GetPixel(const ConvertCase& test, const std::vector<uint8_t>& out, int pitch, int x, int y, int rgb[3]) {
+		const uint8_t* p = out.data() + (size_t)y * pitch + x * 4;
+		if (test.dstFormat == RGBFormat::RGBA8) {
+			rgb[0] = p[0];
+			rgb[1] = p[1];
+			rgb[2] = p[2];
+			return;
+		}
+		uint32_t v;
+		memcpy(&v, p, 4);
+		rgb[0] = v & 1023;
+		rgb[1] = (v >> 10) & 1023;
+		rgb[2] = (v >> 20) & 1023;
+	}
+
+	void TestShaderMath() {
+		for (auto colorspace : { AVCOL_SPC_BT709, AVCOL_SPC_SMPTE170M, AVCOL_SPC_BT2020_NCL }) {
+			for (auto range : { AVCOL_RANGE_MPEG, AVCOL_RANGE_JPEG }) {
+				for (auto& test : GetCases(colorspace, range)) {
+					// CPU 只用高 10 位。超过 10 位的格式截掉的低位让 Y、U、V 各少不到 1/1023，
+					// 经过矩阵（有限范围 BT.709 的 R 是 1.16Y + 1.83V）放大后输出 10 位时最多差 3，加上取整是 4
+					int tolerance = test.desc.bitDepth > 10 && test.dstFormat == RGBFormat::RGB10A2 ? 4 : 1;
+					int maxValue = test.dstFormat == RGBFormat::RGBA8 ? 255 : 1023;
+
+					auto frame = MakeRandomFrame(test, 33, 9);
+					auto out = Convert(GetYUVConverter(test.format, test.dstFormat), test, frame.frame);
+					int pitch = frame.frame.width * 4 + 12;
+					int maxDiff = 0;
+					for (int y = 0; y < frame.frame.height; y++) {
+						for (int x = 0; x < frame.frame.width; x++) {
+							double expected[3];
+							int actual[3];
+							ShaderReference(test, frame.frame, x, y, expected);
+							GetPixel(test, out, pitch, x, y, actual);
+							for (int c = 0; c < 3; c++) {
+								maxDiff = std::max(maxDiff, abs(actual[c] - (int)lround(expected[c] * maxValue)));
+							}
+						}
+					}
+					if (!NV_CHECK(maxDiff <= tolerance)) {
+						printf("  %s to %s, %s: differs from the shader by %d\n", av_get_pix_fmt_name(test.format),
+							test.dstFormat == RGBFormat::RGBA8 ? "rgba8" : "rgb10a2", GetColorSpaceName(test.colorDesc), maxDiff);
+					}
+				}
+			}
+		}
+	}
+
+	// libswscale 的矩阵编号
+	int GetSwsColorspace(AVColorSpace colorspace) {
+		switch (colorspace) {
+		case AVCOL_SPC_BT709:
+			return SWS_CS_ITU709;
+		case AVCOL_SPC_BT2020_NCL:
+			return SWS_CS_BT2020;
+		default:
+			return SWS_CS_ITU601;
+		}
+	}
+
+	// accurate 时色度按全分辨率插值、精确取整，用来比较结果；否则是 libswscale 默认的快速路径，用来比较速度
+	SwsContext* CreateSws(AVPixelFormat format, int width, int height, AVColorSpace colorspace, AVColorRange range, bool accurate) {
+		int flags = accurate ? SWS_BILINEAR | SWS_ACCURATE_RND | SWS_FULL_CHR_H_INT | SWS_FULL_CHR_H_INP : SWS_BILINEAR;
+		auto sws = sws_getContext(width, height, format, width, height, AV_PIX_FMT_RGBA, flags, nullptr, nullptr, nullptr);
+		if (sws) {
+			auto coefficients = sws_getCoefficients(GetSwsColorspace(colorspace));
+			sws_setColorspaceDetails(sws, coefficients, range == AVCOL_RANGE_JPEG, coefficients, 1, 0, 1 << 16, 1 << 16);
+		}
+		return sws;
+	}
+
+	// 和 libswscale 比。二次采样的格式 libswscale 的色度位置和滤波不一样，用平滑的画面比，差别只剩取整
+	void TestSwscale() {
+		constexpr int width = 128, height = 72;
+		const AVPixelFormat formats[] = { AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUV420P, AV_PIX_FMT_NV12, AV_PIX_FMT_YUV422P, AV_PIX_FMT_P010LE, AV_PIX_FMT_YUV420P10LE };
+		for (auto colorspace : { AVCOL_SPC_BT709, AVCOL_SPC_SMPTE170M }) {
+			for (auto range : { AVCOL_RANGE_MPEG, AVCOL_RANGE_JPEG }) {
+				for (auto format : formats) {
+					ConvertCase test = { format, RGBFormat::RGBA8 };
+					GetPixelFormatDesc(format, test.desc);
+					int bitDepth = GetYUVBitDepth(format);
+					test.colorDesc = { colorspace, range, AVCOL_PRI_UNSPECIFIED, height, bitDepth, bitDepth > 8 ? 16 - bitDepth : 0 };
+					GetYUVCoeffs(format, RGBFormat::RGBA8, GetYUVMatrix(test.colorDesc), test.coeffs);
+
+					// libswscale 对超出 16..235（色度 16..240）的有限范围样本会溢出回绕，只用合法的值
+					int shift = test.desc.bitDepth - 8;
+					int maxValue = (1 << test.desc.bitDepth) - 1;
+					auto frame = test::MakeFrame(format, width, height, [&](int c, int x, int y) {
+						int w = c == 0 ? width : GetPlaneWidth(test.desc, 1, width);
+						int h = c == 0 ? height : GetPlaneHeight(test.desc, 1, height);
+						double t = c == 0 ? (double)(x + y) / (w + h) : c == 1 ? (double)x / w : (double)y / h;
+						if (range == AVCOL_RANGE_JPEG) {
+							return (int)lround(t * maxValue);
+						}
+						int low = 16 << shift;
+						int high = (c == 0 ? 235 : 240) << shift;
+						return low + (int)lround(t * (high - low));
+					});
+
+					auto ours = Convert(GetYUVConverter(format, RGBFormat::RGBA8), test, frame.frame);
+					int pitch = width * 4 + 12;
+
+					auto sws = CreateSws(format, width, height, colorspace, range, true);
+					if (!NV_CHECK(sws)) {
+						continue;
+					}
+					std::vector<uint8_t> theirs((size_t)width * height * 4);
+					uint8_t* dst[] = { theirs.data() };
+					int dstStride[] = { width * 4 };
+					sws_scale(sws, frame.frame.data, frame.frame.linesize, 0, height, dst, dstStride);
+					sws_freeContext(sws);
+
+					int maxDiff = 0;
+					double sumDiff = 0;
+					for (int y = 0; y < height; y++) {
+						for (int x = 0; x < width; x++) {
+							for (int c = 0; c < 3; c++) {
+								int diff = abs(ours[(size_t)y * pitch + x * 4 + c] - theirs[((size_t)y * width + x) * 4 + c]);
+								maxDiff = std::max(maxDiff, diff);
+								sumDiff += diff;
+							}
+						}
+					}
+					double meanDiff = sumDiff / (width * height * 3);
+					if (!NV_CHECK(maxDiff <= 1 && meanDiff < 0.3)) {
+						printf("  %s %s: max diff %d, mean %.3f against libswscale\n", av_get_pix_fmt_name(format), GetColorSpaceName(test.colorDesc), maxDiff, meanDiff);
+					}
+				}
+			}
+		}
+	}
+
+	double MeasureMilliseconds(const std::function<void()>& run) {
+		// 取几次里最快的
+		double best = 1e30;
+		for (int i = 0; i < 10; i++) {
+			auto start = std::chrono::steady_clock::now();
+			run();
+			best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		return best;
+	}
+
+	void Bench() {
+		const AVPixelFormat formats[] = { AV_PIX_FMT_NV12, AV_PIX_FMT_YUV420P, AV_PIX_FMT_P010LE, AV_PIX_FMT_YUV420P10LE };
+		printf("%-14s %-9s %-8s %9s %9s %9s %9s %9s  (ms)\n", "format", "size", "output", "scalar", "sse4.1", GetYUVConverterName(), "swscale", "speedup");
+		for (auto size : { std::make_pair(1920, 1080), std::make_pair(3840, 2160) }) {
+			int width = size.first, height = size.second;
+			for (auto format : formats) {
+				for (auto dstFormat : { RGBFormat::RGBA8, RGBFormat::RGB10A2 }) {
+					ConvertCase test = { format, dstFormat };
+					GetPixelFormatDesc(format, test.desc);
+					int bitDepth = GetYUVBitDepth(format);
+					test.colorDesc = { AVCOL_SPC_BT709, AVCOL_RANGE_MPEG, AVCOL_PRI_BT709, height, bitDepth, bitDepth > 8 ? 16 - bitDepth : 0 };
+					GetYUVCoeffs(format, dstFormat, GetYUVMatrix(test.colorDesc), test.coeffs);
+					auto frame = MakeRandomFrame(test, width, height);
+					std::vector<uint8_t> out((size_t)width * height * 4);
+					auto run = [&](YUVConvertFunc convert) {
+						return MeasureMilliseconds([&] { convert(frame.frame.data, frame.frame.linesize, width, height, out.data(), width * 4, test.coeffs); });
+					};
+
+					double scalar = run(GetYUVConverterRef(format, dstFormat));
+					double sse = 0;
+					if (cpu::HasAVX2()) {
+						cpu::DisableAVX2(true);
+						sse = run(GetYUVConverter(format, dstFormat));
+						cpu::DisableAVX2(false);
+					}
+					double fast = run(GetYUVConverter(format, dstFormat));
+
+					// libswscale 只比 RGBA8，它没有 R10G10B10A2 的输出
+					double swscale = 0;
+					if (dstFormat == RGBFormat::RGBA8) {
+						auto sws = CreateSws(format, width, height, AVCOL_SPC_BT709, AVCOL_RANGE_MPEG, false);
+						uint8_t* dst[] = { out.data() };
+						int dstStride[] = { width * 4 };
+						swscale = MeasureMilliseconds([&] { sws_scale(sws, frame.frame.data, frame.frame.linesize, 0, height, dst, dstStride); });
+						sws_freeContext(sws);
+					}
+
+					char sizeName[16];
+					snprintf(sizeName, sizeof(sizeName), "%dx%d", width, height);
+					printf("%-14s %-9s %-8s %9.2f %9.2f %9.2f", av_get_pix_fmt_name(format), sizeName,
+						dstFormat == RGBFormat::RGBA8 ? "rgba8" : "rgb10a2", scalar, sse, fast);
+					if (swscale > 0) {
+						printf(" %9.2f %8.1fx\n", swscale, swscale / fast);
+					}
+					else {
+						printf(" %9s %9s\n", "-", "-");
+					}
+				}
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+		Bench();
+		return 0;
+	}
+
+	TestKernels();
+	// 有 AVX2 时再关掉它测一遍 SSE4.1
+	if (cpu::HasAVX2()) {
+		auto avx2Kernel = GetYUVConverter(AV_PIX_FMT_NV12, RGBFormat::RGBA8);
+		cpu::DisableAVX2(true);
+		NV_CHECK(GetYUVConverter(AV_PIX_FMT_NV12, RGBFormat::RGBA8) != avx2Kernel);
+		TestKernels();
+		cpu::DisableAVX2(false);
+		NV_CHECK(GetYUVConverter(AV_PIX_FMT_NV12, RGBFormat::RGBA8) == avx2Kernel);
+	}
+
+	TestShaderMath();
+	TestSwscale();
+	return test::Result();
+}
@@ -0,0 +1,60 @@
+#include "../Check.h"
+#include "CropDetector.h"
+#include "CpuFeatures.h"
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+
+// 4K 2.39:1 的画面检测一次黑边的耗时，8 位和 P010，标量参考实现和当前 CPU 能用的每一级 SIMD 对比
+using namespace nv;
+
+namespace {
+	constexpr int width = 3840;
+	constexpr int height = 2160;
+
+	double Measure(CropRect (*detect)(const LumaPlane&, int), const LumaPlane& plane) {
+		// 取几轮里最快的一次，排除调度的干扰
+		double best = 1e30;
+		for (int round = 0; round < 50; round++) {
+			auto start = std::chrono::steady_clock::now();
+			detect(plane, 24);
+			best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		return best;
+	}
+}
+
+int main() {
+	int bar = (height - (int)(width / 2.39 + 0.5)) / 2;
+	auto& random = test::GetRandom();
+	printf("%-6s %9s %9s %9s  (ms, %dx%d, bars %d rows)\n", "bytes", "scalar", "sse2", "avx2", width, height, bar);
+	for (int bytesPerSample = 1; bytesPerSample <= 2; bytesPerSample++) {
+		int shift = bytesPerSample == 1 ? 0 : 8;
+		std::vector<uint8_t> data((size_t)width * height * bytesPerSample);
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				int v = y < bar || y >= height - bar ? 16 : 40 + random() % 100;
+				uint8_t* p = &data[((size_t)y * width + x) * bytesPerSample];
+				if (bytesPerSample == 1) {
+					*p = (uint8_t)v;
+				}
+				else {
+					uint16_t sample = (uint16_t)(v << shift);
+					memcpy(p, &sample, 2);
+				}
+			}
+		}
+		LumaPlane plane = { data.data(), width * bytesPerSample, width, height, bytesPerSample, shift };
+
+		double scalar = Measure(DetectCropRef, plane);
+		double sse = 0;
+		if (cpu::HasAVX2()) {
+			cpu::DisableAVX2(true);
+			sse = Measure(DetectCrop, plane);
+			cpu::DisableAVX2(false);
+		}
+		double fast = Measure(DetectCrop, plane);
+		printf("%-6d %9.3f %9.3f %9.3f\n", bytesPerSample, scalar, sse, fast);
+	}
+	return 0;
+}
@@ -0,0 +1,57 @@
+#include "../Check.h"
+#include "Dither.h"
+#include "CpuFeatures.h"
+#include <chrono>
+#include <algorithm>
+#include <functional>
+
+// CPU 渲染路径上一帧 4K RGB10A2 抖动成 RGBA8 的耗时（原地，和 SoftwareRenderer 一样），每种模式，标量参考实现和当前 CPU 能用的每一级 SIMD 对比
+using namespace nv;
+
+namespace {
+	constexpr int width = 3840;
+	constexpr int height = 2160;
+
+	double Measure(const std::function<void()>& run) {
+		// 取几轮里最快的一次，排除调度的干扰
+		double best = 1e30;
+		for (int round = 0; round < 20; round++) {
+			auto start = std::chrono::steady_clock::now();
+			run();
+			best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		return best;
+	}
+}
+
+int main() {
+	std::vector<uint8_t> source((size_t)width * height * 4);
+	test::FillRandom(source);
+	std::vector<uint8_t> frame(source.size());
+
+	// 第一次用到时才生成蓝噪声表，不算在内
+	GetDitherMatrix(DitherMode::BlueNoise);
+
+	printf("%-11s %9s %9s %9s  (ms, %dx%d)\n", "mode", "scalar", "sse4.1", "avx2", width, height);
+	for (auto mode : { DitherMode::None, DitherMode::Ordered, DitherMode::BlueNoise }) {
+		auto run = [&](decltype(DitherRGB10A2)* dither) {
+			return Measure([&] {
+				frame = source;
+				dither(frame.data(), width * 4, width, height, frame.data(), width * 4, mode);
+			});
+		};
+		// 复制源数据的时间要扣掉
+		double copy = Measure([&] { frame = source; });
+
+		double scalar = run(DitherRGB10A2Ref) - copy;
+		double sse = 0;
+		if (cpu::HasAVX2()) {
+			cpu::DisableAVX2(true);
+			sse = run(DitherRGB10A2) - copy;
+			cpu::DisableAVX2(false);
+		}
+		double fast = run(DitherRGB10A2) - copy;
+		printf("%-11s %9.3f %9.3f %9.3f\n", GetDitherModeName(mode), scalar, sse, fast);
+	}
+	return 0;
+}
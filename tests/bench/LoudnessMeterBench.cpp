@@ -0,0 +1,49 @@
+#include "../Check.h"
+#include "LoudnessMeter.h"
+#include "SampleConvert.h"
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+
+// 预扫描里解码之后的那部分：解码器输出的 fltp 转成交错 float，再过 K 加权和门限统计。单核，按解码器一帧 1024 个样本喂
+// 结果是实时的多少倍，预扫描整体要 200 倍以上，这部分应该远高于它，剩下的时间留给 demuxer 和解码器（LoudnessScannerBench 测整体）
+using namespace nv;
+
+namespace {
+	constexpr int chunkFrames = 1024;
+	constexpr int seconds = 60;
+}
+
+int main() {
+	auto convert = GetSampleConverter(AV_SAMPLE_FMT_FLTP);
+	printf("%3s %6s %12s %12s  (%s, %d s of audio)\n", "ch", "rate", "ms/s audio", "x realtime", GetSampleConverterName(), seconds);
+	for (int rate : { 44100, 48000, 96000 }) {
+		for (int channels : { 2, 6, 8 }) {
+			std::vector<std::vector<float>> planes(channels, std::vector<float>(chunkFrames));
+			std::vector<const uint8_t*> src;
+			for (int c = 0; c < channels; c++) {
+				for (int i = 0; i < chunkFrames; i++) {
+					planes[c][i] = 0.3f * (float)sin(i * 0.05 * (c + 1));
+				}
+				src.push_back((const uint8_t*)planes[c].data());
+			}
+			std::vector<float> samples((size_t)chunkFrames * channels);
+
+			// 取几轮里最快的一次，排除调度的干扰
+			int chunks = seconds * rate / chunkFrames;
+			double best = 1e30;
+			for (int round = 0; round < 3; round++) {
+				LoudnessMeter meter(channels, rate, 0);
+				auto start = std::chrono::steady_clock::now();
+				for (int i = 0; i < chunks; i++) {
+					convert(src.data(), samples.data(), chunkFrames, channels);
+					meter.Process(samples.data(), chunkFrames);
+				}
+				best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+			}
+			double ms = best * rate / ((double)chunks * chunkFrames);
+			printf("%3d %6d %12.3f %12.0f\n", channels, rate, ms, 1000 / ms);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,65 @@
+#include "../Check.h"
+#include "LoudnessScanner.h"
+#include "WavFileAudioSink.h"
+#include "MediaCache.h"
+#include <math.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <filesystem>
+
+// 整个预扫描（demuxer + 解码 + 响度计）的速度，实时的多少倍，要求单核 200 倍以上
+// 不带参数时用 WavFileAudioSink 生成 10 分钟 48 kHz 的 5.1 float WAV 来扫；也可以给一个文件路径，扫真实的片源
+// 每次扫完删掉缓存，不然第二次直接读缓存
+using namespace nv;
+
+namespace {
+	std::string MakeWav() {
+		auto path = (std::filesystem::temp_directory_path() / "nv_loudness_bench.wav").string();
+		constexpr int channels = 6, rate = 48000;
+		WavFileAudioSink sink(path, false);
+		sink.Open(channels, rate, 1);
+		sink.Start();
+		uint64_t t = 0;
+		for (int second = 0; second < 600; second++) {
+			float* buffer = sink.GetBuffer(rate);
+			for (int i = 0; i < rate; i++, t++) {
+				// 响度每 10 秒变一次，门限要去掉一部分
+				float level = (float)pow(10, -(20 + (second / 10) % 4 * 6) / 20.0);
+				for (int c = 0; c < channels; c++) {
+					buffer[i * channels + c] = level * (float)sin(t * 0.02 * (c + 1));
+				}
+			}
+			sink.ReleaseBuffer(rate);
+			sink.AdvanceClock(1);
+		}
+		sink.Close();
+		return path;
+	}
+}
+
+int main(int argc, char** argv) {
+	bool isGenerated = argc < 2;
+	std::string path = isGenerated ? MakeWav() : argv[1];
+
+	double best = 0, lufs = 0;
+	for (int round = 0; round < 3; round++) {
+		std::filesystem::remove(U8Path(GetMediaCachePath(path, "loudness", ".txt")));
+		LoudnessScanner scanner(path);
+		while (!scanner.IsDone()) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		if (!scanner.GetLoudness(lufs)) {
+			printf("%s: scan failed\n", path.c_str());
+			return 1;
+		}
+		best = std::max(best, scanner.GetSpeed());
+	}
+	std::filesystem::remove(U8Path(GetMediaCachePath(path, "loudness", ".txt")));
+	printf("%s: %.2f LUFS, %.0fx real time\n", path.c_str(), lufs, best);
+
+	if (isGenerated) {
+		std::filesystem::remove(path);
+	}
+	return 0;
+}
@@ -0,0 +1,68 @@
+#include "../Check.h"
+#include "SampleConvert.h"
+#include "CpuFeatures.h"
+#include <chrono>
+#include <algorithm>
+
+// 每种格式转成交错 float 的吞吐（输出样本数 / 纳秒），标量参考实现和当前 CPU 能用的每一级 SIMD 对比
+using namespace nv;
+
+namespace {
+	constexpr int frames = 48000;
+
+	double Measure(SampleConvertFunc convert, const uint8_t* const* src, float* dst, int channels) {
+		// 取几轮里最快的一次，排除调度的干扰
+		double best = 1e30;
+		for (int round = 0; round < 5; round++) {
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < 20; i++) {
+				convert(src, dst, frames, channels);
+			}
+			best = std::min(best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / 20);
+		}
+		return (double)frames * channels / best;
+	}
+}
+
+int main() {
+	const AVSampleFormat formats[] = {
+		AV_SAMPLE_FMT_U8, AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_S32, AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_DBL, AV_SAMPLE_FMT_S64,
+		AV_SAMPLE_FMT_U8P, AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_S32P, AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_DBLP, AV_SAMPLE_FMT_S64P,
+	};
+
+	bool hasAVX2 = cpu::HasAVX2();
+	printf("%-6s %3s %10s %10s %10s  (samples/ns)\n", "format", "ch", "scalar", hasAVX2 ? "sse2" : "", GetSampleConverterName());
+
+	for (auto format : formats) {
+		for (int channels : { 2, 6 }) {
+			int planeCount = av_sample_fmt_is_planar(format) ? channels : 1;
+			std::vector<std::vector<uint8_t>> planes(planeCount, std::vector<uint8_t>((size_t)frames * channels * 8));
+			std::vector<const uint8_t*> src;
+			for (auto& plane : planes) {
+				// 随机的位模式对浮点格式会有 NaN 和非规格化数，浮点格式换成 -1..1 的值
+				test::FillRandom(plane);
+				auto packed = av_get_packed_sample_fmt(format);
+				for (size_t i = 0; packed == AV_SAMPLE_FMT_FLT && i < plane.size() / 4; i++) {
+					((float*)plane.data())[i] = (float)(i % 2000) / 1000 - 1;
+				}
+				for (size_t i = 0; packed == AV_SAMPLE_FMT_DBL && i < plane.size() / 8; i++) {
+					((double*)plane.data())[i] = (double)(i % 2000) / 1000 - 1;
+				}
+				src.push_back(plane.data());
+			}
+			std::vector<float> dst((size_t)frames * channels);
+
+			double scalar = Measure(GetSampleConverterRef(format), src.data(), dst.data(), channels);
+			double sse2 = 0;
+			if (hasAVX2) {
+				cpu::DisableAVX2(true);
+				sse2 = Measure(GetSampleConverter(format), src.data(), dst.data(), channels);
+				cpu::DisableAVX2(false);
+			}
+			double fast = Measure(GetSampleConverter(format), src.data(), dst.data(), channels);
+
+			printf("%-6s %3d %10.2f %10.2f %10.2f\n", av_get_sample_fmt_name(format), channels, scalar, sse2, fast);
+		}
+	}
+	return 0;
+}
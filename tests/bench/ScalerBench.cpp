@@ -0,0 +1,66 @@
+#include "../Check.h"
+#include "Scaler.h"
+#include "SoftwareRenderer.h"
+#include "CpuFeatures.h"
+#include <chrono>
+#include <algorithm>
+#include <functional>
+
+// CPU 渲染路径上缩放一帧的耗时：4K 缩小到 1080p 的窗口，480p 放大到 1080p，每种核，标量参考实现和当前 CPU 能用的每一级 SIMD 对比
+// 权重表由 ScaleWeightCache 缓存，不算在内；最后一列是生成一次权重表的耗时
+using namespace nv;
+
+namespace {
+	constexpr int viewWidth = 1920;
+	constexpr int viewHeight = 1080;
+
+	double Measure(const std::function<void()>& run) {
+		// 取几轮里最快的一次，排除调度的干扰
+		double best = 1e30;
+		for (int round = 0; round < 10; round++) {
+			auto start = std::chrono::steady_clock::now();
+			run();
+			best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		return best;
+	}
+}
+
+int main() {
+	printf("%-11s %-12s %9s %9s %9s %9s  (ms, to %dx%d)\n", "source", "filter", "scalar", "sse4.1", "avx2", "weights", viewWidth, viewHeight);
+	for (auto size : { std::make_pair(3840, 2160), std::make_pair(720, 480) }) {
+		int width = size.first, height = size.second;
+		std::vector<uint8_t> src((size_t)width * height * 4);
+		test::FillRandom(src);
+		std::vector<uint8_t> dst((size_t)viewWidth * viewHeight * 4);
+		std::vector<int16_t> temp;
+
+		double scaleX, scaleY;
+		GetFitScale(width, height, viewWidth, viewHeight, scaleX, scaleY);
+		for (auto filter : { ScaleFilter::Bilinear, ScaleFilter::CatmullRom, ScaleFilter::Bicubic, ScaleFilter::Lanczos3 }) {
+			auto columns = MakeScaleWeights(filter, width, viewWidth, scaleX);
+			auto rows = MakeScaleWeights(filter, height, viewHeight, scaleY);
+			auto run = [&](decltype(ScaleRGBA)* scale) {
+				return Measure([&] { scale(*columns, *rows, src.data(), width * 4, dst.data(), viewWidth * 4, temp); });
+			};
+
+			double scalar = run(ScaleRGBARef);
+			double sse = 0;
+			if (cpu::HasAVX2()) {
+				cpu::DisableAVX2(true);
+				sse = run(ScaleRGBA);
+				cpu::DisableAVX2(false);
+			}
+			double fast = run(ScaleRGBA);
+			double weights = Measure([&] {
+				MakeScaleWeights(filter, width, viewWidth, scaleX);
+				MakeScaleWeights(filter, height, viewHeight, scaleY);
+			});
+
+			char sizeName[16];
+			snprintf(sizeName, sizeof(sizeName), "%dx%d", width, height);
+			printf("%-11s %-12s %9.2f %9.2f %9.2f %9.3f\n", sizeName, GetScaleFilterName(filter), scalar, sse, fast, weights);
+		}
+	}
+	return 0;
+}